@@ -6,7 +6,11 @@
 #include <unordered_map>
 #include <string>
 #include <cstdint>
+#include <cstdio>
+#include <memory>
 #include <mutex>
+#include <atomic>
+#include <array>
 #include <functional>
 #include "../http/http_response.h"
 #include <cynnypp/bloom_filters.hpp>
@@ -17,31 +21,54 @@
 #include "cache_element.h"
 #include "ttl_cleaner.h"
 #include "tag.h"
+#include "memory_tier.h"
+#include "journal.h"
+#include "mapped_file.h"
 #include "../fs/fs_manager_wrapper.h"
+#include "../stats/stats_manager.h"
 #include "../utils/log_wrapper.h"
+#include "../utils/dstring.h"
 
 
 /** \brief the cache class provides a basic cache functionality in the form of key-value interrogations
  * on a data structure. It interacts with the disk in order to store the value information.
  * It is basically a mediator between different indexes and the disk.
  *
- * \tparam replacement_policy the policy used to evict elements in case cache space is exhausted 4
+ * The keys are split among independent shards by their hash: every shard has its own indexes, replacement policy
+ * and lock, so that operations on different shards do not contend. Only the byte budget is shared.
+ *
+ * Every shard logs the elements it stores in a journal, so that a new cache can find again the contents left on disk
+ * by the previous one.
+ *
+ * \tparam replacement_policy the policy used to evict elements in case cache space is exhausted (see policies/)
  * \tparam key_t the type of the key
  * \tparam max_elements_size the maximum number of elements to be stored in the cache (defaults to 2^20)
+ * \tparam shards_count the number of shards; each one can store up to max_elements_size / shards_count elements
  * */
-template<template<class> class replacement_policy, typename key_t = std::string, size_t max_elements_size = 1024 * 1024>
+template<template<class> class replacement_policy, typename key_t = std::string, size_t max_elements_size = 1024 * 1024,
+	size_t shards_count = 16>
 class cache
 {
 	static bool _has_instance;
 	static std::mutex singleton_mutex;
 	static std::unique_ptr<cache> instance;
 
+	/** Maximum number of elements stored by a single shard */
+	static constexpr size_t shard_elements_size = max_elements_size / shards_count;
+	static_assert( shards_count > 0 && shard_elements_size > 0, "every shard must be able to store some elements" );
+
 	/** Structure used for fast lookup*/
-	using bloom_filter = cynny::cynnypp::bloom_filters::CountingBloomFilter<max_elements_size * 2, 3, 4, key_t>;
+	using bloom_filter = cynny::cynnypp::bloom_filters::CountingBloomFilter<shard_elements_size * 2, 3, 4, key_t>;
 	/** Structure used to store and return back the values stored in the cache */
 	using output_data_t = std::vector<uint8_t>;
 	/** Type of the read callback */
 	using read_callback = std::function<void( output_data_t )>;
+	/** Values shared with the memory tier; they are never modified */
+	using shared_data_t = typename memory_tier<int>::data_t;
+	/** Type of the read callback receiving the shared value */
+	using shared_read_callback = std::function<void( shared_data_t )>;
+	/** Type of the read callback receiving a view on the value, backed by the memory tier or by the mapped file */
+	using view_read_callback = std::function<void( dstring )>;
 
 	/** \brief temp_cache_representation is a temporary representation of an element in the cache; it is used
 	 *  before the value associated to a certain key has been provided completely to the cache, hence before
@@ -56,19 +83,27 @@ class cache
 		 * */
 		temp_cache_representation( uint32_t ttl, std::chrono::system_clock::time_point creation_time,
 			const std::string& tag, const std::string& etag )
-			: data(), ttl{ ttl }, creation_time{ creation_time }, tag{ tag }, etag{ etag } {}
+			: ttl{ ttl }, creation_time{ creation_time }, tag{ tag }, etag{ etag } {}
 
 		/** creates a temp_cache_representation object
 		 * \param ttl user provided time to live of the resource
 		 * \param tag user provided category (or tag) for the element; used for selective, user mandated eviction*/
 		temp_cache_representation( uint32_t ttl, std::chrono::system_clock::time_point creation_time,
-			const std::string& tag ) : data(), ttl{ ttl }, creation_time{ creation_time }, tag{ tag }, etag{} {}
+			const std::string& tag ) : ttl{ ttl }, creation_time{ creation_time }, tag{ tag }, etag{} {}
 
 		temp_cache_representation( uint32_t ttl, std::chrono::system_clock::time_point creation_time )
-			: data(), ttl{ ttl }, creation_time{ creation_time }, tag{}, etag{} {}
-
-		/* Data */
-		std::vector<uint8_t> data;
+			: ttl{ ttl }, creation_time{ creation_time }, tag{}, etag{} {}
+
+		/** Data received and not written yet: at most a segment */
+		std::shared_ptr<std::vector<uint8_t>> segment{ std::make_shared<std::vector<uint8_t>>() };
+		/** Temporary file the segments are written to, renamed on commit */
+		std::string path;
+		/** Bytes written to the temporary file */
+		size_t written{ 0 };
+		/** Segments being written */
+		size_t writing{ 0 };
+		/** The temporary file has been created by the first segment */
+		bool created{ false };
 		/** TimeToLive*/
 		unsigned int ttl;
 		std::chrono::system_clock::time_point creation_time;
@@ -83,6 +118,7 @@ class cache
 		{
 			finished = true;
 			invalidated = true;
+			segment.reset();
 		}
 	};
 
@@ -96,40 +132,155 @@ class cache
 		}
 	};
 
+	/** Elements being put, by key */
+	using fills_t = std::unordered_map<key_t, temp_cache_representation, city_hash>;
+
+	/** \brief a shard owns the indexes of the keys hashed to it, together with the lock protecting them. */
+	struct shard
+	{
+		shard() :
+			approximate_membership
+				{
+					{
+						[]( const key_t& c )
+						{
+							const uint128 seed{ 58966895434, 23289789237897 };
+							return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
+						},
+						[]( const key_t& c )
+						{
+							const uint128 seed{ 574542563448, 8679805476824 };
+							return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
+						},
+						[]( const key_t& c )
+						{
+							const uint128 seed{ 2574657455567, 878679086346 };
+							return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
+						}
+					}
+				}
+		{}
+
+		/** Translation unit: transforms key_t (usually an expensive type) in rather unexpensive ids of type uint32_t */
+		translation_unit<key_t, cache_element, city_hash, static_cast<int>(shard_elements_size)> elements;
+		/** Index of the elements ordered by ttl, used to evict expired elements*/
+		ttl_cleaner<shard_elements_size * 2, 32> ttl;
+		/** Data structure used to store the <key,value> pairs before "commit" on diks*/
+		fills_t tmp;
+		/** Number of puts begun, naming their temporary files */
+		size_t fills = 0;
+		/** Policy manager, decides which between the valid elements should be evicted. */
+		replacement_policy<int> rp;
+		/** Tag index, stores elements by tag*/
+		tagger<std::string, int> tag_indexes;
+		/** appproximate membership structure*/
+		bloom_filter approximate_membership;
+		/** Contents read recently, served without going to the disk */
+		memory_tier<int> memory;
+		/** Log of the stored elements, read on startup */
+		journal index_journal;
+		std::mutex mutex{};
+		/** Temporary used to store how much of the data was freed during the cleaning operation triggered by evict*/
+		size_t freed_size = 0;
+
+		/** Verifies if an element associated to a certain key is contained in the shard, without performing locks.
+		 * Used only for the inner logic.
+		 *
+		 * \param key the key of the element for which an existence verification is required
+		 * \return true if the key is stored in the cache with an associated value, false otherwise.
+		 *
+		 * */
+		bool lockless_has( const key_t& key )
+		{
+			bool approximate_has = approximate_membership.has( key );
+			if ( !approximate_has ) return false;
+			return elements.has( key );
+		}
+	};
+
 	/** Cache base dir, used to store the contents.*/
 	std::string base_dir;
-	/** Translation unit: transforms key_t (usually an expensive type) in rather unexpensive ids of type uint32_t */
-	translation_unit<key_t, cache_element, city_hash> elements;
-	/** Index of the elements ordered by ttl, used to evict expired elements*/
-	ttl_cleaner<max_elements_size * 2, 32> ttl;
-	/** Data structure used to store the <key,value> pairs before "commit" on diks*/
-	std::unordered_map<key_t, temp_cache_representation, city_hash> tmp;
-	/** Policy manager, decides which between the valid elements should be evicted. */
-	replacement_policy<int> rp;
-	/** Tag index, stores elements by tag*/
-	tagger<std::string, int> tag_indexes;
-	std::mutex global_mutex{};
-	/** Total size of the cache. */
-	uint64_t total_size = 0;
-	/** appproximate membership structure*/
-	bloom_filter approximate_membership;
+	/** The shards; a key always belongs to the same one */
+	std::array<shard, shards_count> shards;
+	/** Total size of the cache, shared by all the shards. */
+	std::atomic<uint64_t> total_size{ 0 };
 	/** Maximum allowed size of the cache (in terms of the total size occupied by the *values*) */
 	size_t max_bytes_size = 0;
-	/** Temporary used to store how much of the data was freed during the cleaning operation triggered by evict*/
-	size_t freed_size;
 
-	/** Verifies if an element associated to a certain key is contained in the cache, without performing locks.
-	 * Used only for the inner logic.
-	 *
-	 * \param key the key of the element for which an existence verification is required
-	 * \return true if the key is stored in the cache with an associated value, false otherwise.
-	 *
-	 * */
-	bool lockless_has( const key_t& key )
+	/** Index of the shard a key belongs to; the hash is independent from the one used by the shard indexes. */
+	static size_t shard_index( const key_t& key )
 	{
-		bool approximate_has = approximate_membership.has( key );
-		if ( !approximate_has ) return false;
-		return elements.has( key );
+		return CityHash64( key.data(), key.size()) % shards_count;
+	}
+
+	shard& shard_of( const key_t& key )
+	{
+		return shards[ shard_index( key ) ];
+	}
+
+	/** Installs the callbacks of the indexes of a shard, which could trigger spontaneous remove operations. */
+	void set_remove_callbacks( shard& s )
+	{
+		s.ttl.set_remove_callback( [ this, &s ]( const unsigned int id )
+			{
+				auto& k = s.elements.get_key( id );
+				s.approximate_membership.remove( k );
+				s.index_journal.remove( k );
+
+				s.rp.remove( id );
+				s.memory.remove( id );
+				std::string tag = s.tag_indexes.remove( id );
+				auto name = get_fs_name( this->base_dir, k, tag );
+				try {
+					cynny::cynnypp::filesystem::removeFile( name.second );
+				}
+				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
+				}
+				size_t element_size = s.elements.remove( id );
+				s.freed_size += element_size;
+			}
+		);
+
+		s.elements.set_remove_callback( [ this, &s ]( const std::string& str, const unsigned int id,
+				std::chrono::system_clock::time_point expiry_time, size_t size )
+			{
+				s.ttl.thorough_remove_element( id, expiry_time );
+				s.approximate_membership.remove( str );
+				s.index_journal.remove( str );
+				s.rp.remove( id );
+				s.memory.remove( id );
+				total_size -= size;
+				std::string tag = s.tag_indexes.remove( id );
+				auto name = get_fs_name( this->base_dir, str, tag );
+				try {
+					cynny::cynnypp::filesystem::removeFile( name.second );
+				}
+				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
+				}
+			}
+		);
+
+		s.rp.set_remove_callback( [ this, &s ]( unsigned int id )
+			{
+				auto& k = s.elements.get_key( id );
+				s.approximate_membership.remove( k );
+				s.index_journal.remove( k );
+				s.ttl.thorough_remove_element( id );
+				s.memory.remove( id );
+				std::string tag = s.tag_indexes.remove( id );
+
+				auto name = get_fs_name( this->base_dir, k, tag );
+				try {
+					cynny::cynnypp::filesystem::removeFile( name.second );
+				}
+				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
+				}
+				s.elements.remove( id );
+			}
+		);
 	}
 
 	/** Returns the filename on disk for a given content
@@ -170,107 +321,244 @@ class cache
 		return ss.str();
 	}
 
-public:
-	/** Creates a new cache
-	 *  \param max_bytes_size the maximum size occupied by the cache
-	 *  \param base_dir the base directory used to write the files on disk.
+	/** Removes an element from the indexes of its shard, and its content from the disk.
+	 * The shard must be locked by the caller.
 	 * */
+	void lockless_invalidate( shard& s, const cache_element* el )
+	{
+		total_size -= el->_size;
+		int id = el->id;
+		s.ttl.thorough_remove_element( id );
+		s.tag_indexes.remove( id );
+		s.rp.remove( id );
+		s.memory.remove( id );
+		s.approximate_membership.remove( el->key );
+		s.index_journal.remove( el->key );
+		auto path = get_fs_name( this->base_dir, el->key, el->tag );
+		s.elements.remove( id );
+		try {
+			cynny::cynnypp::filesystem::removeFile( path.second );
+		}
+		catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+			LOGERROR( "[CACHE] could not delete file", path.second, " from disk; error is: ", ec.what());
+		}
+	}
 
-	static std::unique_ptr<cache>&
-	get_instance( unsigned int max_bytes_size = UINT32_MAX, std::string base_dir = "/tmp/cache/" )
+	/** Name of the journal of a shard */
+	std::string journal_path( size_t index ) const
 	{
-		std::lock_guard<std::mutex> s{ singleton_mutex };
-		if ( _has_instance ) return instance;
-		instance = std::unique_ptr<cache>{ new cache( max_bytes_size, base_dir ) };
-		_has_instance = true;
-		return instance;
+		return base_dir + "journal/" + std::to_string( index );
 	}
 
-	cache( unsigned int max_bytes_size = UINT32_MAX, std::string base_dir = "/tmp/cache/" ) :
-		base_dir{ base_dir },
-		approximate_membership
-			{
-				{
-					[]( const key_t& c )
-					{
-						const uint128 seed{ 58966895434, 23289789237897 };
-						return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
-					},
-					[]( const key_t& c )
-					{
-						const uint128 seed{ 574542563448, 8679805476824 };
-						return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
-					},
-					[]( const key_t& c )
-					{
-						const uint128 seed{ 2574657455567, 878679086346 };
-						return CityHashCrc128WithSeed( c.data(), c.size(), seed ).first;
+	/** Finds again the elements stored by a previous cache in the same base dir, reading the journals of its shards.
+	 * Their contents are not checked: the ones missing from the disk are forgotten when they are read.
+	 * \return false if no journal was found
+	 * */
+	bool restore()
+	{
+		bool found = false;
+		auto now = std::chrono::system_clock::now();
+		for ( size_t i = 0; i < shards_count; ++i ) {
+			std::vector<journal::entry> entries;
+			if ( !journal::load( journal_path( i ), entries )) continue;
+			found = true;
+			for ( auto& e : entries ) {
+				if ( e.expiry_time <= now ) {
+					try {
+						cynny::cynnypp::filesystem::removeFile( get_fs_name( base_dir, e.key, e.tag ).second );
 					}
+					catch ( const cynny::cynnypp::filesystem::ErrorCode& ) {}
+					continue;
 				}
-			},
-		max_bytes_size{ max_bytes_size }
+				// the number of shards could have changed since the journal was written
+				auto& s = shard_of( e.key );
+				if ( s.lockless_has( e.key )) continue;
+				auto id = s.elements.insert( e.key, e.tag, e.creation_time, e.expiry_time, e.size, e.ttl, e.etag );
+				if ( id < 0 ) continue;
+				s.approximate_membership.set( e.key );
+				s.ttl.insert( id, e.expiry_time );
+				s.rp.put( id, e.size );
+				if ( e.tag.size()) s.tag_indexes.insert( e.tag, id );
+				total_size += e.size;
+			}
+		}
+		return found;
+	}
+
+	/** Starts the journals of the shards, recording the elements they already hold. */
+	void open_journals()
 	{
-		//initialization of the callbacks for the elements which could trigger spontaneous remove operations.
 		try {
-			cynny::cynnypp::filesystem::removeDirectory( base_dir );
+			cynny::cynnypp::filesystem::createDirectory( base_dir + "journal/", true );
 		}
 		catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-			LOGERROR( "[Cache] could not clean the base dir", base_dir, " on startup because of ", ec.what());
+			LOGERROR( "[CACHE] could not create the journal directory in ", base_dir, ": ", ec.what());
+			return;
 		}
-		ttl.set_remove_callback( [ this ]( const unsigned int id )
-			{
-				auto& k = elements.get_key( id );
-				approximate_membership.remove( k );
-
-				rp.remove( id );
-				std::string tag = tag_indexes.remove( id );
-				auto name = get_fs_name( this->base_dir, k, tag );
-				try {
-					cynny::cynnypp::filesystem::removeFile( name.second );
-				}
-				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
+		for ( size_t i = 0; i < shards_count; ++i ) {
+			auto& s = shards[ i ];
+			bool ok = s.index_journal.open( journal_path( i ), [ &s ]( std::function<void( const cache_element& )> record )
+				{
+					s.elements.for_each( record );
 				}
-				size_t element_size = elements.remove( id );
-				freed_size += element_size;
-			}
-		);
+			);
+			if ( !ok ) LOGERROR( "[CACHE] could not write the journal ", journal_path( i ));
+		}
+	}
 
-		elements.set_remove_callback( [ this ]( const std::string& str, const unsigned int id,
-				std::chrono::system_clock::time_point expiry_time, size_t size )
+	/** Rewrites the journal of a shard when most of its records are about elements removed since.
+	 * Only the live elements are taken under the lock of the shard, held by the caller; they are written later.
+	 * */
+	void compact_journal( shard& s )
+	{
+		if ( s.index_journal.size() < 2 * s.elements.size() + 1024 ) return;
+		s.index_journal.compact( [ &s ]( std::function<void( const cache_element& )> record )
 			{
-				ttl.thorough_remove_element( id, expiry_time );
-				approximate_membership.remove( str );
-				rp.remove( id );
-				total_size -= size;
-				std::string tag = tag_indexes.remove( id );
-				auto name = get_fs_name( this->base_dir, str, tag );
-				try {
-					cynny::cynnypp::filesystem::removeFile( name.second );
-				}
-				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
-				}
+				s.elements.for_each( record );
 			}
 		);
+	}
 
-		rp.set_remove_callback( [ this ]( unsigned int id )
-			{
-				auto& k = elements.get_key( id );
-				approximate_membership.remove( k );
-				ttl.thorough_remove_element( id );
-				std::string tag = tag_indexes.remove( id );
+	/** Directory of the temporary files of the puts; its contents never survive a restart */
+	std::string fill_dir() const
+	{
+		return base_dir + "fill/";
+	}
 
-				auto name = get_fs_name( this->base_dir, k, tag );
-				try {
-					cynny::cynnypp::filesystem::removeFile( name.second );
+	/** Sends the segment collected by a put to the disk; the first one creates the temporary file.
+	 * The bytes count in the size of the cache once they are written. The shard must be locked by the caller.
+	 * */
+	void write_segment( shard& s, const key_t& key, temp_cache_representation& fill )
+	{
+		std::shared_ptr<const std::vector<uint8_t>> segment = std::move( fill.segment );
+		fill.segment = std::make_shared<std::vector<uint8_t>>();
+		++fill.writing;
+		auto index = shard_index( key );
+		auto written_cb = [ this, &s, index, key, segment ]( const cynny::cynnypp::filesystem::ErrorCode& ec, size_t )
+			{
+				{
+					std::lock_guard<std::mutex> g{ s.mutex };
+					auto fill = s.tmp.find( key ); // it is kept until all its segments are written
+					--fill->second.writing;
+					if ( ec ) {
+						LOGERROR( "[CACHE]", "Could not store ", key, " contents because of a filesystem error: ", ec.what());
+						fill->second.invalidate();
+					} else {
+						fill->second.written += segment->size();
+						total_size += segment->size();
+						// what was put meanwhile waited for this write
+						if ( !fill->second.invalidated && fill->second.segment->size() >= segment_size )
+							write_segment( s, key, fill->second );
+					}
+					if ( fill->second.writing == 0 && fill->second.finished ) end_fill( s, fill );
 				}
-				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-					LOGERROR( "[CACHE] error while removing file ", name.second, ": ", ec.what());
+				// evict takes the locks of the shards one at a time: ours must have been released
+				evict( index );
+			};
+		if ( fill.created )
+			service::locator::fs_manager().async_append( fill.path, *segment, std::move( written_cb ));
+		else
+			service::locator::fs_manager().async_write( fill.path, *segment, std::move( written_cb ));
+		fill.created = true;
+	}
+
+	/** Ends a put whose segments have all been written: its temporary file is renamed to the one of the element,
+	 * which is then indexed; if the put was invalidated the file is removed instead.
+	 * The shard must be locked by the caller.
+	 * */
+	void end_fill( shard& s, typename fills_t::iterator fill )
+	{
+		auto& key = fill->first;
+		auto& data = fill->second;
+		if ( !data.invalidated ) {
+			auto fs_name = get_fs_name( base_dir, key, data.tag );
+			try {
+				cynny::cynnypp::filesystem::createDirectory( fs_name.first, true );
+				if ( std::rename( data.path.c_str(), fs_name.second.c_str()) == 0 ) {
+					auto expiry_time = data.creation_time + std::chrono::seconds( data.ttl );
+					auto translation_id = s.elements.insert( key, data.tag, data.creation_time, expiry_time, data.written, data.ttl, data.etag );
+					s.approximate_membership.set( key );
+					s.ttl.insert( translation_id, expiry_time );
+					s.rp.put( translation_id, data.written );
+					if ( data.tag.size()) s.tag_indexes.insert( data.tag, translation_id );
+					s.index_journal.put( cache_element{ key, static_cast<unsigned int>( translation_id ), data.tag,
+						data.creation_time, expiry_time, data.written, data.ttl, data.etag } );
+					compact_journal( s );
+					s.tmp.erase( fill );
+					return;
 				}
-				elements.remove( id );
+				LOGERROR( "[CACHE]", "Could not store ", key, " contents because ", data.path, " could not be renamed" );
 			}
-		);
+			catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+				LOGERROR( "[CACHE]", "Could not store ", key, " contents because creation of directory ", fs_name.first, " failed with error: ", ec.what());
+			}
+		}
+		if ( data.created ) {
+			try {
+				cynny::cynnypp::filesystem::removeFile( data.path );
+			}
+			catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+				LOGERROR( "[CACHE] could not delete file", data.path, " from disk; error is: ", ec.what());
+			}
+		}
+		total_size -= data.written;
+		s.tmp.erase( fill );
+	}
+
+public:
+	/** Values at least this big are mapped from the disk rather than read */
+	static constexpr size_t map_threshold = 64 * 1024;
+	/** Contents are written to the disk in segments this big while they are put */
+	static constexpr size_t segment_size = 256 * 1024;
+	/** At most this many segments of a put are written at the same time; the content put meanwhile is kept */
+	static constexpr size_t max_writing_segments = 2;
+	/** A put is given up when it keeps more than this waiting for the disk, so that its memory stays bounded */
+	static constexpr size_t max_waiting_size = 8 * segment_size;
+
+	/** Creates a new cache
+	 *  \param max_bytes_size the maximum size occupied by the cache
+	 *  \param base_dir the base directory used to write the files on disk.
+	 *  \param memory_bytes_size the maximum size of the contents kept in memory, split among the shards; 0 disables it.
+	 *  \param restore_contents true to keep the contents stored in base_dir by a previous cache; otherwise it is cleaned.
+	 * */
+
+	static std::unique_ptr<cache>&
+	get_instance( unsigned int max_bytes_size = UINT32_MAX, std::string base_dir = "/tmp/cache/", size_t memory_bytes_size = 0,
+		bool restore_contents = false )
+	{
+		std::lock_guard<std::mutex> s{ singleton_mutex };
+		if ( _has_instance ) return instance;
+		instance = std::unique_ptr<cache>{ new cache( max_bytes_size, base_dir, memory_bytes_size, restore_contents ) };
+		_has_instance = true;
+		return instance;
+	}
+
+	cache( unsigned int max_bytes_size = UINT32_MAX, std::string base_dir = "/tmp/cache/", size_t memory_bytes_size = 0,
+		bool restore_contents = false ) :
+		base_dir{ base_dir },
+		max_bytes_size{ max_bytes_size }
+	{
+		for ( auto& s : shards ) {
+			set_remove_callbacks( s );
+			s.memory.set_max_size( memory_bytes_size / shards_count );
+		}
+		// puts interrupted by a restart are lost anyway
+		auto dirty_dir = restore_contents && restore() ? fill_dir() : base_dir;
+		try {
+			cynny::cynnypp::filesystem::removeDirectory( dirty_dir );
+		}
+		catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+			LOGERROR( "[Cache] could not clean the dir", dirty_dir, " on startup because of ", ec.what());
+		}
+		try {
+			cynny::cynnypp::filesystem::createDirectory( fill_dir(), true );
+		}
+		catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
+			LOGERROR( "[CACHE] could not create the directory of the puts in ", base_dir, ": ", ec.what());
+		}
+		open_journals();
+		// the size allowed could be smaller than the one of the previous cache
+		evict();
 	}
 
 	/** Checks whether a key is stored in cache.
@@ -280,10 +568,11 @@ public:
 	 * */
 	inline bool has( const key_t& k )
 	{
-		bool approximate_has = approximate_membership.has( k );
+		auto& s = shard_of( k );
+		bool approximate_has = s.approximate_membership.has( k );
 		if ( !approximate_has ) return false;
-		std::lock_guard<std::mutex> g{ global_mutex };
-		return elements.has( k );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		return s.elements.has( k );
 	}
 
 	/** Gets the age of the current content, if it exists.
@@ -291,7 +580,9 @@ public:
 	 * */
 	inline uint32_t get_age( const key_t& k )
 	{
-		auto el = elements.get_element( k );
+		auto& s = shard_of( k );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		auto el = s.elements.get_element( k );
 		if ( el == nullptr ) return 0;
 		return std::chrono::duration_cast<std::chrono::seconds>( std::chrono::system_clock::now() - el->creation_time
 		).count();
@@ -312,33 +603,111 @@ public:
 	 * */
 	bool get( const key_t& key, read_callback rcb )
 	{
-		bool ret = false;
-		std::lock_guard<std::mutex> g{ global_mutex };
-		auto found = elements.get_element( key );
-		if ( found != nullptr ) {
-			auto fs_name = get_fs_name( base_dir, key, found->tag ).second;
-			std::basic_ifstream<uint8_t>* fdptr = new std::basic_ifstream<uint8_t>( fs_name,
-				std::ios::in | std::ios::binary | std::ios::ate
-			);
-			if ( !(*fdptr)) {
-				service::locator::service_pool().get_thread_io_service().post( std::bind( rcb, output_data_t{} ));
-				return false;
+		return get( key, shared_read_callback{ [ rcb ]( shared_data_t data ) { rcb( *data ); } } );
+	}
+
+	/** Gets an element from the cache (if it exists), without copying it.
+	 * Contents held in memory are passed to the callback before returning; the others are read from disk, and kept
+	 * in memory afterwards.
+	 * \param key the key for whcih the user wants to get the content
+	 * \param rcb the callback used to send back the content to the requestor. In case the key is not found, an empty data structure is returned.
+	 * */
+	bool get( const key_t& key, shared_read_callback rcb )
+	{
+		auto& s = shard_of( key );
+		std::unique_lock<std::mutex> g{ s.mutex };
+		auto found = s.elements.get_element( key );
+		if ( found == nullptr ) {
+			g.unlock();
+			service::locator::service_pool().get_thread_io_service().post( std::bind( rcb, std::make_shared<const output_data_t>()));
+			return false;
+		}
+		s.rp.touch( found->id );
+		if ( auto in_memory = s.memory.get( found->id )) {
+			// the callback could use the cache again
+			g.unlock();
+			rcb( std::move( in_memory ));
+			return true;
+		}
+
+		auto fs_name = get_fs_name( base_dir, key, found->tag ).second;
+		std::basic_ifstream<uint8_t>* fdptr = new std::basic_ifstream<uint8_t>( fs_name,
+			std::ios::in | std::ios::binary | std::ios::ate
+		);
+		if ( !(*fdptr)) {
+			delete fdptr;
+			// the content is missing, e.g. it was lost while the journal was not in use
+			lockless_invalidate( s, found );
+			g.unlock();
+			service::locator::service_pool().get_thread_io_service().post( std::bind( rcb, std::make_shared<const output_data_t>()));
+			return false;
+		}
+		std::unique_ptr<std::basic_ifstream<uint8_t>> file_descriptor( fdptr );
+		auto retrieved_data = std::make_shared<output_data_t>();
+		auto creation_time = found->creation_time;
+		service::locator::fs_manager().async_read( std::move( file_descriptor ), *retrieved_data, [ this, &s, key, creation_time, retrieved_data, rcb ](
+				const cynny::cynnypp::filesystem::ErrorCode& ec, size_t size )
+			{
+				shared_data_t data = std::make_shared<const output_data_t>( std::move( *retrieved_data ));
+				{
+					std::lock_guard<std::mutex> g{ s.mutex };
+					// the element could have been replaced while reading
+					auto el = s.elements.get_element( key );
+					if ( el != nullptr && el->creation_time == creation_time ) {
+						if ( ec ) lockless_invalidate( s, el );
+						else s.memory.put( el->id, data );
+					}
+				}
+				if ( ec ) return rcb( std::make_shared<const output_data_t>());
+				rcb( std::move( data ));
 			}
-			ret = true;
-			std::unique_ptr<std::basic_ifstream<uint8_t>> file_descriptor( fdptr );
-			auto retrieved_data = std::make_shared<output_data_t>();
-			service::locator::fs_manager().async_read( std::move( file_descriptor ), *retrieved_data, [ retrieved_data, rcb ](
-					const cynny::cynnypp::filesystem::ErrorCode& ec, size_t size )
+		);
+		return true;
+	}
+
+	/** Gets an element from the cache (if it exists), as a view that does not copy it.
+	 * Big contents are mapped from the disk, out of the lock of the shard, and passed to the callback before
+	 * returning, like the ones held in memory; the others are read as by the get receiving the shared value.
+	 * \param key the key for whcih the user wants to get the content
+	 * \param rcb the callback used to send back the content to the requestor. In case the key is not found, an empty view is returned.
+	 * */
+	bool get( const key_t& key, view_read_callback rcb )
+	{
+		auto& s = shard_of( key );
+		std::unique_lock<std::mutex> g{ s.mutex };
+		auto found = s.elements.get_element( key );
+		if ( found == nullptr || found->size() < map_threshold ) {
+			g.unlock();
+			return get( key, shared_read_callback{ [ rcb ]( shared_data_t data )
 				{
-					if ( !ec ) rcb( std::move( *retrieved_data )); //enhance this.
-					else rcb( output_data_t{} );
+					rcb( dstring::wrap( reinterpret_cast<const char*>( data->data()), data->size(), data ));
 				}
-			);
-		} else {
-			service::locator::service_pool().get_thread_io_service().post( std::bind( rcb, output_data_t{} ));
+			} );
+		}
+		s.rp.touch( found->id );
+		if ( auto in_memory = s.memory.get( found->id )) {
+			g.unlock();
+			rcb( dstring::wrap( reinterpret_cast<const char*>( in_memory->data()), in_memory->size(), in_memory ));
+			return true;
 		}
 
-		return ret;
+		// the file is opened and mapped without holding the shard
+		auto path = get_fs_name( base_dir, key, found->tag ).second;
+		auto size = found->size();
+		auto creation_time = found->creation_time;
+		g.unlock();
+		auto mapped = std::make_shared<const mapped_file>( path );
+		if ( mapped->size() != size ) {
+			// the content is missing or damaged, unless it has been put again meanwhile
+			g.lock();
+			auto el = s.elements.get_element( key );
+			if ( el != nullptr && el->creation_time == creation_time ) lockless_invalidate( s, el );
+			g.unlock();
+			service::locator::service_pool().get_thread_io_service().post( std::bind( rcb, dstring{} ));
+			return false;
+		}
+		rcb( dstring::wrap( mapped->data(), mapped->size(), mapped ));
+		return true;
 	}
 
 	/** Starts to put content for a given key
@@ -352,88 +721,62 @@ public:
 	template<typename... T>
 	bool begin_put( const key_t& key, unsigned int ttl, T&& ... t )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		if ( ttl <= 0 || tmp.find( key ) != tmp.end() || lockless_has( key )) return false;
-		tmp.emplace( key, temp_cache_representation{ ttl, std::forward<T>( t )... } );
+		auto index = shard_index( key );
+		auto& s = shards[ index ];
+		std::lock_guard<std::mutex> g{ s.mutex };
+		if ( ttl <= 0 || s.tmp.find( key ) != s.tmp.end() || s.lockless_has( key )) return false;
+		auto fill = s.tmp.emplace( key, temp_cache_representation{ ttl, std::forward<T>( t )... } ).first;
+		fill->second.path = fill_dir() + std::to_string( index ) + "-" + std::to_string( s.fills++ );
 		return true;
 	}
 
-	/** Puts the content for a given key
+	/** Puts the content for a given key; it is written to the disk a segment at a time.
 	 * \param key the identifier of the content on which the append operation will be performed
 	 * \param cl the data to append
-	 * \return true in case the operation is successfully; false otherwise
+	 * \return true in case the operation is successfully; false otherwise, also when the put was given up because
+	 * more than max_waiting_size bytes were waiting for the disk.
 	 * */
 	bool put( const key_t& key, const std::string& cl )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		total_size += cl.size();
-		evict();
-		auto where_to_put = tmp.find( key );
-		if ( where_to_put != tmp.end() && !where_to_put->second.finished ) {
-			auto& container = where_to_put->second.data;
-			container.insert( container.end(), cl.begin(), cl.end());
+		auto& s = shard_of( key );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		auto where_to_put = s.tmp.find( key );
+		if ( where_to_put == s.tmp.end() || where_to_put->second.finished ) return false;
+		auto& fill = where_to_put->second;
+		auto& container = *fill.segment;
+		container.insert( container.end(), cl.begin(), cl.end());
+		if ( container.size() < segment_size ) return true;
+		if ( fill.writing < max_writing_segments ) {
+			write_segment( s, key, fill );
 			return true;
 		}
-		total_size -= cl.size();
+		// it is written as soon as one of the segments before is
+		if ( container.size() <= max_waiting_size ) return true;
+		LOGDEBUG( "[CACHE] giving up storing ", key, ": the disk is late" );
+		service::locator::stats_manager().enqueue( stats::stat_type::cache_fills_abandoned, 1 );
+		fill.invalidate();
 		return false;
 	}
 
-	/** Stores an element in the cache (if ok == true) or discards it, preventing other put operations on it
+	/** Stores an element in the cache (if ok == true) or discards it, preventing other put operations on it.
+	 * The element is indexed once all its data is on the disk.
 	 * \param key the identifier of the data
 	 * \param ok commit or rollback flag
 	 * */
 	void end_put( const key_t& key, bool ok = true )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		auto data = tmp.find( key );
-		if ( data != tmp.end() && !data->second.finished ) {
+		auto& s = shard_of( key );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		auto data = s.tmp.find( key );
+		if ( data == s.tmp.end() || data->second.finished ) return;
+		if ( ok ) {
+			// even an empty content needs its file
+			if ( data->second.segment->size() || !data->second.created ) write_segment( s, key, data->second );
 			data->second.finished = true;
-			if ( ok ) {
-				auto fs_name = get_fs_name( base_dir, key, data->second.tag );
-				try {
-					cynny::cynnypp::filesystem::createDirectory( fs_name.first, true );
-				}
-				catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-					LOGERROR( "[CACHE]", "Could not store ", key, " contents because creation of directory ", fs_name.first, " failed with error: ", ec.what());
-					return;
-				}
-				service::locator::fs_manager().async_write( fs_name.second, data->second.data, [ this, key ](
-						const cynny::cynnypp::filesystem::ErrorCode& ec, size_t size )
-					{
-						std::lock_guard<std::mutex> g{ global_mutex };
-						auto data = tmp.find( key ); //already checked: don't do it again.
-						if ( !ec && data->second.invalidated == false ) {
-							auto expiry_time = data->second.creation_time + std::chrono::seconds( data->second.ttl );
-							auto translation_id = elements.insert( key, data->second.tag, data->second.creation_time, expiry_time, size, data->second.ttl, data->second.etag );
-							approximate_membership.set( key );
-							ttl.insert( translation_id, expiry_time );
-							rp.put( translation_id, size );
-							if ( data->second.tag.size()) tag_indexes.insert( data->second.tag, translation_id );
-							tmp.erase( data );
-						} else {
-							if ( data->second.invalidated ) {
-								auto path = get_fs_name( this->base_dir, key, data->second.tag );
-								try {
-									cynny::cynnypp::filesystem::removeFile( path.second );
-								}
-								catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-									LOGERROR( "[CACHE] File was not created; hence i have not deleted it.", ec.what());
-								}
-							}
-							LOGERROR( "[CACHE]", "Could not store ", key, " contents because of a filesystem error: ", ec.what());
-							total_size -= data->second.data.size();
-							tmp.erase( data );
-						}
-					}
-				);
-				return;
-			} else {
-				total_size -= data->second.data.size();
-				tmp.erase( data );
-			}
-
-			return;
+		} else {
+			data->second.invalidate();
 		}
+		if ( data->second.writing == 0 ) end_fill( s, data );
 	}
 
 	/** Clears all elements under a given tag
@@ -442,19 +785,23 @@ public:
 	 * */
 	size_t clear_tag( const std::string& tag )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
 		size_t clearedBytes = 0;
-		tag_indexes.clear( tag, [ this, &clearedBytes ]( int id )
-			{
-				auto& k = elements.get_key( id );
-				approximate_membership.remove( k );
-				size_t element_size = elements.remove( id );
-				total_size -= element_size;
-				clearedBytes += element_size;
-				ttl.thorough_remove_element( id );
-				rp.remove( id );
-			}
-		);
+		for ( auto& s : shards ) {
+			std::lock_guard<std::mutex> g{ s.mutex };
+			s.tag_indexes.clear( tag, [ this, &s, &clearedBytes ]( int id )
+				{
+					auto& k = s.elements.get_key( id );
+					s.approximate_membership.remove( k );
+					s.index_journal.remove( k );
+					size_t element_size = s.elements.remove( id );
+					total_size -= element_size;
+					clearedBytes += element_size;
+					s.ttl.thorough_remove_element( id );
+					s.rp.remove( id );
+					s.memory.remove( id );
+				}
+			);
+		}
 
 		auto name = get_tag_dir( base_dir, tag );
 		try {
@@ -474,31 +821,19 @@ public:
 	 * */
 	void invalidate( const key_t& key )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		auto el = elements.get_element( key );
+		auto& s = shard_of( key );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		auto el = s.elements.get_element( key );
 		if ( el == nullptr ) {
 			/** The element is not in cache... Yet, it might be in temporary and we're writing it right now. Make it work as if it doesnt.*/
-			auto d = tmp.find( key );
-			if ( d != tmp.end()) {
+			auto d = s.tmp.find( key );
+			if ( d != s.tmp.end()) {
 				d->second.invalidate();
+				if ( d->second.writing == 0 ) end_fill( s, d );
 			}
 			return;
 		}
-		total_size -= el->_size;
-		int id = el->id;
-		ttl.thorough_remove_element( id );
-		tag_indexes.remove( id );
-		rp.remove( id );
-		approximate_membership.remove( el->key );
-		auto path = get_fs_name( this->base_dir, el->key, el->tag );
-		elements.remove( id );
-		try {
-			cynny::cynnypp::filesystem::removeFile( path.second );
-		}
-		catch ( const cynny::cynnypp::filesystem::ErrorCode& ec ) {
-			LOGERROR( "[CACHE] could not delete file", path.second, " from disk; error is: ", ec.what());
-		}
-
+		lockless_invalidate( s, el );
 	}
 
 	/** Verifies the version associated to a certain key.
@@ -510,24 +845,39 @@ public:
 	template<typename T>
 	bool verify_version( const key_t& key, const T& t )
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		auto el = elements.get_element( key );
+		auto& s = shard_of( key );
+		std::lock_guard<std::mutex> g{ s.mutex };
+		auto el = s.elements.get_element( key );
 		return el != nullptr && el->verify_version( t );
 	}
 
 
-	/** Cache eviction: frees space. NOT THREAD SAFE
+	/** Cache eviction: frees space. The expired elements of every shard are dropped first; what is still missing
+	 * is asked to the replacement policies, starting from the one of the first shard.
+	 * The shards are locked one at a time, hence the caller must not hold any of them.
+	 * \param first the index of the shard whose policy is asked first
 	 * */
-	void evict()
-	{
-		if ( total_size < max_bytes_size ) return;
-		auto min_size_to_evict = 2 * (total_size - max_bytes_size);
-		freed_size = 0;
-		ttl.remove_expired();
-		total_size -= freed_size;
-		if ( freed_size >= min_size_to_evict ) return;
-		//call policy maker.
-		total_size -= rp.free_space( min_size_to_evict - freed_size );
+	void evict( size_t first = 0 )
+	{
+		uint64_t current_size = total_size;
+		if ( current_size < max_bytes_size ) return;
+		uint64_t min_size_to_evict = 2 * (current_size - max_bytes_size);
+		uint64_t freed = 0;
+		for ( auto& s : shards ) {
+			std::lock_guard<std::mutex> g{ s.mutex };
+			s.freed_size = 0;
+			s.ttl.remove_expired();
+			total_size -= s.freed_size;
+			freed += s.freed_size;
+		}
+		//call policy makers.
+		for ( size_t i = 0; i < shards_count && freed < min_size_to_evict; ++i ) {
+			auto& s = shards[ (first + i) % shards_count ];
+			std::lock_guard<std::mutex> g{ s.mutex };
+			auto policy_freed = s.rp.free_space( min_size_to_evict - freed );
+			total_size -= policy_freed;
+			freed += policy_freed;
+		}
 	}
 
 	/** Clears all elements in cache
@@ -535,25 +885,42 @@ public:
 	 * */
 	size_t clear_all()
 	{
-		std::lock_guard<std::mutex> g{ global_mutex };
-		freed_size = 0;
-		auto old_total = total_size;
-		ttl.remove_expired();
-		total_size -= freed_size;
-		total_size -= rp.free_space( total_size );
+		size_t old_total = total_size;
+		for ( auto& s : shards ) {
+			std::lock_guard<std::mutex> g{ s.mutex };
+			s.freed_size = 0;
+			s.ttl.remove_expired();
+			total_size -= s.freed_size;
+			total_size -= s.rp.free_space( total_size );
+		}
 		return old_total;
 	}
 };
 
-template<template<class> class replacement_policy, typename key_t, size_t max_elements_size>
-bool cache<replacement_policy, key_t, max_elements_size>::_has_instance{ false };
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+constexpr size_t cache<replacement_policy, key_t, max_elements_size, shards_count>::shard_elements_size;
+
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+constexpr size_t cache<replacement_policy, key_t, max_elements_size, shards_count>::map_threshold;
+
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+constexpr size_t cache<replacement_policy, key_t, max_elements_size, shards_count>::segment_size;
+
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+constexpr size_t cache<replacement_policy, key_t, max_elements_size, shards_count>::max_writing_segments;
+
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+constexpr size_t cache<replacement_policy, key_t, max_elements_size, shards_count>::max_waiting_size;
+
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+bool cache<replacement_policy, key_t, max_elements_size, shards_count>::_has_instance{ false };
 
-template<template<class> class replacement_policy, typename key_t, size_t max_elements_size>
-std::unique_ptr<cache<replacement_policy, key_t, max_elements_size>> cache<replacement_policy, key_t, max_elements_size>::instance
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+std::unique_ptr<cache<replacement_policy, key_t, max_elements_size, shards_count>> cache<replacement_policy, key_t, max_elements_size, shards_count>::instance
 {
 	nullptr
 };
 
-template<template<class> class replacement_policy, typename key_t, size_t max_elements_size>
-std::mutex cache<replacement_policy, key_t, max_elements_size>::singleton_mutex;
+template<template<class> class replacement_policy, typename key_t, size_t max_elements_size, size_t shards_count>
+std::mutex cache<replacement_policy, key_t, max_elements_size, shards_count>::singleton_mutex;
 #endif //DOORMAT_CACHE_H
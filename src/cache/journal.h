@@ -0,0 +1,271 @@
+#ifndef DOORMAT_JOURNAL_H
+#define DOORMAT_JOURNAL_H
+
+#include "cache_element.h"
+#include "../service_locator/service_locator.h"
+#include "../fs/fs_manager_wrapper.h"
+#include "../utils/log_wrapper.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** \brief append only log of the elements stored by a cache on disk, read on startup to find them again.
+ *
+ * Every stored element appends a record with its metadata, every removal a record with its key; replaying them
+ * gives back the live elements. The log is rewritten with the live elements only when it grows too much.
+ * A record cut by a crash ends the replay; records lost that way only make the cache forget some contents.
+ *
+ * Records are collected in memory and appended by the filesystem manager, which writes them in the order they are
+ * handed to it; while an append is being written the following records are collected, and appended together.
+ * */
+class journal
+{
+	enum class record_type : uint8_t { put = 'P', remove = 'R' };
+	/** Changes whenever the records or the format of the stored contents change: older journals are ignored */
+	static constexpr uint32_t magic = 0x324a4d44; // "DMJ2"
+	/** Longer strings can only come from a damaged journal */
+	static constexpr uint32_t max_string_size = 1024 * 1024;
+
+public:
+	using clock = std::chrono::system_clock;
+
+	/** An element found in the journal */
+	struct entry
+	{
+		std::string key;
+		std::string tag;
+		std::string etag;
+		size_t size;
+		unsigned int ttl;
+		clock::time_point creation_time;
+		clock::time_point expiry_time;
+	};
+
+	/** Reads the live elements of a journal
+	 * \param path the journal file
+	 * \param entries where the elements are added, least recently stored first
+	 * \return false if the file does not exist or is not a journal
+	 * */
+	static bool load(const std::string &path, std::vector<entry> &entries)
+	{
+		std::ifstream in{path, std::ios::in | std::ios::binary};
+		uint32_t header = 0;
+		if(!in || !read(in, header) || header != magic) return false;
+
+		std::vector<std::pair<entry, bool>> found;
+		std::unordered_map<std::string, size_t> positions;
+		record_type type;
+		while(read(in, type))
+		{
+			std::string key;
+			if(!read(in, key)) break;
+			auto position = positions.find(key);
+			if(position != positions.end())
+			{
+				found[position->second].second = false;
+				positions.erase(position);
+			}
+			if(type == record_type::remove) continue;
+
+			entry e;
+			uint64_t size, creation, expiry;
+			uint32_t ttl;
+			if(!read(in, e.tag) || !read(in, e.etag) || !read(in, size) || !read(in, ttl) || !read(in, creation) ||
+				!read(in, expiry)) break;
+			e.key = std::move(key);
+			e.size = size;
+			e.ttl = ttl;
+			e.creation_time = clock::time_point{clock::duration{static_cast<clock::rep>(creation)}};
+			e.expiry_time = clock::time_point{clock::duration{static_cast<clock::rep>(expiry)}};
+			positions.emplace(e.key, found.size());
+			found.emplace_back(std::move(e), true);
+		}
+
+		for(auto &f: found)
+			if(f.second) entries.push_back(std::move(f.first));
+		return true;
+	}
+
+	journal() = default;
+	journal(const journal&) = delete;
+	journal& operator=(const journal&) = delete;
+
+	/** Writes the records not handed to the filesystem manager yet, which could be gone with the journal.
+	 * An append still being written may end after them: at worst an element removed is found again on startup,
+	 * and dropped when its content turns out to be missing.
+	 * */
+	~journal()
+	{
+		std::lock_guard<std::mutex> g{state->mutex};
+		if(state->pending.empty() || state->path.empty()) return;
+		std::ofstream out{state->path, std::ios::out | std::ios::binary | std::ios::app};
+		out.write(reinterpret_cast<const char*>(state->pending.data()), state->pending.size());
+		state->pending.clear();
+	}
+
+	/** Starts a journal, replacing the file if it exists; the file is written before returning
+	 * \param path the journal file
+	 * \param elements function calling its argument on every live element, which are recorded first
+	 * */
+	template<typename elements_visitor>
+	bool open(const std::string &path, elements_visitor &&elements)
+	{
+		buffer snapshot;
+		take(snapshot, std::forward<elements_visitor>(elements));
+		auto tmp_path = path + ".tmp";
+		std::ofstream out{tmp_path, std::ios::out | std::ios::binary | std::ios::trunc};
+		out.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+		out.close();
+		if(!out || std::rename(tmp_path.c_str(), path.c_str()) != 0) return false;
+
+		std::lock_guard<std::mutex> g{state->mutex};
+		state->path = path;
+		state->pending.clear();
+		return true;
+	}
+
+	/** Rewrites the journal with the live elements only. They are taken before returning, while the file is written
+	 * later by the filesystem manager, before any record that follows; a crash while it is written makes the cache
+	 * forget the elements not written yet.
+	 * \param elements function calling its argument on every live element
+	 * */
+	template<typename elements_visitor>
+	void compact(elements_visitor &&elements)
+	{
+		auto snapshot = std::make_shared<buffer>();
+		take(*snapshot, std::forward<elements_visitor>(elements));
+
+		std::lock_guard<std::mutex> g{state->mutex};
+		if(state->path.empty()) return;
+		// the records not handed yet are in the snapshot
+		state->pending.clear();
+		auto path = state->path;
+		service::locator::fs_manager().async_write(path, *snapshot,
+			[path, snapshot](const cynny::cynnypp::filesystem::ErrorCode &ec, size_t)
+			{
+				if(ec) LOGERROR("[CACHE] could not rewrite the journal ", path, ": ", ec.what());
+			});
+	}
+
+	/** Records a stored element */
+	void put(const cache_element &e)
+	{
+		std::lock_guard<std::mutex> g{state->mutex};
+		append(state->pending, e);
+		++records;
+		flush(state);
+	}
+
+	/** Records the removal of an element */
+	void remove(const std::string &key)
+	{
+		std::lock_guard<std::mutex> g{state->mutex};
+		write(state->pending, record_type::remove);
+		write(state->pending, key);
+		++records;
+		flush(state);
+	}
+
+	/** \return the number of records appended since the journal was opened or rewritten */
+	size_t size() const noexcept { return records; }
+
+private:
+	using buffer = std::vector<uint8_t>;
+
+	/** What the appends of the journal share with their completion handlers, which can outlive it */
+	struct appender
+	{
+		std::mutex mutex;
+		std::string path;
+		/** Records not handed to the filesystem manager yet */
+		buffer pending;
+		/** An append is being written: the records are collected meanwhile, and appended at once */
+		bool writing{false};
+	};
+
+	/** Hands the pending records to the filesystem manager, unless it is still writing the previous ones.
+	 * The mutex of the appender must be held by the caller.
+	 * */
+	static void flush(const std::shared_ptr<appender> &state)
+	{
+		if(state->writing || state->pending.empty() || state->path.empty()) return;
+		state->writing = true;
+		auto records = std::make_shared<buffer>();
+		records->swap(state->pending);
+		service::locator::fs_manager().async_append(state->path, *records,
+			[state, records](const cynny::cynnypp::filesystem::ErrorCode &ec, size_t)
+			{
+				if(ec) LOGERROR("[CACHE] could not append to the journal ", state->path, ": ", ec.what());
+				std::lock_guard<std::mutex> g{state->mutex};
+				state->writing = false;
+				flush(state);
+			});
+	}
+
+	/** Writes the header and the live elements in a buffer, counting them as the only records */
+	template<typename elements_visitor>
+	void take(buffer &snapshot, elements_visitor &&elements)
+	{
+		records = 0;
+		write(snapshot, static_cast<uint32_t>(magic));
+		elements(std::function<void(const cache_element&)>{[this, &snapshot](const cache_element &e)
+		{
+			append(snapshot, e);
+			++records;
+		}});
+	}
+
+	static void append(buffer &b, const cache_element &e)
+	{
+		write(b, record_type::put);
+		write(b, e.key);
+		write(b, e.tag);
+		write(b, e.etag);
+		write(b, static_cast<uint64_t>(e.size()));
+		write(b, static_cast<uint32_t>(e.ttl));
+		write(b, static_cast<uint64_t>(e.creation_time.time_since_epoch().count()));
+		write(b, static_cast<uint64_t>(e.expiry_time.time_since_epoch().count()));
+	}
+
+	template<typename T>
+	static void write(buffer &b, const T &value)
+	{
+		auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		b.insert(b.end(), bytes, bytes + sizeof(value));
+	}
+
+	static void write(buffer &b, const std::string &value)
+	{
+		write(b, static_cast<uint32_t>(value.size()));
+		b.insert(b.end(), value.begin(), value.end());
+	}
+
+	template<typename T>
+	static bool read(std::ifstream &i, T &value)
+	{
+		return bool(i.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+
+	static bool read(std::ifstream &i, std::string &value)
+	{
+		uint32_t size;
+		if(!read(i, size) || size > max_string_size) return false;
+		value.resize(size);
+		return bool(i.read(&value[0], size));
+	}
+
+	std::shared_ptr<appender> state{std::make_shared<appender>()};
+	size_t records = 0;
+};
+
+
+#endif //DOORMAT_JOURNAL_H
@@ -0,0 +1,57 @@
+#ifndef DOORMAT_MAPPED_FILE_H
+#define DOORMAT_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** \brief read only mapping of a whole file, so that its content can be sent without copying it.
+ * The mapping survives the removal of the file; files being mapped must never be truncated,
+ * only removed and created again.
+ * */
+class mapped_file
+{
+public:
+	/** Maps a file; the mapping is empty if the file cannot be opened or is empty.
+	 * The pages are read ahead, so that sending them does not stop on page faults.
+	 * */
+	explicit mapped_file(const std::string &path) noexcept
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0) return;
+		struct stat st;
+		if(::fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void *m = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if(m != MAP_FAILED)
+			{
+				mapping = m;
+				length = st.st_size;
+				::madvise(mapping, length, MADV_WILLNEED);
+			}
+		}
+		::close(fd);
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	~mapped_file()
+	{
+		if(mapping) ::munmap(mapping, length);
+	}
+
+	const char* data() const noexcept { return static_cast<const char*>(mapping); }
+	size_t size() const noexcept { return length; }
+
+private:
+	void *mapping = nullptr;
+	size_t length = 0;
+};
+
+
+#endif //DOORMAT_MAPPED_FILE_H
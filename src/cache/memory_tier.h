@@ -0,0 +1,99 @@
+#ifndef DOORMAT_MEMORY_TIER_H
+#define DOORMAT_MEMORY_TIER_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/** \brief memory_tier keeps in memory the most recently read contents of the cache, up to a byte budget,
+ * so that they can be served without going to the disk.
+ * Contents are immutable and shared: a reader keeps its buffer alive even after the tier dropped it.
+ *
+ * \tparam key_t the type of the identifiers of the contents
+ * */
+template<typename key_t>
+class memory_tier
+{
+public:
+	using data_t = std::shared_ptr<const std::vector<uint8_t>>;
+
+	explicit memory_tier(size_t max_bytes_size = 0) : max_bytes_size{max_bytes_size} {}
+
+	/** Changes the budget, dropping the least recently used contents that do not fit anymore. */
+	void set_max_size(size_t size)
+	{
+		max_bytes_size = size;
+		shrink(max_bytes_size);
+	}
+
+	/** Stores a content, replacing the one with the same key; contents bigger than the budget are not kept.
+	 * \param k the key of the content
+	 * \param data the content
+	 * */
+	void put(const key_t &k, data_t data)
+	{
+		remove(k);
+		if(!data || max_bytes_size == 0 || data->size() > max_bytes_size) return;
+		shrink(max_bytes_size - data->size());
+		order.push_front(k);
+		bytes_size += data->size();
+		contents.emplace(k, entry{std::move(data), order.begin()});
+	}
+
+	/** Looks for a content, which becomes the most recently used one.
+	 * \param k the key of the content
+	 * \return the content, or nullptr if it is not in memory
+	 * */
+	data_t get(const key_t &k)
+	{
+		auto found = contents.find(k);
+		if(found == contents.end()) return nullptr;
+		order.splice(order.begin(), order, found->second.position);
+		return found->second.data;
+	}
+
+	void remove(const key_t &k)
+	{
+		auto found = contents.find(k);
+		if(found == contents.end()) return;
+		bytes_size -= found->second.data->size();
+		order.erase(found->second.position);
+		contents.erase(found);
+	}
+
+	void clear()
+	{
+		contents.clear();
+		order.clear();
+		bytes_size = 0;
+	}
+
+	/** \return the bytes held in memory */
+	size_t size() const noexcept { return bytes_size; }
+	size_t max_size() const noexcept { return max_bytes_size; }
+
+private:
+	struct entry
+	{
+		data_t data;
+		typename std::list<key_t>::iterator position;
+	};
+
+	/** Drops the least recently used contents until at most size bytes are held. */
+	void shrink(size_t size)
+	{
+		while(bytes_size > size)
+			remove(order.back());
+	}
+
+	size_t max_bytes_size;
+	size_t bytes_size = 0;
+	/** Keys from the most to the least recently used */
+	std::list<key_t> order;
+	std::unordered_map<key_t, entry> contents;
+};
+
+
+#endif //DOORMAT_MEMORY_TIER_H
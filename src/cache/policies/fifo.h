@@ -1,8 +1,10 @@
 #ifndef DOORMAT_FIFO_H
 #define DOORMAT_FIFO_H
 
+#include <cstddef>
 #include <functional>
 #include <list>
+#include <unordered_map>
 #include <utility>
 
 template<typename key>
@@ -22,36 +24,38 @@ public:
 
 	inline void put(const key& k, size_t size)
 	{
+		remove(k);
 		fifo.push_back(std::make_pair(k, size));
+		positions.emplace(k, std::prev(fifo.end()));
 	}
 
 	inline size_t free_space(const size_t size_to_free)
 	{
-		auto total_size = 0;
+		size_t total_size = 0;
 		while (total_size < size_to_free && fifo.size())
 		{
 			auto element_to_remove = fifo.front().first;
-			remove_function(element_to_remove);
 			total_size += fifo.front().second;
+			positions.erase(element_to_remove);
 			fifo.pop_front();
+			remove_function(element_to_remove);
 		}
 		return total_size;
 	}
 
 	inline void remove(key k)
 	{
-		for(auto &el: fifo)
-		{
-			if(el.first == k)
-			{
-				fifo.remove(el);
-				return;
-			}
-		}
+		auto position = positions.find(k);
+		if(position == positions.end()) return;
+		fifo.erase(position->second);
+		positions.erase(position);
 	}
 
 private:
-	std::list<std::pair<const key, size_t>> fifo;
+	using fifo_t = std::list<std::pair<const key, size_t>>;
+	fifo_t fifo;
+	/** Position of every key in the fifo, for constant time removals */
+	std::unordered_map<key, typename fifo_t::iterator> positions;
 	std::function<void(key)> remove_function;
 };
 
@@ -0,0 +1,101 @@
+#ifndef DOORMAT_FREQUENCY_SKETCH_H
+#define DOORMAT_FREQUENCY_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/** \brief count-min sketch estimating how many times the keys were seen, with counters saturating at 15.
+ * When the samples reach ten times the width all the counters are halved, so that the estimate follows
+ * the recent popularity of the keys.
+ *
+ * \tparam key the type of the keys
+ * */
+template<typename key>
+class frequency_sketch
+{
+public:
+	static constexpr unsigned int depth = 4;
+	static constexpr uint8_t max_frequency = 15;
+
+	explicit frequency_sketch(size_t width = 64)
+	{
+		resize(width);
+	}
+
+	/** Sets the width to the first power of two not smaller than the requested one; all counts are lost. */
+	void resize(size_t min_width)
+	{
+		width = 16;
+		while(width < min_width) width <<= 1;
+		counters.assign(width * depth, 0);
+		samples = 0;
+	}
+
+	void increment(const key &k)
+	{
+		auto h = std::hash<key>()(k);
+		bool added = false;
+		for(unsigned int i = 0; i < depth; ++i)
+		{
+			auto &counter = counters[i * width + index(h, i)];
+			if(counter < max_frequency)
+			{
+				++counter;
+				added = true;
+			}
+		}
+		if(added && ++samples >= 10 * width) age();
+	}
+
+	/** Raises the counts of a key up to a frequency, without taking it as a sample; a wider sketch is given
+	 * this way the counts of the keys known to the one it replaces. */
+	void restore(const key &k, unsigned int frequency)
+	{
+		auto h = std::hash<key>()(k);
+		uint8_t count = frequency < max_frequency ? frequency : max_frequency;
+		for(unsigned int i = 0; i < depth; ++i)
+		{
+			auto &counter = counters[i * width + index(h, i)];
+			if(counter < count) counter = count;
+		}
+	}
+
+	unsigned int frequency(const key &k) const
+	{
+		auto h = std::hash<key>()(k);
+		uint8_t min = max_frequency;
+		for(unsigned int i = 0; i < depth; ++i)
+		{
+			auto counter = counters[i * width + index(h, i)];
+			if(counter < min) min = counter;
+		}
+		return min;
+	}
+
+	size_t size() const noexcept { return width; }
+
+private:
+	size_t index(size_t h, unsigned int row) const noexcept
+	{
+		static const uint64_t seeds[depth] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+		uint64_t x = (h + seeds[row]) * 0x9e3779b97f4a7c15ULL;
+		x ^= x >> 32;
+		return x & (width - 1);
+	}
+
+	void age()
+	{
+		for(auto &counter: counters)
+			counter >>= 1;
+		samples /= 2;
+	}
+
+	size_t width;
+	size_t samples;
+	std::vector<uint8_t> counters;
+};
+
+
+#endif //DOORMAT_FREQUENCY_SKETCH_H
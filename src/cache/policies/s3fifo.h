@@ -0,0 +1,161 @@
+#ifndef DOORMAT_S3FIFO_H
+#define DOORMAT_S3FIFO_H
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/** \brief S3-FIFO: new elements enter a small queue, and only the ones touched while there move to the main one;
+ * the others are evicted and remembered in a ghost queue, so that they go to the main queue if they come back.
+ * The main queue is a FIFO giving a second chance to the elements touched since they were inserted.
+ * Elements seen once, like the ones of a crawler scan, leave from the small queue.
+ *
+ * The policy does not know the capacity of the cache: the small queue is kept to its share of the bytes
+ * currently held, and the ghost queue to the number of the elements held.
+ * */
+template<typename key>
+class s3fifo_policy
+{
+public:
+	/** Share of the bytes that the small queue can hold */
+	static constexpr unsigned int small_percentage = 10;
+	static constexpr unsigned int max_frequency = 3;
+
+	inline void set_remove_callback(std::function<void(key)> &&remove_function)
+	{
+		this->remove_function = std::move(remove_function);
+	}
+
+	inline void touch(const key& k)
+	{
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		if(found->second.frequency < max_frequency) ++found->second.frequency;
+	}
+
+	inline void put(const key& k, size_t size)
+	{
+		remove(k);
+		auto ghost_position = ghosts.find(k);
+		bool in_main = ghost_position != ghosts.end();
+		if(in_main)
+		{
+			ghost.erase(ghost_position->second);
+			ghosts.erase(ghost_position);
+		}
+		auto &queue = in_main ? main : small;
+		queue.push_front(k);
+		elements.emplace(k, element{queue.begin(), size, 0, in_main});
+		(in_main ? main_size : small_size) += size;
+	}
+
+	inline size_t free_space(const size_t size_to_free)
+	{
+		size_t total_size = 0;
+		while (total_size < size_to_free && elements.size())
+		{
+			bool from_small = !small.empty() &&
+				(main.empty() || small_size * 100 >= (small_size + main_size) * small_percentage);
+			if(from_small)
+				total_size += evict_small();
+			else
+				total_size += evict_main();
+		}
+		return total_size;
+	}
+
+	inline void remove(key k)
+	{
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		auto &e = found->second;
+		if(e.in_main)
+		{
+			main.erase(e.position);
+			main_size -= e.size;
+		}
+		else
+		{
+			small.erase(e.position);
+			small_size -= e.size;
+		}
+		elements.erase(found);
+	}
+
+private:
+	struct element
+	{
+		typename std::list<key>::iterator position;
+		size_t size;
+		unsigned int frequency;
+		bool in_main;
+	};
+
+	/** Evicts the tail of the small queue, or moves it to the main one if touched.
+	 * \return the bytes freed
+	 * */
+	size_t evict_small()
+	{
+		auto k = small.back();
+		auto &e = elements.find(k)->second;
+		if(e.frequency > 0)
+		{
+			main.splice(main.begin(), small, e.position);
+			small_size -= e.size;
+			main_size += e.size;
+			e.frequency = 0;
+			e.in_main = true;
+			return 0;
+		}
+		size_t size = e.size;
+		remove(k);
+		remember(k);
+		remove_function(k);
+		return size;
+	}
+
+	/** Evicts the tail of the main queue, or gives it another chance if touched.
+	 * \return the bytes freed
+	 * */
+	size_t evict_main()
+	{
+		auto k = main.back();
+		auto &e = elements.find(k)->second;
+		if(e.frequency > 0)
+		{
+			--e.frequency;
+			main.splice(main.begin(), main, e.position);
+			return 0;
+		}
+		size_t size = e.size;
+		remove(k);
+		remove_function(k);
+		return size;
+	}
+
+	void remember(const key &k)
+	{
+		ghost.push_front(k);
+		ghosts[k] = ghost.begin();
+		while(ghost.size() > elements.size() + 1)
+		{
+			ghosts.erase(ghost.back());
+			ghost.pop_back();
+		}
+	}
+
+	/** Most recently inserted first */
+	std::list<key> small;
+	std::list<key> main;
+	std::list<key> ghost;
+	size_t small_size = 0;
+	size_t main_size = 0;
+	std::unordered_map<key, element> elements;
+	std::unordered_map<key, typename std::list<key>::iterator> ghosts;
+	std::function<void(key)> remove_function;
+};
+
+
+#endif //DOORMAT_S3FIFO_H
@@ -0,0 +1,115 @@
+#ifndef DOORMAT_SLRU_H
+#define DOORMAT_SLRU_H
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/** \brief segmented LRU: new elements enter a probation segment and are promoted to a protected one when touched.
+ * Victims are taken from probation first, hence elements seen only once (e.g. by a crawler scan) cannot push out
+ * the ones used again. The protected segment holds at most protected_percentage of the bytes; its least recently
+ * used elements go back to probation.
+ * */
+template<typename key>
+class slru_policy
+{
+public:
+	/** Share of the bytes that the protected segment can hold */
+	static constexpr unsigned int protected_percentage = 80;
+
+	inline void set_remove_callback(std::function<void(key)> &&remove_function)
+	{
+		this->remove_function = std::move(remove_function);
+	}
+
+	inline void touch(const key& k)
+	{
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		auto &e = found->second;
+		if(e.is_protected)
+		{
+			protected_segment.splice(protected_segment.begin(), protected_segment, e.position);
+			return;
+		}
+		protected_segment.splice(protected_segment.begin(), probation, e.position);
+		e.is_protected = true;
+		probation_size -= e.size;
+		protected_size += e.size;
+		balance();
+	}
+
+	inline void put(const key& k, size_t size)
+	{
+		remove(k);
+		probation.push_front(k);
+		elements.emplace(k, element{probation.begin(), size, false});
+		probation_size += size;
+	}
+
+	inline size_t free_space(const size_t size_to_free)
+	{
+		size_t total_size = 0;
+		while (total_size < size_to_free && elements.size())
+		{
+			auto element_to_remove = probation.empty() ? protected_segment.back() : probation.back();
+			total_size += elements.find(element_to_remove)->second.size;
+			remove(element_to_remove);
+			remove_function(element_to_remove);
+		}
+		return total_size;
+	}
+
+	inline void remove(key k)
+	{
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		auto &e = found->second;
+		if(e.is_protected)
+		{
+			protected_segment.erase(e.position);
+			protected_size -= e.size;
+		}
+		else
+		{
+			probation.erase(e.position);
+			probation_size -= e.size;
+		}
+		elements.erase(found);
+	}
+
+private:
+	struct element
+	{
+		typename std::list<key>::iterator position;
+		size_t size;
+		bool is_protected;
+	};
+
+	/** Moves the least recently used protected elements back to probation, until the segment fits its share. */
+	void balance()
+	{
+		while(protected_segment.size() > 1 &&
+			protected_size * 100 > (protected_size + probation_size) * protected_percentage)
+		{
+			auto &e = elements.find(protected_segment.back())->second;
+			probation.splice(probation.begin(), protected_segment, e.position);
+			e.is_protected = false;
+			protected_size -= e.size;
+			probation_size += e.size;
+		}
+	}
+
+	/** Most recently used first */
+	std::list<key> probation;
+	std::list<key> protected_segment;
+	size_t probation_size = 0;
+	size_t protected_size = 0;
+	std::unordered_map<key, element> elements;
+	std::function<void(key)> remove_function;
+};
+
+
+#endif //DOORMAT_SLRU_H
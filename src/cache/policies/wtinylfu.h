@@ -0,0 +1,197 @@
+#ifndef DOORMAT_WTINYLFU_H
+#define DOORMAT_WTINYLFU_H
+
+#include "frequency_sketch.h"
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/** \brief W-TinyLFU: new elements enter a small LRU window, and then compete to be admitted in a segmented LRU
+ * holding the most of the bytes: when space is needed, the oldest candidate that left the window and the victim of
+ * the segmented LRU are compared, and the one seen less often according to a count-min sketch is evicted.
+ * Elements seen once, like the ones of a crawler scan, hardly ever win against popular ones.
+ *
+ * The policy does not know the capacity of the cache: it is taken as the bytes held when space is needed.
+ * Until the segmented LRU holds its share of them candidates are admitted without competing.
+ * */
+template<typename key>
+class wtinylfu_policy
+{
+public:
+	/** Share of the bytes that the window can hold */
+	static constexpr unsigned int window_percentage = 1;
+	/** Share of the bytes of the segmented LRU that its protected segment can hold */
+	static constexpr unsigned int protected_percentage = 80;
+
+	inline void set_remove_callback(std::function<void(key)> &&remove_function)
+	{
+		this->remove_function = std::move(remove_function);
+	}
+
+	inline void touch(const key& k)
+	{
+		sketch.increment(k);
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		auto &e = found->second;
+		switch(e.where)
+		{
+		case segment::window:
+			window.splice(window.begin(), window, e.position);
+			break;
+		case segment::candidates:
+			move(e, segment::window);
+			balance_window();
+			break;
+		case segment::probation:
+			move(e, segment::protected_segment);
+			balance_protected();
+			break;
+		case segment::protected_segment:
+			protected_segment.splice(protected_segment.begin(), protected_segment, e.position);
+			break;
+		}
+	}
+
+	inline void put(const key& k, size_t size)
+	{
+		remove(k);
+		sketch.increment(k);
+		window.push_front(k);
+		elements.emplace(k, element{window.begin(), size, segment::window});
+		sizes[static_cast<int>(segment::window)] += size;
+		// the sketch must be wide enough not to mix up the counts of the elements held
+		if(elements.size() > sketch.size()) widen_sketch();
+		balance_window();
+	}
+
+	inline size_t free_space(const size_t size_to_free)
+	{
+		size_t total_size = 0;
+		while (total_size < size_to_free && elements.size())
+		{
+			auto element_to_remove = victim();
+			total_size += elements.find(element_to_remove)->second.size;
+			remove(element_to_remove);
+			remove_function(element_to_remove);
+		}
+		return total_size;
+	}
+
+	inline void remove(key k)
+	{
+		auto found = elements.find(k);
+		if(found == elements.end()) return;
+		auto &e = found->second;
+		segment_of(e.where).erase(e.position);
+		sizes[static_cast<int>(e.where)] -= e.size;
+		elements.erase(found);
+	}
+
+private:
+	enum class segment { window = 0, candidates, probation, protected_segment };
+
+	struct element
+	{
+		typename std::list<key>::iterator position;
+		size_t size;
+		segment where;
+	};
+
+	std::list<key>& segment_of(segment s)
+	{
+		switch(s)
+		{
+		case segment::window: return window;
+		case segment::candidates: return candidates;
+		case segment::probation: return probation;
+		default: return protected_segment;
+		}
+	}
+
+	size_t size_of(segment s) const { return sizes[static_cast<int>(s)]; }
+
+	/** Moves an element at the head of another segment */
+	void move(element &e, segment to)
+	{
+		auto &destination = segment_of(to);
+		destination.splice(destination.begin(), segment_of(e.where), e.position);
+		sizes[static_cast<int>(e.where)] -= e.size;
+		sizes[static_cast<int>(to)] += e.size;
+		e.where = to;
+	}
+
+	size_t total_size() const
+	{
+		return sizes[0] + sizes[1] + sizes[2] + sizes[3];
+	}
+
+	/** The least recently used elements of the window in excess become candidates */
+	void balance_window()
+	{
+		while(window.size() > 1 && size_of(segment::window) * 100 > total_size() * window_percentage)
+			move(elements.find(window.back())->second, segment::candidates);
+	}
+
+	/** The least recently used protected elements in excess go back to probation */
+	void balance_protected()
+	{
+		size_t main = size_of(segment::probation) + size_of(segment::protected_segment);
+		while(protected_segment.size() > 1 && size_of(segment::protected_segment) * 100 > main * protected_percentage)
+			move(elements.find(protected_segment.back())->second, segment::probation);
+	}
+
+	/** Chooses the element to evict, admitting the oldest candidate when it is the most popular one */
+	key victim()
+	{
+		while(!candidates.empty() &&
+			(size_of(segment::probation) + size_of(segment::protected_segment)) * 100 < total_size() * (100 - window_percentage))
+			move(elements.find(candidates.back())->second, segment::probation);
+
+		bool main_empty = probation.empty() && protected_segment.empty();
+		if(candidates.empty())
+			return main_empty ? window.back() : main_victim();
+		if(main_empty)
+			return candidates.back();
+
+		auto candidate = candidates.back();
+		auto main_candidate = main_victim();
+		if(sketch.frequency(candidate) > sketch.frequency(main_candidate))
+		{
+			move(elements.find(candidate)->second, segment::probation);
+			return main_candidate;
+		}
+		return candidate;
+	}
+
+	/** Replaces the sketch with one twice as wide as the elements held, which keeps their counts */
+	void widen_sketch()
+	{
+		frequency_sketch<key> wider{elements.size() * 2};
+		for(auto &e: elements)
+			wider.restore(e.first, sketch.frequency(e.first));
+		sketch = std::move(wider);
+	}
+
+	key main_victim() const
+	{
+		return probation.empty() ? protected_segment.back() : probation.back();
+	}
+
+	/** Most recently used first */
+	std::list<key> window;
+	/** Left the window, not admitted yet; the oldest last */
+	std::list<key> candidates;
+	std::list<key> probation;
+	std::list<key> protected_segment;
+	size_t sizes[4]{};
+	std::unordered_map<key, element> elements;
+	frequency_sketch<key> sketch;
+	std::function<void(key)> remove_function;
+};
+
+
+#endif //DOORMAT_WTINYLFU_H
@@ -1,95 +1,116 @@
 #ifndef DOORMAT_TAG_H
 #define DOORMAT_TAG_H
 
-#include <vector>
+#include <cstddef>
 #include <functional>
-#include <algorithm>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
-template<typename tag_t, typename key_t, unsigned int set_expected_size = 64>
+/** \brief Index of the keys by tag, with constant time insertions and removals.
+ *
+ * Every tag owns an intrusive doubly linked list of keys, threaded through an array indexed by the key itself;
+ * the same array tells the tag of a key. Tags left without keys are dropped, so that many short lived tags
+ * (e.g. surrogate keys of the responses) do not pile up.
+ *
+ * \tparam tag_t the type of the tags
+ * \tparam key_t the type of the keys: small non negative integers, like the ids of a translation_unit
+ * */
+template<typename tag_t, typename key_t>
 class tagger
 {
-public:
-	inline void insert(const tag_t &tag, const key_t &k)
+	struct keys_list
 	{
-		for(auto &v: tag_manager)
-		{
-			if(v.first == tag)
-			{
-				insert(v.second, k);
-				return;
-			}
-		}
+		key_t first = none;
+		size_t size = 0;
+	};
 
-		//tag does not exist.
-		auto new_tag =std::make_pair(tag, std::vector<key_t>());
-		insert(new_tag.second, k);
-		tag_manager.push_back(std::move(new_tag));
-		return;
-	}
+	using tags_t = std::unordered_map<tag_t, keys_list>;
+	/** References to the elements of an unordered_map survive rehashing */
+	using tag_entry = typename tags_t::value_type;
+
+	struct link
+	{
+		tag_entry *tag = nullptr;
+		key_t previous = none;
+		key_t next = none;
+	};
 
-	inline void insert(std::vector<key_t> &where, const key_t &k)
+	static constexpr key_t none = static_cast<key_t>(-1);
+
+public:
+	/** Indexes a key under a tag; a key has one tag at most, hence a previous one is replaced. */
+	inline void insert(const tag_t &tag, const key_t &k)
 	{
-		where.push_back(k);
+		remove(k);
+		if(static_cast<size_t>(k) >= links.size()) links.resize(static_cast<size_t>(k) + 1);
+		auto &entry = *tags.emplace(tag, keys_list{}).first;
+		auto &l = links[k];
+		l.tag = &entry;
+		l.previous = none;
+		l.next = entry.second.first;
+		if(l.next != none) links[l.next].previous = k;
+		entry.second.first = k;
+		++entry.second.size;
 	}
 
+	/** Removes a key from the index.
+	 * \return its tag, or an empty one if the key was not tagged
+	 * */
 	inline tag_t remove(const key_t &k)
 	{
-		for(auto &v: tag_manager)
-		{
-			auto b = std::find(v.second.begin(), v.second.end(), k);
-			if(b != v.second.end())
-			{
-				v.second.erase(b);
-				return v.first;
-			}
-		}
-
-		return tag_t{};
+		if(static_cast<size_t>(k) >= links.size() || links[k].tag == nullptr) return tag_t{};
+		auto &entry = *links[k].tag;
+		tag_t tag = entry.first;
+		unlink(k);
+		if(entry.second.size == 0) tags.erase(tag);
+		return tag;
 	}
 
+	/** Removes all the keys under a tag, calling the callback on every one of them after its removal. */
 	inline void clear(const tag_t &tag, std::function<void(key_t)> &&callback)
 	{
-		for(auto v = tag_manager.begin(); v != tag_manager.end(); ++v)
+		auto found = tags.find(tag);
+		if(found == tags.end()) return;
+		while(found->second.first != none)
 		{
-			if(v->first == tag)
-			{
-				clear(*v, std::move(callback));
-				tag_manager.erase(v);
-				return;
-			}
+			key_t k = found->second.first;
+			unlink(k);
+			callback(k);
 		}
+		tags.erase(found);
 	}
 
-private:
-
-	inline void remove(std::vector<key_t> &what, const key_t &k)
+	/** \return the number of keys under a tag */
+	inline size_t size(const tag_t &tag) const
 	{
-		auto b = std::find(what.begin(), what.end(), k);
-		what.erase(b);
+		auto found = tags.find(tag);
+		return found == tags.end() ? 0 : found->second.size;
 	}
 
-	inline void remove(const tag_t &tag, const key_t &k)
+	/** \return the number of tags with at least a key */
+	inline size_t tags_count() const noexcept
 	{
-		for(auto &v: tag_manager)
-		{
-			if (v.first == tag)
-			{
-				remove(v.second, k);
-				return;
-			}
-		}
+		return tags.size();
 	}
 
-	inline void clear(const std::pair<tag_t, std::vector<key_t>> &what, std::function<void(key_t)> && callback)
+private:
+	void unlink(const key_t &k)
 	{
-		for(auto &v: what.second)
-		{
-			callback(v);
-		}
+		auto &l = links[k];
+		auto &list = l.tag->second;
+		if(l.previous != none) links[l.previous].next = l.next;
+		else list.first = l.next;
+		if(l.next != none) links[l.next].previous = l.previous;
+		--list.size;
+		l = link{};
 	}
 
-	std::vector<std::pair<tag_t, std::vector<key_t>>> tag_manager;
+	tags_t tags;
+	std::vector<link> links;
 };
 
+template<typename tag_t, typename key_t>
+constexpr key_t tagger<tag_t, key_t>::none;
+
 #endif //DOORMAT_TAG_H
@@ -124,6 +124,19 @@ public:
 		return inner_remove(translated);
 	}
 
+	/** Calls f on every element, valid or not, in no particular order */
+	template<typename F>
+	void for_each(F &&f) const
+	{
+		for(auto &v: outerkey_translator)
+			f(*v.second);
+	}
+
+	size_t size() const noexcept
+	{
+		return outerkey_translator.size();
+	}
+
 	~translation_unit()
 	{
 		for(auto &v: outerkey_translator)
@@ -8,9 +8,66 @@
 #include <tuple>
 #include <memory>
 #include <functional>
+#include <type_traits>
 #include "index_sequence.h"
 #include "node_interface.h"
 
+namespace impl
+{
+
+/**
+ * Whether a node declares its own handler for an event, or inherits the one
+ * of node_interface that just forwards it through a std::function.
+ */
+#define DOORMAT_NODE_HANDLES(event) \
+	template<typename T> \
+	struct handles_##event : std::integral_constant<bool, \
+		!std::is_same<decltype(&T::event), decltype(&node_interface::event)>::value> {};
+
+DOORMAT_NODE_HANDLES(on_request_preamble)
+DOORMAT_NODE_HANDLES(on_request_body)
+DOORMAT_NODE_HANDLES(on_request_trailer)
+DOORMAT_NODE_HANDLES(on_request_canceled)
+DOORMAT_NODE_HANDLES(on_request_finished)
+DOORMAT_NODE_HANDLES(on_header)
+DOORMAT_NODE_HANDLES(on_body)
+DOORMAT_NODE_HANDLES(on_trailer)
+DOORMAT_NODE_HANDLES(on_end_of_message)
+DOORMAT_NODE_HANDLES(on_error)
+DOORMAT_NODE_HANDLES(on_response_continue)
+
+#undef DOORMAT_NODE_HANDLES
+
+/**
+ * Pooled chains are reset between transactions, node by node: each node
+ * must bring back its own state, there is no generic way to do it.
+ */
+template<typename T>
+struct handles_reset : std::true_type
+{
+	static_assert(!std::is_same<decltype(&T::reset), decltype(&node_interface::reset)>::value,
+		"a node must declare reset(), bringing it back to its just-built state");
+};
+
+/**
+ * Events a node does not handle skip it: they go straight to its neighbour,
+ * a direct call the compiler can inline, instead of through the std::function
+ * hops of node_interface.
+ */
+template<typename Handle, typename Skip>
+inline void route(std::true_type, Handle&& handle, Skip&&)
+{
+	handle();
+}
+
+template<typename Handle, typename Skip>
+inline void route(std::false_type, Handle&&, Skip&& skip)
+{
+	skip();
+}
+
+}
+
 template<typename T, typename S, typename... N>
 struct chain;
 
@@ -23,6 +80,7 @@ struct node
 	node(prev_type* p, next_type* n, logging::access_recorder *aclogger = nullptr)
 		: prev{p}
 		, next{n}
+		, aclogger{aclogger}
 		, t(
 			[this](http::http_request&& message){ next->request_preamble(std::move(message)); },
 			[this](dstring &&chunk) { next->request_body(std::move(chunk)); },
@@ -40,72 +98,103 @@ struct node
 	template<typename... Args>
 	void request_preamble(Args&&... args)
 	{
-		t.on_request_preamble(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_preamble<decltype(t)>{},
+			[&]{ t.on_request_preamble(std::forward<Args>(args)...); },
+			[&]{ next->request_preamble(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_body(Args &&... args)
+	void request_body(Args&&... args)
 	{
-		t.on_request_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_body<decltype(t)>{},
+			[&]{ t.on_request_body(std::forward<Args>(args)...); },
+			[&]{ next->request_body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_trailer(Args &&... args)
+	void request_trailer(Args&&... args)
 	{
-		t.on_request_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_trailer<decltype(t)>{},
+			[&]{ t.on_request_trailer(std::forward<Args>(args)...); },
+			[&]{ next->request_trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename...Args>
-	void request_canceled(Args&&... args) {
-		t.on_request_canceled(std::forward<Args>(args)...);
+	void request_canceled(Args&&... args)
+	{
+		impl::route(impl::handles_on_request_canceled<decltype(t)>{},
+			[&]{ t.on_request_canceled(std::forward<Args>(args)...); },
+			[&]{ next->request_canceled(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_finished(Args &&... args)
+	void request_finished(Args&&... args)
 	{
-		t.on_request_finished(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_finished<decltype(t)>{},
+			[&]{ t.on_request_finished(std::forward<Args>(args)...); },
+			[&]{ next->request_finished(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void header(Args&&... args)
 	{
-		t.on_header(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_header<decltype(t)>{},
+			[&]{ t.on_header(std::forward<Args>(args)...); },
+			[&]{ prev->header(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void body(Args&&... args)
 	{
-		t.on_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_body<decltype(t)>{},
+			[&]{ t.on_body(std::forward<Args>(args)...); },
+			[&]{ prev->body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void trailer(Args&&... args)
 	{
-		t.on_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_trailer<decltype(t)>{},
+			[&]{ t.on_trailer(std::forward<Args>(args)...); },
+			[&]{ prev->trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void end_of_message(Args&&... args)
 	{
-		t.on_end_of_message(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_end_of_message<decltype(t)>{},
+			[&]{ t.on_end_of_message(std::forward<Args>(args)...); },
+			[&]{ prev->end_of_message(std::forward<Args>(args)...); });
 	}
 
 
 	template<typename... Args>
 	void error(Args&&... args)
 	{
-		t.on_error(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_error<decltype(t)>{},
+			[&]{ t.on_error(std::forward<Args>(args)...); },
+			[&]{ prev->error(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void response_continue(Args&&... args)
 	{
-		t.on_response_continue(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_response_continue<decltype(t)>{},
+			[&]{ t.on_response_continue(std::forward<Args>(args)...); },
+			[&]{ prev->response_continue(std::forward<Args>(args)...); });
+	}
+
+	/** Brings the node back to its just-built state. */
+	void reset()
+	{
+		static_assert(impl::handles_reset<decltype(t)>::value, "");
+		t.reset();
 	}
 
 private:
 	prev_type* prev{nullptr};
 	next_type* next{nullptr};
+	logging::access_recorder* aclogger{nullptr};
 	typename std::tuple_element<N, std::tuple<T...>>::type t;
 };
 
@@ -118,6 +207,7 @@ struct node<I, 0, M, T...>
 	node(prev_type* p, next_type* n, logging::access_recorder *aclogger = nullptr)
 		: prev{p}
 		, next{n}
+		, aclogger{aclogger}
 		, t(
 			[this](http::http_request&& message){ next->request_preamble(std::move(message)); },
 			[this](dstring&& chunk){ next->request_body(std::move(chunk)); },
@@ -135,73 +225,103 @@ struct node<I, 0, M, T...>
 	template<typename... Args>
 	void request_preamble(Args&&... args)
 	{
-		t.on_request_preamble(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_preamble<decltype(t)>{},
+			[&]{ t.on_request_preamble(std::forward<Args>(args)...); },
+			[&]{ next->request_preamble(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_body(Args &&... args)
+	void request_body(Args&&... args)
 	{
-		t.on_request_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_body<decltype(t)>{},
+			[&]{ t.on_request_body(std::forward<Args>(args)...); },
+			[&]{ next->request_body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_trailer(Args &&... args)
+	void request_trailer(Args&&... args)
 	{
-		t.on_request_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_trailer<decltype(t)>{},
+			[&]{ t.on_request_trailer(std::forward<Args>(args)...); },
+			[&]{ next->request_trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void request_canceled(Args&&... args)
 	{
-		t.on_request_canceled(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_canceled<decltype(t)>{},
+			[&]{ t.on_request_canceled(std::forward<Args>(args)...); },
+			[&]{ next->request_canceled(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
-	void request_finished(Args &&... args)
+	void request_finished(Args&&... args)
 	{
-		t.on_request_finished(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_request_finished<decltype(t)>{},
+			[&]{ t.on_request_finished(std::forward<Args>(args)...); },
+			[&]{ next->request_finished(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void header(Args&&... args)
 	{
-		t.on_header(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_header<decltype(t)>{},
+			[&]{ t.on_header(std::forward<Args>(args)...); },
+			[&]{ prev->header(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void body(Args&&... args)
 	{
-		t.on_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_body<decltype(t)>{},
+			[&]{ t.on_body(std::forward<Args>(args)...); },
+			[&]{ prev->body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void trailer(Args&&... args)
 	{
-		t.on_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_trailer<decltype(t)>{},
+			[&]{ t.on_trailer(std::forward<Args>(args)...); },
+			[&]{ prev->trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void end_of_message(Args&&... args)
 	{
-		t.on_end_of_message(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_end_of_message<decltype(t)>{},
+			[&]{ t.on_end_of_message(std::forward<Args>(args)...); },
+			[&]{ prev->end_of_message(std::forward<Args>(args)...); });
 	}
 
 
 	template<typename... Args>
 	void error(Args&&... args)
 	{
-		t.on_error(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_error<decltype(t)>{},
+			[&]{ t.on_error(std::forward<Args>(args)...); },
+			[&]{ prev->error(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void response_continue(Args&&... args)
 	{
-		t.on_response_continue(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_response_continue<decltype(t)>{},
+			[&]{ t.on_response_continue(std::forward<Args>(args)...); },
+			[&]{ prev->response_continue(std::forward<Args>(args)...); });
+	}
+
+	/** Brings the node back to its just-built state. */
+	void reset()
+	{
+		static_assert(impl::handles_reset<decltype(t)>::value, "");
+		t.reset();
 	}
 
 private:
 	prev_type* prev{nullptr};
 	next_type* next{nullptr};
+	logging::access_recorder* aclogger{nullptr};
 	typename std::tuple_element<0, std::tuple<T...>>::type t;
 };
 
@@ -212,6 +332,7 @@ struct node<I, 0, 0, T>
 
 	node(prev_type* p, void *, logging::access_recorder *aclogger = nullptr)
 		: prev{p}
+		, aclogger{aclogger}
 		, t(
 			[this](http::http_request&&){ /*do nothing: we need to receive body. */},
 			[this](dstring &&) { /* do nothing, we don't know if it is the last one! */},
@@ -258,42 +379,62 @@ struct node<I, 0, 0, T>
 	template<typename... Args>
 	void header(Args&&... args)
 	{
-		t.on_header(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_header<decltype(t)>{},
+			[&]{ t.on_header(std::forward<Args>(args)...); },
+			[&]{ prev->header(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void body(Args&&... args)
 	{
-		t.on_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_body<decltype(t)>{},
+			[&]{ t.on_body(std::forward<Args>(args)...); },
+			[&]{ prev->body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void trailer(Args&&... args)
 	{
-		t.on_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_trailer<decltype(t)>{},
+			[&]{ t.on_trailer(std::forward<Args>(args)...); },
+			[&]{ prev->trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void end_of_message(Args&&... args)
 	{
-		t.on_end_of_message(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_end_of_message<decltype(t)>{},
+			[&]{ t.on_end_of_message(std::forward<Args>(args)...); },
+			[&]{ prev->end_of_message(std::forward<Args>(args)...); });
 	}
 
 
 	template<typename... Args>
-	void error(Args &&... args)
+	void error(Args&&... args)
 	{
-		t.on_error(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_error<decltype(t)>{},
+			[&]{ t.on_error(std::forward<Args>(args)...); },
+			[&]{ prev->error(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void response_continue(Args&&... args)
 	{
-		t.on_response_continue(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_response_continue<decltype(t)>{},
+			[&]{ t.on_response_continue(std::forward<Args>(args)...); },
+			[&]{ prev->response_continue(std::forward<Args>(args)...); });
+	}
+
+	/** Brings the node back to its just-built state. */
+	void reset()
+	{
+		static_assert(impl::handles_reset<decltype(t)>::value, "");
+		t.reset();
 	}
 
 private:
 	prev_type* prev{nullptr};
+	logging::access_recorder* aclogger{nullptr};
 	T t;
 };
 
@@ -304,6 +445,7 @@ struct node<I,N, N, T...>
 
 	node(prev_type* p, void*, logging::access_recorder *aclogger = nullptr)
 		: prev{p}
+		, aclogger{aclogger}
 		, t(
 			//request forward callback
 			[this](http::http_request&&){},
@@ -352,42 +494,62 @@ struct node<I,N, N, T...>
 	template<typename... Args>
 	void header(Args&&... args)
 	{
-		t.on_header(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_header<decltype(t)>{},
+			[&]{ t.on_header(std::forward<Args>(args)...); },
+			[&]{ prev->header(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void body(Args&&... args)
 	{
-		t.on_body(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_body<decltype(t)>{},
+			[&]{ t.on_body(std::forward<Args>(args)...); },
+			[&]{ prev->body(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void trailer(Args&&... args)
 	{
-		t.on_trailer(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_trailer<decltype(t)>{},
+			[&]{ t.on_trailer(std::forward<Args>(args)...); },
+			[&]{ prev->trailer(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void end_of_message(Args&&... args)
 	{
-		t.on_end_of_message(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_end_of_message<decltype(t)>{},
+			[&]{ t.on_end_of_message(std::forward<Args>(args)...); },
+			[&]{ prev->end_of_message(std::forward<Args>(args)...); });
 	}
 
 
 	template<typename... Args>
-	void error(Args &&... args)
+	void error(Args&&... args)
 	{
-		t.on_error(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_error<decltype(t)>{},
+			[&]{ t.on_error(std::forward<Args>(args)...); },
+			[&]{ prev->error(std::forward<Args>(args)...); });
 	}
 
 	template<typename... Args>
 	void response_continue(Args&&... args)
 	{
-		t.on_response_continue(std::forward<Args>(args)...);
+		impl::route(impl::handles_on_response_continue<decltype(t)>{},
+			[&]{ t.on_response_continue(std::forward<Args>(args)...); },
+			[&]{ prev->response_continue(std::forward<Args>(args)...); });
+	}
+
+	/** Brings the node back to its just-built state. */
+	void reset()
+	{
+		static_assert(impl::handles_reset<decltype(t)>::value, "");
+		t.reset();
 	}
 
 private:
 	prev_type* prev{nullptr};
+	logging::access_recorder* aclogger{nullptr};
 	typename std::tuple_element<N, std::tuple<T...>>::type t;
 };
 
@@ -412,6 +574,12 @@ struct chain<T,impl::integer_sequence<std::size_t, I...>, N...>: public T
 		, node<T, I, sizeof...(N)-1, N...>{this, this, aclogger}...
 	{}
 
+	void reset() override
+	{
+		using expand = int[];
+		(void)expand{0, (node<T, I, sizeof...(N)-1, N...>::reset(), 0)...};
+	}
+
 	template<typename... Args>
 	void request_preamble(Args&&... args)
 	{
@@ -84,6 +84,12 @@ struct node_interface : private boost::noncopyable
 	//Handle HTTP1.1 CONTINUE
 	void on_response_continue(){ response_continue(); }
 
+	/**
+	 * Brings a chain back to the state it was built in, so that it can serve
+	 * another transaction. Every node of a chain declares its own reset().
+	 */
+	virtual void reset() {}
+
 	virtual ~node_interface() = default;
 
 protected:
@@ -14,11 +14,12 @@ const std::string configuration_maker::mandatory_keys[13]
 	"operation_timeout", "board_timeout", "log_path", "error_host", "error_files"
 };
 
-const std::string configuration_maker::allowed_keys[15]
+const std::string configuration_maker::allowed_keys[18]
 {
 	"threads","interreg_address","request_size_limit","header_config","disable_http2",
-	"daemon", "http2_ng", "inspector",
-	"log_level","cache", "gzip", "connection_attempts", "file_descriptor_limit", "cache_normalization", "magnet"
+	"daemon", "http2_ng", "http2", "inspector",
+	"log_level","cache", "gzip", "connection_attempts", "file_descriptor_limit", "cache_normalization", "magnet",
+	"chains", "pipeline_buffer_size"
 };
 
 configuration_maker::configuration_maker(bool verbose) : cw{new configuration_wrapper()}, verbose{verbose}
@@ -84,9 +85,11 @@ bool configuration_maker::add_configuration(const std::string &key, const json &
 	if (key == "error_host") return errorhost_configuration(js);
 	if (key == "error_files") return errorfiles_configuration(js);
 	/** Allowed:
-	 * threads, interreg_address, request_size_limit, header_config, disable_http2, daemon,
-	 * log_level, cache_path, cached_domains, gzip[compression_level,  compression_min_size, compressed_mime_types]
-	 * magnet
+	 * threads, interreg_address, request_size_limit, header_config, disable_http2, http2_ng,
+	 * http2[max_concurrent_streams, header_table_size, initial_window_size, max_frame_size,
+	 * max_header_list_size, max_window_size], daemon,
+	 * log_level, cache[path, domains, memory, persistent], gzip[compression_level,  compression_min_size, compressed_mime_types]
+	 * magnet, chains, pipeline_buffer_size
 	 */
 	if (key == "threads") return threads_configuration(js);
 	if (key == "interreg_address") return interregaddress_configuration(js);
@@ -94,6 +97,7 @@ bool configuration_maker::add_configuration(const std::string &key, const json &
 	if (key == "header_config") return headerconfig_configuration(js);
 	if (key == "disable_http2") return disablehttp2_configuration(js);
 	if (key == "http2_ng") return http2_ng(js);
+	if (key == "http2") return http2_configuration(js);
 	if (key == "inspector") return inspector_active_configuration( js );
 	if (key == "daemon") return daemon_configuration(js);
 	if (key == "log_level") return loglevel_configuration(js);
@@ -103,6 +107,8 @@ bool configuration_maker::add_configuration(const std::string &key, const json &
 	if (key == "file_descriptor_limit") return fd_configuration(js);
 	if (key == "cache_normalization") return cache_normalization_configuration(js);
 	if (key == "magnet") return magnet_configuration(js);
+	if (key == "chains") return chains_configuration(js);
+	if (key == "pipeline_buffer_size") return pipelinebuffer_configuration(js);
 
 	return false;
 }
@@ -223,6 +229,46 @@ bool configuration_maker::cache_normalization_configuration(const json&js)
 	return true;
 }
 
+bool configuration_maker::chains_configuration(const json&js)
+{
+	if(!is_array(js))
+		return false;
+
+	for(auto rule = js.cbegin(); rule != js.cend(); ++rule)
+	{
+		if(!is_object(rule.value()))
+		{
+			notify("chains directive must have as value an array of objects with mandatory fields vhost and chain, and allowed field path");
+			return false;
+		}
+		chain_rule r;
+		for(auto rule_field = rule.value().cbegin(); rule_field != rule.value().cend(); ++rule_field)
+		{
+			if(!is_string(rule_field.value())) return false;
+			if(rule_field.key() == "vhost")
+				r.vhost = rule_field.value();
+			else if(rule_field.key() == "chain")
+				r.chain = rule_field.value();
+			else if(rule_field.key() == "path")
+				r.path = rule_field.value();
+			else
+			{
+				notify("key ", rule_field.key(), " not allowed in chains rule.");
+				return false;
+			}
+		}
+		if(r.vhost.empty() || r.chain.empty())
+		{
+			notify("every chains rule must contain mandatory fields \"vhost\" and \"chain\"");
+			return false;
+		}
+
+		cw->chain_rules.push_back(std::move(r));
+		notify_valid();
+	}
+	return true;
+}
+
 bool configuration_maker::operationtimeout_configuration(const json &js)
 {
 
@@ -440,6 +486,19 @@ bool configuration_maker::rsizelimit_configuration(const json &js)
 	return true;
 }
 
+bool configuration_maker::pipelinebuffer_configuration(const json &js)
+{
+	if (!is_number_integer(js) || js <= 0)
+	{
+		notify("key \"", current_key, "\" allows a positive integer, in bytes");
+		return false;
+	}
+	size_t size = js;
+	cw->pipeline_buffer_size = size;
+	notify_valid();
+	return true;
+}
+
 bool configuration_maker::headerconfig_configuration(const json &js)
 {
 	if(!is_string(js)) return false;
@@ -466,6 +525,40 @@ bool configuration_maker::http2_ng( const json& js )
 	return true;
 }
 
+bool configuration_maker::http2_configuration(const json &js)
+{
+	if(!is_object(js)) return false;
+	http2_settings settings;
+	for(auto b = js.cbegin(); b != js.cend(); ++b)
+	{
+		if(!is_number_integer(b.value())) return false;
+		long int value = b.value();
+		if(value < 0 || value > 2147483647)
+			throw std::logic_error{"invalid value " + std::to_string(value) + " for http2 setting " + b.key()};
+
+		if(b.key() == "max_concurrent_streams") settings.max_concurrent_streams = value;
+		else if(b.key() == "header_table_size") settings.header_table_size = value;
+		else if(b.key() == "initial_window_size") settings.initial_window_size = value;
+		else if(b.key() == "max_frame_size") settings.max_frame_size = value;
+		else if(b.key() == "max_header_list_size") settings.max_header_list_size = value;
+		else if(b.key() == "max_window_size") settings.max_window_size = value;
+		else
+		{
+			notify("key \"", current_key, "\" does not allow the setting ", b.key());
+			return false;
+		}
+	}
+
+	if(settings.max_frame_size < 16384 || settings.max_frame_size > 16777215)
+		throw std::logic_error{"http2 max_frame_size must be between 16384 and 16777215"};
+	if(settings.max_window_size < settings.initial_window_size)
+		throw std::logic_error{"http2 max_window_size is smaller than initial_window_size"};
+
+	cw->h2_settings = settings;
+	notify_valid();
+	return true;
+}
+
 bool configuration_maker::disablehttp2_configuration(const json &js)
 {
 	if(!is_boolean(js)) return false;
@@ -503,6 +596,9 @@ bool configuration_maker::cache_configuration(const json &js)
 
 	bool has_cache_path = false;
 	std::string cache_path;
+	size_t memory_size = cw->cache_memory_size_;
+	bool persistent = cw->cache_persistent_;
+	std::string policy = cw->cache_policy_;
 	std::vector<std::pair<bool,std::string>> domains;
 	for(auto cb = js.cbegin(); cb != js.cend(); ++cb)
 	{
@@ -513,6 +609,30 @@ bool configuration_maker::cache_configuration(const json &js)
 			cache_path = cb.value();
 		}
 
+		if(cb.key() == "memory")
+		{
+			if(!is_number_integer(cb.value())) return false;
+			long int value = cb.value();
+			if(value < 0)
+				throw std::logic_error{"invalid value " + std::to_string(value) + " for the cache memory size"};
+			memory_size = value;
+		}
+
+		if(cb.key() == "persistent")
+		{
+			if(!is_boolean(cb.value())) return false;
+			persistent = cb.value();
+		}
+
+		if(cb.key() == "policy")
+		{
+			if(!is_string(cb.value())) return false;
+			std::string value = cb.value();
+			if(value != "fifo" && value != "slru" && value != "s3fifo" && value != "wtinylfu")
+				throw std::logic_error{"Invalid cache policy " + value + " in configuration file"};
+			policy = value;
+		}
+
 		if(cb.key() == "domains")
 		{
 			if(!is_array(cb.value())) return false;
@@ -529,6 +649,9 @@ bool configuration_maker::cache_configuration(const json &js)
 	}
 	cw->cache_enabled_ = true;
 	cw->cache_path_ = cache_path;
+	cw->cache_memory_size_ = memory_size;
+	cw->cache_persistent_ = persistent;
+	cw->cache_policy_ = policy;
 	cw->cache_domains = domains;
 	if(has_cache_path) notify_valid();
 	return has_cache_path;
@@ -63,7 +63,7 @@ private:
 
 	//configuration_wrapper wrp;
 	const static std::string mandatory_keys[13];
-	const static std::string allowed_keys[15];
+	const static std::string allowed_keys[18];
 
 	std::bitset<sizeof(mandatory_keys)/sizeof(std::string)> mandatory_inserted;
 	std::unique_ptr<configuration_wrapper> cw;
@@ -110,12 +110,16 @@ private:
 
 	bool rsizelimit_configuration(const json &js);
 
+	bool pipelinebuffer_configuration(const json &js);
+
 	bool headerconfig_configuration(const json &js);
 
 	bool disablehttp2_configuration(const json &js);
 	
 	bool http2_ng( const json& js );
 
+	bool http2_configuration(const json &js);
+
 	bool daemon_configuration(const json &js);
 
 	bool loglevel_configuration(const json &js);
@@ -138,6 +142,8 @@ private:
 
 	bool cache_normalization_configuration(const json &js);
 
+	bool chains_configuration(const json &js);
+
 	bool magnet_configuration(const json &js);
 };
 
@@ -22,6 +22,32 @@ namespace configuration
 
 class certificates_iterator;
 
+/**
+ * @brief A chain_rule sends the requests of a virtual host, and of a path
+ * prefix if given, through the chain registered with that name.
+ */
+struct chain_rule
+{
+	std::string vhost;
+	std::string path;
+	std::string chain;
+};
+
+/**
+ * @brief SETTINGS announced by HTTP/2 sessions, and how far their
+ * receive windows can grow.
+ */
+struct http2_settings
+{
+	uint32_t max_concurrent_streams{100};
+	uint32_t header_table_size{4096};
+	uint32_t initial_window_size{65535};
+	uint32_t max_frame_size{16384};
+	uint32_t max_header_list_size{0}; // Not announced when 0
+	// Windows grow with the measured bandwidth-delay product up to this, per connection
+	uint32_t max_window_size{16777216};
+};
+
 class configuration_wrapper
 {
 	friend class configuration_maker;
@@ -61,6 +87,7 @@ class configuration_wrapper
 	void parse_network_file(const std::string&, std::list<network::IPV4Network>&);
 	bool http2_disabled{false};
 	bool http2_next{false};
+	http2_settings h2_settings;
 	bool inspector{false};
 	bool daemonize{false};
 	std::string daemon_path{""};
@@ -69,8 +96,12 @@ class configuration_wrapper
 
 	bool cache_enabled_{false};
 	std::string cache_path_{""};
+	size_t cache_memory_size_{64 * 1024 * 1024}; // Bytes of cached contents served from memory
+	bool cache_persistent_{true}; // Keep the cached contents across restarts
+	std::string cache_policy_{"fifo"}; // Replacement policy of the cache: fifo, slru, s3fifo or wtinylfu
 
 	size_t size_limit{0};
+	size_t pipeline_buffer_size{1048576}; // Responses to pipelined requests held per connection
 
 	std::unique_ptr<header> header_conf{ std::unique_ptr<header>( new header ) };
 	bool cache_allowed;
@@ -81,6 +112,7 @@ class configuration_wrapper
 	uint32_t comp_minsize{0};
 	std::vector<std::string> compressed_mime_types;
 	std::vector<cache_normalization_rule> normalization_rules;
+	std::vector<chain_rule> chain_rules;
 
 	std::string magnet_metadata_map{""};
 	std::string magnet_data_map{""};
@@ -97,6 +129,7 @@ public:
 
 	virtual bool http2_is_disabled() const noexcept{ return http2_disabled; }
 	virtual bool http2_ng() const noexcept { return http2_next; }
+	virtual const http2_settings& get_http2_settings() const noexcept { return h2_settings; }
 	virtual bool inspector_active() const noexcept { return inspector; }
 	virtual std::string get_error_filename( uint16_t code ) const;
 	virtual std::string get_route_map() const noexcept { return route_map; }
@@ -112,10 +145,14 @@ public:
 	virtual uint64_t get_operation_timeout() const noexcept;
 	virtual uint64_t get_board_timeout() const noexcept;
 	virtual size_t get_max_reqsize() const noexcept { return size_limit; }
+	virtual size_t get_pipeline_buffer_size() const noexcept { return pipeline_buffer_size; }
 	virtual const header& header_configuration() const noexcept;
 	virtual std::string get_daemon_root() const noexcept { return daemon_path; }
 	virtual bool cache_enabled() const noexcept { return cache_enabled_; }
 	virtual std::string cache_path() const noexcept { return cache_path_; }
+	virtual size_t cache_memory_size() const noexcept { return cache_memory_size_; }
+	virtual bool cache_persistent() const noexcept { return cache_persistent_; }
+	virtual std::string cache_policy() const noexcept { return cache_policy_; }
 	virtual const std::vector<std::pair<bool, std::string>>& get_cache_domains_config() const noexcept { return cache_domains; }
 	virtual bool get_compression_enabled() const noexcept { return comp_enabled; }
 	virtual uint8_t get_compression_level() const noexcept { return comp_level; }
@@ -132,6 +169,8 @@ public:
 		}
 	}
 
+	virtual const std::vector<chain_rule>& get_chain_rules() const noexcept { return chain_rules; }
+
 	virtual bool magnet_enabled() { return magnet_data_map.size() || magnet_metadata_map.size(); }
 	virtual const std::string& get_magnet_data_map() const noexcept { return magnet_data_map; }
 	virtual const std::string& get_magnet_metadata_map() const noexcept { return magnet_metadata_map; }
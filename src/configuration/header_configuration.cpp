@@ -1,5 +1,6 @@
 #include "header_configuration.h"
 
+#include <atomic>
 #include <fstream>
 
 namespace configuration 
@@ -31,6 +32,12 @@ void header::init_generators()
 	generators = std::move ( t );
 }
 
+std::size_t header::next_generation() noexcept
+{
+	static std::atomic_size_t generations{0};
+	return ++generations;
+}
+
 const header::variable_set& header::variables() const noexcept
 {
 	return generators;
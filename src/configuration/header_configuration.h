@@ -23,8 +23,10 @@ private:
 	header_map to_add;
 	header_kill to_kill;
 	variable_set generators;
+	std::size_t _generation{0};
 	
 	void init_generators();
+	static std::size_t next_generation() noexcept;
 public:
 	header( const std::string& config_file );
 	header() noexcept {}
@@ -34,6 +36,7 @@ public:
 	void init( Stream& stream )
 	{
 		init_generators();
+		_generation = next_generation();
 		int state{0};
 		std::string key;
 		std::string value;
@@ -101,6 +104,9 @@ public:
 	header_kill::const_iterator end_kill() const { return to_kill.cend(); }
 	
 	const variable_set& variables() const noexcept;
+
+	/** Changes whenever rules are loaded, so that their users can tell stale copies. */
+	std::size_t generation() const noexcept { return _generation; }
 };
 
 }
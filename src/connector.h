@@ -3,6 +3,7 @@
 #include <memory>
 #include <functional>
 #include <type_traits>
+#include <vector>
 
 #include <boost/array.hpp>
 #include <boost/asio/ssl.hpp>
@@ -11,6 +12,7 @@
 
 #include "protocol/handler_factory.h"
 #include "utils/dstring.h"
+#include "utils/dstring_factory.h"
 #include "utils/reusable_buffer.h"
 #include "utils/log_wrapper.h"
 
@@ -33,10 +35,13 @@ public:
 	virtual void do_write() = 0;
 	virtual boost::asio::ip::address origin() const = 0;
 	virtual bool is_ssl() const noexcept = 0;
+	/** Hands the connection over to another handler, as when the protocol changes. */
+	virtual void handler( handler_interface* h ) = 0;
 	reusable_buffer<MAXINBYTESPERLOOP> _rb;
 
 protected:
-	dstring _out;
+	std::vector<dstring> _out;
+	std::vector<boost::asio::const_buffer> _out_buffers;
 };
 
 // handler_interface will become a template!?
@@ -52,6 +57,7 @@ class connector: public connector_interface,
 
 	boost::asio::deadline_timer _timer;
 
+	bool _reading {false};
 	bool _writing {false};
 	bool _stopped {false};
 
@@ -120,7 +126,7 @@ public:
 
 	void renew_ttl() { schedule_deadline(_ttl); }
 
-	void handler( handler_interface* h )
+	void handler( handler_interface* h ) override
 	{
 		_handler = h;
 		_handler->connector( this );
@@ -164,18 +170,20 @@ public:
 
 	void do_read() override
 	{
-		if(_stopped)
+		if(_reading || _stopped)
 			return;
 
 		renew_ttl();
 		LOGTRACE(this," triggered a read");
 
+		_reading = true;
 		auto self = this->shared_from_this();
 		auto buf = _rb.reserve();
 		_socket->async_read_some( boost::asio::mutable_buffers_1(buf),
 			[this,self](const berror_code& ec, size_t bytes_transferred)
 			{
 				cancel_deadline();
+				_reading = false;
 				if(!ec)
 				{
 					LOGDEBUG(this," received:",bytes_transferred," Bytes");
@@ -185,7 +193,10 @@ public:
 					if( _handler->on_read(tmp, bytes_transferred) )
 					{
 						LOGDEBUG(this," read succeded");
-						do_read();
+						if( _handler->should_read() )
+							do_read();
+						else
+							LOGTRACE(this," read suspended by the handler");
 					}
 					else
 					{
@@ -210,14 +221,14 @@ public:
 		if (_writing || _stopped)
 			return;
 
-		_out = dstring{};
-		if ( !_handler->on_write(_out) )
+		_out.clear();
+		if ( !_handler->on_write_chunks(_out) )
 		{
 			LOGERROR(this," error on_write - write failed");
 			return stop();
 		}
 
-		if( !_out && _handler->should_stop() )
+		if( _out.empty() && _handler->should_stop() )
 		{
 			LOGDEBUG(this," nothing left to write, stopping");
 			stop();
@@ -226,14 +237,30 @@ public:
 
 		renew_ttl();
 
-		if( !_out )
+		if( _out.empty() )
 			return;
 
-		LOGTRACE(this," triggered a write of ", _out.size(), " bytes");
+		// TLS writes a record per buffer: one buffer is cheaper than many small records
+		if( is_ssl() && _out.size() > 1 )
+		{
+			dstring joined = dstring_factory::join(_out);
+			_out.clear();
+			_out.push_back(std::move(joined));
+		}
+
+		_out_buffers.clear();
+		size_t bytes{0};
+		for(auto&& chunk : _out)
+		{
+			_out_buffers.emplace_back(chunk.cdata(), chunk.size());
+			bytes += chunk.size();
+		}
+
+		LOGTRACE(this," triggered a write of ", bytes, " bytes in ", _out.size(), " buffers");
 		_writing = true;
 
 		auto self = this->shared_from_this(); //Let the connector live inside the callback
-		boost::asio::async_write(*_socket, boost::asio::buffer(_out.cdata(), _out.size()),
+		boost::asio::async_write(*_socket, _out_buffers,
 			[this, self](const berror_code& ec, size_t s)
 			{
 				cancel_deadline();
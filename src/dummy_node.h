@@ -49,6 +49,12 @@ struct dummy_node : public node_interface
 		LOGTRACE("dummy node got a chunk");
 	}
 
+	void reset()
+	{
+		procrastinator.reset();
+		http_message_protocol_copy = http::http_request{};
+	}
+
 	~dummy_node()
 	{
 		LOGTRACE("dummy node is dead");
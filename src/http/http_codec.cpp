@@ -25,15 +25,15 @@ dstring http_codec::encode_body(const dstring& data)
 	if(data.empty())
 		return {};
 
-	dstring msg;
-	if(_chunked)
-		msg.append(from<size_t>(data.size()))
-				.append(http::crlf)
-				.append(data)
-				.append(http::crlf);
-	else
-		msg.append(data);
+	// Without chunking the body goes out as it is, sharing its storage
+	if(!_chunked)
+		return data;
 
+	dstring msg;
+	msg.append(from<size_t>(data.size()))
+			.append(http::crlf)
+			.append(data)
+			.append(http::crlf);
 	return msg;
 }
 
@@ -79,15 +79,24 @@ void http_codec::register_callback(const structured_cb& begin,const void_cb& hea
 	codec_impl->register_callback(begin,header,body, trailer,completion,error);
 }
 
-bool http_codec::decode(const char* data, size_t len) noexcept
+bool http_codec::decode(const char* read, size_t len) noexcept
 {
+	//The only copy of the read: everything parsed out of it is a slice
+	const char* data = codec_impl->buffer(read, len);
+
 	size_t b{0};
 	while( len > b )
 	{
 		b += codec_impl->decode(data+b, len - b);
 
+		if( codec_impl->stopped() )
+			break;
+
 		if( codec_impl->on_parser_error() != HPE_OK )
+		{
+			codec_impl->release_buffer();
 			return false;
+		}
 
 		if( _skip_next_header )
 		{
@@ -111,9 +120,26 @@ bool http_codec::decode(const char* data, size_t len) noexcept
 		}
 	}
 
+	codec_impl->release_buffer();
+	_decoded = b;
 	return true;
 }
 
+void http_codec::stop_after_message() noexcept
+{
+	codec_impl->stop_after_message();
+}
+
+void http_codec::reset() noexcept
+{
+	_chunked = false;
+	_skip_next_header = false;
+	_ignore_content_len = false;
+	_decoded = 0;
+	_encoder_state = encoder_state::ZERO;
+	codec_impl->restart();
+}
+
 int http_codec::on_message_begin(http_parser* parser)
 {
 	auto impl = static_cast<http_codec::impl*>(parser->data);
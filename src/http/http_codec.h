@@ -62,6 +62,14 @@ public:
 	bool decode(const char* data, size_t len) noexcept;
 	void ingnore_content_len() noexcept { _ignore_content_len = true; }
 
+	/** Decoding stops at the end of the current message: what follows belongs to the protocol upgraded to. */
+	void stop_after_message() noexcept;
+	/** Bytes parsed by the last decode: all of them, unless it was stopped. */
+	size_t decoded() const noexcept { return _decoded; }
+
+	/** Forgets the messages being decoded and encoded, to start over on another connection; callbacks are kept. */
+	void reset() noexcept;
+
 private:
 	static int on_url(http_parser*, const char *at, size_t length);
 	static int on_status(http_parser*, const char *at, size_t length);
@@ -80,6 +88,8 @@ private:
 	bool _skip_next_header{false};
 	bool _ignore_content_len{false};
 
+	size_t _decoded{0};
+
 	encoder_state _encoder_state{encoder_state::ZERO};
 
 	/**
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <list>
 #include <string>
 #include <utility>
@@ -8,6 +9,7 @@
 #include "http_request.h"
 #include "http_response.h"
 
+#include "../utils/arena.h"
 #include "../utils/utils.h"
 #include "../utils/likely.h"
 #include "../utils/log_wrapper.h"
@@ -25,15 +27,18 @@ class http_codec::impl
 	proto_version _version{proto_version::UNSET};
 
 	bool _ignore{false};
-	bool _connected{false};
 	bool _got_header{false};
 	bool _headers_completed{false};
+	bool _stop{false};
 
 	//NOTE: this limit is hardcoded to today defacto standard (nginx supports up to 8kb URI)
 	//It would be nice to join this check with a more general check on overall header size
 	//handled directly by buffer
 	const uint16_t max_uri_len{8192};
 
+	//Private copy of the read being decoded: tokens are slices of it
+	dstring _buffer;
+
 	dstring _urline;
 	dstring _status;
 	dstring _key;
@@ -52,23 +57,27 @@ class http_codec::impl
 
 public:
 	impl() noexcept
-		: _key{true}
 	{
 		reset();
 	}
 
+	/**
+	 * Hands the token over leaving it empty; unlike assigning
+	 * a fresh dstring, this does not allocate.
+	 */
+	static dstring take(dstring& token) noexcept { return std::move(token); }
+
 	void reset() noexcept
 	{
 		_data=nullptr;
 		_ignore = false;
-		_connected = false;
 		_got_header = false;
 		_headers_completed=false;
 
-		_urline = dstring{};
-		_status = dstring{};
-		_value = dstring{};
-		_key = dstring{true};
+		take(_urline);
+		take(_status);
+		take(_value);
+		take(_key);
 
 		http_parser_init(&_parser, HTTP_BOTH);
 		_parser.data = this;
@@ -104,6 +113,27 @@ public:
 	proto_version version() const noexcept { return _version; }
 	bool headers_done() const { return _headers_completed; }
 
+	void stop_after_message() noexcept { _stop = true; }
+
+	/** Unlike reset(), which runs between the messages of a connection, forgets the connection too. */
+	void restart() noexcept
+	{
+		reset();
+		_version = proto_version::UNSET;
+		_stop = false;
+		release_buffer();
+	}
+
+	/** True once, when decoding was stopped after a message. */
+	bool stopped() noexcept
+	{
+		if( !_stop || HTTP_PARSER_ERRNO(&_parser) != HPE_PAUSED )
+			return false;
+		_stop = false;
+		http_parser_pause(&_parser, 0);
+		return true;
+	}
+
 	void ignore_content_len()
 	{
 		//This has been provided to emulate NGINX behavior
@@ -116,11 +146,54 @@ public:
 		}
 	}
 
+	/**
+	 * Keeps a private copy of the read; returns what is to be parsed.
+	 * Only reads of a preamble go to the current arena: a body can
+	 * come in any number of them, kept until the transaction ends.
+	 */
+	const char* buffer(const char* read, size_t len) noexcept
+	{
+		if( _headers_completed )
+		{
+			utils::arena::scope heap{nullptr};
+			_buffer = dstring{read, len};
+		}
+		else
+			_buffer = dstring{read, len};
+		return _buffer.cdata();
+	}
+
+	void release_buffer() noexcept { take(_buffer); }
+
 	int decode(const char * const bytes, size_t size) noexcept
 	{
 		return http_parser_execute(&_parser, &_parser_settings, bytes, size);
 	}
 
+	/**
+	 * Tokens point into the read buffer; only those split between
+	 * two reads are copied.
+	 */
+	void collect(dstring& token, const char* at, size_t len) noexcept
+	{
+		if(token)
+			token.append(at, len);
+		else
+			token = _buffer.slice(at, at + len);
+	}
+
+	/**
+	 * Header names are lowercased in place: the buffer belongs to the codec
+	 * and nothing else points to this area yet.
+	 */
+	void collect_field(const char* at, size_t len) noexcept
+	{
+		assert(at >= _buffer.cbegin() && at + len <= _buffer.cend());
+		char* field = const_cast<char*>(at);
+		std::transform(at, at + len, field, ::tolower);
+		collect(_key, at, len);
+	}
+
 	int on_message_begin() noexcept
 	{
 		_scb( &_data );
@@ -130,29 +203,40 @@ public:
 
 	int on_url(const char *at, size_t len) noexcept
 	{
-		_urline.append(at, len);
+		collect(_urline, at, len);
 		if( _urline.size()> max_uri_len )
 			return 1;
 
 		auto d = static_cast<http::http_request *>(this->_data);
-		if(http_parser_parse_url(at, len, _connected, &_url) == 0)
+		if(http_parser_parse_url(_urline.cdata(), _urline.size(), _parser.method == HTTP_CONNECT, &_url) == 0)
 		{
-			d->schema(_urline.substr(_url.field_data[UF_SCHEMA].off,_url.field_data[UF_SCHEMA].len));
-			d->urihost(_urline.substr(_url.field_data[UF_HOST].off,_url.field_data[UF_HOST].len));
-			d->port(_urline.substr(_url.field_data[UF_PORT].off,_url.field_data[UF_PORT].len));
-			d->path(_urline.substr(_url.field_data[UF_PATH].off,_url.field_data[UF_PATH].len));
-			d->query(_urline.substr(_url.field_data[UF_QUERY].off,_url.field_data[UF_QUERY].len));
-			d->fragment(_urline.substr(_url.field_data[UF_FRAGMENT].off,_url.field_data[UF_FRAGMENT].len));
-			d->userinfo(_urline.substr(_url.field_data[UF_USERINFO].off,_url.field_data[UF_USERINFO].len));
+			//A split url is parsed again: skip what a previous attempt left behind
+			auto field = [this](http_parser_url_fields f)
+			{
+				size_t off{0}, len{0};
+				if( _url.field_set & (1 << f) )
+				{
+					off = _url.field_data[f].off;
+					len = _url.field_data[f].len;
+				}
+				return _urline.slice(off, len);
+			};
+
+			d->schema(field(UF_SCHEMA));
+			d->urihost(field(UF_HOST));
+			d->port(field(UF_PORT));
+			d->path(field(UF_PATH));
+			d->query(field(UF_QUERY));
+			d->fragment(field(UF_FRAGMENT));
+			d->userinfo(field(UF_USERINFO));
 		}
-		_connected = true;
 		return 0;
 	}
 
 	int on_status(const char* at, size_t len) noexcept
 	{
 		assert(_data->type() == typeid(http::http_response));
-		_status.append(at,len);
+		collect(_status, at, len);
 		http::http_response* d = static_cast<http::http_response *>(_data);
 		d->status(_parser.status_code,_status);
 		return 0;
@@ -163,13 +247,11 @@ public:
 		assert( _headers_completed == false );
 		if( _got_header )
 		{
-			_data->header(std::move(_key), std::move(_value));
+			_data->header(take(_key), take(_value));
 			_got_header = false;
-			_key = dstring{true};
-			_value = {};
 		}
 
-		_key.append(at,len);
+		collect_field(at, len);
 		return 0;
 	}
 
@@ -177,7 +259,7 @@ public:
 	{
 		assert( _headers_completed == false );
 		_got_header = true;
-		_value.append(at,len);
+		collect(_value, at, len);
 		return 0;
 	}
 
@@ -201,10 +283,8 @@ public:
 		//Set last header
 		if( _got_header )
 		{
-			_data->header(std::move(_key), std::move(_value));
+			_data->header(take(_key), take(_value));
 			_got_header = false;
-			_key = dstring{true};
-			_value = {};
 		}
 
 		//Set persistency
@@ -224,13 +304,11 @@ public:
 	{
 		if( _got_header )
 		{
-			_tcb(std::move(_key), std::move(_value));
+			_tcb(take(_key), take(_value));
 			_got_header = false;
-			_key = dstring{true};
-			_value = {};
 		}
 
-		_key.append(at,len);
+		collect_field(at, len);
 		return 0;
 	}
 
@@ -244,14 +322,14 @@ public:
 		//'on_eom' invocation.
 
 		_got_header = true;
-		_value.append(at,len);
+		collect(_value, at, len);
 		return 0;
 	}
 
 	int on_body(const char *at, size_t len) noexcept
 	{
 		if(!_ignore)
-			_bcb(dstring{at,len});
+			_bcb(_buffer.slice(at, at + len));
 		return 0;
 	}
 
@@ -273,10 +351,8 @@ public:
 	{
 		if( _got_header )
 		{
-			_tcb(std::move(_key), std::move(_value));
+			_tcb(take(_key), take(_value));
 			_got_header = false;
-			_key = dstring{true};
-			_value = {};
 		}
 
 		//Apparently keepalive can be instructed in trailers,
@@ -284,6 +360,9 @@ public:
 		//_keepalive = http_should_keep_alive(&_parser);
 		_ccb();
 		reset();
+		//The parser returns right after this callback
+		if( _stop )
+			http_parser_pause(&_parser, 1);
 		return 0;
 	}
 
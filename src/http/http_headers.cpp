@@ -0,0 +1,198 @@
+#include "http_headers.h"
+#include "http_commons.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace http
+{
+
+namespace
+{
+
+struct known_header
+{
+	const char* name;
+	size_t size;
+	uint32_t hash;
+};
+
+#define KNOWN_HEADER(hf) { hf, detail::length(hf), header_hash(hf) }
+
+// Indexed by header_id
+constexpr known_header known_headers[] =
+{
+	{ "", 0, header_hash("") },
+	KNOWN_HEADER(hf_connection),
+	KNOWN_HEADER(hf_host),
+	KNOWN_HEADER(hf_date),
+	KNOWN_HEADER(hf_cyndate),
+	KNOWN_HEADER(hf_content_len),
+	KNOWN_HEADER(hf_accept_encoding),
+	KNOWN_HEADER(hf_content_encoding),
+	KNOWN_HEADER(hf_transfer_encoding),
+	KNOWN_HEADER(hf_allow),
+	KNOWN_HEADER(hf_via),
+	KNOWN_HEADER(hf_server),
+	KNOWN_HEADER(hf_maxforward),
+	KNOWN_HEADER(hf_cyn_dest),
+	KNOWN_HEADER(hf_cyn_dest_port),
+	KNOWN_HEADER(hf_content_type),
+};
+
+#undef KNOWN_HEADER
+
+static_assert(sizeof(known_headers) / sizeof(known_header) == static_cast<size_t>(header_id::count),
+	"known_headers and header_id are out of sync");
+
+// Same as header_hash, without recursing on names of any length
+uint32_t hash_of(const char* s, size_t len) noexcept
+{
+	uint32_t h{2166136261u};
+	for(size_t i = 0; i < len; ++i)
+		h = (h ^ static_cast<uint8_t>(s[i])) * 16777619u;
+	return h;
+}
+
+}
+
+header_id intern(const char* name, size_t len, uint32_t hash) noexcept
+{
+	header_id id;
+	// Case labels must be unique: a collision among known headers does not compile
+	switch(hash)
+	{
+		case header_hash(hf_connection): id = header_id::connection; break;
+		case header_hash(hf_host): id = header_id::host; break;
+		case header_hash(hf_date): id = header_id::date; break;
+		case header_hash(hf_cyndate): id = header_id::cyndate; break;
+		case header_hash(hf_content_len): id = header_id::content_len; break;
+		case header_hash(hf_accept_encoding): id = header_id::accept_encoding; break;
+		case header_hash(hf_content_encoding): id = header_id::content_encoding; break;
+		case header_hash(hf_transfer_encoding): id = header_id::transfer_encoding; break;
+		case header_hash(hf_allow): id = header_id::allow; break;
+		case header_hash(hf_via): id = header_id::via; break;
+		case header_hash(hf_server): id = header_id::server; break;
+		case header_hash(hf_maxforward): id = header_id::maxforward; break;
+		case header_hash(hf_cyn_dest): id = header_id::cyn_dest; break;
+		case header_hash(hf_cyn_dest_port): id = header_id::cyn_dest_port; break;
+		case header_hash(hf_content_type): id = header_id::content_type; break;
+		default: return header_id::unknown;
+	}
+
+	// Unknown names may still share the hash of a known one
+	const auto& k = known_headers[static_cast<size_t>(id)];
+	if(k.size == len && std::equal(name, name + len, k.name))
+		return id;
+	return header_id::unknown;
+}
+
+const dstring& header_name(header_id id) noexcept
+{
+	// Immutable: copies are aliases and never allocate
+	static const dstring names[] =
+	{
+		dstring::make_immutable(known_headers[0].name),
+		dstring::make_immutable(hf_connection),
+		dstring::make_immutable(hf_host),
+		dstring::make_immutable(hf_date),
+		dstring::make_immutable(hf_cyndate),
+		dstring::make_immutable(hf_content_len),
+		dstring::make_immutable(hf_accept_encoding),
+		dstring::make_immutable(hf_content_encoding),
+		dstring::make_immutable(hf_transfer_encoding),
+		dstring::make_immutable(hf_allow),
+		dstring::make_immutable(hf_via),
+		dstring::make_immutable(hf_server),
+		dstring::make_immutable(hf_maxforward),
+		dstring::make_immutable(hf_cyn_dest),
+		dstring::make_immutable(hf_cyn_dest_port),
+		dstring::make_immutable(hf_content_type),
+	};
+	return names[static_cast<size_t>(id)];
+}
+
+header_key::header_key(const dstring& key) noexcept
+	: hash{hash_of(key.cdata(), key.size())}
+	, id{intern(key.cdata(), key.size(), hash)}
+	, name{key}
+{}
+
+header_key::header_key(const char* key) noexcept
+	: header_key{key, strlen(key)}
+{}
+
+header_key::header_key(const char* key, size_t size) noexcept
+	: hash{hash_of(key, size)}
+	, id{intern(key, size, hash)}
+	, name{id != header_id::unknown ? header_name(id) : dstring{key, size}}
+{}
+
+header_key::header_key(header_id key) noexcept
+	: hash{known_headers[static_cast<size_t>(key)].hash}
+	, id{key}
+	, name{header_name(key)}
+{}
+
+bool header_key::operator==(const dstring& other) const noexcept
+{
+	return name.size() == other.size() && std::equal(name.cbegin(), name.cend(), other.cbegin());
+}
+
+bool header_list::matches(const entry& e, const header_key& key) noexcept
+{
+	if(key.id != header_id::unknown)
+		return e.id == key.id;
+	return e.hash == key.hash && key == e.first;
+}
+
+header_list::const_iterator header_list::find(const header_key& key) const noexcept
+{
+	return std::find_if(_entries.cbegin(), _entries.cend(), [&key](const entry& e)
+	{
+		return matches(e, key);
+	});
+}
+
+std::pair<header_list::const_iterator, header_list::const_iterator>
+	header_list::equal_range(const header_key& key) const noexcept
+{
+	// Entries are sorted: equal names are next to each other
+	auto first = find(key);
+	auto last = first;
+	while(last != _entries.cend() && matches(*last, key))
+		++last;
+	return std::make_pair(first, last);
+}
+
+size_t header_list::count(const header_key& key) const noexcept
+{
+	auto range = equal_range(key);
+	return std::distance(range.first, range.second);
+}
+
+void header_list::insert(const header_key& key, const dstring& value)
+{
+	// After the equal ones, as std::multimap does
+	auto pos = std::upper_bound(_entries.begin(), _entries.end(), key, [](const header_key& k, const entry& e)
+	{
+		return std::lexicographical_compare(k.name.cbegin(), k.name.cend(), e.first.cbegin(), e.first.cend());
+	});
+	_entries.emplace(pos, header_t{key.to_dstring(), value}, key.hash, key.id);
+}
+
+size_t header_list::erase(const header_key& key) noexcept
+{
+	auto range = equal_range(key);
+	auto n = std::distance(range.first, range.second);
+	if(n)
+		_entries.erase(range.first, range.second);
+	return n;
+}
+
+void header_list::erase_if(std::function<bool(const header_t&)> predicate)
+{
+	_entries.erase(std::remove_if(_entries.begin(), _entries.end(), predicate), _entries.end());
+}
+
+}
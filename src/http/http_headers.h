@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "../utils/dstring.h"
+#include "../utils/arena.h"
+
+namespace http
+{
+
+/**
+ * Header fields doormat looks for on every request; they are
+ * recognized once, when inserted, and then matched by id.
+ */
+enum class header_id : uint8_t
+{
+	unknown,
+	connection,
+	host,
+	date,
+	cyndate,
+	content_len,
+	accept_encoding,
+	content_encoding,
+	transfer_encoding,
+	allow,
+	via,
+	server,
+	maxforward,
+	cyn_dest,
+	cyn_dest_port,
+	content_type,
+	count
+};
+
+namespace detail
+{
+constexpr size_t length(const char* s) { return *s ? 1 + length(s + 1) : 0; }
+}
+
+/** FNV-1a; constexpr so that ids can be resolved in a switch. */
+constexpr uint32_t header_hash(const char* s, size_t len, uint32_t h = 2166136261u)
+{
+	return len ? header_hash(s + 1, len - 1, (h ^ static_cast<uint8_t>(*s)) * 16777619u) : h;
+}
+
+constexpr uint32_t header_hash(const char* s)
+{
+	return header_hash(s, detail::length(s));
+}
+
+header_id intern(const char* name, size_t len, uint32_t hash) noexcept;
+const dstring& header_name(header_id id) noexcept;
+
+/**
+ * A header name to look for, hashed once per call.
+ * It holds its own reference to the name, so a key taken from an entry
+ * stays valid while the list the entry belongs to changes.
+ */
+struct header_key
+{
+	uint32_t hash;
+	header_id id;
+	/** Known names are shared, never copied */
+	dstring name;
+
+	header_key(const dstring& key) noexcept;
+	header_key(const char* key) noexcept;
+	header_key(header_id key) noexcept;
+
+	bool operator==(const dstring& other) const noexcept;
+
+	dstring to_dstring() const noexcept { return name; }
+
+private:
+	header_key(const char* key, size_t size) noexcept;
+};
+
+/**
+ * Flat storage for the headers of a message.
+ *
+ * Entries are kept sorted by name like a multimap would, so that iteration
+ * and serialization do not change; lookups are linear scans on the hash
+ * precomputed at insertion, cheap for the couple dozens of headers
+ * a message carries and touching contiguous memory only.
+ * Storage comes from the arena current when the list is made, if any.
+ */
+class header_list
+{
+public:
+	using header_t = std::pair<dstring, dstring>;
+
+	struct entry : header_t
+	{
+		uint32_t hash;
+		header_id id;
+
+		entry(header_t&& h, uint32_t hs, header_id i)
+			: header_t{std::move(h)}, hash{hs}, id{i}
+		{}
+	};
+
+	using container = std::vector<entry, utils::arena_allocator<entry>>;
+	using value_type = entry;
+	using iterator = container::iterator;
+	using const_iterator = container::const_iterator;
+
+	header_list() { _entries.reserve(expected_headers); }
+
+	const_iterator begin() const noexcept { return _entries.begin(); }
+	const_iterator end() const noexcept { return _entries.end(); }
+	const_iterator cbegin() const noexcept { return _entries.cbegin(); }
+	const_iterator cend() const noexcept { return _entries.cend(); }
+	size_t size() const noexcept { return _entries.size(); }
+	bool empty() const noexcept { return _entries.empty(); }
+
+	const_iterator find(const header_key& key) const noexcept;
+	std::pair<const_iterator, const_iterator> equal_range(const header_key& key) const noexcept;
+	size_t count(const header_key& key) const noexcept;
+
+	void insert(const header_key& key, const dstring& value);
+	size_t erase(const header_key& key) noexcept;
+	void erase_if(std::function<bool(const header_t&)> predicate);
+
+private:
+	static constexpr size_t expected_headers{8};
+
+	static bool matches(const entry& e, const header_key& key) noexcept;
+
+	container _entries;
+};
+
+}
@@ -1,5 +1,8 @@
 #include "http_request.h"
 #include "http_structured_data.h"
+#include "../utils/dstring_factory.h"
+
+#include <cstring>
 namespace http
 {
 
@@ -13,37 +16,74 @@ namespace http
 
 dstring http_request::serialize() const noexcept
 {
-	dstring msg;
-	msg.append(method()).append(http::space);
+	const char* method = method_mapper[_method];
+	auto method_len = std::strlen(method);
+	auto proto = protocol();
 
+	// Sized first, then written in a single buffer
+	size_t size = method_len + 1;
 	if(_schema)
-		msg.append(_schema).append("://");
+		size += _schema.size() + 3;
 
 	//TODO: DRM-207 userinfo not yet supported
 	//if(_userinfo.valid())
 	//	chunks.push_back(_userinfo);
 
 	if(_urihost)
-		msg.append(_urihost);
-
+		size += _urihost.size();
 	if(_port)
-		msg.append(http::colon).append(_port);
-
+		size += 1 + _port.size();
 	if(_path)
-		msg.append(_path);
-
+		size += _path.size();
 	if(_query)
-		msg.append(http::questionmark).append(_query);
-
+		size += 1 + _query.size();
 	if(_fragment)
-		msg.append(http::hash).append(_fragment);
+		size += 1 + _fragment.size();
+	size += 1 + proto.size() + 2;
+	auto line_size = size;
+	size += serialized_size();
+
+	dstring_factory buffer{size};
+	char* out = buffer.data();
+	auto put = [&out](const char* data, size_t len)
+	{
+		std::memcpy(out, data, len);
+		out += len;
+	};
 
-	msg.append(http::space)
-		.append(protocol())
-		.append(http::crlf)
-		.append(http_structured_data::serialize());
+	put(method, method_len);
+	put(http::space, 1);
+	if(_schema)
+	{
+		put(_schema.cdata(), _schema.size());
+		put("://", 3);
+	}
+	if(_urihost)
+		put(_urihost.cdata(), _urihost.size());
+	if(_port)
+	{
+		put(http::colon, 1);
+		put(_port.cdata(), _port.size());
+	}
+	if(_path)
+		put(_path.cdata(), _path.size());
+	if(_query)
+	{
+		put(http::questionmark, 1);
+		put(_query.cdata(), _query.size());
+	}
+	if(_fragment)
+	{
+		put(http::hash, 1);
+		put(_fragment.cdata(), _fragment.size());
+	}
+	put(http::space, 1);
+	put(proto.cdata(), proto.size());
+	put(http::crlf, 2);
+	assert(out == buffer.data() + line_size);
+	serialize_to(out);
 
-	return msg;
+	return buffer.create_dstring(size);
 }
 
 void http_request::method(const std::string& val) noexcept
@@ -1,4 +1,9 @@
 #include "http_response.h"
+#include "../utils/dstring_factory.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
 
 namespace http
 {
@@ -51,8 +56,56 @@ namespace http
 		return "Damn!"; // Default value: Some Microsoft clients behave badly if the reason string is empty
 	}
 
+	namespace
+	{
+		constexpr uint16_t first_status{100};
+		constexpr uint16_t last_status{599};
+		constexpr size_t statuses{last_status - first_status + 1};
+
+		/**
+		 * The status line, CRLF included, of a code with its default reason,
+		 * for HTTP/1.0 and HTTP/1.1; nullptr for anything else.
+		 */
+		const std::string* status_line(proto_version pv, uint16_t code) noexcept
+		{
+			static const std::vector<std::string> lines = []()
+			{
+				std::vector<std::string> l;
+				l.reserve(2 * statuses);
+				for(auto protocol : {http::http10, http::http11})
+					for(uint16_t c = first_status; c <= last_status; ++c)
+						l.push_back(std::string{protocol} + http::space + std::to_string(c)
+							+ http::space + get_default_message(c) + http::crlf);
+				return l;
+			}();
+
+			if(code < first_status || code > last_status)
+				return nullptr;
+			switch(pv)
+			{
+				case proto_version::HTTP10: return &lines[code - first_status];
+				case proto_version::HTTP11: return &lines[statuses + code - first_status];
+				default: return nullptr;
+			}
+		}
+	}
+
 	dstring http_response::serialize() const noexcept
 	{
+		if(_encoded)
+			return _encoded;
+
+		const std::string* line = status_line(protocol_version(), _status_code);
+		if(line && _status_message == get_default_message(_status_code))
+		{
+			auto size = line->size() + serialized_size();
+			dstring_factory buffer{size};
+			std::memcpy(buffer.data(), line->data(), line->size());
+			serialize_to(buffer.data() + line->size());
+			_encoded = buffer.create_dstring(size);
+			return _encoded;
+		}
+
 		dstring msg;
 		msg.append(protocol())
 			.append(http::space)
@@ -61,19 +114,22 @@ namespace http
 			.append(status_message())
 			.append(http::crlf)
 			.append(http_structured_data::serialize());
-		return msg;
+		_encoded = msg;
+		return _encoded;
 	}
 
 	void http_response::status(uint16_t code) noexcept
 	{
 		_status_code = code;
 		_status_message = get_default_message(code);
+		changed();
 	}
 
 	void http_response::status(uint16_t code, const dstring& msg) noexcept
 	{
 		_status_code = code;
 		_status_message = msg;
+		changed();
 	}
 
 	bool http_response::operator==(const http_response&res)
@@ -1,6 +1,8 @@
 #include "http_structured_data.h"
 #include "http_commons.h"
+#include "../utils/dstring_factory.h"
 
+#include <cstring>
 #include <string>
 #include <ctime>
 
@@ -13,8 +15,8 @@ http_structured_data::http_structured_data(std::type_index type)
 	: _type{type}
 {
 	//x-cyn-date set to default.
-	header(http::hf_content_len, "0");
-	header(http::hf_connection, http::hv_connection_close);
+	header(header_id::content_len, "0");
+	header(header_id::connection, http::hv_connection_close);
 }
 
 bool http_structured_data::operator== ( const http::http_structured_data& other ) const
@@ -35,28 +37,33 @@ bool http_structured_data::has_same_headers ( const http::http_structured_data&
 	return rv;
 }
 
-void http_structured_data::header( const dstring& key, const dstring& value ) noexcept
+void http_structured_data::header( const header_key& key, const dstring& value ) noexcept
 {
-	if( key == http::hf_connection )
+	switch( key.id )
 	{
-		remove_header(key);
-	}
-	else if( key == http::hf_content_len )
-	{
-		value.to_integer(_content_len);
-		remove_header(key);
-	}
-	else if( key == http::hf_transfer_encoding && utils::icompare(value,"chunked"))
-	{
-		_chunked = true;
-		remove_header(http::hf_transfer_encoding);
-		remove_header(http::hf_content_len);
+		case header_id::connection:
+			remove_header(key);
+			break;
+		case header_id::content_len:
+			value.to_integer(_content_len);
+			remove_header(key);
+			break;
+		case header_id::transfer_encoding:
+			if( utils::icompare(value,"chunked") )
+			{
+				_chunked = true;
+				remove_header(header_id::transfer_encoding);
+				remove_header(header_id::content_len);
+			}
+			break;
+		default: break;
 	}
 
-	_headers.insert( std::make_pair( key, value ) );
+	_headers.insert( key, value );
+	changed();
 }
 
-const dstring& http_structured_data::header( const dstring& key ) const noexcept
+const dstring& http_structured_data::header( const header_key& key ) const noexcept
 {
 	auto&& element = _headers.find( key );
 	if ( element != _headers.end() )
@@ -64,7 +71,7 @@ const dstring& http_structured_data::header( const dstring& key ) const noexcept
 	return empty;
 }
 
-std::list<dstring> http_structured_data::headers( const dstring& key ) const noexcept
+std::list<dstring> http_structured_data::headers( const header_key& key ) const noexcept
 {
 	auto&& span = _headers.equal_range(key);
 	std::list<dstring> hl;
@@ -72,22 +79,23 @@ std::list<dstring> http_structured_data::headers( const dstring& key ) const noe
 	return hl;
 }
 
-void http_structured_data::remove_header(const dstring& key) noexcept
+void http_structured_data::remove_header(const header_key& key) noexcept
 {
 	_headers.erase( key );
+	changed();
 }
 
-bool http_structured_data::has( const dstring& key ) const noexcept
+bool http_structured_data::has( const header_key& key ) const noexcept
 {
 	return header( key ).size();
 }
 
-bool http_structured_data::has(const dstring& key, const dstring& val ) const noexcept
+bool http_structured_data::has(const header_key& key, const dstring& val ) const noexcept
 {
 	return has( key, [&val](const dstring& v){ return v == val;} );
 }
 
-bool http_structured_data::has(const dstring& key, std::function<bool(const dstring&)> pred ) const noexcept
+bool http_structured_data::has(const header_key& key, std::function<bool(const dstring&)> pred ) const noexcept
 {
 	auto&& hl = _headers.equal_range( key );
 	auto&& it = std::find_if( hl.first, hl.second, [&pred](const header_t& h){ return pred(h.second);});
@@ -101,14 +109,8 @@ bool http_structured_data::has( std::function<bool ( const header_t& ) > predica
 
 void http_structured_data::filter( std::function<bool ( const header_t& ) >  predicate )
 {
-	auto&& it = _headers.begin();
-	while ( it != _headers.end() )
-	{
-		if ( predicate ( *it ) )
-			it = _headers.erase ( it );
-		else
-			++it;
-	}
+	_headers.erase_if( predicate );
+	changed();
 }
 
 void http_structured_data::add_destination_header( const dstring& key )
@@ -129,23 +131,30 @@ void http_structured_data::chunked(bool val) noexcept
 	if( val != _chunked )
 	{
 		if( val )
-			header(http::hf_transfer_encoding, hv_chunked);
+			header(header_id::transfer_encoding, hv_chunked);
 		else
-			remove_header(http::hf_transfer_encoding);
+		{
+			_chunked = false;
+			remove_header(header_id::transfer_encoding);
+		}
 	}
 }
 
 void http_structured_data::keepalive(bool val) noexcept
 {
-	_keepalive = val;
+	const auto value = val ? http::hv_keepalive : http::hv_connection_close;
 	_default_keepalive = false;
-	header(http::hf_connection, val ? http::hv_keepalive : http::hv_connection_close);
+	// Nothing changes: an already encoded message is still good
+	if( _keepalive == val && has( header_id::connection, value ) )
+		return;
+	_keepalive = val;
+	header(header_id::connection, value);
 }
 
 void http_structured_data::content_len(const size_t& val) noexcept
 {
 	assert(!_chunked || val == 0);
-	header( http::hf_content_len, dstring::to_string(val) );
+	header( header_id::content_len, dstring::to_string(val) );
 }
 
 void http_structured_data::protocol ( const proto_version& val ) noexcept
@@ -153,16 +162,17 @@ void http_structured_data::protocol ( const proto_version& val ) noexcept
 	if ( _protocol != val )
 	{
 		_protocol = val;
+		changed();
 		if ( _default_keepalive )
 		{
-			remove_header( http::hf_connection );
+			remove_header( header_id::connection );
 			switch ( val )
 			{
 				case proto_version::HTTP11:
 					_keepalive = true;
 				break;
 				case proto_version::HTTP10:
-					header(http::hf_connection, http::hv_connection_close);
+					header(header_id::connection, http::hv_connection_close);
 					_keepalive = false;
 				break;
 				default:
@@ -193,38 +203,72 @@ dstring http_structured_data::protocol() const noexcept
 	return proto_to_string( _protocol );
 }
 
-dstring http_structured_data::serialize() const noexcept
+size_t http_structured_data::serialized_size() const noexcept
+{
+	size_t size{0};
+	const dstring* last_key = nullptr;
+	for(const auto& h : _headers)
+	{
+		if(last_key && h.first == *last_key)
+			size += 2; // comma_space or semicolon_space
+		else
+		{
+			if(last_key)
+				size += 2; // crlf
+			last_key = &(h.first);
+			size += h.first.size() + 2;
+		}
+		if(h.second)
+			size += h.second.size();
+	}
+	if(last_key && !last_key->empty())
+		size += 2;
+	return size + 2;
+}
+
+char* http_structured_data::serialize_to(char* out) const noexcept
 {
-	dstring msg;
+	auto put = [&out](const char* data, size_t len)
+	{
+		std::memcpy(out, data, len);
+		out += len;
+	};
+
 	const dstring* last_key = nullptr;
-	bool not_first{false};
 	for(const auto& h : _headers)
 	{
-		if(not_first && h.first == *last_key)
+		if(last_key && h.first == *last_key)
 		{
 			if(h.first == "cookie")
-				msg.append(http::semicolon_space);
+				put(http::semicolon_space, 2);
 			else
-				msg.append(http::comma_space);
+				put(http::comma_space, 2);
 		} else
 		{
-			if(not_first)
-				msg.append(http::crlf);
+			if(last_key)
+				put(http::crlf, 2);
 			last_key = &(h.first);
-			msg.append(h.first);
-			msg.append(http::colon_space);
+			put(h.first.cdata(), h.first.size());
+			put(http::colon_space, 2);
 		}
 
 		//FIXME: exclude invalid chunks from being serialized
 		if(h.second)
-			msg.append(h.second);
-		not_first=true;
+			put(h.second.cdata(), h.second.size());
 	}
 	assert(last_key);
-	if(!last_key->empty())
-		msg.append(http::crlf);
-	msg.append(http::crlf);
-	return msg;
+	if(last_key && !last_key->empty())
+		put(http::crlf, 2);
+	put(http::crlf, 2);
+	return out;
+}
+
+dstring http_structured_data::serialize() const noexcept
+{
+	auto size = serialized_size();
+	dstring_factory buffer{size};
+	serialize_to(buffer.data());
+	return buffer.create_dstring(size);
 }
 
 }
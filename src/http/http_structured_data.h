@@ -7,6 +7,7 @@
 #include <typeindex>
 
 #include "http_commons.h"
+#include "http_headers.h"
 
 #include "../utils/doormat_types.h"
 #include "../utils/utils.h"
@@ -23,7 +24,7 @@ namespace http
 class http_structured_data
 {
 public:
-	using headers_map = std::multimap<dstring, dstring>;
+	using headers_map = header_list;
 private:
 	std::type_index _type;
 
@@ -51,8 +52,16 @@ protected:
 
 	bool has_same_headers ( const http_structured_data& other ) const;
 
+	// The whole message as last encoded, dropped as soon as it changes
+	mutable dstring _encoded;
+	void changed() noexcept { if ( _encoded ) _encoded = dstring{}; }
+
+	size_t serialized_size() const noexcept;
+	/** Writes the serialized headers, exactly serialized_size() bytes; returns their end. */
+	char* serialize_to( char* out ) const noexcept;
+
 public:
-	using header_t = typename headers_map::value_type;
+	using header_t = headers_map::header_t;
 
 	std::type_index type() const { return _type; }
 
@@ -62,12 +71,12 @@ public:
 	// Better make it protected and not virtual
 	virtual ~http_structured_data() noexcept = default;
 
-	void header( const dstring& key, const dstring& value ) noexcept;
-	void remove_header( const dstring& key ) noexcept;
+	void header( const header_key& key, const dstring& value ) noexcept;
+	void remove_header( const header_key& key ) noexcept;
 
 	// I feel lucky, I'd take only the first hit
-	const dstring& header( const dstring& key ) const noexcept;
-	std::list<dstring> headers( const dstring& key ) const noexcept;
+	const dstring& header( const header_key& key ) const noexcept;
+	std::list<dstring> headers( const header_key& key ) const noexcept;
 
 	// HTTP2ng needs this
 	const headers_map& headers() const noexcept { return _headers; }
@@ -76,10 +85,10 @@ public:
 	void add_destination_header( const dstring& key );
 	void set_destination_header( const routing::abstract_destination_provider::address& );
 
-	bool has( const dstring& ) const noexcept;
+	bool has( const header_key& ) const noexcept;
 	bool has( std::function<bool ( const header_t& ) > ) const noexcept;
-	bool has( const dstring& , const dstring& ) const noexcept;
-	bool has( const dstring& , std::function<bool(const dstring&)> ) const noexcept;
+	bool has( const header_key& , const dstring& ) const noexcept;
+	bool has( const header_key& , std::function<bool(const dstring&)> ) const noexcept;
 	void filter ( std::function< bool ( const header_t& ) > );
 
 	bool chunked() const noexcept { return _chunked; }
@@ -89,16 +98,16 @@ public:
 	proto_version channel() const noexcept { return _channel; }
 	boost::asio::ip::address origin() const noexcept { return _origin; }
 	dstring protocol() const noexcept;
-	const dstring& date() const noexcept { return header( http::hf_date ); }
-	const dstring& hostname() const noexcept { return header( http::hf_host ); }
+	const dstring& date() const noexcept { return header( header_id::date ); }
+	const dstring& hostname() const noexcept { return header( header_id::host ); }
 
 	void chunked ( bool val ) noexcept;
 	void keepalive ( bool val ) noexcept;
 	void content_len ( const size_t& val ) noexcept;
 	void protocol ( const proto_version& val ) noexcept;
 	void channel ( const proto_version& val ) noexcept { _channel = val; }
-	void hostname ( const dstring& val ) noexcept { header(http::hf_host, val );}
-	void date ( const dstring& val ) noexcept { remove_header(http::hf_date); header ( http::hf_date, val ); }
+	void hostname ( const dstring& val ) noexcept { header(header_id::host, val );}
+	void date ( const dstring& val ) noexcept { remove_header(header_id::date); header ( header_id::date, val ); }
 	void origin ( const boost::asio::ip::address& a ) { _origin = a; }
 
 	dstring serialize() const noexcept;
@@ -1,51 +1,219 @@
 #include "http2alloc.h"
 
 #include <cstdlib>
-
-// #include "../utils/logWrapper.h"
+#include <cstring>
 
 namespace http2
 {
 
-void* malloc_cb(size_t size, void *mem_user_data) 
+constexpr std::size_t mem_pool::chunk_size;
+constexpr std::size_t mem_pool::min_pooled;
+constexpr std::size_t mem_pool::max_pooled;
+constexpr std::size_t mem_pool::classes;
+
+namespace
+{
+
+constexpr std::size_t alignment{alignof(std::max_align_t)};
+
+constexpr std::size_t aligned(std::size_t size)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Index of the smallest class holding size; min_pooled is 2^4
+std::size_t size_class(std::size_t size) noexcept
+{
+	if(size <= mem_pool::min_pooled)
+		return 0;
+	return sizeof(unsigned long) * 8 - __builtin_clzl(size - 1) - 4;
+}
+
+}
+
+struct mem_pool::chunk
+{
+	chunk* next;
+};
+
+/** Precedes big blocks, before their header: it keeps them in a list. */
+struct mem_pool::large
+{
+	large* prev;
+	large* next;
+};
+
+/** Precedes every block; the payload of a free one links it to the next. */
+struct mem_pool::block
+{
+	std::size_t capacity;
+
+	void* payload() noexcept { return reinterpret_cast<char*>(this) + header; }
+	block*& next() noexcept { return *static_cast<block**>(payload()); }
+	bool pooled() const noexcept { return capacity <= max_pooled; }
+
+	static block* of(void* p) noexcept
+	{
+		return reinterpret_cast<block*>(static_cast<char*>(p) - header);
+	}
+
+	static constexpr std::size_t header{aligned(sizeof(std::size_t))};
+};
+
+constexpr std::size_t mem_pool::block::header;
+
+namespace
+{
+
+constexpr std::size_t chunk_header{aligned(sizeof(void*))};
+constexpr std::size_t large_header{aligned(2 * sizeof(void*))};
+
+}
+
+mem_pool::~mem_pool()
+{
+	while(chunks)
+	{
+		auto next = chunks->next;
+		::free(chunks);
+		chunks = next;
+	}
+	while(larges)
+	{
+		auto next = larges->next;
+		::free(larges);
+		larges = next;
+	}
+}
+
+void* mem_pool::carve(std::size_t cls) noexcept
+{
+	const std::size_t size = block::header + (min_pooled << cls);
+	if(static_cast<std::size_t>(end - cur) < size)
+	{
+		auto c = static_cast<chunk*>(::malloc(chunk_header + chunk_size));
+		if(!c)
+			return nullptr;
+		c->next = chunks;
+		chunks = c;
+		_reserved += chunk_header + chunk_size;
+		cur = reinterpret_cast<char*>(c) + chunk_header;
+		end = cur + chunk_size;
+	}
+	auto b = reinterpret_cast<block*>(cur);
+	cur += size;
+	b->capacity = min_pooled << cls;
+	return b->payload();
+}
+
+void* mem_pool::allocate(std::size_t size) noexcept
+{
+	if(size <= max_pooled)
+	{
+		auto cls = size_class(size);
+		if(auto b = free_lists[cls])
+		{
+			free_lists[cls] = b->next();
+			return b->payload();
+		}
+		return carve(cls);
+	}
+
+	size = aligned(size);
+	auto l = static_cast<large*>(::malloc(large_header + block::header + size));
+	if(!l)
+		return nullptr;
+	l->prev = nullptr;
+	l->next = larges;
+	if(larges)
+		larges->prev = l;
+	larges = l;
+	_reserved += large_header + block::header + size;
+
+	auto b = reinterpret_cast<block*>(reinterpret_cast<char*>(l) + large_header);
+	b->capacity = size;
+	return b->payload();
+}
+
+void mem_pool::deallocate(void* p) noexcept
+{
+	if(!p || releasing)
+		return;
+
+	auto b = block::of(p);
+	if(b->pooled())
+	{
+		auto cls = size_class(b->capacity);
+		b->next() = free_lists[cls];
+		free_lists[cls] = b;
+		return;
+	}
+
+	auto l = reinterpret_cast<large*>(reinterpret_cast<char*>(b) - large_header);
+	if(l->prev)
+		l->prev->next = l->next;
+	else
+		larges = l->next;
+	if(l->next)
+		l->next->prev = l->prev;
+	_reserved -= large_header + block::header + b->capacity;
+	::free(l);
+}
+
+void* mem_pool::reallocate(void* p, std::size_t size) noexcept
 {
-	http2_allocator<std::uint8_t>* ha = static_cast<http2_allocator<std::uint8_t>*>( mem_user_data );
-	void* r = ha->allocate( size );
-// 	logTrace ( "Malloc ", r, " align ", ((long) r)%8 );
-	return r;
+	if(!p)
+		return allocate(size);
+	if(!size)
+	{
+		deallocate(p);
+		return nullptr;
+	}
+
+	auto capacity = block::of(p)->capacity;
+	if(size <= capacity)
+		return p;
+
+	auto moved = allocate(size);
+	if(!moved)
+		return nullptr;
+	std::memcpy(moved, p, capacity);
+	deallocate(p);
+	return moved;
 }
 
-void free_cb(void *ptr, void *mem_user_data) 
+namespace
 {
-// 	logTrace ( "Free ", ptr, " align ", ((long) ptr)%8  );
-	http2_allocator<std::uint8_t>* ha = static_cast<http2_allocator<std::uint8_t>*>( mem_user_data );
-	ha->deallocate( static_cast<http2_allocator<std::uint8_t>::pointer>( ptr ), 0 );
+
+void* malloc_cb(size_t size, void *mem_user_data)
+{
+	return static_cast<mem_pool*>(mem_user_data)->allocate(size);
+}
+
+void free_cb(void *ptr, void *mem_user_data)
+{
+	static_cast<mem_pool*>(mem_user_data)->deallocate(ptr);
 }
 
-void* calloc_cb(size_t nmemb, size_t size, void *mem_user_data) 
+void* calloc_cb(size_t nmemb, size_t size, void *mem_user_data)
 {
-// 	logTrace("Calloc: ", nmemb, " ", size );
 	size_t real_size = size * nmemb;
-	void* allocated = malloc_cb( real_size, mem_user_data );
-	std::memset( allocated, 0, real_size );
-// 	logTrace("Calloc: ", allocated );
+	void* allocated = malloc_cb(real_size, mem_user_data);
+	if(allocated)
+		std::memset(allocated, 0, real_size);
 	return allocated;
 }
 
-void* realloc_cb(void *ptr, size_t size, void *mem_user_data) 
+void* realloc_cb(void *ptr, size_t size, void *mem_user_data)
 {
-// 	logTrace("Realloc ", ptr, " size ", size );
-	http2_allocator<std::uint8_t>* ha = static_cast<http2_allocator<std::uint8_t>*>( mem_user_data );
-	void* r = ha->realloc( static_cast<http2_allocator<std::uint8_t>::pointer>( ptr ), size );
-// 	logTrace( "Realloc ", r );
-	return r;
+	return static_cast<mem_pool*>(mem_user_data)->reallocate(ptr, size);
 }
 
-static http2_allocator<std::uint8_t> global_allocator;
+}
 
-nghttp2_mem create_allocator()
+nghttp2_mem create_allocator(mem_pool& pool) noexcept
 {
-	return nghttp2_mem{ &global_allocator, malloc_cb, free_cb, calloc_cb, realloc_cb };
+	return nghttp2_mem{&pool, malloc_cb, free_cb, calloc_cb, realloc_cb};
 }
 
 }
@@ -1,8 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include <new>
-#include <cstring>
 #include <cstddef>
 
 #include <nghttp2/nghttp2.h>
@@ -10,55 +8,60 @@
 namespace http2
 {
 
-nghttp2_mem create_allocator();
-
-// This is a skeleton of allocator to be used with nghttp2_mem
-// For the future: constructor copy *must* not throw
-template<class T>
-class http2_allocator
+/**
+ * @brief The mem_pool class serves the allocations of one nghttp2 session:
+ * frames, HPACK entries and stream state.
+ *
+ * Requests are rounded up to power of two size classes, up to max_pooled bytes,
+ * and carved from chunks; freed blocks are kept in a list per class and reused.
+ * Bigger requests go to the heap. A session lives in a single thread, so
+ * nothing is locked.
+ *
+ * Everything is given back to the heap at once when the pool is destroyed;
+ * after release_on_destruction deallocations are not even tracked.
+ */
+class mem_pool
 {
+	struct chunk;
+	struct large;
+	struct block;
+
 public:
-	using size_type = std::size_t;
-	using difference_type = std::ptrdiff_t;
-	using pointer = T*;
-	using const_pointer = const T*;
-	using reference = T&;
-	using const_reference = const T&;
-	using value_type = T;
-	
-	template<typename U>
-	struct rebind { using other = http2_allocator<U>; };
+	static constexpr std::size_t chunk_size{32768};
+	static constexpr std::size_t min_pooled{16};
+	static constexpr std::size_t max_pooled{4096};
+
+	mem_pool() noexcept = default;
+	mem_pool(const mem_pool&) = delete;
+	mem_pool& operator=(const mem_pool&) = delete;
+	~mem_pool();
+
+	void* allocate(std::size_t size) noexcept;
+	void deallocate(void* p) noexcept;
+	/** Behaves as realloc; blocks that are big enough are not moved. */
+	void* reallocate(void* p, std::size_t size) noexcept;
+
+	/** The owner is about to go: memory is reclaimed all at once by the destructor. */
+	void release_on_destruction() noexcept { releasing = true; }
 
-	pointer allocate( std::size_t n, const void * hint = nullptr )
-	{
-		//return static_cast<T*>(::operator new(n * sizeof(T), std::nothrow ));
-		return static_cast<pointer>( ::malloc( n ) );
-	}
-	
-	void deallocate(pointer p, size_type n)
-	{
-		//::operator delete(p);
-		::free( p );
-	}
-	
-	pointer realloc( pointer p, size_type size )
-	{
-		return static_cast<pointer>( ::realloc( p, size ) );
-	}
-	
-// 	template<typename U, typename ... Args>
-// 	void construct(U* p, Args&&... args)
-// 	{
-// 		new (p) U ( std::forward<Args>( args)... );
-// 	};
-// 
-// 	template<typename U>
-// 	void destroy(U* p)
-// 	{
-// 		p->~U();
-// 	}
+	/** Bytes taken from the heap and not given back yet. */
+	std::size_t reserved() const noexcept { return _reserved; }
 
-	constexpr bool operator==( const http2_allocator& ) const noexcept { return true; }
-	constexpr bool operator!=( const http2_allocator& o ) const noexcept { return ! ( o == *this ); }
+private:
+	static constexpr std::size_t classes{9};
+
+	void* carve(std::size_t cls) noexcept;
+
+	block* free_lists[classes]{};
+	chunk* chunks{nullptr};
+	large* larges{nullptr};
+	char* cur{nullptr};
+	char* end{nullptr};
+	std::size_t _reserved{0};
+	bool releasing{false};
 };
+
+/** @return the nghttp2 hooks over a pool, which must outlive the session using them. */
+nghttp2_mem create_allocator(mem_pool& pool) noexcept;
+
 }
@@ -0,0 +1,33 @@
+#include "priority.h"
+
+namespace http2
+{
+
+namespace
+{
+
+bool blank( std::uint8_t c ) noexcept { return c == ' ' || c == '\t'; }
+
+}
+
+std::int32_t urgency_weight( const std::uint8_t* value, std::size_t len ) noexcept
+{
+	static constexpr const std::int32_t weights[8] = { 256, 128, 64, 16, 8, 4, 2, 1 };
+
+	std::size_t i = 0;
+	while ( i < len )
+	{
+		while ( i < len && blank( value[i] ) ) ++i;
+		std::size_t end = i;
+		while ( end < len && value[end] != ',' ) ++end;
+
+		// A member is u=N, optionally with parameters
+		if ( end - i >= 3 && value[i] == 'u' && value[i + 1] == '=' && value[i + 2] >= '0' && value[i + 2] <= '7'
+			&& ( end - i == 3 || value[i + 3] == ';' || blank( value[i + 3] ) ) )
+			return weights[ value[i + 2] - '0' ];
+		i = end + 1;
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace http2
+{
+
+/**
+ * Weight for the urgency of the extensible priority scheme, RFC 9218:
+ * u=0 is the most urgent, u=3 the default, the same as RFC 7540's default weight.
+ * @param value the value of a priority header, e.g. "u=1, i".
+ * @return 0 if no urgency is given.
+ */
+std::int32_t urgency_weight( const std::uint8_t* value, std::size_t len ) noexcept;
+
+}
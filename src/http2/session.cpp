@@ -1,18 +1,26 @@
+#include <algorithm>
 #include <cstring>
 
 #include "session.h"
 #include "stream.h"
 #include "http2error.h"
+#include "priority.h"
 #include "../utils/log_wrapper.h"
 #include "http2alloc.h"
+#include "../utils/dstring_factory.h"
+#include "../utils/arena.h"
+#include "../utils/base64.h"
+#include "../service_locator/service_locator.h"
+#include "../io_service_pool.h"
 
 const std::size_t header_size_bytes = 8 * 1024;
 
 namespace
 {
 
-// @todo Sooner or later it must be moved to configuration
-static constexpr const std::int32_t max_concurrent_streams = 100;
+// What a write takes from the library at most: the rest stays queued in nghttp2,
+// where a stream of higher priority asked for meanwhile can still overtake it
+static constexpr const std::size_t write_budget = 64 * 1024;
 
 }
 
@@ -33,13 +41,14 @@ void session::on_error(const int& er)
 	finished_stream();
 }
 
-session::session(): session_data( nullptr, [] ( nghttp2_session* s ) { if ( s ) nghttp2_session_del ( s ); } )
+session::session(): all( create_allocator( pool ) ),
+	session_data( nullptr, [] ( nghttp2_session* s ) { if ( s ) nghttp2_session_del ( s ); } ),
+	settings( service::locator::configuration().get_http2_settings() ),
+	tuner( settings.initial_window_size, settings.max_window_size )
 {
 	LOGTRACE("Session: ", this );
 	nghttp2_option_new( &options );
-	nghttp2_option_set_peer_max_concurrent_streams( options, max_concurrent_streams );
-
-	all = create_allocator();
+	nghttp2_option_set_peer_max_concurrent_streams( options, settings.max_concurrent_streams );
 
 	nghttp2_session_callbacks *callbacks;
 	nghttp2_session_callbacks_new(&callbacks);
@@ -55,6 +64,7 @@ session::session(): session_data( nullptr, [] ( nghttp2_session* s ) { if ( s )
 	nghttp2_session_callbacks_set_on_data_chunk_recv_callback( callbacks,
 		on_data_chunk_recv_callback );
 
+	nghttp2_session_callbacks_set_send_data_callback( callbacks, send_data_callback );
 	nghttp2_session_callbacks_set_on_frame_send_callback( callbacks, frame_send_callback );
 	nghttp2_session_callbacks_set_on_frame_not_send_callback( callbacks, frame_not_send_callback );
 
@@ -66,6 +76,15 @@ session::session(): session_data( nullptr, [] ( nghttp2_session* s ) { if ( s )
 	session_data.reset( ngsession );
 }
 
+session::~session()
+{
+	*alive = false;
+	// No need to free block by block what the pool releases in bulk
+	pool.release_on_destruction();
+	session_data.reset();
+	nghttp2_option_del( options );
+}
+
 bool session::start() noexcept
 {
 	LOGTRACE("start");
@@ -77,20 +96,76 @@ bool session::start() noexcept
 	return true;
 }
 
+bool session::upgrade( http::http_request&& request )
+{
+	LOGTRACE("upgrade");
+	// HTTP2-Settings is the payload of a SETTINGS frame, base64url encoded
+	const dstring& encoded = request.header( "http2-settings" );
+	std::string settings_b64{ encoded.cdata(), encoded.size() };
+	std::replace( settings_b64.begin(), settings_b64.end(), '-', '+' );
+	std::replace( settings_b64.begin(), settings_b64.end(), '_', '/' );
+	dstring payload = utils::base64_decode( settings_b64 );
+
+	int rv = nghttp2_session_upgrade2( session_data.get(), reinterpret_cast<const uint8_t*>( payload.cdata() ),
+		payload.size(), request.method_code() == HTTP_HEAD, nullptr );
+	if ( rv != 0 )
+	{
+		LOGERROR( "nghttp2_session_upgrade2 ", nghttp2_strerror( rv ) );
+		return false;
+	}
+
+	static const char response[] = "HTTP/1.1 101 Switching Protocols\r\nconnection: Upgrade\r\nupgrade: h2c\r\n\r\n";
+	switching_protocols = dstring{ response, sizeof(response) - 1 };
+	send_connection_header();
+
+	// Hop by hop, they were for this connection only
+	request.remove_header( "upgrade" );
+	request.remove_header( "http2-settings" );
+	request.remove_header( http::hf_connection );
+	create_stream( 1 )->on_request_upgraded( std::move( request ) );
+	return true;
+}
+
 void session::send_connection_header()
 {
 	LOGTRACE("send_connection_header");
-	constexpr const int ivlen = 1;
-	nghttp2_settings_entry iv[ivlen] = { {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, max_concurrent_streams} };
+	nghttp2_settings_entry iv[] = {
+		{NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, settings.max_concurrent_streams},
+		{NGHTTP2_SETTINGS_HEADER_TABLE_SIZE, settings.header_table_size},
+		{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, settings.initial_window_size},
+		{NGHTTP2_SETTINGS_MAX_FRAME_SIZE, settings.max_frame_size},
+		{NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, settings.max_header_list_size} };
+	std::size_t ivlen = sizeof(iv) / sizeof(nghttp2_settings_entry);
+	if ( ! settings.max_header_list_size ) --ivlen;
 
 	int r = nghttp2_submit_settings( session_data.get(), NGHTTP2_FLAG_NONE, iv, ivlen );
 
 	// If this happens is a bug - die with fireworks
 	if ( r ) THROW( errors::setting_connection_failure, r );
 
+	// The connection window is not covered by SETTINGS
+	if ( settings.initial_window_size > NGHTTP2_INITIAL_WINDOW_SIZE )
+		grow_connection_window( settings.initial_window_size );
+
 	do_write();
 }
 
+void session::grow_connection_window( std::int32_t size )
+{
+	int r = nghttp2_session_set_local_window_size( session_data.get(), NGHTTP2_FLAG_NONE, 0, size );
+	if ( r ) LOGERROR( "nghttp2_session_set_local_window_size ", nghttp2_strerror( r ) );
+}
+
+void session::grow_windows( std::int32_t size )
+{
+	LOGDEBUG( "Session: ", this, " receive windows grown to ", size, " bytes, rtt ",
+		std::chrono::duration_cast<std::chrono::microseconds>( tuner.rtt() ).count(), "us" );
+	grow_connection_window( size );
+	nghttp2_settings_entry iv{ NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, static_cast<std::uint32_t>( size ) };
+	int r = nghttp2_submit_settings( session_data.get(), NGHTTP2_FLAG_NONE, &iv, 1 );
+	if ( r ) LOGERROR( "nghttp2_submit_settings ", nghttp2_strerror( r ) );
+}
+
 stream* session::create_stream ( std::int32_t id )
 {
 	stream* stream_data = static_cast<stream*>( all.malloc( sizeof(stream), all.mem_user_data ) );
@@ -153,6 +228,7 @@ int session::on_header_callback( nghttp2_session *session_,
 	static const char METHOD[] = ":method";
 	static const char AUTHORITY[] = ":authority";
 	static const char SCHEME[] = ":scheme";
+	static const char PRIORITY[] = "priority";
 	switch (frame->hd.type)
 	{
 		case NGHTTP2_HEADERS:
@@ -202,6 +278,13 @@ int session::on_header_callback( nghttp2_session *session_,
 			}
 			else // Normal headers
 			{
+				if ( namelen == sizeof(PRIORITY) - 1 && memcmp(PRIORITY, name, namelen ) == 0 )
+				{
+					std::int32_t weight = urgency_weight( value, valuelen );
+					if ( weight )
+						stream_data->weight( weight );
+				}
+
 				dstring key{ reinterpret_cast<const char*>( name ), namelen};
 				dstring val{ reinterpret_cast<const char*> ( value ), valuelen};
 				stream_data->add_header( key, val );
@@ -218,7 +301,17 @@ void session::do_write()
 {
 	LOGTRACE("do_write");
 	if(connector())
-		connector()->do_write();
+	{
+		if ( flush_scheduled )
+			return;
+		flush_scheduled = true;
+		std::shared_ptr<bool> token = alive;
+		service::locator::service_pool().get_thread_io_service().post( [this, token]()
+		{
+			if ( *token )
+				flush();
+		});
+	}
 	else
 	{
 		LOGERROR("session http2 ", this, " connector already destroyed");
@@ -226,6 +319,14 @@ void session::do_write()
 	}
 }
 
+void session::flush()
+{
+	LOGTRACE("flush");
+	flush_scheduled = false;
+	if ( connector() )
+		connector()->do_write();
+}
+
 void session::on_connector_nulled()
 {
 	LOGTRACE("on_connector_nulled");
@@ -253,6 +354,14 @@ int session::on_frame_recv_callback(nghttp2_session *session_, const nghttp2_fra
 	LOGTRACE( "on_frame_recv_callback Stream id: ", frame->hd.stream_id , " type ", frame->hd.type );
 
 	int32_t stream_id = frame->hd.stream_id;
+	// Only our PINGs are acknowledged by the peer: they time the round trip
+	if ( frame->hd.type == NGHTTP2_PING && ( frame->hd.flags & NGHTTP2_FLAG_ACK ) )
+	{
+		std::int32_t grown = s_this->tuner.on_ping_ack( window_tuner::clock::now() );
+		if ( grown )
+			s_this->grow_windows( grown );
+	}
+
 	void* stream_data_v = nghttp2_session_get_stream_user_data( s_this->session_data.get(), stream_id );
 	stream* stream_data = static_cast<stream*>( stream_data_v );
 
@@ -261,10 +370,15 @@ int session::on_frame_recv_callback(nghttp2_session *session_, const nghttp2_fra
 		if ( frame->hd.type == NGHTTP2_HEADERS )
 		{
 			if ( frame->headers.cat == NGHTTP2_HCAT_REQUEST )
+			{
+				s_this->prioritize( stream_data, frame );
 				stream_data->on_request_header_complete();
+			}
 			else
 				LOGERROR("Strangeness in HTTP2 Headers");
 		}
+		else if ( frame->hd.type == NGHTTP2_PRIORITY )
+			stream_data->weight( frame->priority.pri_spec.weight );
 
 		// bitwise operator is not an error
 		if ( frame->hd.flags & NGHTTP2_FLAG_END_STREAM )
@@ -276,6 +390,26 @@ int session::on_frame_recv_callback(nghttp2_session *session_, const nghttp2_fra
 	return 0;
 }
 
+void session::prioritize( stream* stream_data, const nghttp2_frame* frame )
+{
+	// The dependency tree sent by the client rules; the library already applied it
+	if ( frame->hd.flags & NGHTTP2_FLAG_PRIORITY )
+	{
+		stream_data->weight( frame->headers.pri_spec.weight );
+		return;
+	}
+
+	// Otherwise the urgency of the priority header, if any, becomes the weight
+	if ( stream_data->weight() == NGHTTP2_DEFAULT_WEIGHT )
+		return;
+
+	nghttp2_priority_spec spec;
+	nghttp2_priority_spec_init( &spec, 0, stream_data->weight(), 0 );
+	int rv = nghttp2_session_change_stream_priority( session_data.get(), frame->hd.stream_id, &spec );
+	if ( rv != 0 )
+		LOGERROR( "nghttp2_session_change_stream_priority ", nghttp2_strerror( rv ) );
+}
+
 int session::on_stream_close_callback( nghttp2_session* session_, int32_t stream_id, uint32_t error_code, void *user_data )
 {
 	LOGTRACE( "Stream close callback ", stream_id );
@@ -306,6 +440,15 @@ int session::on_data_chunk_recv_callback(nghttp2_session *session_, uint8_t flag
 	dstring body{ data, len }; /// @warning : we don't have ownership of this stuff - this should come out of input
 	req->on_request_body( std::move(body) );
 
+	if ( s_this->tuner.on_data( len ) )
+	{
+		int rc = nghttp2_submit_ping( session_, NGHTTP2_FLAG_NONE, nullptr );
+		if ( rc == 0 )
+			s_this->tuner.on_ping_sent( window_tuner::clock::now() );
+		else
+			LOGERROR( "nghttp2_submit_ping ", nghttp2_strerror( rc ) );
+	}
+
 	/// @note return  NGHTTP2_ERR_PAUSE ; to pause input
 
 	if ( nghttp2_session_want_write( s_this->session_data.get() ) )
@@ -356,23 +499,86 @@ int session::frame_not_send_callback ( nghttp2_session *session_, const nghttp2_
 	return 0;
 }
 
-bool session::on_write( dstring& ch )
+int session::send_data_callback( nghttp2_session *session_, nghttp2_frame *frame, const uint8_t *framehd,
+	size_t length, nghttp2_data_source *source, void *user_data )
 {
-	if ( connector() == nullptr ) return false;
+	session* s_this = static_cast<session*>( user_data );
+	stream* stream_data = static_cast<stream*>( source->ptr );
+	LOGTRACE( "send_data_callback - Stream id: ", frame->hd.stream_id, " length ", length );
+	assert( s_this->gathering );
+
+	// Frames go out in order: the header follows what the library produced so far
+	std::vector<dstring>& out = *s_this->gathering;
+	static constexpr std::size_t frame_header_size{9};
+	std::size_t padlen = frame->data.padlen;
+	if ( s_this->gathering_tail )
+		out.back().append( reinterpret_cast<const char*>( framehd ), frame_header_size );
+	else
+		out.emplace_back( framehd, frame_header_size );
+	if ( padlen > 0 )
+	{
+		char padfield = static_cast<char>( padlen - 1 );
+		out.back().append( &padfield, 1 );
+	}
 
-	LOGTRACE("on_write");
+	out.push_back( stream_data->consume_body( length ) );
+	s_this->gathering_tail = false;
 
-	const uint8_t* data;
-	int consumed = nghttp2_session_mem_send( session_data.get(), &data );
+	if ( padlen > 1 )
+	{
+		static const char padding[256]{};
+		out.emplace_back( padding, padlen - 1 );
+		s_this->gathering_tail = true;
+	}
 
-	if ( consumed < 0 ) // Memory exhausted!
-		THROW ( errors::session_send_failure, consumed );
+	s_this->gathered += frame_header_size + frame->hd.length;
+	// The frame is taken anyway; the next ones wait for the next write
+	return s_this->gathered < write_budget ? 0 : NGHTTP2_ERR_PAUSE;
+}
 
-	if ( consumed >= 0 )
+bool session::on_write_chunks( std::vector<dstring>& chunks )
+{
+	if ( connector() == nullptr ) return false;
+
+	LOGTRACE("on_write_chunks");
+
+	// The connector holds the chunks until the socket takes them, when the streams and their arenas
+	// may be gone: payloads in an arena are copied out, the others shared
+	utils::arena::scope heap{nullptr};
+	gathering = &chunks;
+	gathering_tail = false;
+	gathered = 0;
+	if ( switching_protocols )
 	{
-		dstring tdata{data, static_cast<size_t>(consumed)};
-		ch = std::move( tdata );
+		chunks.push_back( std::move( switching_protocols ) );
+		switching_protocols = dstring{};
+		gathering_tail = true;
 	}
+	const uint8_t* data;
+	ssize_t produced{0};
+	while ( gathered < write_budget && ( produced = nghttp2_session_mem_send( session_data.get(), &data ) ) > 0 )
+	{
+		gathered += produced;
+		// Control frames and headers are small: they are copied together
+		if ( gathering_tail )
+			chunks.back().append( reinterpret_cast<const char*>( data ), static_cast<size_t>( produced ) );
+		else
+			chunks.emplace_back( data, static_cast<size_t>( produced ) );
+		gathering_tail = true;
+	}
+	gathering = nullptr;
+
+	if ( produced < 0 ) // Memory exhausted!
+		THROW ( errors::session_send_failure, static_cast<int>( produced ) );
+	return true;
+}
+
+bool session::on_write( dstring& ch )
+{
+	std::vector<dstring> chunks;
+	if ( ! on_write_chunks( chunks ) )
+		return false;
+	ch = dstring_factory::join( chunks );
 	return true;
 }
 
@@ -7,6 +7,9 @@
 #include "../connector.h"
 #include "../log/access_record.h"
 #include "../chain_of_responsibility/error_code.h"
+#include "http2alloc.h"
+#include "window_tuner.h"
+#include "../configuration/configuration_wrapper.h"
 
 #include <memory>
 #include <vector>
@@ -21,7 +24,12 @@ extern const std::size_t header_size_bytes;
 class session : public server::handler_interface
 {
 	using session_deleter = std::function<void(nghttp2_session*)>;
+	// Declared first: whatever nghttp2 holds goes with it, after the session
+	mem_pool pool;
+	nghttp2_mem all;
 	std::unique_ptr<nghttp2_session, session_deleter> session_data;
+	const configuration::http2_settings settings;
+	window_tuner tuner;
 
 	static int on_frame_recv_callback ( nghttp2_session *session_,
 		const nghttp2_frame *frame, void *user_data);
@@ -37,16 +45,31 @@ class session : public server::handler_interface
 	static int on_data_chunk_recv_callback(nghttp2_session *session_, uint8_t flags, int32_t stream_id,
 		const uint8_t *data, size_t len, void *user_data );
 
+	static int send_data_callback ( nghttp2_session *session_, nghttp2_frame *frame, const uint8_t *framehd,
+		size_t length, nghttp2_data_source *source, void *user_data );
 	static int frame_send_callback (nghttp2_session *session, const nghttp2_frame *frame, void *user_data );
 	static int frame_not_send_callback ( nghttp2_session *session, const nghttp2_frame *frame,
 		int lib_error_code, void *user_data );
 
 	void send_connection_header();
+	void grow_connection_window( std::int32_t size );
+	void grow_windows( std::int32_t size );
+	void prioritize( stream* stream_data, const nghttp2_frame* frame );
 	stream* create_stream( std::int32_t id );
 	void go_away();
 
-	nghttp2_mem all;
 	nghttp2_option* options;
+	// Where frames go while the library is asked for them; the last one can be appended to
+	std::vector<dstring>* gathering{nullptr};
+	// The answer to an upgrade from HTTP/1.1 goes before any frame
+	dstring switching_protocols;
+	std::size_t gathered{0};
+	bool gathering_tail{false};
+	// Writes wait for the end of the current turn of the io_service, gathering what
+	// the streams produce meanwhile; the token tells the posted flush if we are gone
+	bool flush_scheduled{false};
+	std::shared_ptr<bool> alive{std::make_shared<bool>(true)};
+	void flush();
 	bool gone{false};
 	std::int32_t stream_counter{0};
 public:
@@ -56,8 +79,16 @@ public:
 	bool start() noexcept override;
 	bool on_read(const char*, size_t) override;
 	bool on_write( dstring& chunk ) override;
+	bool on_write_chunks( std::vector<dstring>& chunks ) override;
 	bool should_stop() const noexcept override;
 
+	/**
+	 * @brief Takes over a connection upgraded from HTTP/1.1: the request
+	 * that asked for it becomes stream 1.
+	 * @return false, leaving the request untouched, if its settings are refused.
+	 */
+	bool upgrade( http::http_request&& request );
+
 	void do_write() override;
 	void on_connector_nulled() override;
 
@@ -65,7 +96,7 @@ public:
 	void on_error(const int &) override;
 
 	void finished_stream() noexcept;
-	virtual ~session() { nghttp2_option_del( options ); }
+	virtual ~session();
 
 	// Push interface to come
 
@@ -28,6 +28,7 @@ void stream::invalidate() noexcept
 
 stream::stream ( stream && o) noexcept
 {
+	mem = std::move( o.mem );
 	id_ = o.id_;
 	request = std::move( o.request );
 	destructor = std::move( o.destructor );
@@ -42,12 +43,14 @@ stream& stream::operator=( stream&& o ) noexcept
 		id_ = o.id_;
 		request = std::move( o.request );
 		destructor = std::move( o.destructor );
+		// Last: what was allocated in the previous arena is gone by now
+		mem = std::move( o.mem );
 	}
 	return *this;
 }
 
-stream::stream( session* s,  std::function<void(stream*, session*)> des, std::int16_t prio ):
-	weight_{prio}, session_{s}, destructor{des}
+stream::stream( session* s,  std::function<void(stream*, session*)> des, std::int32_t prio ):
+	weight_{prio}, session_{s}, request{ s->connector() == nullptr || s->connector()->is_ssl() }, destructor{des}
 {
 	LOGTRACE("stream ", this, " session", session_ );
 	assert(session_ != nullptr);
@@ -60,7 +63,7 @@ stream::stream( session* s,  std::function<void(stream*, session*)> des, std::in
 
 	// Not all streams are supposed to send data - it would be better to have a
 	// lazy creation
-	auto cor = server::handler_interface::make_chain();
+	auto cor = server::handler_interface::acquire_chain();
 	logger.set_request_start();
 	callback_cor_initializer<stream>( cor, this );
 	managed_chain = std::move( cor );
@@ -70,11 +73,22 @@ void stream::on_request_header_complete()
 {
 	logger.request( request );
 	LOGTRACE("stream headers complete!");
+	utils::arena::scope use{mem};
 	managed_chain->on_request_preamble( std::move( request ) );
 }
 
+void stream::on_request_upgraded( http::http_request&& r )
+{
+	request = std::move( r );
+	request.channel( http::proto_version::HTTP20 );
+	request.origin( session_->find_origin() );
+	on_request_header_complete();
+	on_request_finished();
+}
+
 void stream::on_request_header( http::http_structured_data::header_t&& h )
 {
+	utils::arena::scope use{mem};
 	request.header( h.first, h.second );
 }
 
@@ -108,14 +122,6 @@ void stream::on_response_continue()
 	LOGINFO(" called - not doing anything!");
 }
 
-void stream::weight( std::int16_t p ) noexcept
-{
-	weight_ = p;
-	nghttp2_priority_spec prio { id_, weight_, 0 };
-	int rc = nghttp2_submit_priority( session_->next_layer(),  NGHTTP2_FLAG_NONE, id_, &prio );
-	assert( rc == 0 );
-}
-
 void stream::on_error( const int& error )
 {
 	errored = true;
@@ -207,21 +213,24 @@ ssize_t stream::data_source_read_callback ( nghttp2_session *session_, std::int3
 	if ( s_this->body_empty() )
 		return 0;
 
-	//*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY; needed sooner or later
-	dstring& first = s_this->body.front();
+	// The bytes are taken by the session when the frame is sent: see consume_body
+	*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+	std::size_t len = s_this->body.front().size() - s_this->body_index;
+	return std::min( len, length );
+}
 
-	std::size_t len = first.size() - s_this->body_index;
-	ssize_t r = std::min( len, length );
-	s_this->body_index += r;
-	std::memcpy( buf, first.cdata(), r );
+dstring stream::consume_body( std::size_t length ) noexcept
+{
+	dstring& first = body.front();
+	dstring chunk = first.slice( body_index, length );
+	body_index += length;
 
-	if ( s_this->body_index == first.size() )
+	if ( body_index == first.size() )
 	{
-		s_this->body.pop_front();
-		s_this->body_index = 0;
+		body.pop_front();
+		body_index = 0;
 	}
-
-	return r;
+	return chunk;
 }
 
 void stream::flush() noexcept
@@ -247,7 +256,7 @@ void stream::flush() noexcept
 		else if ( body_sent && eof_ )
 		{
 			trailers_nvlen = trailers.size();
-			create_headers( &trailers_nva );
+			create_headers( &trailers_nva, trailers_nvlen );
 
 			std::size_t i = 0;
 			for ( auto&& it : trailers )
@@ -284,17 +293,16 @@ void stream::on_body( dstring&& c )
 	flush();
 }
 
-void stream::create_headers( nghttp2_nv** a ) noexcept
+void stream::create_headers( nghttp2_nv** a, std::size_t len ) noexcept
 {
-	*a = reinterpret_cast<nghttp2_nv*> (
-		static_cast<http2_allocator<std::uint8_t>*>( session_->next_layer_allocator()->mem_user_data )
-			->allocate( sizeof(nghttp2_nv) * nvlen ) );
+	nghttp2_mem* all = session_->next_layer_allocator();
+	*a = static_cast<nghttp2_nv*>( all->malloc( sizeof(nghttp2_nv) * len, all->mem_user_data ) );
 }
 
 void stream::destroy_headers( nghttp2_nv** d ) noexcept
 {
-	static_cast<http2_allocator<std::uint8_t>*>( session_->next_layer_allocator()->mem_user_data )
-		->deallocate( reinterpret_cast<uint8_t*>( *d ), 0 );
+	nghttp2_mem* all = session_->next_layer_allocator();
+	all->free( *d, all->mem_user_data );
 	*d = nullptr;
 }
 
@@ -340,7 +348,7 @@ void stream::on_header(  http::http_response && resp )
 
 	for ( auto&& it : resp.headers() )
 	{
-		http::http_structured_data::headers_map::iterator found = prepared_headers.find( it.first );
+		auto found = prepared_headers.find( it.first );
 		if ( found != prepared_headers.end() )
 		{
 			dstring cval = found->second;
@@ -354,7 +362,7 @@ void stream::on_header(  http::http_response && resp )
 	}
 
 	nvlen = prepared_headers.size();
-	create_headers( &nva );
+	create_headers( &nva, nvlen );
 
 	std::size_t i = 0;
 	for ( auto&& it : prepared_headers )
@@ -381,6 +389,7 @@ stream::~stream()
 	logger.commit();
 	if ( nva ) destroy_headers( &nva );
 	if ( trailers_nva ) destroy_headers( &trailers_nva );
+	server::handler_interface::release_chain( std::move( managed_chain ) );
 }
 
 void stream::uri_host( const dstring &p ) noexcept
@@ -7,8 +7,10 @@
 #include <cstddef>
 #include <string>
 #include <memory>
+#include <map>
 
 #include "../chain_of_responsibility/node_interface.h"
+#include "../utils/arena.h"
 #include "session.h"
 #include "../http/http_structured_data.h"
 #include "../http/http_request.h"
@@ -30,6 +32,8 @@ namespace http2
 	
 class stream final
 {
+	// Request headers are allocated here; it must outlive them
+	utils::arena mem;
 	std::int32_t id_;
 	std::int32_t status; 
 	bool headers_sent{false};
@@ -38,8 +42,8 @@ class stream final
 	bool eof_{false};
 	bool errored{false};
 	bool closed_{false};
-	// TODO Used for prioritization! In the future.
-	std::int32_t weight_{0};
+	// As the client asked for it; nghttp2 keeps the dependency tree and schedules on it
+	std::int32_t weight_{NGHTTP2_DEFAULT_WEIGHT};
 	
 	std::unique_ptr<node_interface> managed_chain{nullptr};
 
@@ -47,13 +51,13 @@ class stream final
 	std::size_t body_index{0};
 	nghttp2_nv* nva{nullptr}; // headers HTTP2
 	std::size_t nvlen{0};
-	http::http_structured_data::headers_map trailers;
+	std::multimap<dstring, dstring> trailers;
 	nghttp2_nv* trailers_nva{nullptr};
 	std::size_t trailers_nvlen{0};
 
 	session* const session_{nullptr};
 	
-	http::http_structured_data::headers_map prepared_headers;
+	std::multimap<dstring, dstring> prepared_headers;
 	http::http_request request{true};
 	
 	nghttp2_data_provider prd;
@@ -64,7 +68,7 @@ class stream final
 		std::size_t length, std::uint32_t *data_flags, nghttp2_data_source *source, void *user_data );
 	
 	void destroy_headers( nghttp2_nv** h ) noexcept;
-	void create_headers( nghttp2_nv** h ) noexcept;
+	void create_headers( nghttp2_nv** h, std::size_t len ) noexcept;
 	bool has_trailers() const noexcept { return trailers.size() > 0; }
 	bool defer() const noexcept;
 	bool body_empty() const noexcept;
@@ -75,7 +79,7 @@ class stream final
 	std::function<void(stream*, session*)> destructor;
 public:
 //	stream( std::function<void(stream*, session*)> des );
-	stream( session* s, std::function<void(stream*, session*)> des, std::int16_t prio = 0 );
+	stream( session* s, std::function<void(stream*, session*)> des, std::int32_t prio = NGHTTP2_DEFAULT_WEIGHT );
 	stream( const stream& ) = delete;
 	stream& operator=( const stream& ) = delete;
 	stream( stream&& o ) noexcept;
@@ -96,13 +100,15 @@ public:
 	std::int32_t id() const noexcept { return id_; }
 	void id( std::int32_t i ) noexcept { id_ = i; }
 	
-	std::int16_t weight() const noexcept{ return weight_; }
-	void weight( std::int16_t p ) noexcept;
+	std::int32_t weight() const noexcept{ return weight_; }
+	void weight( std::int32_t w ) noexcept { weight_ = w; }
 	
 	// Request / Response management 
 // 	void on_request_preamble(http::http_request&& message);
 	void on_request_header( http::http_request::header_t&& h ); // NGHttp2 friendly
 	void on_request_header_complete();
+	/** The request of a connection upgraded from HTTP/1.1, complete as it is. */
+	void on_request_upgraded( http::http_request&& r );
 	void on_request_body(dstring&& c);
 	// on request trailer missing?
 	void on_request_finished();
@@ -114,6 +120,9 @@ public:
 	void on_error(const int &);
 	void on_response_continue();
 	void on_request_canceled(const errors::error_code &ec);
+	/** The next length bytes of the response body, as much as the last read callback offered.
+	 * A slice of the body, unless it is in the arena of the stream: then a copy, made where the current arena says. */
+	dstring consume_body( std::size_t length ) noexcept;
 	
 	void on_write( dstring& out );
 	void on_read( dstring&& in );
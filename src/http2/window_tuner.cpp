@@ -0,0 +1,47 @@
+#include "window_tuner.h"
+
+#include <algorithm>
+
+namespace http2
+{
+
+window_tuner::window_tuner(std::int32_t initial, std::int32_t limit) noexcept
+	: _window{initial}
+	, _limit{std::max(initial, limit)}
+{}
+
+bool window_tuner::on_data(std::size_t len) noexcept
+{
+	_sample += len;
+	if(_sampling || _window >= _limit)
+		return false;
+
+	_sampling = true;
+	_sample = len;
+	return true;
+}
+
+void window_tuner::on_ping_sent(clock::time_point now) noexcept
+{
+	_ping_sent = now;
+}
+
+std::int32_t window_tuner::on_ping_ack(clock::time_point now) noexcept
+{
+	if(!_sampling)
+		return 0;
+	_sampling = false;
+
+	auto rtt = now - _ping_sent;
+	_rtt = _rtt == clock::duration::zero() ? rtt : (_rtt * 7 + rtt) / 8;
+
+	// Less than two thirds of the window in a round trip: the window is not the limit
+	if(_sample * 3 < static_cast<std::size_t>(_window) * 2)
+		return 0;
+
+	auto grown = std::max<std::size_t>(static_cast<std::size_t>(_window) * 2, _sample * 2);
+	_window = static_cast<std::int32_t>(std::min<std::size_t>(grown, _limit));
+	return _window;
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace http2
+{
+
+/**
+ * @brief The window_tuner class grows the receive windows of a session
+ * to the bandwidth-delay product of its connection.
+ *
+ * When data arrives a PING is sent; the data received until its ACK
+ * is what the peer could send in a round trip. If that filled most of the
+ * window the window was the bottleneck: it is doubled, up to the limit.
+ */
+class window_tuner
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	window_tuner(std::int32_t initial, std::int32_t limit) noexcept;
+
+	/** @return true when a PING is to be sent to take a sample. */
+	bool on_data(std::size_t len) noexcept;
+	void on_ping_sent(clock::time_point now) noexcept;
+	/** @return the new window size, or 0 if the window stays as it is. */
+	std::int32_t on_ping_ack(clock::time_point now) noexcept;
+
+	std::int32_t window() const noexcept { return _window; }
+	/** Smoothed round trip time, zero until measured. */
+	clock::duration rtt() const noexcept { return _rtt; }
+
+private:
+	std::int32_t _window;
+	const std::int32_t _limit;
+	bool _sampling{false};
+	std::size_t _sample{0};
+	clock::time_point _ping_sent;
+	clock::duration _rtt{clock::duration::zero()};
+};
+
+}
@@ -22,6 +22,7 @@
  * IN THE SOFTWARE.
  */
 #include "http_parser.h"
+#include "http_scan.h"
 #include <assert.h>
 #include <stddef.h>
 #include <ctype.h>
@@ -1307,6 +1308,8 @@ reexecute:
 
           switch (parser->header_state) {
             case h_general:
+              /* skip the plain token chars in one go */
+              p = http_scan_header_field(p + 1, data + len) - 1;
               break;
 
             case h_C:
@@ -1533,24 +1536,13 @@ reexecute:
           switch (h_state) {
             case h_general:
             {
-              const char* p_cr;
-              const char* p_lf;
               size_t limit = data + len - p;
 
               limit = MIN(limit, HTTP_MAX_HEADER_SIZE);
 
-              p_cr = (const char*) memchr(p, CR, limit);
-              p_lf = (const char*) memchr(p, LF, limit);
-              if (p_cr != NULL) {
-                if (p_lf != NULL && p_cr >= p_lf)
-                  p = p_lf;
-                else
-                  p = p_cr;
-              } else if (UNLIKELY(p_lf != NULL)) {
-                p = p_lf;
-              } else {
-                p = data + len;
-              }
+              /* single pass up to the next CR, LF or invalid char; the
+               * current char has already been checked above */
+              p = http_scan_header_value(p + 1, p + limit);
               --p;
 
               break;
@@ -0,0 +1,202 @@
+#include "http_scan.h"
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define HTTP_SCAN_X86 1
+# include <immintrin.h>
+#endif
+
+typedef const char* (*scan_fn)(const char*, const char*);
+
+/* Bytes that stop a header value: every CTL but HTAB, and DEL. */
+#define VALUE_STOP(c) (((unsigned char)(c) < 0x20 && (c) != '\t') || (c) == 0x7f)
+
+/* The common subset of header field tokens. */
+#define FIELD_SKIP(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') \
+	|| ((c) >= '0' && (c) <= '9') || (c) == '-' || (c) == '_')
+
+static const char* scalar_header_value(const char* p, const char* end)
+{
+	for (; p != end; ++p)
+		if (VALUE_STOP(*p))
+			break;
+	return p;
+}
+
+static const char* scalar_header_field(const char* p, const char* end)
+{
+	for (; p != end; ++p)
+		if (!FIELD_SKIP(*p))
+			break;
+	return p;
+}
+
+#ifdef HTTP_SCAN_X86
+
+/*
+ * SSE4.2: PCMPESTRI does the whole range check of a 16 bytes block
+ * in a single instruction.
+ */
+__attribute__((target("sse4.2")))
+static const char* sse42_header_value(const char* p, const char* end)
+{
+	static const char stop_ranges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+	const __m128i ranges = _mm_loadu_si128((const __m128i*) stop_ranges);
+
+	while (end - p >= 16)
+	{
+		const __m128i block = _mm_loadu_si128((const __m128i*) p);
+		int idx = _mm_cmpestri(ranges, 6, block, 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+		if (idx != 16)
+			return p + idx;
+		p += 16;
+	}
+	return scalar_header_value(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static const char* sse42_header_field(const char* p, const char* end)
+{
+	static const char skip_ranges[16] = "09AZaz__--";
+	const __m128i ranges = _mm_loadu_si128((const __m128i*) skip_ranges);
+
+	while (end - p >= 16)
+	{
+		const __m128i block = _mm_loadu_si128((const __m128i*) p);
+		int idx = _mm_cmpestri(ranges, 10, block, 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+		if (idx != 16)
+			return p + idx;
+		p += 16;
+	}
+	return scalar_header_field(p, end);
+}
+
+/*
+ * AVX2 has no string instructions on 256 bits registers; ranges are checked
+ * with unsigned saturating arithmetic instead: x is in [lo, hi] iff
+ * min(x - lo, hi - lo) == x - lo.
+ */
+__attribute__((target("avx2")))
+static __m256i avx2_in_range(__m256i block, char lo, char hi)
+{
+	const __m256i shifted = _mm256_sub_epi8(block, _mm256_set1_epi8(lo));
+	const __m256i width = _mm256_set1_epi8((char)(hi - lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, width), shifted);
+}
+
+__attribute__((target("avx2")))
+static const char* avx2_header_value(const char* p, const char* end)
+{
+	const __m256i ctl = _mm256_set1_epi8(0x1f);
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i del = _mm256_set1_epi8(0x7f);
+
+	while (end - p >= 32)
+	{
+		const __m256i block = _mm256_loadu_si256((const __m256i*) p);
+		const __m256i is_ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(block, ctl), block);
+		const __m256i is_tab = _mm256_cmpeq_epi8(block, tab);
+		const __m256i is_del = _mm256_cmpeq_epi8(block, del);
+		const unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_andnot_si256(is_tab, is_ctl), is_del));
+		if (mask)
+			return p + __builtin_ctz(mask);
+		p += 32;
+	}
+	return sse42_header_value(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* avx2_header_field(const char* p, const char* end)
+{
+	const __m256i dash = _mm256_set1_epi8('-');
+	const __m256i underscore = _mm256_set1_epi8('_');
+
+	while (end - p >= 32)
+	{
+		const __m256i block = _mm256_loadu_si256((const __m256i*) p);
+		__m256i ok = _mm256_or_si256(avx2_in_range(block, 'a', 'z'), avx2_in_range(block, 'A', 'Z'));
+		unsigned int mask;
+		ok = _mm256_or_si256(ok, avx2_in_range(block, '0', '9'));
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(block, dash));
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(block, underscore));
+		mask = ~(unsigned int) _mm256_movemask_epi8(ok);
+		if (mask)
+			return p + __builtin_ctz(mask);
+		p += 32;
+	}
+	return sse42_header_field(p, end);
+}
+
+#endif /* HTTP_SCAN_X86 */
+
+static const char* resolve_header_value(const char* p, const char* end);
+static const char* resolve_header_field(const char* p, const char* end);
+
+static scan_fn header_value_impl = resolve_header_value;
+static scan_fn header_field_impl = resolve_header_field;
+
+static enum http_scan_mode best_mode(void)
+{
+#ifdef HTTP_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return HTTP_SCAN_AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return HTTP_SCAN_SSE42;
+#endif
+	return HTTP_SCAN_SCALAR;
+}
+
+enum http_scan_mode http_scan_set_mode(enum http_scan_mode mode)
+{
+	enum http_scan_mode best = best_mode();
+	if (mode == HTTP_SCAN_AUTO || mode > best)
+		mode = best;
+
+	switch (mode)
+	{
+#ifdef HTTP_SCAN_X86
+		case HTTP_SCAN_AVX2:
+			header_value_impl = avx2_header_value;
+			header_field_impl = avx2_header_field;
+			break;
+		case HTTP_SCAN_SSE42:
+			header_value_impl = sse42_header_value;
+			header_field_impl = sse42_header_field;
+			break;
+#endif
+		default:
+			mode = HTTP_SCAN_SCALAR;
+			header_value_impl = scalar_header_value;
+			header_field_impl = scalar_header_field;
+			break;
+	}
+	return mode;
+}
+
+/* First call lands here: pick the implementation, then forward. */
+static const char* resolve_header_value(const char* p, const char* end)
+{
+	http_scan_set_mode(HTTP_SCAN_AUTO);
+	return header_value_impl(p, end);
+}
+
+static const char* resolve_header_field(const char* p, const char* end)
+{
+	http_scan_set_mode(HTTP_SCAN_AUTO);
+	return header_field_impl(p, end);
+}
+
+const char* http_scan_header_value(const char* p, const char* end)
+{
+	return header_value_impl(p, end);
+}
+
+const char* http_scan_header_field(const char* p, const char* end)
+{
+	return header_field_impl(p, end);
+}
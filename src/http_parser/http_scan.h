@@ -0,0 +1,52 @@
+#ifndef http_scan_h
+#define http_scan_h
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Vectorized byte scanners used by http_parser to skip over the
+ * common parts of header fields and values.
+ *
+ * The scanners never decide on their own whether a message is valid:
+ * they only tell the parser how many bytes are "boring" and can be
+ * skipped, stopping at the first byte the scalar state machine must see.
+ *
+ * The implementation (scalar, SSE4.2 or AVX2) is selected at runtime on
+ * first use according to the features of the running CPU.
+ */
+
+enum http_scan_mode
+{
+	HTTP_SCAN_AUTO = 0,
+	HTTP_SCAN_SCALAR,
+	HTTP_SCAN_SSE42,
+	HTTP_SCAN_AVX2
+};
+
+/**
+ * Returns a pointer to the first byte in [p, end) that cannot be skipped
+ * inside a header value: CR, LF, any other control char but HTAB, DEL.
+ * Returns end if no such byte is found.
+ */
+const char* http_scan_header_value(const char* p, const char* end);
+
+/**
+ * Returns a pointer to the first byte in [p, end) that is not one of
+ * the usual header field chars [A-Za-z0-9_-]; this includes ':' and
+ * all the less common token chars, left to the scalar parser.
+ * Returns end if no such byte is found.
+ */
+const char* http_scan_header_field(const char* p, const char* end);
+
+/**
+ * Forces a given implementation; used by tests and benchmarks.
+ * Returns the mode actually in use, which falls back to the best
+ * available one if the CPU does not support the requested mode.
+ */
+enum http_scan_mode http_scan_set_mode(enum http_scan_mode mode);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,6 +1,10 @@
 #include <boost/lexical_cast.hpp>
 #include "http_server.h"
 #include "service_locator/service_initializer.h"
+#include "configuration/configuration_wrapper.h"
+#include "protocol/handler_factory.h"
+#include "protocol/chain_registry.h"
+#include "utils/http_clock.h"
 #include "utils/log_wrapper.h"
 
 using namespace std;
@@ -53,6 +57,9 @@ http_server::http_server()
 	for( auto&& iter = sni.begin(); iter != sni.end(); ++iter )
 		_handlers.register_protocol_selection_callbacks(iter->context.native_handle());
 
+	// Before any connection: routes are read without locking
+	handler_interface::chains().configure( service::locator::configuration().get_chain_rules() );
+
 	auto port = service::locator::configuration().get_port();
 	auto porth = service::locator::configuration().get_port_h();
 
@@ -92,6 +99,7 @@ void http_server::start(io_service_pool::main_init_fn_t& main_init) noexcept
 			locator::stats_manager().register_handler();
 // 			initializer::set_socket_pool(new network::magnet(1));
 			initializer::thread_local_socket_pool_initializer();
+			utils::http_clock::start(ios);
 
 			auto&& cw = locator::configuration();
 			auto il = new logging::inspector_log{ cw.get_log_path(), "inspector", cw.inspector_active() };
@@ -110,6 +118,7 @@ void http_server::stop( ) noexcept
 	if(running)
 	{
 		running = false;
+		utils::http_clock::stop();
 
 		for (auto &acceptor : _acceptors)
 			acceptor.close();
@@ -179,8 +188,7 @@ void http_server::start_accept(tcp_acceptor& acceptor)
 		if (!ec)
 		{
 			auto conn = std::make_shared<tcp_connector>(_connect_timeout, _read_timeout, socket);
-			//Assume only HTTP1.1 can land here
-			auto h = _handlers.build_handler(ht_h1);
+			auto h = _handlers.build_cleartext_handler();
 			conn->handler( h );
 			conn->start();
 			return;
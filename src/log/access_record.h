@@ -6,6 +6,7 @@
 #include "../http/http_request.h"
 
 #include <chrono>
+#include <map>
 #include <string>
 
 namespace logging
@@ -76,6 +77,8 @@ public:
 	void cancel() noexcept;
 	void continued() noexcept;
 	void commit() noexcept;
+	/** Nothing is logged: the transaction is recorded somewhere else. */
+	void discard() noexcept { committed_ = true; }
 	void request( const http::http_request& r );
 	void response( const http::http_response& r );
 	void append_response_body( const dstring& body );
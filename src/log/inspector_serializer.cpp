@@ -74,14 +74,14 @@ void inspector_log::jsonize_body( nlohmann::json &json, const std::list<dstring>
 	json["body"] = built_body;
 }
 
-void inspector_log::jsonize_headers( nlohmann::json &json, const http::http_structured_data::headers_map &hrs )
+void inspector_log::jsonize_headers( nlohmann::json &json, const std::multimap<dstring, dstring> &hrs )
 {
 	if ( hrs.size() == 0 )
 		return;
 
 	std::vector<std::string> multi_values;
 	std::string multi_key;
-	for ( const http::http_structured_data::header_t& values : hrs )
+	for ( const std::pair<const dstring, dstring>& values : hrs )
 	{
 		dstring key = values.first;
 		dstring value = values.second;
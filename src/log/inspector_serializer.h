@@ -29,7 +29,7 @@ class inspector_log final
 {
 	std::unique_ptr<writer> logfile;
 
-	void jsonize_headers( nlohmann::json& json, const http::http_structured_data::headers_map& hrs );
+	void jsonize_headers( nlohmann::json& json, const std::multimap<dstring, dstring>& hrs );
 	void jsonize_body( nlohmann::json& json, const std::list<dstring>& body );
 	void jsonize(  access_recorder& r ) noexcept;
 public:
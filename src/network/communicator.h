@@ -5,6 +5,7 @@
 #include <queue>
 #include "../chain_of_responsibility/error_code.h"
 #include "../utils/dstring.h"
+#include "../utils/arena.h"
 #include "../utils/log_wrapper.h"
 #include "../errors/error_codes.h"
 #include "../utils/reusable_buffer.h"
@@ -65,7 +66,9 @@ public:
 	 * */
 	void write(dstring&& data)
 	{
-		queue.emplace(std::move(data));
+		// Writes can outlive the transaction asking for them, and its arena
+		utils::arena::scope heap{nullptr};
+		queue.emplace(data);
 		perform_write();
 	}
 
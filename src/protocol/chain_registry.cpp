@@ -0,0 +1,259 @@
+#include "chain_registry.h"
+#include "handler_factory.h"
+#include "../configuration/configuration_wrapper.h"
+#include "../chain_of_responsibility/chain_of_responsibility.h"
+#include "../requests_manager/method_filter.h"
+#include "../requests_manager/error_producer.h"
+#include "../requests_manager/client_wrapper.h"
+#include "../requests_manager/date_setter.h"
+#include "../requests_manager/sys_filter.h"
+#include "../requests_manager/interreg_filter.h"
+#include "../requests_manager/error_file_provider.h"
+#include "../requests_manager/header_filter.h"
+#include "../requests_manager/franco_host.h"
+#include "../requests_manager/request_stats.h"
+#include "../requests_manager/id_header_adder.h"
+#include "../requests_manager/configurable_header_filter.h"
+#include "../requests_manager/gzip_filter.h"
+#include "../utils/log_wrapper.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace server
+{
+
+constexpr size_t chain_registry::default_chain;
+constexpr size_t chain_registry::npos;
+
+namespace
+{
+
+// FNV-1a of the lowercase host, port excluded
+uint32_t host_hash(const char* host, size_t len, size_t& hostlen) noexcept
+{
+	uint32_t h{2166136261u};
+	for(hostlen = 0; hostlen < len && host[hostlen] != ':'; ++hostlen)
+		h = (h ^ static_cast<uint8_t>(std::tolower(host[hostlen]))) * 16777619u;
+	return h;
+}
+
+// A prefix ends at a segment of the path: at its end, at a '/' or with one
+bool segment_prefix(const std::string& prefix, const dstring& path) noexcept
+{
+	if(prefix.size() > path.size() || !std::equal(prefix.begin(), prefix.end(), path.cbegin()))
+		return false;
+	return prefix.empty() || prefix.back() == '/' || prefix.size() == path.size() || path.cdata()[prefix.size()] == '/';
+}
+
+}
+
+chain_registry::chain_registry()
+{
+	// Deferred: make_chain can be replaced after the registry is built
+	add("default", [](){ return handler_interface::make_chain(); });
+
+	// Just a proxy: no cache, no compression, no local pages
+	add("passthrough", []()
+	{
+		return make_unique_chain<node_interface,
+			nodes::error_producer,
+			nodes::request_stats,
+			nodes::date_setter,
+			nodes::header_filter,
+			nodes::method_filter,
+			nodes::sys_filter,
+			nodes::interreg_filter,
+			nodes::id_header_adder,
+			nodes::configurable_header_filter,
+			nodes::client_wrapper>();
+	});
+
+	add("nocache", []()
+	{
+		return make_unique_chain<node_interface,
+			nodes::error_producer,
+			nodes::request_stats,
+			nodes::date_setter,
+			nodes::header_filter,
+			nodes::method_filter,
+			nodes::franco_host,
+			nodes::sys_filter,
+			nodes::interreg_filter,
+			nodes::error_file_provider,
+			nodes::id_header_adder,
+			nodes::configurable_header_filter,
+			nodes::gzip_filter,
+			nodes::client_wrapper>();
+	});
+}
+
+size_t chain_registry::add(const std::string& name, factory f)
+{
+	auto found = find(name);
+	if(found != npos)
+	{
+		chains[found].second = std::move(f);
+		return found;
+	}
+	chains.emplace_back(name, std::move(f));
+	return chains.size() - 1;
+}
+
+size_t chain_registry::find(const std::string& name) const noexcept
+{
+	for(size_t i = 0; i < chains.size(); ++i)
+		if(chains[i].first == name)
+			return i;
+	return npos;
+}
+
+std::unique_ptr<node_interface> chain_registry::make(size_t chain) const
+{
+	return chains.at(chain).second();
+}
+
+bool chain_registry::route(const std::string& host, const std::string& path_prefix, const std::string& chain)
+{
+	auto index = find(chain);
+	if(index == npos)
+		return false;
+
+	size_t len;
+	auto hash = host_hash(host.data(), host.size(), len);
+	std::string name = host.substr(0, len);
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	auto candidates = hosts.equal_range(hash);
+	auto routes = std::find_if(candidates.first, candidates.second, [&name](const decltype(hosts)::value_type& r)
+	{
+		return r.second.host == name;
+	});
+	if(routes == candidates.second)
+		routes = hosts.emplace(hash, host_routes{name, {}});
+
+	auto& prefixes = routes->second.prefixes;
+	auto same = std::find_if(prefixes.begin(), prefixes.end(), [&path_prefix](const prefix_route& r)
+	{
+		return r.prefix == path_prefix;
+	});
+	if(same != prefixes.end())
+	{
+		same->chain = index;
+		return true;
+	}
+
+	auto pos = std::find_if(prefixes.begin(), prefixes.end(), [&path_prefix](const prefix_route& r)
+	{
+		return r.prefix.size() < path_prefix.size();
+	});
+	prefixes.insert(pos, prefix_route{path_prefix, index});
+	return true;
+}
+
+bool chain_registry::configure(const std::vector<configuration::chain_rule>& rules)
+{
+	hosts.clear();
+	bool valid{true};
+	for(auto&& rule : rules)
+	{
+		if(!route(rule.vhost, rule.path, rule.chain))
+		{
+			LOGERROR("No chain named ", rule.chain, " for host ", rule.vhost);
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+size_t chain_registry::select(const dstring& host, const dstring& path) const noexcept
+{
+	if(hosts.empty())
+		return default_chain;
+
+	size_t len;
+	auto candidates = hosts.equal_range(host_hash(host.cdata(), host.size(), len));
+	for(auto it = candidates.first; it != candidates.second; ++it)
+	{
+		auto& routes = it->second;
+		if(routes.host.size() != len
+			|| !std::equal(routes.host.begin(), routes.host.end(), host.cbegin(),
+				[](char a, char b){ return a == std::tolower(b); }))
+			continue;
+
+		for(auto&& r : routes.prefixes)
+			if(segment_prefix(r.prefix, path))
+				return r.chain;
+		break;
+	}
+	return default_chain;
+}
+
+chain_selector::chain_selector(const chain_registry& registry)
+	: node_interface(
+		[this](http::http_request&& message){ on_request_preamble(std::move(message)); },
+		[this](dstring&& chunk){ on_request_body(std::move(chunk)); },
+		[this](dstring&& k, dstring&& v){ on_request_trailer(std::move(k), std::move(v)); },
+		[this](const errors::error_code& ec){ on_request_canceled(ec); },
+		[this](){ on_request_finished(); },
+		[](http::http_response&&){},
+		[](dstring&&){},
+		[](dstring&&, dstring&&){},
+		[](){},
+		[](const errors::error_code&){},
+		[](){})
+	, registry{registry}
+{}
+
+chain_selector::~chain_selector()
+{
+	release();
+}
+
+void chain_selector::release() noexcept
+{
+	if(chain)
+		handler_interface::release_chain(selected, std::move(chain));
+	selected = chain_registry::npos;
+}
+
+void chain_selector::on_request_preamble(http::http_request&& preamble)
+{
+	release();
+	selected = registry.select(preamble.hostname(), preamble.path());
+	chain = handler_interface::acquire_chain(selected);
+	chain->initialize_callbacks(
+		[this](http::http_response&& res){ on_header(std::move(res)); },
+		[this](dstring&& chunk){ on_body(std::move(chunk)); },
+		[this](dstring&& k, dstring&& v){ on_trailer(std::move(k), std::move(v)); },
+		[this](){ on_end_of_message(); },
+		[this](const errors::error_code& ec){ on_error(ec); },
+		[this](){ on_response_continue(); });
+	chain->on_request_preamble(std::move(preamble));
+}
+
+void chain_selector::on_request_body(dstring&& chunk)
+{
+	if(chain)
+		chain->on_request_body(std::move(chunk));
+}
+
+void chain_selector::on_request_trailer(dstring&& k, dstring&& v)
+{
+	if(chain)
+		chain->on_request_trailer(std::move(k), std::move(v));
+}
+
+void chain_selector::on_request_canceled(const errors::error_code& ec)
+{
+	if(chain)
+		chain->on_request_canceled(ec);
+}
+
+void chain_selector::on_request_finished()
+{
+	if(chain)
+		chain->on_request_finished();
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../chain_of_responsibility/node_interface.h"
+
+namespace configuration
+{
+struct chain_rule;
+}
+
+namespace server
+{
+
+/**
+ * @brief The chain_registry class holds the chains that can serve a request
+ * and decides which one does, by virtual host and path prefix.
+ *
+ * Chains are registered by name and referred to by index; index 0 is
+ * handler_interface::make_chain. Requests matching no route use it.
+ */
+class chain_registry
+{
+public:
+	using factory = std::function<std::unique_ptr<node_interface>()>;
+
+	static constexpr size_t default_chain{0};
+	static constexpr size_t npos{static_cast<size_t>(-1)};
+
+	/** Registers the default chain and the precompiled alternatives to it. */
+	chain_registry();
+
+	size_t add(const std::string& name, factory f);
+	size_t find(const std::string& name) const noexcept;
+	size_t size() const noexcept { return chains.size(); }
+	std::unique_ptr<node_interface> make(size_t chain) const;
+
+	/**
+	 * @brief route sends the requests for a host, and a path prefix
+	 * if not empty, to a registered chain.
+	 * @return false if there is no chain with that name.
+	 */
+	bool route(const std::string& host, const std::string& path_prefix, const std::string& chain);
+	/** Replaces all routes with the ones of the rules. */
+	bool configure(const std::vector<configuration::chain_rule>& rules);
+	bool routing() const noexcept { return !hosts.empty(); }
+
+	/**
+	 * @return the chain for a request; the port of the host is not considered.
+	 * A prefix matches whole segments of the path: "/live" matches "/live" and
+	 * "/live/channel1", not "/lively".
+	 */
+	size_t select(const dstring& host, const dstring& path) const noexcept;
+
+private:
+	struct prefix_route
+	{
+		std::string prefix;
+		size_t chain;
+	};
+
+	struct host_routes
+	{
+		std::string host;
+		// Longest prefix first: the first match is the most specific
+		std::vector<prefix_route> prefixes;
+	};
+
+	std::vector<std::pair<std::string, factory>> chains;
+	// By the hash of the lowercase host; hosts colliding share it
+	std::unordered_multimap<uint32_t, host_routes> hosts;
+};
+
+/**
+ * @brief The chain_selector class is the chain of a transaction when routes
+ * are configured: the actual chain is chosen, and taken from the pool,
+ * once the request preamble is known; events are then relayed to it.
+ * Selectors are pooled as well, and give their chain back when reset.
+ */
+class chain_selector : public node_interface
+{
+	const chain_registry& registry;
+	size_t selected{chain_registry::npos};
+	std::unique_ptr<node_interface> chain;
+
+	void release() noexcept;
+public:
+	explicit chain_selector(const chain_registry& registry);
+	~chain_selector();
+
+	void on_request_preamble(http::http_request&& preamble);
+	void on_request_body(dstring&& chunk);
+	void on_request_trailer(dstring&& k, dstring&& v);
+	void on_request_canceled(const errors::error_code& ec);
+	void on_request_finished();
+
+	void reset() override { release(); }
+};
+
+}
@@ -0,0 +1,50 @@
+#include "handler_cleartext.h"
+#include "../connector.h"
+#include "../utils/log_wrapper.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace server
+{
+
+namespace
+{
+
+// RFC 7540, 3.5: HTTP/1.x has no method named PRI
+constexpr const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr const size_t preface_len = sizeof(preface) - 1;
+
+}
+
+bool handler_cleartext::on_read(const char* data, size_t len)
+{
+	// The first read starts an empty buffer: what is left in it stays contiguous
+	if(!received)
+		received = data;
+
+	size_t n = std::min(len, preface_len - matched);
+	bool http2 = std::memcmp(data, preface + matched, n) == 0;
+	matched += n;
+	if(http2 && matched < preface_len)
+		return true;
+
+	LOGDEBUG(this, " cleartext connection speaks ", http2 ? "HTTP/2" : "HTTP/1.x");
+	auto next = http2 ? factory.build_handler(ht_h2, http::proto_version::HTTP20) : factory.build_handler(ht_h1);
+	auto conn = connector();
+	const char* begin = received;
+	const size_t size = data + len - received;
+	delete this;
+
+	conn->handler(next);
+	if(!next->start())
+		return false;
+	return next->on_read(begin, size);
+}
+
+void handler_cleartext::on_connector_nulled()
+{
+	delete this;
+}
+
+} //namespace
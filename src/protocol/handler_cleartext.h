@@ -0,0 +1,37 @@
+#pragma once
+
+#include "handler_factory.h"
+
+namespace server
+{
+
+/**
+ * @brief The handler_cleartext class reads the first bytes of a connection
+ * without TLS, to tell HTTP/2 with prior knowledge from HTTP/1.x.
+ *
+ * As soon as the protocol is known the connection, with the bytes read
+ * so far, is handed over to the handler for it and this one goes away.
+ */
+class handler_cleartext : public handler_interface
+{
+	const handler_factory& factory;
+	// Where the connection began; bytes are left in the buffer of the connector until then
+	const char* received{nullptr};
+	size_t matched{0};
+public:
+	explicit handler_cleartext(const handler_factory& factory) noexcept : factory(factory) {}
+
+	bool start() noexcept override { return true; }
+	bool should_stop() const noexcept override { return false; }
+	bool on_read(const char*, size_t) override;
+	bool on_write(dstring&) override { return true; }
+
+	void on_eom() override {}
+	void on_error(const int&) override {}
+
+protected:
+	void do_write() override {}
+	void on_connector_nulled() override;
+};
+
+} //namespace
@@ -1,6 +1,7 @@
 #include "handler_factory.h"
 #include "handler_http1.h"
 #include "handler_http2.h"
+#include "handler_cleartext.h"
 #include "../http2/session.h"
 #include "../connector.h"
 #include "../utils/log_wrapper.h"
@@ -22,11 +23,15 @@
 #include "../requests_manager/gzip_filter.h"
 #include "../requests_manager/cache_manager/cache_manager.h"
 #include "../requests_manager/cache_cleaner.h"
+#include "chain_registry.h"
 #include "../dummy_node.h"
 #include "../utils/likely.h"
 #include "../configuration/configuration_wrapper.h"
+#include "../utils/arena.h"
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -160,6 +165,20 @@ handler_interface* handler_factory::build_handler(handler_type type, http::proto
 	return nullptr;
 }
 
+handler_interface* handler_factory::build_cleartext_handler() const noexcept
+{
+	if ( cleartext_http2() )
+		return new handler_cleartext( *this );
+	return build_handler( ht_h1 );
+}
+
+bool handler_factory::cleartext_http2() noexcept
+{
+	// The legacy HTTP/2 handler works on TLS sockets only
+	auto&& conf = service::locator::configuration();
+	return ! conf.http2_is_disabled() && conf.http2_ng();
+}
+
 void handler_interface::initialize_callbacks(node_interface &cor)
 {
 	header_callback hcb = [this](http::http_response&& headers){ /*on_header(move(headers)); */ };
@@ -172,6 +191,16 @@ void handler_interface::initialize_callbacks(node_interface &cor)
     cor.initialize_callbacks(hcb, bcb, tcb, eomcb, ecb, rccb);
 }
 
+bool handler_interface::on_write_chunks( std::vector<dstring>& chunks )
+{
+	dstring chunk;
+	if ( !on_write( chunk ) )
+		return false;
+	if ( chunk )
+		chunks.push_back( std::move( chunk ) );
+	return true;
+}
+
 void handler_interface::connector( connector_interface * conn )
 {
 	LOGTRACE("handler_interface::connector ", conn );
@@ -201,9 +230,119 @@ std::function<std::unique_ptr<node_interface>()> handler_interface::make_chain =
 };
 	
 
+namespace
+{
+
+constexpr size_t chain_pool_size{64};
+
+// Bumped when make_chain changes: pooled chains of the old kind are dropped
+std::atomic<size_t> chain_generation{0};
+
+chain_registry registry;
+
+struct chain_pool
+{
+	// Indexed by the kind of chain, its index in the registry
+	std::vector<std::vector<std::unique_ptr<node_interface>>> ready;
+	// Selectors do not depend on make_chain: they outlive its generations
+	std::vector<std::unique_ptr<node_interface>> selectors;
+	size_t generation{0};
+
+	std::vector<std::unique_ptr<node_interface>>& of( size_t kind )
+	{
+		auto current = chain_generation.load(std::memory_order_relaxed);
+		if ( generation != current )
+		{
+			ready.clear();
+			generation = current;
+		}
+		if ( ready.size() <= kind )
+			ready.resize( kind + 1 );
+		ready[kind].reserve( chain_pool_size );
+		return ready[kind];
+	}
+};
+
+thread_local chain_pool pool;
+
+// Forgets the transaction that was using a chain
+void forget( node_interface& chain ) noexcept
+{
+	chain.initialize_callbacks( []( http::http_response&& ){}, []( dstring&& ){}, []( dstring&&, dstring&& ){},
+		[](){}, []( const errors::error_code& ){}, [](){} );
+	chain.reset();
+}
+
+}
+
 void handler_interface::chain_initializer( std::function<std::unique_ptr<node_interface>()> newfunc )
 {
 	make_chain = newfunc;
+	chain_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+chain_registry& handler_interface::chains() noexcept
+{
+	return registry;
+}
+
+std::unique_ptr<node_interface> handler_interface::acquire_chain()
+{
+	// Routes are set up at start: the chain is chosen when the preamble is known
+	if ( registry.routing() )
+	{
+		auto& selectors = pool.selectors;
+		if ( ! selectors.empty() )
+		{
+			auto s = std::move( selectors.back() );
+			selectors.pop_back();
+			return s;
+		}
+		selectors.reserve( chain_pool_size );
+		utils::arena::scope heap{nullptr};
+		return std::unique_ptr<node_interface>{ new chain_selector{ registry } };
+	}
+	return acquire_chain( chain_registry::default_chain );
+}
+
+std::unique_ptr<node_interface> handler_interface::acquire_chain( size_t kind )
+{
+	auto& ready = pool.of( kind );
+	if ( ! ready.empty() )
+	{
+		auto c = std::move( ready.back() );
+		ready.pop_back();
+		return c;
+	}
+	// Pooled chains outlive the transaction: keep them out of its arena
+	utils::arena::scope heap{nullptr};
+	return registry.make( kind );
+}
+
+void handler_interface::release_chain( std::unique_ptr<node_interface> chain ) noexcept
+{
+	if ( ! dynamic_cast<chain_selector*>( chain.get() ) )
+		return release_chain( chain_registry::default_chain, std::move( chain ) );
+
+	// Its chain goes back to the pool of its kind when the selector is reset
+	auto& selectors = pool.selectors;
+	if ( selectors.size() == selectors.capacity() )
+		return;
+	forget( *chain );
+	selectors.push_back( std::move( chain ) );
+}
+
+void handler_interface::release_chain( size_t kind, std::unique_ptr<node_interface> chain ) noexcept
+{
+	if ( ! chain || pool.generation != chain_generation.load(std::memory_order_relaxed) || pool.ready.size() <= kind )
+		return;
+	// Capacity is reserved on acquire: releasing never allocates
+	auto& ready = pool.ready[kind];
+	if ( ready.size() == ready.capacity() )
+		return;
+
+	forget( *chain );
+	ready.push_back( std::move( chain ) );
 }
 
 } //namespace
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <functional>
+#include <vector>
 #include <boost/asio.hpp>
 #include <openssl/ssl.h>
 
@@ -18,6 +19,8 @@ namespace http
 namespace server
 {
 
+class chain_registry;
+
 constexpr const size_t MAXINBYTESPERLOOP{8192};
 
 enum handler_type
@@ -55,8 +58,15 @@ public :
 
 	virtual bool start() noexcept = 0;
 	virtual bool should_stop() const noexcept = 0;
+	/** False while the handler cannot take more input; it asks for a read once it can. */
+	virtual bool should_read() const noexcept { return true; }
 	virtual bool on_read(const char*, size_t) = 0;
 	virtual bool on_write(dstring& chunk) = 0;
+	/**
+	 * @brief Gathers all that is ready to be sent, to be written at once;
+	 * by default it is the chunk of on_write.
+	 */
+	virtual bool on_write_chunks(std::vector<dstring>& chunks);
 
 	virtual void on_eom() = 0;
 	virtual void on_error(const int &) = 0;
@@ -64,6 +74,16 @@ public :
 	static std::function<std::unique_ptr<node_interface>()> make_chain;
 	
 	static void chain_initializer( std::function<std::unique_ptr<node_interface>()> );
+
+	/** Chains selectable per virtual host; routes are to be set before serving requests. */
+	static chain_registry& chains() noexcept;
+
+	/** A ready chain, taken from the ones released in this thread when possible. */
+	static std::unique_ptr<node_interface> acquire_chain();
+	static std::unique_ptr<node_interface> acquire_chain( size_t kind );
+	/** Resets a chain no longer used and keeps it for the next transaction of this thread. */
+	static void release_chain( std::unique_ptr<node_interface> chain ) noexcept;
+	static void release_chain( size_t kind, std::unique_ptr<node_interface> chain ) noexcept;
 };
 
 class handler_factory
@@ -72,6 +92,11 @@ public:
 	void register_protocol_selection_callbacks(SSL_CTX* ctx);
 	handler_interface* negotiate_handler(const SSL* ssl) const noexcept;
 	handler_interface* build_handler(handler_type, http::proto_version vers = http::proto_version::UNSET) const noexcept;
+	/** For connections without TLS: HTTP/2 is told from HTTP/1.x by its preface, if it can be served. */
+	handler_interface* build_cleartext_handler() const noexcept;
+
+	/** Whether HTTP/2 is spoken without TLS, with prior knowledge or upgrading from HTTP/1.1. */
+	static bool cleartext_http2() noexcept;
 };
 
 } //namespace
@@ -4,15 +4,46 @@
 #include "../utils/log_wrapper.h"
 #include "../log/inspector_serializer.h"
 #include "../service_locator/service_locator.h"
+#include "../configuration/configuration_wrapper.h"
+#include "../http2/session.h"
+#include "../utils/dstring_factory.h"
 
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <strings.h>
 #include <typeinfo>
 
 namespace server
 {
 
+namespace
+{
+
+// A token of a comma separated list, ignoring case
+bool has_token( const dstring& list, const char* token ) noexcept
+{
+	const size_t len = std::strlen( token );
+	const char* it = list.cbegin();
+	while ( it < list.cend() )
+	{
+		while ( it < list.cend() && ( *it == ' ' || *it == '\t' || *it == ',' ) ) ++it;
+		const char* end = std::find( it, list.cend(), ',' );
+		const char* last = end;
+		while ( last > it && ( last[-1] == ' ' || last[-1] == '\t' ) ) --last;
+		if ( static_cast<size_t>( last - it ) == len && strncasecmp( it, token, len ) == 0 )
+			return true;
+		it = end;
+	}
+	return false;
+}
+
+}
+
 handler_http1::handler_http1(http::proto_version version)
 	: ne(*this)
 	, version{version}
+	, buffer_limit{service::locator::configuration().get_pipeline_buffer_size()}
 {
 	LOGINFO("HTTP1 selected");
 }
@@ -26,7 +57,10 @@ bool handler_http1::start() noexcept
 {
 	auto scb = [this](http::http_structured_data** data)
 	{
-		th.emplace_back(std::move(handler_interface::make_chain()), this, connector()->is_ssl() );
+		// The request is built in the arena of the transaction, the chain comes from the pool
+		utils::arena mem;
+		mem.use();
+		th.emplace_back(std::move(mem), handler_interface::acquire_chain(), this, connector()->is_ssl() );
 		*data = &(th.back().get_data());
 		(*data)->origin( find_origin() );
 	};
@@ -37,6 +71,11 @@ bool handler_http1::start() noexcept
 		auto&& data = current_transaction.get_data();
 		persistent_connection = current_transaction.persistent = data.keepalive();
 		version = (version == http::proto_version::UNSET) ? data.protocol_version() : version;
+		if(asks_upgrade(data))
+		{
+			upgrade_requested = true;
+			return;
+		}
 		current_transaction.on_request_preamble(std::move(data));
 	};
 
@@ -57,6 +96,10 @@ bool handler_http1::start() noexcept
 
 	auto ccb = [this]()
 	{
+		// HTTP/2 frames follow
+		if(upgrade_requested)
+			return decoder.stop_after_message();
+
 		auto&& current_transaction = th.back();
 		// the request is complete
 		current_transaction.on_request_finished();
@@ -126,19 +169,97 @@ bool handler_http1::should_stop() const noexcept
 bool handler_http1::on_read(const char* data, size_t len)
 {
 	LOGTRACE(this, " Received chunk of size:", len);
-	auto rv = decoder.decode(data, len);
+	bool rv;
+	{
+		// What the codec builds goes to the arena of the request being read; every new request switches to its own
+		utils::arena::scope use{nullptr};
+		if(!th.empty() && !th.back().request_is_finished)
+			th.back().memory().use();
+		rv = decoder.decode(data, len);
+	}
+	if(rv && upgrade_requested)
+		return upgrade(data + decoder.decoded(), len - decoder.decoded());
 	connector()->_rb.consume(data + len );
 	return rv;
 }
 
+bool handler_http1::asks_upgrade(const http::http_request& request) const noexcept
+{
+	// RFC 7540, 3.2; requests with a body are served as they are: it would have to be replayed on stream 1
+	if(connector()->is_ssl() || !handler_factory::cleartext_http2() || request.protocol_version() != http::proto_version::HTTP11
+		|| request.chunked() || request.content_len() || !request.headers().count("http2-settings")
+		|| !has_token(request.header("upgrade"), "h2c") || !has_token(request.header(http::hf_connection), "upgrade"))
+		return false;
+
+	// The session must be the only one writing from now on
+	return std::all_of(th.begin(), std::prev(th.end()), [](const transaction_handler& t){ return t.disposable(); });
+}
+
+bool handler_http1::upgrade(const char* rest, size_t len)
+{
+	upgrade_requested = false;
+	auto conn = connector();
+	auto&& transaction = th.back();
+	auto&& request = transaction.get_data();
+
+	auto session = new http2::session();
+	conn->handler(session);
+	if(!session->upgrade(std::move(request)))
+	{
+		LOGDEBUG(this, " h2c upgrade refused, going on with HTTP/1.1");
+		conn->handler(this);
+		session->connector(nullptr);
+		utils::arena::scope use{transaction.memory()};
+		transaction.on_request_preamble(std::move(request));
+		transaction.on_request_finished();
+		return on_read(rest, len);
+	}
+
+	LOGDEBUG(this, " upgraded to h2c");
+	transaction.upgraded();
+	delete this;
+	if(len)
+		return session->on_read(rest, len);
+	conn->_rb.consume(rest);
+	return true;
+}
+
+bool handler_http1::should_read() const noexcept
+{
+	// Pipelined requests keep being dispatched until their responses, waiting
+	// for the ones before them to be written, fill the buffer
+	return buffered <= buffer_limit;
+}
+
 bool handler_http1::on_write(dstring& data)
+{
+	std::vector<dstring> chunks;
+	if(!on_write_chunks(chunks))
+		return false;
+	if(chunks.size() == 1)
+		data = std::move(chunks.front());
+	else if(chunks.size())
+		data = dstring_factory::join(chunks);
+	return true;
+}
+
+bool handler_http1::on_write_chunks(std::vector<dstring>& chunks)
 {
 	if(connector())
 	{
-		if(!th.empty() && th.front().has_encoded_data())
-			data = std::move( th.front().get_encoded_data() );
-		else if(!th.empty() && th.front().disposable())
+		// Responses go out in the order of the requests
+		while(!th.empty() && th.front().disposable())
 			th.pop_front();
+		if(!th.empty() && th.front().has_encoded_data())
+		{
+			auto encoded = th.front().get_encoded_data();
+			// The connector may still hold them when the transaction and its arena are gone
+			utils::arena::scope heap{nullptr};
+			std::copy(encoded.begin(), encoded.end(), std::back_inserter(chunks));
+		}
+
+		if(should_read())
+			connector()->do_read();
 		return true;
 	}
 	return false;
@@ -150,8 +271,7 @@ void handler_http1::transaction_handler::on_header(http::http_response&& preambl
 	LOGTRACE(this," transaction_handler::on_header");
 	message_started = true;
 	preamble.keepalive(persistent);
-	encoded_data.append(encoder.encode_header(preamble));
-	enclosing->notify_write();
+	encoded(encoder.encode_header(preamble));
 }
 
 void handler_http1::transaction_handler::on_body(dstring&& chunk)
@@ -160,8 +280,7 @@ void handler_http1::transaction_handler::on_body(dstring&& chunk)
 	assert(chunk.size());
 	if ( service::locator::inspector_log().active() ) access.append_response_body( chunk );
 	access.add_request_size(chunk.size());
-	encoded_data.append(encoder.encode_body(chunk));
-	enclosing->notify_write();
+	encoded(encoder.encode_body(chunk));
 }
 
 void handler_http1::transaction_handler::on_trailer(dstring&& k, dstring&& v)
@@ -169,16 +288,14 @@ void handler_http1::transaction_handler::on_trailer(dstring&& k, dstring&& v)
 	LOGTRACE(this," transaction_handler::on_trailer");
 	assert( k.size() && v.size() );
 	if ( service::locator::inspector_log().active() ) access.append_response_trailer(k, v);
-	encoded_data.append(encoder.encode_trailer(k,v));
-	enclosing->notify_write();
+	encoded(encoder.encode_trailer(k,v));
 }
 
 void handler_http1::transaction_handler::on_eom()
 {
 	LOGTRACE(this," transaction_handler::on_eom");
 	access.set_request_end();
-	encoded_data.append(encoder.encode_eom());
-	enclosing->notify_write();
+	encoded(encoder.encode_eom());
 	message_ended = true;
 	enclosing->on_eom();
 }
@@ -220,9 +337,8 @@ void handler_http1::transaction_handler::on_response_continue()
 	continue_response.status(100);  //continue code
 	continue_response.protocol(http::proto_version::HTTP11);
 	continue_response.keepalive(persistent);
-	encoded_data.append(encoder.encode_header(continue_response));
-	encoded_data.append(encoder.encode_eom());
-	enclosing->notify_write();
+	encoded(encoder.encode_header(continue_response));
+	encoded(encoder.encode_eom());
 }
 
 void handler_http1::transaction_handler::on_error(const int &ec)
@@ -231,7 +347,7 @@ void handler_http1::transaction_handler::on_error(const int &ec)
 	access.error( ec );
 	access.commit();
 	message_ended = true;
-	encoded_data = {};
+	get_encoded_data();
 	enclosing->on_error(ec);
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "../http/http_codec.h"
 #include "../http/http_structured_data.h"
 #include "../errors/error_factory_async.h"
@@ -9,6 +10,7 @@
 
 #include "handler_factory.h"
 #include "../utils/log_wrapper.h"
+#include "../utils/arena.h"
 #include "../chain_of_responsibility/node_interface.h"
 #include "../chain_of_responsibility/chain_of_responsibility.h"
 #include "../chain_of_responsibility/callback_initializer.h"
@@ -42,13 +44,20 @@ class handler_http1 : public handler_interface
 	node_erased ne;
 	std::shared_ptr<errors::error_factory_async> efa;
 	http::proto_version version{http::proto_version::UNSET};
+	// Encoded response bytes not yet handed to the connector
+	size_t buffered{0};
+	const size_t buffer_limit;
+	// The last request asked for h2c: it is served by the HTTP/2 session
+	bool upgrade_requested{false};
 public:
 	handler_http1(http::proto_version version);
 
 	bool start() noexcept override;
 	bool should_stop() const noexcept override;
+	bool should_read() const noexcept override;
 	bool on_read(const char*, size_t) override;
 	bool on_write(dstring&) override;
+	bool on_write_chunks(std::vector<dstring>&) override;
 
 	void on_eom() override;
 	void on_error(const int&) override;
@@ -58,9 +67,15 @@ protected:
 	void on_connector_nulled() override;
 private:
 	bool some_message_started( http::proto_version& proto ) const noexcept;
+	bool asks_upgrade( const http::http_request& request ) const noexcept;
+	bool upgrade( const char* rest, size_t len );
 	class transaction_handler
 	{
-		dstring encoded_data;
+		// First in, last out: whatever follows may have been allocated in it
+		utils::arena mem;
+		/** Bodies are kept as they come, to be written without copying them; small chunks are joined */
+		std::vector<dstring> encoded_data;
+		static constexpr size_t join_limit{4096};
 		http::http_request data;
 		http::http_response continue_response;
 		handler_http1 *enclosing = nullptr;
@@ -75,8 +90,9 @@ private:
 		bool request_is_finished{false};
 		std::unique_ptr<node_interface> cor;
 
-		transaction_handler(std::unique_ptr<node_interface> managed_cor, handler_http1 *enclosing, bool ssl)
-			: data{ssl}
+		transaction_handler(utils::arena&& arena, std::unique_ptr<node_interface> managed_cor, handler_http1 *enclosing, bool ssl)
+			: mem{std::move(arena)}
+			, data{ssl}
 			, enclosing{enclosing}
 			, cor{std::move(managed_cor)}
 		{
@@ -88,25 +104,43 @@ private:
 		~transaction_handler() noexcept
 		{
 			access.commit();
+			handler_interface::release_chain(std::move(cor));
 		}
 
 		bool has_encoded_data() const noexcept
 		{
-			return encoded_data;
+			return !encoded_data.empty();
 		}
 
-		dstring get_encoded_data()
+		std::vector<dstring> get_encoded_data()
 		{
-			dstring tmp;
+			std::vector<dstring> tmp;
 			std::swap(encoded_data, tmp);
+			for(auto &chunk : tmp)
+				enclosing->buffered -= chunk.size();
 			return tmp;
 		}
 
+		void encoded(dstring chunk)
+		{
+			enclosing->buffered += chunk.size();
+			if(encoded_data.size() && encoded_data.back().size() < join_limit && chunk.size() < join_limit)
+				encoded_data.back().append(chunk);
+			else if(chunk)
+				encoded_data.push_back(std::move(chunk));
+			enclosing->notify_write();
+		}
+
 		http::http_request& get_data() noexcept
 		{
 			return data;
 		}
 
+		utils::arena& memory() noexcept
+		{
+			return mem;
+		}
+
 		void on_request_preamble(http::http_request&& message);
 		void on_request_body(dstring&& c) { access.append_response_body(c); cor->on_request_body(std::move(c)); }
 		void on_request_finished() { request_is_finished = true; cor->on_request_finished(); }
@@ -123,6 +157,8 @@ private:
 		void on_response_continue();
 		void on_request_canceled(const errors::error_code &ec);
 		bool disposable() const noexcept { return encoded_data.empty() && message_ended && request_is_finished; }
+		/** The request goes on as stream 1 of an HTTP/2 session, which logs it. */
+		void upgraded() noexcept { access.discard(); }
 	};
 
 	std::list<transaction_handler> th;
@@ -1,15 +1,14 @@
 #include <boost/regex.hpp>
 #include "cache_cleaner.h"
 #include "../constants.h"
-#include "../cache/cache.h"
-#include "../configuration/configuration_wrapper.h"
-#include "../cache/policies/fifo.h"
+#include "../utils/utils.h"
+#include "cache_manager/configured_cache.h"
 
 namespace nodes
 {
 
 	const static boost::regex rgx_simple_clear{"/cache/clear"};
-	const static boost::regex rgx_clear_tag{"/cache/tag/([[:word:]]+)/clear"};
+	const static boost::regex rgx_clear_tag{"/cache/tag/([[:word:].-]+)/clear"};
 	void cache_cleaner::on_request_preamble(http::http_request &&req)
 	{
 		if(req.method_code() != http_method::HTTP_POST) return base::on_request_preamble(std::move(req));
@@ -19,15 +18,13 @@ namespace nodes
 		if(boost::regex_match(path.cbegin(), path.cend(), simple, rgx_simple_clear))
 		{
 			matched = true;
-			auto cache_ptr = cache<fifo_policy>::get_instance(UINT32_MAX, service::locator::configuration().cache_path()).get();
-			freed = cache_ptr->clear_all();
+			freed = configured_cache::instance().clear_all();
 			return;
 		}
 		if(boost::regex_match(path.cbegin(), path.cend(), tag, rgx_clear_tag))
 		{
 			matched = true;
-			auto cache_ptr = cache<fifo_policy>::get_instance(UINT32_MAX, service::locator::configuration().cache_path()).get();
-			freed = cache_ptr->clear_tag(tag[1]);
+			freed = configured_cache::instance().clear_tag(tag[1]);
 			return;
 		}
 
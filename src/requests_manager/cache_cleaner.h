@@ -12,6 +12,7 @@ public:
 
 	void on_request_preamble(http::http_request &&req);
 	void on_request_finished();
+	void reset() { matched = false; freed = 0; }
 private:
 	void generate_successful_response();
 	bool matched{false};
@@ -0,0 +1,122 @@
+#include "byte_range.h"
+
+#include <algorithm>
+
+namespace nodes
+{
+	constexpr uint64_t byte_range::slice_size;
+	constexpr uint64_t byte_range::unbounded;
+
+	namespace
+	{
+		/** Reads a number, failing on overflow; the position is moved past its digits */
+		bool read_number(const std::string &value, size_t &position, uint64_t &number)
+		{
+			size_t begin = position;
+			number = 0;
+			while(position < value.size() && value[position] >= '0' && value[position] <= '9')
+			{
+				uint64_t digit = value[position++] - '0';
+				if(number > (UINT64_MAX - digit) / 10) return false;
+				number = number * 10 + digit;
+			}
+			return position != begin;
+		}
+
+		bool read(const std::string &value, size_t &position, char expected)
+		{
+			if(position == value.size() || value[position] != expected) return false;
+			++position;
+			return true;
+		}
+
+		void skip_spaces(const std::string &value, size_t &position)
+		{
+			while(position < value.size() && (value[position] == ' ' || value[position] == '\t')) ++position;
+		}
+	}
+
+	bool byte_range::parse(const std::string &value, byte_range &range)
+	{
+		static const std::string unit{"bytes="};
+		if(value.compare(0, unit.size(), unit) != 0) return false;
+		size_t position = unit.size();
+		skip_spaces(value, position);
+
+		byte_range parsed;
+		if(read(value, position, '-'))
+		{
+			if(!read_number(value, position, parsed.suffix) || !parsed.suffix) return false;
+		}
+		else
+		{
+			if(!read_number(value, position, parsed.first) || !read(value, position, '-')) return false;
+			if(position < value.size() && value[position] != ' ')
+			{
+				if(!read_number(value, position, parsed.last) || parsed.last < parsed.first) return false;
+			}
+		}
+		skip_spaces(value, position);
+		if(position != value.size()) return false;
+		range = parsed;
+		return true;
+	}
+
+	bool byte_range::parse_content_range(const std::string &value, byte_range &range, uint64_t &total)
+	{
+		static const std::string unit{"bytes "};
+		if(value.compare(0, unit.size(), unit) != 0) return false;
+		size_t position = unit.size();
+
+		byte_range sent{range};
+		if(!read(value, position, '*'))
+		{
+			if(!read_number(value, position, sent.first) || !read(value, position, '-') ||
+				!read_number(value, position, sent.last) || sent.last < sent.first) return false;
+		}
+		if(!read(value, position, '/') || !read_number(value, position, total) || position != value.size())
+			return false;
+		if(sent.last != unbounded && sent.last >= total) return false;
+		range = sent;
+		return true;
+	}
+
+	bool byte_range::resolve(uint64_t total, byte_range &resolved) const noexcept
+	{
+		resolved = byte_range{};
+		if(suffix)
+		{
+			resolved.first = total - std::min(suffix, total);
+			resolved.last = total - 1;
+		}
+		else
+		{
+			resolved.first = first;
+			resolved.last = std::min(last, total - 1);
+		}
+		return total && resolved.first < total;
+	}
+
+	uint64_t byte_range::slice_length(uint64_t index, uint64_t total) noexcept
+	{
+		uint64_t begin = index * slice_size;
+		return begin < total ? std::min(slice_size, total - begin) : 0;
+	}
+
+	std::string byte_range::content_range(uint64_t total) const
+	{
+		return "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(total);
+	}
+
+	std::string byte_range::unsatisfied(uint64_t total)
+	{
+		return "bytes */" + std::to_string(total);
+	}
+
+	std::string byte_range::header() const
+	{
+		std::string value = "bytes=" + std::to_string(first) + "-";
+		if(last != unbounded) value += std::to_string(last);
+		return value;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef DOORMAT_BYTE_RANGE_H
+#define DOORMAT_BYTE_RANGE_H
+
+#include <cstdint>
+#include <string>
+
+namespace nodes
+{
+
+/** \brief a single range of bytes asked by a client with the range header: "bytes=first-last", "bytes=first-" or
+ * "bytes=-suffix". Contents asked by range are cached as slices of slice_size bytes, so that a range is served
+ * from the slices it spans and only the missing ones are asked to the board.
+ * */
+struct byte_range
+{
+	/** Big enough for full slices to be mapped from the disk */
+	static constexpr uint64_t slice_size = 1024 * 1024;
+	static constexpr uint64_t unbounded = UINT64_MAX;
+
+	/** first and last byte of the range, both included */
+	uint64_t first{0};
+	uint64_t last{unbounded};
+	/** number of bytes at the end of the content, for "bytes=-suffix"; 0 otherwise */
+	uint64_t suffix{0};
+
+	/** Reads the value of a range header; sets of ranges are not supported
+	 * \return false if the value is not a single range of bytes
+	 * */
+	static bool parse(const std::string &value, byte_range &range);
+
+	/** Reads the value of a content-range header, "bytes first-last/total", or the total alone
+	 * when no range is sent
+	 * \param range filled with the range sent; left as it is when only the total is sent
+	 * \param total the size of the whole content
+	 * \return false if the value cannot be read or the size of the content is unknown
+	 * */
+	static bool parse_content_range(const std::string &value, byte_range &range, uint64_t &total);
+
+	/** Refers the range to a content of known size; the range itself is left as it was asked
+	 * \param resolved filled with the bytes of the content the range is made of
+	 * \return false if the range cannot be satisfied
+	 * */
+	bool resolve(uint64_t total, byte_range &resolved) const noexcept;
+
+	uint64_t size() const noexcept { return last - first + 1; }
+	uint64_t first_slice() const noexcept { return first / slice_size; }
+	uint64_t last_slice() const noexcept { return last / slice_size; }
+	/** \return the size of a slice of a content, smaller than slice_size for its last one */
+	static uint64_t slice_length(uint64_t index, uint64_t total) noexcept;
+
+	/** \return the value of the content-range header of a response carrying the range */
+	std::string content_range(uint64_t total) const;
+	/** \return the value of the content-range header of a response saying that a range cannot be satisfied */
+	static std::string unsatisfied(uint64_t total);
+	/** \return the value of the range header asking this range */
+	std::string header() const;
+};
+
+}
+
+#endif //DOORMAT_BYTE_RANGE_H
@@ -2,10 +2,14 @@
 #include "../../configuration/configuration_wrapper.h"
 #include "request_elaborations/gzip.h"
 #include "../../stats/stats_manager.h"
+#include "../../errors/internal_error.h"
+#include "../../errors/error_codes.h"
+#include "../../utils/log_wrapper.h"
+
+#include <algorithm>
 
 namespace nodes
 {
-	//cache<fifo_policy> cache_manager::global_cache(UINT32_MAX, service::locator::configuration().cache_path()); //static cache used by everybody.
 	boost::regex cache_manager::nocache{"no-cache|no-store"}; //
 	boost::regex cache_manager::maxage{"[s-]?max[-]?age\\s?=\\s?(\\d+)"}; //
 
@@ -25,19 +29,25 @@ namespace nodes
 			if ((mc == http_method::HTTP_POST || mc == http_method::HTTP_PUT ||
 				  mc == http_method::HTTP_DELETE || mc == http_method::HTTP_PATCH))
 			{
-				global_cache = cache<fifo_policy>::get_instance(UINT32_MAX, service::locator::configuration().cache_path()).get();
-				key = cache_request_processor::get_cache_key(preamble);
-				global_cache->invalidate(key);
+				global_cache = &configured_cache::instance();
+				invalidate(*global_cache, preamble);
 			}
 			return node_interface::on_request_preamble(std::move(preamble));
 		}
 		mc = preamble.method_code();
 		is_cacheable = true;
-		global_cache = cache<fifo_policy>::get_instance(UINT32_MAX, service::locator::configuration().cache_path()).get();
+		global_cache = &configured_cache::instance();
 		key = cache_request_processor::get_cache_key(preamble);
 		LOGTRACE("[Cache] request key is ", key);
+		// with if-range the whole content can be sent instead
+		ranged = preamble.has("range") && !preamble.has("if-range") &&
+			byte_range::parse(std::string(preamble.header("range")), range);
 		is_in_cache = global_cache->has(key);
-		if (!is_in_cache) return node_interface::on_request_preamble(std::move(preamble));
+		if (!is_in_cache)
+		{
+			if (ranged) return slice_request(std::move(preamble));
+			return node_interface::on_request_preamble(std::move(preamble));
+		}
 
 		not_modified = check_not_modified(preamble);
 		if (not_modified) return;
@@ -45,18 +55,61 @@ namespace nodes
 		/** Verification on the max requested age of the content.*/
 		auto age = global_cache->get_age(key);
 		is_in_cache = !cache_request_processor::is_stale(preamble, age);
-		if(!is_in_cache) return node_interface::on_request_preamble(std::move(preamble));
+		if(!is_in_cache)
+		{
+			if (ranged) return slice_request(std::move(preamble));
+			return node_interface::on_request_preamble(std::move(preamble));
+		}
+
+		retrieve_content();
+	}
 
+
+	void cache_manager::reset()
+	{
+		is_in_cache = false;
+		putting = false;
+		request_finished = false;
+		data_retrieved = false;
+		not_modified = false;
+		response_finished = false;
+		is_cacheable = false;
+		ranged = false;
+		slicing = false;
+		head_found = false;
+		slices_retrieved = false;
+		retrieving = false;
+		satisfiable = true;
+		slices_cacheable = false;
+		key.clear();
+		data = dstring{};
+		ttl = 0;
+		encoder = cached_response{};
+		cache_response = http::http_response{};
+		mc = http_method::END;
+		range = byte_range{};
+		resolved = byte_range{};
+		span = byte_range{};
+		total = 0;
+		position = 0;
+		version.clear();
+		slices_tag.clear();
+		creation_time = std::chrono::system_clock::time_point{};
+		putting_slice.clear();
+		slices.clear();
+		request = http::http_request{};
+	}
+
+	void cache_manager::retrieve_content()
+	{
 		//take a shortcut; start to ask for data awaiting for "on request finished" event.
-		global_cache->get(key, [this](std::vector<uint8_t> d)
+		global_cache->get(key, [this](dstring d)
 		{
 			LOGTRACE("[Cache] data has been retrieved!");
 			data = std::move(d);
 			data_retrieved = true;
 			manage_retrieved_content();
 		});
-
-		return;
 	}
 
 
@@ -75,6 +128,13 @@ namespace nodes
 			manage_retrieved_content();
 			return;
 		}
+
+		if (slicing)
+		{
+			request_finished = true;
+			manage_slices();
+			return;
+		}
 		node_interface::on_request_finished();
 	}
 
@@ -111,6 +171,7 @@ namespace nodes
 	void cache_manager::on_header(http::http_response &&response)
 	{
 		assert(!is_in_cache);
+		if (slicing) return sliced_header(std::move(response));
 
 		LOGDEBUG("status: cacheable", (mc == HTTP_GET), " response allows: ", response_filter(response));
 		if (is_cacheable && response_filter(response))
@@ -119,11 +180,7 @@ namespace nodes
 			ttl = cache_request_processor::get_response_max_age(response, 3600);
 			std::string tag = calculate_tag(response);
 			std::string etag = (response.has("etag")) ? response.header("etag") : "";
-			std::chrono::system_clock::time_point creation_time = (response.has("age")) ?
-																  std::chrono::system_clock::now() -
-																  std::chrono::seconds(std::stoi(
-																		  std::string(response.header("age"))))
-																						: std::chrono::system_clock::now();
+			auto creation_time = calculate_creation_time(response);
 			//refines the cache key depending on the status of the response.
 			key = cache_request_processor::refine_cache_key(response, key);
 			putting = global_cache->begin_put(key, ttl, creation_time, tag, etag);
@@ -140,6 +197,7 @@ namespace nodes
 	void cache_manager::on_body(dstring &&body)
 	{
 		assert(!is_in_cache);
+		if (slicing) return sliced_body(std::move(body));
 		if (putting)
 			global_cache->put(key, encoder.encode_body(body));
 		return node_interface::on_body(std::move(body));
@@ -149,8 +207,10 @@ namespace nodes
 	void cache_manager::on_trailer(dstring &&k, dstring &&v)
 	{
 		assert(!is_in_cache);
+		// a range is sent with its length: trailers are left out
+		if (slicing) return;
 		if (putting)
-			global_cache->put(key, encoder.encode_trailer(k, v));
+			encoder.encode_trailer(k, v);
 		return node_interface::on_trailer(std::move(k), std::move(v));
 	}
 
@@ -158,6 +218,7 @@ namespace nodes
 	void cache_manager::on_end_of_message()
 	{
 		assert(!is_in_cache);
+		if (slicing) return sliced_end_of_message();
 		if (putting)
 		{
 			global_cache->put(key, encoder.encode_eom());
@@ -170,17 +231,19 @@ namespace nodes
 	{
 		assert(!is_in_cache);
 		if (putting) global_cache->end_put(key, false);
+		if (!putting_slice.empty()) global_cache->end_put(putting_slice, false);
 		node_interface::on_error(ec);
 	}
 
 	/** fixme: with this process we scan for information twice, once to check for validity and the other time
 	 * to extract informations.*/
-	uint32_t cache_manager::response_filter(const http::http_response &response)
+	uint32_t cache_manager::response_filter(const http::http_response &response, bool partial)
 	{
 		if (response.has("authorization")) return false;
 		auto code = response.status_code();
 		LOGTRACE("[cache] response status code is ", code);
-		if (code != 200 && code != 203 && code != 300 && code != 301 && code != 410) return false;
+		if (code != 200 && code != 203 && code != 300 && code != 301 && code != 410 && !(partial && code == 206))
+			return false;
 		//HTTP 1.0 backwards compatibility
 
 		if (response.has("pragma"))
@@ -230,6 +293,13 @@ namespace nodes
 
 	std::string cache_manager::calculate_tag(const http::http_response &response)
 	{
+		if (response.has("surrogate-key"))
+		{
+			//an element has one tag only: the first surrogate key is used.
+			std::string keys(response.header("surrogate-key"));
+			auto begin = keys.find_first_not_of(' ');
+			if (begin != std::string::npos) return keys.substr(begin, keys.find(' ', begin) - begin);
+		}
 		if (!response.has("content-type")) return {};
 		auto content_type = response.header("content-type");
 		if (content_type.find("html") != std::string::npos) return "html";
@@ -239,6 +309,71 @@ namespace nodes
 	}
 
 
+	std::chrono::system_clock::time_point cache_manager::calculate_creation_time(const http::http_response &response)
+	{
+		auto now = std::chrono::system_clock::now();
+		if (!response.has("age")) return now;
+		return now - std::chrono::seconds(std::stoi(std::string(response.header("age"))));
+	}
+
+
+	std::string cache_manager::calculate_version(const http::http_response &response)
+	{
+		// weak etags cannot be used with if-range
+		if (response.has("etag"))
+		{
+			std::string etag = response.header("etag");
+			if (etag.compare(0, 2, "W/") != 0) return etag;
+		}
+		if (response.has("last-modified")) return response.header("last-modified");
+		return {};
+	}
+
+
+	void cache_manager::invalidate(configured_cache &cache, const http::http_request &preamble)
+	{
+		auto key = cache_request_processor::get_cache_key(preamble);
+		cache.invalidate(key);
+		// slices are stored under the key of the request without accept-encoding, as contents sent uncompressed
+		http::http_request plain{preamble};
+		plain.remove_header(http::hf_accept_encoding);
+		auto plain_key = cache_request_processor::get_cache_key(plain);
+		if (plain_key != key) cache.invalidate(plain_key);
+
+		auto head = head_key(plain_key);
+		if (!cache.has(head)) return;
+		// the slices are found through the version and the size of the content kept by their head
+		cache.get(head, [&cache, plain_key, head](dstring d)
+		{
+			http::http_response response;
+			dstring body;
+			cached_response::trailers_t trailers;
+			byte_range unused;
+			uint64_t total{0};
+			if (cached_response::decode(d, response, body, trailers) &&
+				byte_range::parse_content_range(std::string(response.header("content-range")), unused, total))
+			{
+				auto version = calculate_version(response);
+				for (uint64_t index = 0; index * byte_range::slice_size < total; ++index)
+					cache.invalidate(slice_key(plain_key, version, index));
+			}
+			cache.invalidate(head);
+		});
+	}
+
+
+	std::string cache_manager::head_key(const std::string &key)
+	{
+		return key + "head$";
+	}
+
+
+	std::string cache_manager::slice_key(const std::string &key, const std::string &version, uint64_t index)
+	{
+		return key + "slice$" + version + "$" + std::to_string(index) + "$";
+	}
+
+
 	void cache_manager::generate304()
 	{
 		http::http_response response;
@@ -250,51 +385,331 @@ namespace nodes
 	}
 
 
+	void cache_manager::generate416(uint64_t size)
+	{
+		http::http_response response;
+		response.protocol(http::proto_version::HTTP11);
+		response.status(416);
+		response.header("content-range", byte_range::unsatisfied(size).c_str());
+		response.content_len(0);
+
+		node_interface::on_header(std::move(response));
+		node_interface::on_end_of_message();
+	}
+
+
 	void cache_manager::manage_retrieved_content()
 	{
 		if (request_finished && data_retrieved)
 		{
-			auto decoding_start_cb = [this](http::http_structured_data **data)
-			{ //we will need to assign to data the element that we want filled.
-				*data = &cache_response;
-			};
+			dstring body;
+			cached_response::trailers_t trailers;
+			if (!cached_response::decode(data, cache_response, body, trailers))
+			{
+				LOGERROR("[Cache] could not decode the content of ", key);
+				global_cache->invalidate(key);
+				response_finished = true;
+				return node_interface::on_error(INTERNAL_ERROR(errors::http_error_code::internal_server_error));
+			}
+			data = dstring{};
+
+			if (ranged && trailers.empty())
+			{
+				// the range is cut from the whole content; with trailers it is sent whole
+				if (!range.resolve(body.size(), resolved))
+				{
+					response_finished = true;
+					return generate416(body.size());
+				}
+				cache_response.status(206);
+				cache_response.header("content-range", resolved.content_range(body.size()).c_str());
+				cache_response.content_len(resolved.size());
+				body = body.slice(resolved.first, resolved.size());
+			}
 
-			auto headers_readed_cb = [this]()
-			{ //all headers have been decoded; add a cache management one and go on
-				cache_response.header("x-cache-status", "HIT");
-				service::locator::stats_manager().enqueue(stats::stat_type::cache_hits, 1);
-				node_interface::on_header(std::move(cache_response));
-			};
+			cache_response.header("x-cache-status", "HIT");
+			service::locator::stats_manager().enqueue(stats::stat_type::cache_hits, 1);
+			node_interface::on_header(std::move(cache_response));
+			if (body) node_interface::on_body(std::move(body));
+			for (auto &t : trailers)
+				node_interface::on_trailer(std::move(t.first), std::move(t.second));
+			response_finished = true;
+			node_interface::on_end_of_message();
+		}
+	}
+
+
+	void cache_manager::slice_request(http::http_request &&preamble)
+	{
+		// conditional requests and requests with a body are left to the board
+		if (preamble.has("if-none-match") || preamble.has("if-modified-since") || preamble.content_len() ||
+			preamble.chunked())
+		{
+			ranged = false;
+			return node_interface::on_request_preamble(std::move(preamble));
+		}
+		// slices are stored as sent by the board: ranges of a compressed content could not be served to everybody
+		preamble.remove_header(http::hf_accept_encoding);
+		key = cache_request_processor::get_cache_key(preamble);
+		// contents which are not compressed are stored whole under this key
+		if (global_cache->has(key) && !cache_request_processor::is_stale(preamble, global_cache->get_age(key)))
+		{
+			is_in_cache = true;
+			return retrieve_content();
+		}
+		request = std::move(preamble);
+		slicing = true;
 
-			auto body_received_cb = [this](dstring &&d)
+		auto head = head_key(key);
+		if (!global_cache->has(head) || cache_request_processor::is_stale(request, global_cache->get_age(head)))
+		{
+			slices_retrieved = true;
+			return;
+		}
+		global_cache->get(head, [this](dstring d)
+		{
+			dstring body;
+			cached_response::trailers_t trailers;
+			byte_range unused;
+			head_found = cached_response::decode(d, cache_response, body, trailers) &&
+				byte_range::parse_content_range(std::string(cache_response.header("content-range")), unused, total);
+			if (head_found) version = calculate_version(cache_response);
+			head_found = head_found && !version.empty();
+			if (!head_found)
+			{
+				slices_retrieved = true;
+				return manage_slices();
+			}
+			satisfiable = range.resolve(total, resolved);
+			if (!satisfiable)
 			{
-				assert(!response_finished);
-				node_interface::on_body(std::move(d));
-			};
+				slices_retrieved = true;
+				return manage_slices();
+			}
+			retrieve_slices();
+		});
+	}
+
 
-			auto trailer_received_callback = [this](dstring &&k, dstring &&v)
+	void cache_manager::retrieve_slices()
+	{
+		// slices held in memory or mapped from the disk are passed before get returns: they are retrieved by
+		// this loop, while the others continue it from their callback.
+		while (slices.size() < resolved.last_slice() - resolved.first_slice() + 1)
+		{
+			uint64_t index = resolved.first_slice() + slices.size();
+			retrieving = true;
+			global_cache->get(slice_key(key, version, index), [this, index](dstring d)
+			{
+				// a slice of the wrong size is as good as missing
+				if (d.size() != byte_range::slice_length(index, total)) d = dstring{};
+				slices.push_back(std::move(d));
+				if (retrieving) retrieving = false;
+				else retrieve_slices();
+			});
+			if (retrieving)
 			{
-				assert(!response_finished);
-				node_interface::on_trailer(std::move(k), std::move(v));
-			};
+				retrieving = false;
+				return;
+			}
+		}
+		slices_retrieved = true;
+		manage_slices();
+	}
 
-			auto codec_ccb = [this]()
+
+	void cache_manager::manage_slices()
+	{
+		if (!request_finished || !slices_retrieved) return;
+		if (head_found && !satisfiable)
+		{
+			response_finished = true;
+			return generate416(total);
+		}
+
+		auto missing = [](const dstring &slice) { return !slice; };
+		auto first_missing = std::find_if(slices.begin(), slices.end(), missing);
+		if (head_found && first_missing == slices.end())
+		{
+			cache_response.remove_header("content-range");
+			cache_response.header("content-range", resolved.content_range(total).c_str());
+			cache_response.content_len(resolved.size());
+			cache_response.header("x-cache-status", "HIT");
+			service::locator::stats_manager().enqueue(stats::stat_type::cache_hits, 1);
+			node_interface::on_header(std::move(cache_response));
+			send_slices(0, slices.size());
+			response_finished = true;
+			return node_interface::on_end_of_message();
+		}
+
+		if (!head_found && range.suffix)
+		{
+			// where the range begins is not known without the size of the content
+			slicing = false;
+		}
+		else
+		{
+			// the board is asked from the first missing slice to the last one; whole slices, so that they can
+			// be stored, and only if they still are the version of the cached ones.
+			const byte_range &asked = head_found ? resolved : range;
+			uint64_t first = asked.first_slice();
+			uint64_t last = asked.last_slice();
+			if (head_found)
 			{
-				assert(!response_finished);
-				response_finished = true;
-				node_interface::on_end_of_message();
-			};
+				last = first + (std::find_if(slices.rbegin(), slices.rend(), missing).base() - slices.begin()) - 1;
+				first += first_missing - slices.begin();
+			}
+			span.first = first * byte_range::slice_size;
+			if (head_found) span.last = std::min((last + 1) * byte_range::slice_size, total) - 1;
+			else if (range.last != byte_range::unbounded) span.last = (last + 1) * byte_range::slice_size - 1;
+			request.remove_header("range");
+			request.header("range", span.header().c_str());
+			if (head_found) request.header("if-range", version.c_str());
+			LOGTRACE("[Cache] asking ", span.header(), " of ", key);
+		}
+		node_interface::on_request_preamble(std::move(request));
+		node_interface::on_request_finished();
+	}
+
 
-			auto codec_fcb = [this](int err, bool &fatal)
+	void cache_manager::send_slices(uint64_t begin, uint64_t end)
+	{
+		for (uint64_t i = begin; i < end && i < slices.size(); ++i)
+		{
+			uint64_t slice_begin = (resolved.first_slice() + i) * byte_range::slice_size;
+			uint64_t first = std::max(resolved.first, slice_begin);
+			uint64_t last = std::min(resolved.last, slice_begin + slices[i].size() - 1);
+			node_interface::on_body(slices[i].slice(first - slice_begin, last - first + 1));
+		}
+	}
+
+
+	void cache_manager::store_slices(const dstring &chunk, uint64_t begin)
+	{
+		// a chunk can end a slice and start the next ones
+		uint64_t offset = 0;
+		while (offset < chunk.size() && begin + offset < total)
+		{
+			uint64_t at = begin + offset;
+			uint64_t index = at / byte_range::slice_size;
+			uint64_t slice_end = index * byte_range::slice_size + byte_range::slice_length(index, total);
+			uint64_t count = std::min(chunk.size() - offset, slice_end - at);
+			if (at == index * byte_range::slice_size)
+			{
+				// slices already cached are not put again
+				auto k = slice_key(key, version, index);
+				if (global_cache->begin_put(k, ttl, creation_time, slices_tag, version)) putting_slice = std::move(k);
+			}
+			if (!putting_slice.empty())
 			{
-				assert(false); //this should not happen.
-			};
+				if (!global_cache->put(putting_slice, std::string(chunk.cdata() + offset, count)))
+					putting_slice.clear();
+				else if (at + count == slice_end)
+				{
+					global_cache->end_put(putting_slice, true);
+					putting_slice.clear();
+				}
+			}
+			offset += count;
+		}
+	}
+
+
+	void cache_manager::sliced_header(http::http_response &&response)
+	{
+		byte_range sent;
+		uint64_t size{0};
+		auto code = response.status_code();
+		// the client is sent the length of its range: a range of the board tells it with its content-range
+		bool partial = code == 206 &&
+			byte_range::parse_content_range(std::string(response.header("content-range")), sent, size);
+		bool stored = true;
+		if (partial && sent.first == span.first && sent.last == std::min(span.last, size - 1) &&
+			(!head_found || size == total))
+		{
+			position = sent.first;
+		}
+		else if (partial && range.resolve(size, resolved) && sent.first <= resolved.first && resolved.last <= sent.last)
+		{
+			// another range holding the one of the client: it is cut to it, neither stored nor mixed with slices
+			position = sent.first;
+			stored = false;
+			slices.clear();
+			if (head_found && size != total) global_cache->invalidate(head_key(key));
+		}
+		else if (!response.chunked() && code == 200 && response.content_len())
+		{
+			// the whole content, e.g. because it changed: the cached slices are of another version
+			size = response.content_len();
+			position = 0;
+			slices.clear();
+			if (head_found) global_cache->invalidate(head_key(key));
+		}
+		else
+		{
+			// a whole content of unknown length, a range not holding the one of the client or an error: each
+			// tells the client what it is, hence goes to it as it is
+			slicing = false;
+			slices.clear();
+			response.header("x-cache-status", "MISS");
+			return node_interface::on_header(std::move(response));
+		}
 
-			decoder.register_callback(std::move(decoding_start_cb), std::move(headers_readed_cb),
-				std::move(body_received_cb), std::move(trailer_received_callback),
-				std::move(codec_ccb), std::move(codec_fcb));
-			decoder.decode(reinterpret_cast<char*>(data.data()), data.size());
+		total = size;
+		satisfiable = range.resolve(total, resolved);
+		version = calculate_version(response);
+		ttl = cache_request_processor::get_response_max_age(response, 3600);
+		slices_cacheable = stored && response_filter(response, true) && !version.empty() && ttl;
+		if (slices_cacheable)
+		{
+			slices_tag = calculate_tag(response);
+			creation_time = calculate_creation_time(response);
+			http::http_response head{response};
+			head.status(206);
+			head.remove_header("content-range");
+			head.header("content-range", byte_range::unsatisfied(total).c_str());
+			auto k = head_key(key);
+			if (global_cache->begin_put(k, ttl, creation_time, slices_tag, version))
+			{
+				global_cache->put(k, encoder.encode_header(head));
+				global_cache->put(k, encoder.encode_eom());
+				global_cache->end_put(k, true);
+			}
 		}
+
+		response.status(satisfiable ? 206 : 416);
+		response.remove_header("content-range");
+		response.header("content-range",
+			(satisfiable ? resolved.content_range(total) : byte_range::unsatisfied(total)).c_str());
+		response.chunked(false);
+		response.content_len(satisfiable ? resolved.size() : 0);
+		response.header("x-cache-status", "MISS");
+		node_interface::on_header(std::move(response));
+		if (satisfiable) send_slices(0, span.first / byte_range::slice_size - resolved.first_slice());
+	}
+
+
+	void cache_manager::sliced_body(dstring &&chunk)
+	{
+		uint64_t begin = position;
+		position += chunk.size();
+		if (slices_cacheable) store_slices(chunk, begin);
+		if (!satisfiable || position <= resolved.first || begin > resolved.last) return;
+		uint64_t first = std::max(begin, resolved.first);
+		uint64_t last = std::min(position - 1, resolved.last);
+		node_interface::on_body(chunk.slice(first - begin, last - first + 1));
+	}
+
+
+	void cache_manager::sliced_end_of_message()
+	{
+		// a slice cut short is not kept
+		if (!putting_slice.empty()) global_cache->end_put(putting_slice, false);
+		putting_slice.clear();
+		if (satisfiable && span.last != byte_range::unbounded)
+			send_slices(span.last / byte_range::slice_size + 1 - resolved.first_slice(), slices.size());
+		response_finished = true;
+		node_interface::on_end_of_message();
 	}
 
 }
@@ -2,9 +2,9 @@
 #define DOORMAT_CACHE_MANAGER_H
 
 #include "../../chain_of_responsibility/node_interface.h"
-#include "../../cache/cache.h"
-#include "../../cache/policies/fifo.h"
-#include "../../http/http_codec.h"
+#include "configured_cache.h"
+#include "cached_response.h"
+#include "byte_range.h"
 #include <boost/regex.hpp>
 #include "cache_request_processing.h"
 #include "request_elaborations/configuration.h"
@@ -27,6 +27,8 @@ public:
 	void on_end_of_message();
 	void on_error(const errors::error_code &ec);// { if(!is_request_acked) on_request_ack(); error(ec); }
 
+	void reset();
+
 private:
 	bool check_not_modified(const http::http_request &req)  const noexcept;
 	bool is_in_cache = false;
@@ -36,14 +38,48 @@ private:
 	bool not_modified = false;
 	bool response_finished = false;
 	bool is_cacheable = false;
+	/** a single range of bytes is asked: it is cut from the whole content if cached, or else served by slices */
+	bool ranged = false;
+	/** the range is served by slices: the missing ones are asked to the board, the others sent from the cache */
+	bool slicing = false;
+	bool head_found = false;
+	bool slices_retrieved = false;
+	/** a slice is being retrieved: tells the callback whether get has returned already */
+	bool retrieving = false;
+	bool satisfiable = true;
+	bool slices_cacheable = false;
 
 	std::string key;
-	std::vector<uint8_t> data{};
+	/** view on the memory tier of the cache or on the mapped file: never modified */
+	dstring data;
 	uint32_t ttl{0};
-	http::http_codec decoder, encoder;
+	cached_response encoder;
 	http::http_response cache_response;
 	http_method mc{http_method::END};
-	/** parses, adapts and sends back the contents retrieved from the cache.
+	/** the range as asked by the client */
+	byte_range range;
+	/** the range asked by the client, made of the bytes of a content of size total */
+	byte_range resolved;
+	/** the bytes asked to the board */
+	byte_range span;
+	/** size of the whole content */
+	uint64_t total{0};
+	/** position in the whole content of the next byte coming from the board */
+	uint64_t position{0};
+	/** validator of the content the slices belong to */
+	std::string version;
+	std::string slices_tag;
+	std::chrono::system_clock::time_point creation_time;
+	/** key of the slice being put; empty if none */
+	std::string putting_slice;
+	/** the slices spanned by the range, empty where they are not cached */
+	std::vector<dstring> slices;
+	/** held until it is known which slices must be asked to the board */
+	http::http_request request;
+
+	/** retrieves the content of the key from the cache, then manages it */
+	void retrieve_content();
+	/** parses, adapts and sends back the contents retrieved from the cache; the body is not copied.
 	* */
 	void manage_retrieved_content();
 
@@ -51,21 +87,67 @@ private:
 	*
 	* */
 	void generate304();
+	/** replies that the range asked cannot be satisfied by a content of the given size */
+	void generate416(uint64_t size);
+
+	/** Serves a range by slices; the request is held until the cached slices are retrieved */
+	void slice_request(http::http_request &&preamble);
+	/** Retrieves the cached slices spanned by the range, one after the other */
+	void retrieve_slices();
+	/** Once the request is finished and the slices retrieved, either sends them or asks the missing ones
+	* to the board.
+	* */
+	void manage_slices();
+	/** Sends to the client the part of the range held by some of the cached slices
+	* \param begin the first slice to send, counted from the first one of the range
+	* \param end one past the last slice to send
+	* */
+	void send_slices(uint64_t begin, uint64_t end);
+	/** Puts in the cache the slices a chunk of the response of the board falls in */
+	void store_slices(const dstring &chunk, uint64_t begin);
+	/** the response of the board, stored by slices and cut to the range asked by the client */
+	void sliced_header(http::http_response &&response);
+	void sliced_body(dstring &&chunk);
+	void sliced_end_of_message();
 	/** the global cache used by all nodes. */
-	cache<fifo_policy> *global_cache;
+	configured_cache *global_cache;
 	/** Verifies if a response is eligible for cache.
 	* \param response the response headers received by the origin server
+	* \param partial partial contents are accepted too
 	* \return the ttl (seconds) if the response can be cached; 0 otherwise
 	* */
-	static uint32_t response_filter(const http::http_response &response);
+	static uint32_t response_filter(const http::http_response &response, bool partial = false);
 	/** Verifies if the resource required should be cached according to the domain/subdomain configuration
 	*  \param URI the URI of the request
 	*  \return true if the request can be cached; false otherwise.
 	* */
 	static bool domain_filter(const std::string &URI);
 
+	/** Chooses the tag of a response: its first surrogate key, or else a category given by its content type
+	* \param response the response headers received by the origin server
+	* \return the tag; empty if the response has none
+	* */
 	static std::string calculate_tag(const http::http_response &response);
 
+	/** \return the time a response was generated by the origin server, according to its age */
+	static std::chrono::system_clock::time_point calculate_creation_time(const http::http_response &response);
+
+	/** Chooses the version of a content the slices are stored with, which the board is asked to match with if-range
+	* \param response the response headers received by the origin server
+	* \return its strong etag, or else its last modification date; empty if the response has none
+	* */
+	static std::string calculate_version(const http::http_response &response);
+
+	/** Invalidates what is stored for the resource a request changes: the content stored whole, compressed
+	* or not, and its slices with their head.
+	* */
+	static void invalidate(configured_cache &cache, const http::http_request &preamble);
+
+	/** \return the key of the headers shared by the slices of a content */
+	static std::string head_key(const std::string &key);
+	/** \return the key of a slice of a given version of a content */
+	static std::string slice_key(const std::string &key, const std::string &version, uint64_t index);
+
 	static boost::regex nocache;
 	static boost::regex maxage;
 };
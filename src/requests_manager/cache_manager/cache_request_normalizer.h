@@ -26,6 +26,8 @@ public:
 		return node_interface::on_request_preamble(std::move(req));
 	}
 
+	void reset() {}
+
 };
 
 }
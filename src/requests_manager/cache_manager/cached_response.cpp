@@ -0,0 +1,156 @@
+#include "cached_response.h"
+
+#include <cstring>
+
+namespace nodes
+{
+	namespace
+	{
+		constexpr uint32_t magic{0x31435244}; // "DRC1"
+		/** body size and trailers size */
+		constexpr size_t footer_size{sizeof(uint64_t) + sizeof(uint32_t)};
+
+		template<typename T>
+		void write(std::string &out, T value)
+		{
+			out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		void write(std::string &out, const char *data, size_t size)
+		{
+			write(out, static_cast<uint32_t>(size));
+			out.append(data, size);
+		}
+
+		/** Reads from a stored response, failing instead of going past its end */
+		class reader
+		{
+			const char *position;
+			const char *end;
+		public:
+			reader(const char *begin, const char *end) : position{begin}, end{end} {}
+
+			template<typename T>
+			bool read(T &value)
+			{
+				if(static_cast<size_t>(end - position) < sizeof(value)) return false;
+				std::memcpy(&value, position, sizeof(value));
+				position += sizeof(value);
+				return true;
+			}
+
+			bool read(const char *&data, size_t &size)
+			{
+				uint32_t stored_size;
+				if(!read(stored_size) || static_cast<size_t>(end - position) < stored_size) return false;
+				data = position;
+				size = stored_size;
+				position += size;
+				return true;
+			}
+
+			const char *current() const noexcept { return position; }
+		};
+	}
+
+	std::string cached_response::encode_header(const http::http_response &response)
+	{
+		body_size = 0;
+		trailers_count = 0;
+		trailers.clear();
+
+		std::string out;
+		write(out, magic);
+		write(out, response.status_code());
+		write(out, static_cast<uint8_t>(response.protocol_version()));
+		write(out, response.status_message().cdata(), response.status_message().size());
+		uint32_t count{0};
+		for(auto &h : response.headers())
+			if(h.id != http::header_id::content_len && h.id != http::header_id::transfer_encoding) ++count;
+		write(out, count);
+		for(auto &h : response.headers())
+		{
+			if(h.id == http::header_id::content_len || h.id == http::header_id::transfer_encoding) continue;
+			write(out, h.first.cdata(), h.first.size());
+			write(out, h.second.cdata(), h.second.size());
+		}
+		return out;
+	}
+
+	std::string cached_response::encode_body(const dstring &chunk)
+	{
+		body_size += chunk.size();
+		return std::string(chunk);
+	}
+
+	void cached_response::encode_trailer(const dstring &key, const dstring &value)
+	{
+		++trailers_count;
+		write(trailers, key.cdata(), key.size());
+		write(trailers, value.cdata(), value.size());
+	}
+
+	std::string cached_response::encode_eom()
+	{
+		std::string out;
+		write(out, trailers_count);
+		out.append(trailers);
+		write(out, body_size);
+		write(out, static_cast<uint32_t>(sizeof(trailers_count) + trailers.size()));
+		return out;
+	}
+
+	bool cached_response::decode(const dstring &stored, http::http_response &response, dstring &body, trailers_t &trailers)
+	{
+		if(stored.size() < footer_size) return false;
+		const char *begin = stored.cdata();
+		const char *footer = begin + stored.size() - footer_size;
+		uint64_t body_size;
+		uint32_t trailers_size;
+		reader tail{footer, footer + footer_size};
+		tail.read(body_size);
+		tail.read(trailers_size);
+
+		reader header{begin, footer};
+		uint32_t stored_magic, count;
+		size_t size;
+		uint16_t status;
+		uint8_t protocol;
+		const char *data;
+		if(!header.read(stored_magic) || stored_magic != magic || !header.read(status) || !header.read(protocol) ||
+			!header.read(data, size)) return false;
+		response.protocol(static_cast<http::proto_version>(protocol));
+		response.status(status, dstring{data, size});
+		if(!header.read(count)) return false;
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			const char *value;
+			size_t value_size;
+			if(!header.read(data, size) || !header.read(value, value_size)) return false;
+			response.header(dstring{data, size}, dstring{value, value_size});
+		}
+
+		// the sizes read are not added up: a damaged one could make the sum overflow
+		size_t available = footer - header.current();
+		if(body_size > available || trailers_size != available - body_size) return false;
+		size_t body_offset = header.current() - begin;
+		body = body_size ? stored.slice(body_offset, body_size) : dstring{};
+
+		const char *trailers_begin = header.current() + body_size;
+		reader tail_block{trailers_begin, trailers_begin + trailers_size};
+		if(!tail_block.read(count)) return false;
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			const char *value;
+			size_t value_size;
+			if(!tail_block.read(data, size) || !tail_block.read(value, value_size)) return false;
+			trailers.emplace_back(dstring{data, size}, dstring{value, value_size});
+		}
+
+		if(trailers.empty())
+			response.content_len(body_size);
+		else
+			response.chunked(true);
+		return true;
+	}
+}
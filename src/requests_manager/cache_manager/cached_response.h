@@ -0,0 +1,51 @@
+#ifndef DOORMAT_CACHED_RESPONSE_H
+#define DOORMAT_CACHED_RESPONSE_H
+
+#include "../../http/http_response.h"
+#include "../../utils/dstring.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nodes
+{
+
+/** \brief format of the responses stored in the cache, laid out so that a hit needs no parsing of the body:
+ * a binary header block (status, protocol and headers), the body as received, the trailers and a footer
+ * with the sizes of the body and of the trailers.
+ * The body is stored without its transfer encoding, and a hit is sent with the encoding chosen by the handler.
+ * */
+class cached_response
+{
+public:
+	using trailers_t = std::vector<std::pair<dstring, dstring>>;
+
+	/** \return the header block of a response; content-length and transfer-encoding are left out */
+	std::string encode_header(const http::http_response &response);
+	/** \return the bytes to store for a chunk of the body */
+	std::string encode_body(const dstring &chunk);
+	/** Keeps a trailer, stored at the end */
+	void encode_trailer(const dstring &key, const dstring &value);
+	/** \return the bytes closing the stored response */
+	std::string encode_eom();
+
+	/** Reads a stored response; only the headers are copied, body and trailers point inside the stored data.
+	 * \param stored the bytes stored in the cache
+	 * \param response filled with status and headers; content-length is set, or chunked if there are trailers
+	 * \param body the body, empty if there is none
+	 * \param trailers the trailers
+	 * \return false if the stored data is not a response in this format
+	 * */
+	static bool decode(const dstring &stored, http::http_response &response, dstring &body, trailers_t &trailers);
+
+private:
+	uint64_t body_size{0};
+	uint32_t trailers_count{0};
+	std::string trailers;
+};
+
+}
+
+#endif //DOORMAT_CACHED_RESPONSE_H
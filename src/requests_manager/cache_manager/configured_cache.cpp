@@ -0,0 +1,57 @@
+#include "configured_cache.h"
+#include "../../cache/cache.h"
+#include "../../cache/policies/fifo.h"
+#include "../../cache/policies/slru.h"
+#include "../../cache/policies/s3fifo.h"
+#include "../../cache/policies/wtinylfu.h"
+#include "../../configuration/configuration_wrapper.h"
+
+#include <memory>
+
+namespace nodes
+{
+	namespace
+	{
+		template<template<class> class policy>
+		class policy_cache final : public configured_cache
+		{
+			cache<policy> &c;
+		public:
+			policy_cache() : c(*cache<policy>::get_instance(UINT32_MAX, service::locator::configuration().cache_path(),
+				service::locator::configuration().cache_memory_size(),
+				service::locator::configuration().cache_persistent())) {}
+
+			bool has(const std::string &key) override { return c.has(key); }
+			uint32_t get_age(const std::string &key) override { return c.get_age(key); }
+			bool get(const std::string &key, view_read_callback rcb) override { return c.get(key, std::move(rcb)); }
+			bool begin_put(const std::string &key, unsigned int ttl, std::chrono::system_clock::time_point creation_time,
+				const std::string &tag, const std::string &etag) override
+			{
+				return c.begin_put(key, ttl, creation_time, tag, etag);
+			}
+			bool put(const std::string &key, const std::string &cl) override { return c.put(key, cl); }
+			void end_put(const std::string &key, bool ok) override { c.end_put(key, ok); }
+			void invalidate(const std::string &key) override { c.invalidate(key); }
+			bool verify_version(const std::string &key, const std::string &version) override
+			{
+				return c.verify_version(key, version);
+			}
+			size_t clear_tag(const std::string &tag) override { return c.clear_tag(tag); }
+			size_t clear_all() override { return c.clear_all(); }
+		};
+
+		std::unique_ptr<configured_cache> make(const std::string &policy)
+		{
+			if(policy == "slru") return std::unique_ptr<configured_cache>{new policy_cache<slru_policy>};
+			if(policy == "s3fifo") return std::unique_ptr<configured_cache>{new policy_cache<s3fifo_policy>};
+			if(policy == "wtinylfu") return std::unique_ptr<configured_cache>{new policy_cache<wtinylfu_policy>};
+			return std::unique_ptr<configured_cache>{new policy_cache<fifo_policy>};
+		}
+	}
+
+	configured_cache& configured_cache::instance()
+	{
+		static std::unique_ptr<configured_cache> configured = make(service::locator::configuration().cache_policy());
+		return *configured;
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef DOORMAT_CONFIGURED_CACHE_H
+#define DOORMAT_CONFIGURED_CACHE_H
+
+#include "../../utils/dstring.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace nodes
+{
+
+/** \brief the cache shared by the nodes, whose replacement policy is chosen by the configuration.
+ * It relays to the cache<policy> instance the operations the nodes need; see cache.h for what they do.
+ * */
+class configured_cache
+{
+public:
+	using view_read_callback = std::function<void(dstring)>;
+
+	/** \return the cache of the configured policy, made at the first call */
+	static configured_cache& instance();
+
+	virtual ~configured_cache() = default;
+
+	virtual bool has(const std::string &key) = 0;
+	virtual uint32_t get_age(const std::string &key) = 0;
+	virtual bool get(const std::string &key, view_read_callback rcb) = 0;
+	virtual bool begin_put(const std::string &key, unsigned int ttl, std::chrono::system_clock::time_point creation_time,
+		const std::string &tag, const std::string &etag) = 0;
+	virtual bool put(const std::string &key, const std::string &cl) = 0;
+	virtual void end_put(const std::string &key, bool ok) = 0;
+	virtual void invalidate(const std::string &key) = 0;
+	virtual bool verify_version(const std::string &key, const std::string &version) = 0;
+	virtual size_t clear_tag(const std::string &tag) = 0;
+	virtual size_t clear_all() = 0;
+};
+
+}
+
+#endif //DOORMAT_CONFIGURED_CACHE_H
@@ -271,6 +271,24 @@ void client_wrapper::on_request_canceled(const errors::error_code &ec)
 }
 
 
+void client_wrapper::reset()
+{
+	assert(waiting_count == 0);
+	write_proxy = communicator_proxy{};
+	stopping = false;
+	finished_request = false;
+	finished_response = false;
+	managing_continue = false;
+	canceled = false;
+	errcode = errors::error_code{};
+	addr = routing::abstract_destination_provider::address{};
+	custom_addr = false;
+	connection_attempts = 0;
+	codec.reset();
+	received_parsed_message = http::http_response{};
+	local_request = http::http_request{};
+}
+
 void client_wrapper::stop()
 {
 	LOGTRACE("client_wrapper ",this," stop!");
@@ -47,6 +47,9 @@ public:
 	/** procedure to be performed when the socket is acquired. */
 	void on_connect(std::unique_ptr<boost::asio::ip::tcp::socket> socket);
 
+	/** Drops the communicator of the last transaction; the codec keeps its callbacks. */
+	void reset();
+
 	~client_wrapper();
 
 private:
@@ -1,56 +1,126 @@
 #include <ctime>
+#include <vector>
 
 #include "configurable_header_filter.h"
 #include "../configuration/configuration_wrapper.h"
 #include "../service_locator/service_locator.h"
+#include "../utils/arena.h"
 #include "../utils/utils.h"
 
 namespace nodes
 {
 
-void configurable_header_filter::on_request_preamble(http::http_request && preamble)
+namespace
+{
+
+enum class value_source : uint8_t
+{
+	constant,
+	timestamp,
+	msec,
+	scheme,
+	destination
+};
+
+struct configured_header
+{
+	dstring key;
+	dstring value;
+	value_source source;
+};
+
+struct configured_headers
 {
-	const configuration::header& conf_header = service::locator::configuration().header_configuration();
+	std::size_t generation{0};
+	std::vector<configured_header> to_set;
+	std::vector<dstring> to_kill;
+};
+
+value_source source_of( const std::string& value, const configuration::header::variable_set& var )
+{
+	if ( var.find( value ) == var.end() )
+		return value_source::constant;
+	if ( value == "$timestamp" )
+		return value_source::timestamp;
+	if ( value == "$msec" )
+		return value_source::msec;
+	if ( value == "$scheme" )
+		return value_source::scheme;
+	if ( value == "$proxy_add_x_forwarded_for" || value == "$remote_addr" )
+		return value_source::destination;
+	return value_source::constant;
+}
+
+/**
+ * The rules of the configuration with keys and constant values already made
+ * into dstrings, once per thread and per loading of the rules: each request
+ * then shares them.
+ */
+const configured_headers& prepared( const configuration::header& conf_header )
+{
+	thread_local static configured_headers headers;
+	if ( headers.generation == conf_header.generation() )
+		return headers;
+
+	utils::arena::scope heap{nullptr};
+	headers.generation = conf_header.generation();
+	headers.to_set.clear();
+	headers.to_kill.clear();
 
 	const configuration::header::variable_set& var = conf_header.variables();
+	for ( auto it = conf_header.begin(); it != conf_header.end(); ++it )
+	{
+		headers.to_set.push_back( configured_header{
+			dstring{it->first.data(), it->first.size(), true},
+			dstring{it->second.data(), it->second.size()},
+			source_of( it->second, var )} );
+	}
 
-	for ( configuration::header::header_map::const_iterator it = conf_header.begin();
-		it != conf_header.end(); ++it )
+	for ( auto it = conf_header.begin_kill(); it != conf_header.end_kill(); ++it )
+		headers.to_kill.emplace_back( it->data(), it->size(), true );
+
+	return headers;
+}
+
+}
+
+void configurable_header_filter::on_request_preamble(http::http_request && preamble)
+{
+	const configured_headers& conf = prepared( service::locator::configuration().header_configuration() );
+
+	for ( auto&& h : conf.to_set )
 	{
-		dstring head{it->first.data(),it->first.size(),true};
-		if ( head != "x-forwarded-for" && preamble.has( head ) )
+		if ( h.key != "x-forwarded-for" && preamble.has( h.key ) )
 			continue;
 
-		dstring val{it->second.data(),it->second.size()};
-		if ( var.find( val ) != var.end() )
+		switch ( h.source )
 		{
-			if ( val == "$timestamp" )
-				val = dstring::to_string( std::time(nullptr) );
-			else if ( val == "$msec" )
+			case value_source::constant:
+				preamble.header( h.key, h.value );
+				break;
+			case value_source::timestamp:
+				preamble.header( h.key, dstring::to_string( std::time(nullptr) ) );
+				break;
+			case value_source::msec:
 			{
 				auto ms = std::chrono::duration_cast<std::chrono::milliseconds>
 					(std::chrono::system_clock::now().time_since_epoch()).count();
-				val = dstring::to_string( ms );
+				preamble.header( h.key, dstring::to_string( ms ) );
+				break;
 			}
-			else if ( val == "$scheme" )
-				val = preamble.ssl() ? "https" : "http";
-			else if ( val == "$proxy_add_x_forwarded_for" || val == "$remote_addr" )
-			{
+			case value_source::scheme:
+				preamble.header( h.key, preamble.ssl() ? "https" : "http" );
+				break;
+			case value_source::destination:
 				// These header will be managed later by set_destination_header
 				// When destination is known!
-				preamble.add_destination_header( std::move(head) );
-				val = {};
-			}
-		}
-		if ( ! val.empty() )
-		{
-			storage.emplace_back( std::move( val ) );
-			preamble.header( dstring{it->first.data(), it->first.size(), true} , storage.back() );
+				preamble.add_destination_header( h.key );
+				break;
 		}
 	}
 
-	for ( auto it = conf_header.begin_kill(); it != conf_header.end_kill(); ++it )
-		preamble.remove_header( dstring{it->data(), it->size(), true} );
+	for ( auto&& k : conf.to_kill )
+		preamble.remove_header( k );
 
 	node_interface::on_request_preamble( std::move ( preamble ) );
 }
@@ -8,12 +8,11 @@ namespace nodes
 
 class configurable_header_filter : public node_interface
 {
-	std::list<dstring> storage;
-
 public:
 	using node_interface::node_interface;
 
 	void on_request_preamble(http::http_request&& preamble);
+	void reset() {}
 };
 
 }
@@ -3,10 +3,7 @@
 
 #include "../chain_of_responsibility/node_interface.h"
 #include "../http/http_structured_data.h"
-#include "../log/format.h"
-
-#include <array>
-#include <chrono>
+#include "../utils/http_clock.h"
 
 namespace nodes
 {
@@ -24,14 +21,11 @@ public:
 	void on_header(http::http_response&& preamble)
 	{
 		if(preamble.date().empty())
-		{
-			const auto& date = logging::format::http_header_date(std::chrono::system_clock::now());
-			preamble.date(dstring{date.data(), date.size()});
-		}
+			preamble.date(utils::http_clock::date());
 		base::on_header(std::move(preamble));
 	}
-private:
-	std::array<uint8_t,29> buf;
+
+	void reset() {}
 };
 
 }
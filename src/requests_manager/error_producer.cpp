@@ -94,4 +94,13 @@ void error_producer::on_request_finished()
 	if ( LIKELY( ! efa ) ) base::on_request_finished();
 }
 
+void error_producer::reset()
+{
+	efa.reset();
+	body.clear();
+	proto = http::proto_version::UNSET;
+	code = errors::error_code{};
+	client_stream_begun = false;
+}
+
 }
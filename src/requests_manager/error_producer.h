@@ -48,6 +48,7 @@ public:
 	void on_request_body(dstring&& chunk);
 	void on_request_trailer(dstring&& k, dstring&& v);
 	void on_request_finished();
+	void reset();
 
 	bool client_stream_begun{false};
 };
@@ -63,6 +63,18 @@ bool gzip_filter::parse_accepted_encoding(const dstring& val)
 
 bool gzip_filter::init_compressor()
 {
+	if( _stream )
+	{
+		_stream->next_in = 0;
+		_stream->avail_in = 0;
+		_stream->next_out = 0;
+		_stream->avail_out = 0;
+		auto rv = deflateReset( _stream.get() );
+		if (rv != Z_OK)
+			LOGERROR("init_compressor failed: ", _stream->msg);
+		return rv == Z_OK;
+	}
+
 	_stream.reset( new z_stream );
 	_stream->zalloc = Z_NULL;
 	_stream->zfree = Z_NULL;
@@ -151,10 +163,12 @@ void gzip_filter::on_header(http::http_response&& h)
 		bool chunked = h.chunked();
 		bool mime_match = service::locator::configuration().comp_mime_matcher( mimetype );
 		bool size_match = chunked || h.content_len() >= min_size;
+		// a part of a content cannot be compressed on its own
+		bool whole = h.status_code() != 206;
 
 		LOGTRACE(this," mime_match: ", mime_match, "size_match: ", size_match );
 
-		if( mime_match && size_match )
+		if( mime_match && size_match && whole )
 		{
 			init_compressor();
 			h.header(http::hf_content_encoding, http::hv_gzip);
@@ -220,5 +234,12 @@ void gzip_filter::on_end_of_message()
 	return base::on_end_of_message();
 }
 
+void gzip_filter::reset()
+{
+	active = false;
+	std::queue<dstring>{}.swap(_in_buf);
+	res = boost::none;
+}
+
 }
 
@@ -71,6 +71,8 @@ public:
 	void on_header(http::http_response&&);
 	void on_body(dstring&&);
 	void on_end_of_message();
+	/** The compressor is kept, to be reset when the next response is compressed */
+	void reset();
 };
 
 }
@@ -23,6 +23,7 @@ public:
 	void on_request_body(dstring&&);
 	void on_request_trailer(dstring&&,dstring&&);
 	void on_request_finished();
+	void reset() { rejected = false; }
 };
 } // namespace nodes
 
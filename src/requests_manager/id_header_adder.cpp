@@ -1,36 +1,82 @@
 #include "id_header_adder.h"
 #include "../http/http_commons.h"
+#include "../utils/arena.h"
 #include "../utils/likely.h"
 #include "../constants.h"
 
+#include <vector>
+
 namespace nodes
 {
 
+namespace
+{
+
+constexpr size_t max_via_tokens{64};
+
+// Values below are built once per thread and shared by every message:
+// they live on the heap, never in the arena of the transaction asking first
+
+const dstring& server_value()
+{
+	thread_local static const dstring server = []()
+	{
+		utils::arena::scope heap{nullptr};
+#ifdef VERSION
+		auto name = project_name() + "-" + version();
+#else
+		auto name = project_name();
+#endif
+		return dstring{name.data(), name.size()};
+	}();
+	return server;
+}
+
+/** The token of this hop in the Via header: protocol and host. */
+const dstring& via_token(http::proto_version version, const dstring& host)
+{
+	struct entry
+	{
+		http::proto_version version;
+		dstring host;
+		dstring token;
+	};
+	thread_local static std::vector<entry> tokens;
+
+	for(auto&& e : tokens)
+		if(e.version == version && e.host == host)
+			return e.token;
+
+	utils::arena::scope heap{nullptr};
+	if(tokens.size() == max_via_tokens)
+		tokens.clear();
+
+	dstring token;
+	token.append(http::proto_to_string(version))
+		.append(" ")
+		.append(host);
+	tokens.push_back(entry{version, dstring{host.cdata(), host.size()}, std::move(token)});
+	return tokens.back().token;
+}
+
+}
+
 void id_header_adder::via_header( http::http_structured_data& preamble )
 {
+	const auto& token = via_token( preamble.protocol_version(), preamble.hostname() );
 	auto via_value = preamble.header( http::hf_via );
 	preamble.remove_header( http::hf_via );
 
 	if( via_value )
-		via_value.append(", ");
-
-	via_value.append(preamble.protocol())
-		.append(" ")
-		.append(preamble.hostname());
-
-	preamble.header(http::hf_via, via_value);
+		preamble.header( http::hf_via, via_value.append(", ").append(token) );
+	else
+		preamble.header( http::hf_via, token );
 }
 
 void id_header_adder::server_header(http::http_structured_data& preamble )
 {
-#ifdef VERSION
-	thread_local static const dstring server{ (project_name() + "-" + version()).c_str() };
-#else
-	thread_local static const dstring server{ project_name() };
-#endif
-
 	preamble.remove_header( http::hf_server );
-	preamble.header( http::hf_server, server);
+	preamble.header( http::hf_server, server_value() );
 }
 
 void id_header_adder::on_request_preamble ( http::http_request&& preamble )
@@ -15,6 +15,7 @@ public:
 
 	void on_request_preamble(http::http_request&&);
 	void on_header(http::http_response &&h);
+	void reset() {}
 };
 
 }
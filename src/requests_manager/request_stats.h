@@ -18,6 +18,7 @@ public:
 	void on_request_preamble( http::http_request&& preamble );
 	void on_end_of_message();
 	void on_error( const errors::error_code& ec );
+	void reset() {}
 };
 
 }
@@ -18,6 +18,7 @@ public:
 	void on_request_body(dstring&& chunk);
 	void on_request_trailer(dstring&& k, dstring&& v);
 	void on_request_finished();
+	void reset() { allowed = true; limit = 0; total_message_size = 0; }
 };
 
 }
@@ -16,6 +16,7 @@ public:
 	void on_request_body(dstring&& chunk);
 	void on_request_trailer(dstring&& k, dstring&& v);
 	void on_request_finished();
+	void reset() { error_code = errors::internal_error{}; }
 };
 
 }
@@ -40,6 +40,7 @@ enum stat_type
 	failed_req_number,
 	cache_requests_arrived,
 	cache_hits,
+	cache_fills_abandoned,
 	//the following value of the enum must remain the last, as it is used in order to multiplex the data in the stats_manager.
 	overall_counter_number
 };
@@ -52,7 +53,8 @@ static const std::map<stat_type, std::string> stat_type_2_name
 	{ request_number, "RequestNumber" },
 	{ failed_req_number, "FailedRequestNumber" },
 	{ cache_requests_arrived, "RequestNumberAsSeenByCache"},
-	{ cache_hits, "RequestsServedByCache"}
+	{ cache_hits, "RequestsServedByCache"},
+	{ cache_fills_abandoned, "CacheFillsAbandoned"}
 };
 
 class stats_manager;
@@ -0,0 +1,156 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace utils
+{
+
+constexpr std::size_t arena::default_chunk_size;
+
+namespace
+{
+
+constexpr std::size_t alignment{alignof(std::max_align_t)};
+
+constexpr std::size_t aligned(std::size_t size)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+struct arena::pool
+{
+	struct chunk
+	{
+		chunk* next;
+		std::size_t size;
+	};
+
+	static constexpr std::size_t chunk_header{aligned(sizeof(chunk))};
+
+	const std::size_t chunk_size;
+	chunk* chunks{nullptr};
+	char* cur{nullptr};
+	char* end{nullptr};
+	std::size_t reserved{0};
+	// One for the arena, one for each allocation not deallocated yet
+	std::atomic<std::size_t> pins{1};
+
+	explicit pool(std::size_t size) noexcept : chunk_size{size} {}
+
+	static void unpin(pool* p) noexcept
+	{
+		if(p->pins.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete p;
+	}
+
+	~pool()
+	{
+		while(chunks)
+		{
+			auto next = chunks->next;
+			::operator delete(chunks);
+			chunks = next;
+		}
+	}
+
+	void* bump(std::size_t size)
+	{
+		if(static_cast<std::size_t>(end - cur) < size)
+		{
+			// Oversized requests get a chunk of their own
+			auto payload = std::max(size, chunk_size);
+			auto c = static_cast<chunk*>(::operator new(chunk_header + payload));
+			c->next = chunks;
+			c->size = payload;
+			chunks = c;
+			reserved += chunk_header + payload;
+			cur = reinterpret_cast<char*>(c) + chunk_header;
+			end = cur + payload;
+		}
+		auto p = cur;
+		cur += size;
+		return p;
+	}
+};
+
+constexpr std::size_t arena::pool::chunk_header;
+
+thread_local arena::pool* arena::in_use{nullptr};
+
+arena::arena(std::size_t chunk_size)
+	: _pool{new pool{aligned(chunk_size)}}
+{}
+
+arena::arena(arena&& o) noexcept
+	: _pool{o._pool}
+{
+	o._pool = nullptr;
+}
+
+arena& arena::operator=(arena&& o) noexcept
+{
+	if(this != &o)
+	{
+		if(_pool)
+			pool::unpin(_pool);
+		_pool = o._pool;
+		o._pool = nullptr;
+	}
+	return *this;
+}
+
+arena::~arena()
+{
+	if(_pool)
+		pool::unpin(_pool);
+}
+
+std::size_t arena::reserved() const noexcept
+{
+	return _pool ? _pool->reserved : 0;
+}
+
+arena::scope::scope(arena& a) noexcept
+	: previous{in_use}
+{
+	in_use = a._pool;
+}
+
+arena::scope::scope(std::nullptr_t) noexcept
+	: previous{in_use}
+{
+	in_use = nullptr;
+}
+
+arena::scope::~scope()
+{
+	in_use = previous;
+}
+
+void arena::use() noexcept
+{
+	in_use = _pool;
+}
+
+void* arena::allocate(std::size_t size, origin from)
+{
+	if(!from)
+		return ::operator new(size);
+	auto p = from->bump(aligned(size));
+	from->pins.fetch_add(1, std::memory_order_relaxed);
+	return p;
+}
+
+void arena::deallocate(void* p, origin from) noexcept
+{
+	if(from)
+		pool::unpin(from);
+	else
+		::operator delete(p);
+}
+
+} // namespace utils
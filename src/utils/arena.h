@@ -0,0 +1,118 @@
+#ifndef DOORMAT_ARENA_H_
+#define DOORMAT_ARENA_H_
+
+#include <cstddef>
+#include <new>
+
+namespace utils
+{
+
+/**
+ * @brief A monotonic arena: memory is handed out by bumping a pointer
+ * into chunks and given back all at once, when the arena goes away.
+ *
+ * Allocations are routed to the arena made current in this thread by a scope;
+ * without one they go to the heap. Whoever allocates remembers where the
+ * memory comes from and tells it back when deallocating: arena memory is
+ * never freed one allocation at a time.
+ *
+ * Each allocation pins the memory of the arena until it is deallocated,
+ * so whatever escapes the transaction - a header value kept by a pooled
+ * connection, say - keeps it alive instead of dangling; the pins are
+ * atomic, as the last one may go away on another thread. Memory meant to
+ * last should rather be copied out to the heap under a scope{nullptr}, not
+ * to hold the whole arena: dstrings and containers using arena_allocator
+ * do it when they are copied for another arena or for the heap.
+ */
+class arena
+{
+	struct pool;
+
+public:
+	static constexpr std::size_t default_chunk_size{16384};
+
+	/** Where memory comes from: an arena, or the heap when null. */
+	using origin = pool*;
+
+	explicit arena(std::size_t chunk_size = default_chunk_size);
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+	arena(arena&& o) noexcept;
+	arena& operator=(arena&& o) noexcept;
+	~arena();
+
+	/** Bytes taken from the heap so far. */
+	std::size_t reserved() const noexcept;
+
+	/**
+	 * @brief Makes an arena the current one of this thread until
+	 * the end of the scope.
+	 */
+	class scope
+	{
+		pool* previous;
+	public:
+		explicit scope(arena& a) noexcept;
+		/** Allocations go to the heap until the end of the scope. */
+		explicit scope(std::nullptr_t) noexcept;
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+		~scope();
+	};
+
+	/**
+	 * @brief Makes this arena the current one until the end of
+	 * the innermost scope, which must exist.
+	 */
+	void use() noexcept;
+
+	/** @return where allocations go in this thread. */
+	static origin current() noexcept { return in_use; }
+
+	/** Allocates from the current arena, or from the heap when there is none. */
+	static void* allocate(std::size_t size) { return allocate(size, in_use); }
+	static void* allocate(std::size_t size, origin from);
+	/** Frees heap memory; arena memory goes away once its arena and all that was allocated in it are gone. */
+	static void deallocate(void* p, origin from) noexcept;
+
+	/** @return true when allocations are served by an arena. */
+	static bool active() noexcept { return in_use != nullptr; }
+
+private:
+	static thread_local pool* in_use;
+
+	pool* _pool;
+};
+
+/**
+ * @brief Allocator over the arena current when it is made, or over the heap.
+ *
+ * Copies of a container get the arena current when they are made, so that
+ * copying under a scope{nullptr} takes it out of its arena.
+ */
+template<typename T>
+struct arena_allocator
+{
+	using value_type = T;
+
+	arena::origin from{arena::current()};
+
+	arena_allocator() noexcept = default;
+	template<typename U>
+	arena_allocator(const arena_allocator<U>& other) noexcept : from{other.from} {}
+
+	arena_allocator select_on_container_copy_construction() const noexcept { return {}; }
+
+	T* allocate(std::size_t n) { return static_cast<T*>(arena::allocate(n * sizeof(T), from)); }
+	void deallocate(T* p, std::size_t) noexcept { arena::deallocate(p, from); }
+};
+
+template<typename T, typename U>
+bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) noexcept { return a.from == b.from; }
+
+template<typename T, typename U>
+bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) noexcept { return a.from != b.from; }
+
+} // namespace utils
+
+#endif // DOORMAT_ARENA_H_
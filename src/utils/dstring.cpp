@@ -1,73 +1,83 @@
 #include "dstring.h"
 #include "log_wrapper.h"
+#include "arena.h"
 
 #include <assert.h>
 #include <cstring>
 #include <iostream>
+#include <new>
 
 constexpr size_t dstring::npos;
+constexpr size_t dstring::sso_capacity;
 
 const dstring dstring::make_immutable(const char* c, const bool caseins) noexcept
 {
+	// Copies point to its data without a reference: it is meant to last
+	utils::arena::scope heap{nullptr};
 	return dstring{c, strlen(c), caseins, true};
 }
 
+namespace
+{
+// Bodies can grow without bounds: only small strings go to the arena
+constexpr size_t arena_capacity{1024};
+}
+
+dstring::block* dstring::allocate(size_t capacity)
+{
+	auto from = capacity <= arena_capacity ? utils::arena::current() : nullptr;
+	return new(utils::arena::allocate(sizeof(block) + capacity, from)) block{0, false, from};
+}
+
+void dstring::release(block* b) noexcept
+{
+	if(b->external)
+		reinterpret_cast<external_owner*>(b->data())->~external_owner();
+	utils::arena::deallocate(b, b->arena);
+}
+
+dstring dstring::wrap(const char* data, size_t len, external_owner owner) noexcept
+{
+	static_assert(sizeof(block) % alignof(external_owner) == 0, "the owner of external storage is misaligned");
+	// The owner is destroyed with the last reference, which may come after the arena is gone
+	utils::arena::scope heap{nullptr};
+	dstring d;
+	d._block = allocate(sizeof(external_owner));
+	d._block->external = true;
+	new(d._block->data()) external_owner{std::move(owner)};
+	d._data = const_cast<char*>(data);
+	d._size = len;
+	d._capacity = len;
+	d.set_valid(len);
+	return d;
+}
+
 dstring::dstring(const bool caseins) noexcept
-	: _flags{0}
-	, _size{0}
-	, _capacity{0}
-	, _refcount{new uint(0)}
-	, _data{nullptr}
 {
 	set_ci(caseins);
 }
 
 dstring::dstring(size_t t, const bool caseins) noexcept
-	: _flags{0}
-	, _size{t}
-	, _capacity{t}
-	, _refcount{new uint(0)}
-	, _data{new char[t]}
 {
+	init(t);
+	_size = t;
 	set_ci(caseins);
 }
 
 dstring::dstring(const char* c , size_t len, const bool caseins, const bool) noexcept
-	: _size{len}
-	, _capacity{len}
-	, _data{new char[len]}
+	: dstring{c, len, caseins}
 {
 	set_immutable(true);
-	set_valid(len);
-
-	if(caseins)
-	{
-		set_ci();
-		std::transform(c, c+len, _data, ::tolower);
-	}
-	else
-		std::copy_n(c, len, _data);
 }
 
 dstring::dstring(const dstring& other) noexcept
-	: _flags{other._flags}
-	, _size{other._size}
-	, _capacity{other._capacity}
-	, _refcount{other._refcount}
-	, _data{other._data}
 {
-	set_immutable(false);
-	if( _refcount )
-		*_refcount +=1;
+	copy_from(other);
 }
 
 dstring::dstring(dstring&& other) noexcept
 {
-	std::swap(_flags, other._flags);
-	std::swap(_size, other._size);
-	std::swap(_capacity, other._capacity);
-	std::swap(_refcount, other._refcount);
-	std::swap(_data, other._data);
+	steal(other);
 }
 
 dstring::dstring(const char* c , size_t len, const bool caseins) noexcept
@@ -76,10 +86,7 @@ dstring::dstring(const char* c , size_t len, const bool caseins) noexcept
 	set_valid(len);
 
 	if(caseins)
-	{
-		set_ci();
 		std::transform(c, c+len, _data, ::tolower);
-	}
 	else
 		std::copy_n(c, len, _data);
 }
@@ -102,26 +109,91 @@ dstring::~dstring() noexcept
 	reset();
 }
 
-void dstring::reset()
+void dstring::init(size_t capacity) noexcept
 {
-	if(!_refcount && is_immutable())
+	if(capacity <= sso_capacity)
+	{
+		_flags |= flags::sso;
+		_data = _inline;
+		_capacity = sso_capacity;
+	}
+	else
 	{
-		delete[] _data;
+		_block = allocate(capacity);
+		_data = _block->data();
+		_capacity = capacity;
+	}
+}
+
+void dstring::copy_from(const dstring& other) noexcept
+{
+	_flags = other._flags;
+	set_immutable(false);
+	_size = other._size;
+	_capacity = other._capacity;
+
+	if(other.is_inline())
+	{
+		std::copy_n(other._inline, _size, _inline);
+		_data = _inline;
 		return;
 	}
 
-	if( _refcount )
+	//Arena storage goes away with its arena: copies made for another one, or for the heap, get their own
+	if(!other.is_immutable() && other._block && other._block->arena && other._block->arena != utils::arena::current())
 	{
-		if( *_refcount > 0)
-		{
-			*_refcount -= 1;
-		}
+		_flags &= ~flags::sso;
+		init(_size);
+		std::copy_n(other._data, _size, _data);
+		return;
+	}
+
+	//Copies of an immutable just point to its data
+	_data = other._data;
+	_block = other.is_immutable() ? nullptr : other._block;
+	if(_block)
+		_block->refcount += 1;
+}
+
+void dstring::steal(dstring& other) noexcept
+{
+	_flags = other._flags;
+	_size = other._size;
+	_capacity = other._capacity;
+
+	if(other.is_inline())
+	{
+		std::copy_n(other._inline, _size, _inline);
+		_data = _inline;
+	}
+	else
+	{
+		_data = other._data;
+		_block = other._block;
+	}
+
+	other._flags = 0;
+	other._size = 0;
+	other._capacity = 0;
+	other._data = nullptr;
+	other._block = nullptr;
+}
+
+void dstring::reset()
+{
+	if(owns_block())
+	{
+		if(!is_immutable() && _block->refcount > 0)
+			_block->refcount -= 1;
 		else
-		{
-			delete _refcount;
-			delete[] _data;
-		}
+			release(_block);
 	}
+
+	_flags = 0;
+	_size = 0;
+	_capacity = 0;
+	_data = nullptr;
+	_block = nullptr;
 }
 
 dstring::operator std::string() const noexcept
@@ -131,28 +203,21 @@ dstring::operator std::string() const noexcept
 
 dstring& dstring::operator=(const dstring& other) noexcept
 {
-	reset();
-	_flags = other._flags;
-	set_immutable(false);
-
-	_size = other._size;
-	_capacity = other._capacity;
-	_data = other._data;
-	_refcount = other._refcount;
-
-	if(_refcount)
-		*_refcount +=1;
-
+	if(this != &other)
+	{
+		reset();
+		copy_from(other);
+	}
 	return *this;
 }
 
 dstring& dstring::operator=(dstring&& other) noexcept
 {
-	std::swap(_flags, other._flags);
-	std::swap(_size, other._size);
-	std::swap(_capacity, other._capacity);
-	std::swap(_data, other._data);
-	std::swap(_refcount, other._refcount);
+	if(this != &other)
+	{
+		reset();
+		steal(other);
+	}
 	return *this;
 }
 
@@ -162,8 +227,7 @@ dstring dstring::clone(std::function<char(char)> fn) const noexcept
 	{
 		dstring d{_size};
 		std::transform(cbegin(), cend(), d._data, fn);
-		d._flags = _flags;
-		d.set_immutable(false);
+		d._flags |= _flags & (flags::valid | flags::cinsensitive);
 		return d;
 	}
 
@@ -194,6 +258,37 @@ dstring dstring::substr(size_t pos, size_t count, std::function<char(char)> fn)
 		return substr(cbegin()+pos, cend(), fn);
 }
 
+dstring dstring::slice(const_iterator b, const_iterator e) const noexcept
+{
+	assert(b >= cbegin() && e <= cend() && b <= e);
+	size_t len = std::distance(b, e);
+
+	//Inline data dies with its string: short slices are copies
+	if(is_inline())
+	{
+		dstring d{len};
+		std::copy(b, e, d._data);
+		d._flags |= _flags & flags::cinsensitive;
+		d.set_valid(len);
+		return d;
+	}
+
+	dstring d{*this};
+	d._data += b - cbegin();
+	d._size = len;
+	d._capacity = len;
+	d.set_valid(len);
+	return d;
+}
+
+dstring dstring::slice(size_t pos, size_t count) const noexcept
+{
+	if(count < size() - pos)
+		return slice(cbegin()+pos, cbegin()+pos+count);
+	else
+		return slice(cbegin()+pos, cend());
+}
+
 bool dstring::operator==( const dstring& other) const  noexcept
 {
 	if(_size != other._size)
@@ -304,39 +399,25 @@ dstring& dstring::append(const char* ndata, size_t len) noexcept
 		assert(_size <= _capacity);
 
 		size_t rsize {_size + len};
-		size_t ncapacity = _capacity > 0? _capacity: rsize;
-
-		while(ncapacity < rsize)
-			ncapacity *=2;
 
-		if(ncapacity > _capacity)
+		//Shared storage is never written: it could belong to a slice or to a copy
+		bool writable = is_inline() || (owns_block() && !is_shared() && _data == _block->data());
+		if(!writable || rsize > _capacity)
 		{
-			char *tmp = new char[ncapacity];
-			_capacity = ncapacity;
-
-			if( is_valid() )
-			{
-				if( is_ci() )
-					std::transform(_data, _data + _size, tmp, ::tolower );
-				else
-					std::copy_n(_data, _size, tmp);
-			}
-			else
-			{
-				assert(_data == nullptr);
-				assert(_size == 0);
-			}
+			size_t ncapacity = _capacity > 0? _capacity: rsize;
+			while(ncapacity < rsize)
+				ncapacity *=2;
 
-			if(!_refcount || *_refcount)
-				_refcount = new uint(0);
+			dstring grown{ncapacity, is_ci()};
+			if( is_ci() )
+				std::transform(_data, _data + _size, grown._data, ::tolower );
 			else
-				delete[] _data;
-
-			_data = tmp;
+				std::copy_n(_data, _size, grown._data);
+			grown._size = _size;
+			*this = std::move(grown);
 		}
 
 		set_valid();
-		set_immutable(false);
 
 		if( is_ci() )
 			std::transform(ndata, ndata + len, _data + _size, ::tolower );
@@ -6,6 +6,9 @@
 #include <type_traits>
 #include <cctype>
 #include <cstring>
+#include <memory>
+
+#include "arena.h"
 
 class dstring
 {
@@ -15,16 +18,41 @@ class dstring
 	{
 		valid = 1,
 		cinsensitive = 1<<1,
-		immutable = 1<<2
+		immutable = 1<<2,
+		sso = 1<<3
+	};
+
+	/** Refcount and data share a single allocation; data follows the block.
+	 * The data of an external block is the owner of storage allocated elsewhere. */
+	struct block
+	{
+		uint refcount;
+		bool external;
+		utils::arena::origin arena;
+		char* data() noexcept { return reinterpret_cast<char*>(this + 1); }
 	};
 
+	using external_owner = std::shared_ptr<const void>;
+
+	static constexpr size_t sso_capacity{16};
+
 	uint8_t _flags{0};
 	size_t _size{0};
 	size_t _capacity{0};
-	uint* _refcount{nullptr};
 	char* _data{nullptr};
+	union
+	{
+		block* _block{nullptr}; // nullptr when inline or not owning (copy of an immutable)
+		char _inline[sso_capacity];
+	};
+
+	static block* allocate(size_t capacity);
+	static void release(block* b) noexcept;
 
 	void reset();
+	void init(size_t capacity) noexcept;
+	void copy_from(const dstring& other) noexcept;
+	void steal(dstring& other) noexcept;
 	explicit dstring(size_t t, const bool caseins = false) noexcept;
 	explicit dstring(const char* c , size_t, const bool, const bool) noexcept;
 
@@ -55,6 +83,9 @@ class dstring
 	bool is_valid() const noexcept { return _flags&flags::valid; }
 	bool is_ci() const noexcept { return _flags&flags::cinsensitive; }
 	bool is_immutable() const noexcept { return _flags&flags::immutable; }
+	bool is_inline() const noexcept { return _flags&flags::sso; }
+	bool owns_block() const noexcept { return !is_inline() && _block; }
+	bool is_shared() const noexcept { return owns_block() && !is_immutable() && _block->refcount; }
 public:
 	static constexpr size_t npos = static_cast<size_t>(-1);
 
@@ -70,6 +101,13 @@ public:
 
 	static const dstring make_immutable(const char*, const bool caseins = false) noexcept;
 
+	/**
+	 * Returns a dstring pointing to storage allocated elsewhere, e.g. a mapped file: no copy is made,
+	 * and owner keeps the storage alive as long as the dstring, its copies or its slices exist.
+	 * The storage is never written; appending detaches the dstring.
+	 */
+	static dstring wrap(const char* data, size_t len, external_owner owner) noexcept;
+
 	dstring(const bool caseins = false) noexcept;
 	dstring(const char*, size_t, const bool caseins = false) noexcept;
 	dstring(const dstring&) noexcept;
@@ -160,4 +198,12 @@ public:
 	dstring clone(std::function<char(char)> fn = nullptr) const noexcept;
 	dstring substr(const_iterator b , const_iterator e, std::function<char(char)> fn = nullptr) const noexcept;
 	dstring substr(size_t pos, size_t count = npos, std::function<char(char)> fn = nullptr) const noexcept;
+
+	/**
+	 * Returns a dstring that points inside this one's storage, sharing its refcount:
+	 * no copy is made and the whole storage stays alive as long as the slice does.
+	 * Appending to a slice detaches it.
+	 */
+	dstring slice(const_iterator b, const_iterator e) const noexcept;
+	dstring slice(size_t pos, size_t count = npos) const noexcept;
 };
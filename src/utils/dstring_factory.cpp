@@ -9,15 +9,15 @@ dstring_factory::dstring_factory(const size_t len, const bool caseins)
 
 dstring_factory::~dstring_factory()
 {
-	if(_data)
-		delete _data;
+	if(_block)
+		dstring::release(_block);
 }
 
 char* dstring_factory::data() noexcept
 {
-	if(!_data)
-		_data = new char[_size];
-	return _data;
+	if(!_block)
+		_block = dstring::allocate(_size);
+	return _block->data();
 }
 
 size_t dstring_factory::max_size() const noexcept
@@ -29,7 +29,7 @@ dstring dstring_factory::create_dstring(const size_t len) noexcept
 {
 	assert(len <= _size);
 	dstring d;
-	if(_data)
+	if(_block)
 	{
 		if(len)
 			d.set_valid();
@@ -38,8 +38,32 @@ dstring dstring_factory::create_dstring(const size_t len) noexcept
 
 		d._size = len;
 		d._capacity = _size;
-		d._data = _data;
-		_data = nullptr;
+		d._data = _block->data();
+		d._block = _block;
+		_block = nullptr;
 	}
 	return d;
 }
+
+dstring dstring_factory::join(const std::vector<dstring>& chunks)
+{
+	if(chunks.empty())
+		return {};
+	if(chunks.size() == 1)
+		return chunks.front();
+
+	size_t size{0};
+	for(auto&& c : chunks)
+		size += c.size();
+
+	dstring_factory joined{size};
+	auto out = joined.data();
+	for(auto&& c : chunks)
+	{
+		if(!c.size())
+			continue;
+		std::memcpy(out, c.cdata(), c.size());
+		out += c.size();
+	}
+	return joined.create_dstring(size);
+}
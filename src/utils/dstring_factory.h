@@ -2,11 +2,13 @@
 
 #include "dstring.h"
 
+#include <vector>
+
 class dstring_factory
 {
 	const size_t _size;
 	const bool _caseins;
-	char* _data{nullptr};
+	dstring::block* _block{nullptr};
 public:
 	dstring_factory(const size_t, const bool caseins = false);
 	~dstring_factory();
@@ -16,4 +18,7 @@ public:
 
 	dstring create_dstring(const size_t len) noexcept;
 	dstring create_dstring() noexcept { return create_dstring(_size); }
+
+	/** Concatenates chunks in a single exactly sized dstring. */
+	static dstring join(const std::vector<dstring>& chunks);
 };
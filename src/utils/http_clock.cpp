@@ -0,0 +1,100 @@
+#include "http_clock.h"
+#include "arena.h"
+#include "../log/format.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio/steady_timer.hpp>
+
+namespace utils
+{
+
+namespace
+{
+
+std::atomic_bool ticking{false};
+
+// The io_services of the threads whose timers are running
+std::mutex services_mutex;
+std::vector<boost::asio::io_service*> services;
+
+struct clock_state
+{
+	std::time_t second{-1};
+	dstring value;
+	std::unique_ptr<boost::asio::steady_timer> timer;
+};
+
+thread_local clock_state state;
+
+void refresh(std::chrono::system_clock::time_point now)
+{
+	auto second = std::chrono::system_clock::to_time_t(now);
+	if(second == state.second)
+		return;
+
+	// Outlives any transaction
+	arena::scope heap{nullptr};
+	const auto& date = logging::format::http_header_date(now);
+	state.value = dstring{date.data(), date.size()};
+	state.second = second;
+}
+
+void tick(const boost::system::error_code& ec)
+{
+	if(!ticking)
+	{
+		// Its io_service may not outlive the thread
+		state.timer.reset();
+		return;
+	}
+	if(ec)
+		return;
+
+	auto now = std::chrono::system_clock::now();
+	refresh(now);
+
+	// Wake up right after the next second begins
+	auto elapsed = now.time_since_epoch() % std::chrono::seconds{1};
+	state.timer->expires_from_now(std::chrono::seconds{1} - elapsed);
+	state.timer->async_wait(tick);
+}
+
+}
+
+void http_clock::start(boost::asio::io_service& ios)
+{
+	{
+		std::lock_guard<std::mutex> lock{services_mutex};
+		if(std::find(services.begin(), services.end(), &ios) == services.end())
+			services.push_back(&ios);
+	}
+	ticking = true;
+	state.timer.reset(new boost::asio::steady_timer{ios});
+	tick({});
+}
+
+void http_clock::stop() noexcept
+{
+	ticking = false;
+
+	// Timers belong to their threads: each one is canceled by the thread running it
+	std::lock_guard<std::mutex> lock{services_mutex};
+	for(auto ios : services)
+		ios->post([](){ if(state.timer) state.timer->cancel(); });
+	services.clear();
+}
+
+const dstring& http_clock::date() noexcept
+{
+	if(!state.timer || !ticking)
+		refresh(std::chrono::system_clock::now());
+	return state.value;
+}
+
+} // namespace utils
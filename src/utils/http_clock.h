@@ -0,0 +1,35 @@
+#ifndef DOORMAT_HTTP_CLOCK_H_
+#define DOORMAT_HTTP_CLOCK_H_
+
+#include "dstring.h"
+
+#include <boost/asio/io_service.hpp>
+
+namespace utils
+{
+
+/**
+ * @brief The http_clock class keeps the HTTP-date of the current second,
+ * so that each response doesn't need to format its own.
+ *
+ * Every thread has its copy. Once started, a timer on the io_service
+ * of the thread refreshes it on each second; otherwise it is refreshed
+ * when asked for, if the second has changed.
+ */
+class http_clock
+{
+public:
+	/** Starts the refresh timer of the calling thread. */
+	static void start(boost::asio::io_service& ios);
+	/**
+	 * Cancels the timers of all threads, so that their io_services run out of work
+	 * at once; the io_services are to be alive until they run.
+	 */
+	static void stop() noexcept;
+
+	static const dstring& date() noexcept;
+};
+
+} // namespace utils
+
+#endif // DOORMAT_HTTP_CLOCK_H_
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include "../src/utils/arena.h"
+#include "../src/utils/dstring.h"
+#include "../src/http/http_headers.h"
+
+#include <string>
+
+TEST(arena, heap_without_scope)
+{
+	utils::arena a;
+	EXPECT_FALSE(utils::arena::active());
+	auto p = utils::arena::allocate(100);
+	utils::arena::deallocate(p, utils::arena::current());
+	EXPECT_EQ(a.reserved(), 0);
+}
+
+TEST(arena, scope)
+{
+	utils::arena a;
+	{
+		utils::arena::scope use{a};
+		EXPECT_TRUE(utils::arena::active());
+		{
+			utils::arena b;
+			utils::arena::scope nested{b};
+			utils::arena::deallocate(utils::arena::allocate(100), utils::arena::current());
+			EXPECT_GT(b.reserved(), 0);
+		}
+		EXPECT_TRUE(utils::arena::active());
+		EXPECT_EQ(a.reserved(), 0);
+	}
+	EXPECT_FALSE(utils::arena::active());
+}
+
+TEST(arena, use)
+{
+	utils::arena a;
+	utils::arena b;
+	{
+		utils::arena::scope use{nullptr};
+		a.use();
+		utils::arena::deallocate(utils::arena::allocate(100), utils::arena::current());
+		b.use();
+		utils::arena::deallocate(utils::arena::allocate(100), utils::arena::current());
+		utils::arena::deallocate(utils::arena::allocate(100), utils::arena::current());
+	}
+	EXPECT_FALSE(utils::arena::active());
+	EXPECT_GT(a.reserved(), 0);
+	EXPECT_EQ(a.reserved(), b.reserved());
+}
+
+TEST(arena, monotonic)
+{
+	utils::arena a{1024};
+	utils::arena::scope use{a};
+	void* p[20];
+	for(auto&& m : p)
+		m = utils::arena::allocate(100);
+	auto reserved = a.reserved();
+	EXPECT_GE(reserved, 20 * 100);
+	EXPECT_LT(reserved, 4 * 1024);
+
+	for(auto&& m : p)
+		utils::arena::deallocate(m, utils::arena::current());
+	// Nothing is reused before the arena is gone
+	auto again = utils::arena::allocate(100);
+	for(auto&& m : p)
+		EXPECT_NE(m, again);
+	EXPECT_EQ(a.reserved(), reserved);
+	utils::arena::deallocate(again, utils::arena::current());
+}
+
+TEST(arena, oversized)
+{
+	utils::arena a{256};
+	utils::arena::scope use{a};
+	auto p = utils::arena::allocate(4096);
+	EXPECT_GE(a.reserved(), 4096);
+	utils::arena::deallocate(p, utils::arena::current());
+}
+
+TEST(arena, shared_within)
+{
+	utils::arena a;
+	utils::arena::scope use{a};
+	dstring s{"a value longer than the inline storage"};
+	dstring copy{s};
+	EXPECT_EQ(copy.cdata(), s.cdata());
+	auto reserved = a.reserved();
+	http::header_list headers;
+	headers.insert("x-forwarded-for", s);
+	EXPECT_EQ(headers.find("x-forwarded-for")->second.cdata(), s.cdata());
+	EXPECT_EQ(a.reserved(), reserved);
+}
+
+TEST(arena, copied_out)
+{
+	dstring escaped;
+	http::header_list kept;
+	{
+		utils::arena a;
+		utils::arena::scope use{a};
+		dstring s{"a value longer than the inline storage"};
+		http::header_list headers;
+		headers.insert("x-forwarded-for", s);
+
+		utils::arena::scope heap{nullptr};
+		escaped = s;
+		EXPECT_NE(escaped.cdata(), s.cdata());
+		kept = headers;
+		EXPECT_NE(kept.find("x-forwarded-for")->second.cdata(), s.cdata());
+		auto copy = headers;
+		kept = std::move(copy);
+	}
+	EXPECT_EQ(std::string(escaped), "a value longer than the inline storage");
+	EXPECT_EQ(std::string(kept.find("x-forwarded-for")->second), "a value longer than the inline storage");
+}
+
+TEST(arena, pinned)
+{
+	dstring escaped;
+	http::header_list kept;
+	{
+		utils::arena a;
+		utils::arena::scope use{a};
+		dstring s{"a value longer than the inline storage"};
+		http::header_list headers;
+		headers.insert("x-forwarded-for", s);
+
+		// Copies within the arena share its memory, which stays until they are gone
+		escaped = s;
+		EXPECT_EQ(escaped.cdata(), s.cdata());
+		kept = std::move(headers);
+	}
+	EXPECT_EQ(std::string(escaped), "a value longer than the inline storage");
+	EXPECT_EQ(std::string(kept.find("x-forwarded-for")->second), "a value longer than the inline storage");
+}
+
+TEST(arena, moved)
+{
+	utils::arena a;
+	utils::arena b{std::move(a)};
+	{
+		utils::arena::scope use{b};
+		utils::arena::deallocate(utils::arena::allocate(100), utils::arena::current());
+	}
+	EXPECT_GT(b.reserved(), 0);
+	EXPECT_EQ(a.reserved(), 0);
+	{
+		utils::arena::scope use{a};
+		EXPECT_FALSE(utils::arena::active());
+	}
+}
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <algorithm>
 #include <chrono>
+#include <thread>
 
 
 using namespace test_utils;
@@ -275,9 +276,13 @@ service::locator::service_pool().get_thread_io_service().run();
 }
 
 
+/*
+ * the order of eviction is the one of the policy only within a shard:
+ * a single one is used to verify it.
+ */
 TEST_F(cache_test, eviction_without_ttl)
 {
-	cache<fifo_policy> cache(302);
+	cache<fifo_policy, std::string, 1024 * 1024, 1> cache(302);
 	std::vector<std::pair<std::string, bool>> inserted_elements;
 
 	std::string key;
@@ -328,6 +333,122 @@ TEST_F(cache_test, eviction_without_ttl)
 }
 
 
+/*
+ * shards share the byte budget: writing on a shard
+ * evicts the elements of the others as well.
+ */
+TEST_F(cache_test, sharded_eviction)
+{
+	cache<fifo_policy> cache(302);
+
+	std::string key;
+	for(int i = 0; i < 100; ++i)
+	{
+		key = std::to_string(i);
+		cache.begin_put(key, 100,std::chrono::system_clock::now());
+		cache.put(key, key);
+		cache.end_put(key);
+	}
+
+	boost::asio::deadline_timer wait_fs(service::locator::service_pool().get_thread_io_service());
+	int wait_attempts{0};
+	wait_fs.expires_from_now(boost::posix_time::milliseconds(10));
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	wait_fun = [&](const boost::system::error_code&ec)
+	{
+		if(!cache.has(key) && wait_attempts++ < 2000)
+		{
+			wait_fs.expires_from_now(boost::posix_time::milliseconds(5));
+			wait_fs.async_wait(wait_fun);
+			return;
+		}
+
+		for(int i = 0; i < 100; ++i)
+		{
+			key = std::to_string(i+100);
+			cache.begin_put(key, 100,std::chrono::system_clock::now());
+			cache.put(key, key);
+			cache.end_put(key);
+		}
+
+		wait_fs.expires_from_now(boost::posix_time::milliseconds(1000));
+		wait_fs.async_wait([&](const boost::system::error_code &ec){
+			ASSERT_LE(cache.size(), 302U);
+			size_t stored{0};
+			for(int i = 0; i < 200; ++i)
+				if(cache.has(std::to_string(i)))
+					++stored;
+			ASSERT_GT(stored, 0U);
+			ASSERT_LT(stored, 200U);
+			service::locator::service_pool().allow_graceful_termination();
+		});
+	};
+	wait_fs.async_wait(wait_fun);
+	service::locator::service_pool().get_thread_io_service().run();
+}
+
+/*
+ * threads putting and reading different keys,
+ * every one of them ends up in the cache.
+ */
+TEST_F(cache_test, concurrent_put_and_has)
+{
+	const int threads_number = 8;
+	const int keys_per_thread = 200;
+	cache<fifo_policy> c;
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < threads_number; ++t)
+	{
+		threads.emplace_back([&c, t]()
+		{
+			for(int i = 0; i < keys_per_thread; ++i)
+			{
+				auto key = std::to_string(t) + "/" + std::to_string(i);
+				EXPECT_FALSE(c.has(key));
+				ASSERT_TRUE(c.begin_put(key, 100, std::chrono::system_clock::now()));
+				c.put(key, key);
+				c.end_put(key);
+			}
+		});
+	}
+	for(auto& t: threads)
+		t.join();
+
+	auto stored = [&c]()
+	{
+		for(int t = 0; t < threads_number; ++t)
+			for(int i = 0; i < keys_per_thread; ++i)
+				if(!c.has(std::to_string(t) + "/" + std::to_string(i)))
+					return false;
+		return true;
+	};
+
+	boost::asio::deadline_timer wait_fs(service::locator::service_pool().get_thread_io_service());
+	int wait_attempts{0};
+	wait_fs.expires_from_now(boost::posix_time::milliseconds(10));
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	wait_fun = [&](const boost::system::error_code&ec)
+	{
+		if(!stored() && wait_attempts++ < 2000)
+		{
+			wait_fs.expires_from_now(boost::posix_time::milliseconds(5));
+			wait_fs.async_wait(wait_fun);
+			return;
+		}
+
+		ASSERT_TRUE(stored());
+		size_t total_size{0};
+		for(int t = 0; t < threads_number; ++t)
+			for(int i = 0; i < keys_per_thread; ++i)
+				total_size += (std::to_string(t) + "/" + std::to_string(i)).size();
+		ASSERT_EQ(c.size(), total_size);
+		service::locator::service_pool().allow_graceful_termination();
+	};
+	wait_fs.async_wait(wait_fun);
+	service::locator::service_pool().get_thread_io_service().run();
+}
+
 TEST_F(cache_test, tagging)
 {
 	cache<fifo_policy> cache(4096);
@@ -439,6 +560,343 @@ TEST_F(cache_test, put_and_get_empty)
 
 }
 
+/*
+ * once read from disk an element is kept in memory:
+ * the next reads are served before get returns.
+ */
+TEST_F(cache_test, get_from_memory)
+{
+	const std::string key = "cicciopasticcio";
+	const std::string value = "cicciobistecca";
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	cache<fifo_policy> c(4096, "/tmp/cache/", 4096 * 16);
+	ASSERT_TRUE(c.begin_put(key, 1000, std::chrono::system_clock::now()));
+	c.put(key, value);
+	c.end_put(key, true);
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	timer.expires_from_now(wait_time);
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		if(!c.has(key) && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+
+		ASSERT_TRUE(c.get(key, [&](std::shared_ptr<const std::vector<uint8_t>> from_disk)
+		{
+			ASSERT_EQ(std::string(from_disk->begin(), from_disk->end()), value);
+
+			bool served{false};
+			std::shared_ptr<const std::vector<uint8_t>> from_memory;
+			ASSERT_TRUE(c.get(key, [&](std::shared_ptr<const std::vector<uint8_t>> data)
+			{
+				served = true;
+				from_memory = std::move(data);
+			}));
+			ASSERT_TRUE(served);
+			ASSERT_EQ(std::string(from_memory->begin(), from_memory->end()), value);
+
+			// an invalidated element is not served anymore, readers still hold their data
+			c.invalidate(key);
+			ASSERT_FALSE(c.get(key, [](std::vector<uint8_t> data) { EXPECT_TRUE(data.empty()); }));
+			ASSERT_EQ(from_memory->size(), value.size());
+			service::locator::service_pool().allow_graceful_termination();
+		}));
+	};
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
+/*
+ * big contents are mapped from the disk; a view keeps them readable after their removal.
+ */
+TEST_F(cache_test, get_mapped)
+{
+	const std::string key = "cicciopasticcio";
+	const std::string value(cache<fifo_policy>::map_threshold + 1, 'c');
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	cache<fifo_policy> c(4 * value.size());
+	ASSERT_TRUE(c.begin_put(key, 1000, std::chrono::system_clock::now()));
+	c.put(key, value);
+	c.end_put(key, true);
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	timer.expires_from_now(wait_time);
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		if(!c.has(key) && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+
+		bool served{false};
+		dstring view;
+		ASSERT_TRUE(c.get(key, [&](dstring data)
+		{
+			served = true;
+			view = std::move(data);
+		}));
+		// mapped contents are served before returning
+		ASSERT_TRUE(served);
+		ASSERT_EQ(std::string(view), value);
+
+		c.invalidate(key);
+		ASSERT_FALSE(c.has(key));
+		ASSERT_EQ(std::string(view), value);
+		service::locator::service_pool().allow_graceful_termination();
+	};
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
+/*
+ * a content is written a segment at a time while it is put: the bytes on the disk
+ * count in the size of the cache before the commit.
+ */
+TEST_F(cache_test, put_in_segments)
+{
+	const std::string key = "cicciopasticcio";
+	const std::string segment(cache<fifo_policy>::segment_size, 's');
+	const size_t segments = 4;
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	cache<fifo_policy> c(4 * segments * segment.size());
+	ASSERT_TRUE(c.begin_put(key, 1000, std::chrono::system_clock::now()));
+	size_t put_segments{0};
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		if(c.size() < put_segments * segment.size() && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+		ASSERT_EQ(c.size(), put_segments * segment.size());
+		ASSERT_FALSE(c.has(key));
+		if(put_segments < segments)
+		{
+			ASSERT_TRUE(c.put(key, segment));
+			++put_segments;
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+
+		// everything is on the disk already
+		c.end_put(key, true);
+		ASSERT_TRUE(c.has(key));
+		ASSERT_TRUE(c.get(key, [&](dstring data)
+		{
+			ASSERT_EQ(data.size(), segments * segment.size());
+			for(size_t i = 0; i < segments; ++i)
+				ASSERT_EQ(std::string(data.slice(i * segment.size(), segment.size())), segment);
+			service::locator::service_pool().allow_graceful_termination();
+		}));
+	};
+	timer.expires_from_now(wait_time);
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
+/*
+ * a put faster than the disk keeps what cannot be written yet,
+ * and writes it as the segments before complete.
+ */
+TEST_F(cache_test, put_waiting_for_a_slow_disk)
+{
+	const std::string key = "cicciopasticcio";
+	const std::string segment(cache<fifo_policy>::segment_size, 's');
+	const size_t segments = cache<fifo_policy>::max_writing_segments + cache<fifo_policy>::max_waiting_size / segment.size();
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	cache<fifo_policy> c(4 * segments * segment.size());
+	ASSERT_TRUE(c.begin_put(key, 1000, std::chrono::system_clock::now()));
+	// the writes complete on this thread: none of them can have completed yet
+	for(size_t i = 0; i < segments; ++i)
+		ASSERT_TRUE(c.put(key, segment));
+	c.end_put(key, true);
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		if(!c.has(key) && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+		ASSERT_TRUE(c.has(key));
+		ASSERT_EQ(c.size(), segments * segment.size());
+		ASSERT_TRUE(c.get(key, [&](dstring data)
+		{
+			ASSERT_EQ(data.size(), segments * segment.size());
+			for(size_t i = 0; i < segments; ++i)
+				ASSERT_EQ(std::string(data.slice(i * segment.size(), segment.size())), segment);
+			service::locator::service_pool().allow_graceful_termination();
+		}));
+	};
+	timer.expires_from_now(wait_time);
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
+/*
+ * a put keeping too much for the disk is given up,
+ * so that the memory it takes stays bounded; the stats count it.
+ */
+TEST_F(cache_test, put_given_up_when_disk_is_late)
+{
+	service::locator::stats_manager().register_handler();
+	service::locator::stats_manager().start();
+	const std::string key = "cicciopasticcio";
+	const std::string segment(cache<fifo_policy>::segment_size, 's');
+	const size_t segments = cache<fifo_policy>::max_writing_segments + cache<fifo_policy>::max_waiting_size / segment.size();
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	cache<fifo_policy> c(16 * segments * segment.size());
+	ASSERT_TRUE(c.begin_put(key, 1000, std::chrono::system_clock::now()));
+	// the writes complete on this thread: none of them can have completed yet
+	for(size_t i = 0; i < segments; ++i)
+		ASSERT_TRUE(c.put(key, segment));
+	ASSERT_FALSE(c.put(key, segment));
+	c.end_put(key, true);
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		// the key can be put again once the writes of the old put are over
+		if(!c.begin_put(key, 1000, std::chrono::system_clock::now()) && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+		ASSERT_LT(wait_count, max_wait_count);
+		ASSERT_FALSE(c.has(key));
+		ASSERT_EQ(c.size(), 0U);
+		c.end_put(key, false);
+		std::this_thread::sleep_for(stats::stats_manager::c_collection_period * 2);
+		EXPECT_EQ(service::locator::stats_manager().get_value(stats::cache_fills_abandoned), 1);
+		service::locator::service_pool().allow_graceful_termination();
+	};
+	timer.expires_from_now(wait_time);
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
+/** Calls f once the filesystem manager has written what it was asked before, the records of the journals included */
+static void after_writes(std::function<void()> f)
+{
+	static const std::vector<uint8_t> nothing;
+	service::locator::fs_manager().async_append("/tmp/cache/barrier", nothing,
+		[f](const cynny::cynnypp::filesystem::ErrorCode&, size_t) { f(); });
+}
+
+/*
+ * a cache restoring the contents finds the elements stored by the previous one;
+ * otherwise it starts empty.
+ */
+TEST_F(cache_test, restore_after_restart)
+{
+	const std::string key = "cicciopasticcio";
+	const std::string tagged_key = "cicciobistecca";
+	const std::string value = "cicciocaramella";
+	auto& io = service::locator::service_pool().get_thread_io_service();
+	boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer(io);
+	const auto wait_time = std::chrono::milliseconds(20);
+	size_t wait_count{};
+	const size_t max_wait_count = 100;
+
+	std::unique_ptr<cache<fifo_policy>> c{new cache<fifo_policy>(4096)};
+	ASSERT_TRUE(c->begin_put(key, 1000, std::chrono::system_clock::now()));
+	c->put(key, value);
+	c->end_put(key, true);
+	ASSERT_TRUE(c->begin_put(tagged_key, 1000, std::chrono::system_clock::now(), std::string("tag"), std::string("etag")));
+	c->put(tagged_key, value);
+	c->end_put(tagged_key, true);
+
+	std::function<void(const boost::system::error_code &)> wait_fun;
+	timer.expires_from_now(wait_time);
+	wait_fun = [&](const boost::system::error_code& ec)
+	{
+		if((!c->has(key) || !c->has(tagged_key)) && ++wait_count < max_wait_count)
+		{
+			timer.expires_from_now(wait_time);
+			timer.async_wait(wait_fun);
+			return;
+		}
+		ASSERT_EQ(c->size(), 2 * value.size());
+
+		// the previous cache must be gone, and its journals written, before the next one reads them
+		c.reset();
+		after_writes([&]()
+		{
+			c.reset(new cache<fifo_policy>(4096, "/tmp/cache/", 0, true));
+			ASSERT_TRUE(c->has(key));
+			ASSERT_TRUE(c->has(tagged_key));
+			ASSERT_EQ(c->size(), 2 * value.size());
+			ASSERT_TRUE(c->verify_version(tagged_key, std::string("etag")));
+			ASSERT_TRUE(c->get(key, [&](std::vector<uint8_t> data)
+			{
+				ASSERT_EQ(std::string(data.begin(), data.end()), value);
+
+				// the tag index is restored too
+				ASSERT_EQ(c->clear_tag("tag"), value.size());
+				c.reset();
+				after_writes([&]()
+				{
+					c.reset(new cache<fifo_policy>(4096, "/tmp/cache/", 0, true));
+					ASSERT_TRUE(c->has(key));
+					ASSERT_FALSE(c->has(tagged_key));
+
+					c.reset();
+					c.reset(new cache<fifo_policy>(4096));
+					ASSERT_FALSE(c->has(key));
+					ASSERT_EQ(c->size(), 0U);
+					service::locator::service_pool().allow_graceful_termination();
+				});
+			}));
+		});
+	};
+	timer.async_wait(wait_fun);
+
+	io.run();
+}
+
 /*
  * put and invalidate an element
  */
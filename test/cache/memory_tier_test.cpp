@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "../../src/cache/memory_tier.h"
+
+using data_t = memory_tier<int>::data_t;
+
+static data_t make_data(size_t size, uint8_t value = 0)
+{
+	return std::make_shared<const std::vector<uint8_t>>(size, value);
+}
+
+TEST(memory_tier_test, put_and_get)
+{
+	memory_tier<int> m{100};
+	auto d = make_data(10, 3);
+	m.put(1, d);
+	ASSERT_EQ(m.get(1), d);
+	ASSERT_EQ(m.get(2), nullptr);
+	ASSERT_EQ(m.size(), 10U);
+}
+
+TEST(memory_tier_test, least_recently_used_is_dropped)
+{
+	memory_tier<int> m{30};
+	m.put(1, make_data(10));
+	m.put(2, make_data(10));
+	m.put(3, make_data(10));
+	ASSERT_NE(m.get(1), nullptr);
+	m.put(4, make_data(10));
+	ASSERT_NE(m.get(1), nullptr);
+	ASSERT_EQ(m.get(2), nullptr);
+	ASSERT_NE(m.get(3), nullptr);
+	ASSERT_NE(m.get(4), nullptr);
+	ASSERT_EQ(m.size(), 30U);
+}
+
+TEST(memory_tier_test, too_big)
+{
+	memory_tier<int> m{30};
+	m.put(1, make_data(10));
+	m.put(2, make_data(31));
+	ASSERT_EQ(m.get(2), nullptr);
+	ASSERT_NE(m.get(1), nullptr);
+
+	memory_tier<int> disabled;
+	disabled.put(1, make_data(0));
+	ASSERT_EQ(disabled.get(1), nullptr);
+}
+
+TEST(memory_tier_test, replace_and_remove)
+{
+	memory_tier<int> m{100};
+	m.put(1, make_data(10));
+	m.put(1, make_data(20, 1));
+	ASSERT_EQ(m.size(), 20U);
+	ASSERT_EQ(m.get(1)->at(0), 1);
+	m.remove(1);
+	m.remove(1);
+	ASSERT_EQ(m.get(1), nullptr);
+	ASSERT_EQ(m.size(), 0U);
+}
+
+TEST(memory_tier_test, readers_keep_data)
+{
+	memory_tier<int> m{100};
+	m.put(1, make_data(10, 7));
+	auto held = m.get(1);
+	m.clear();
+	ASSERT_EQ(m.get(1), nullptr);
+	ASSERT_EQ(held->size(), 10U);
+	ASSERT_EQ(held->at(9), 7);
+}
+
+TEST(memory_tier_test, shrink)
+{
+	memory_tier<int> m{100};
+	for(int i = 0; i < 10; ++i)
+		m.put(i, make_data(10));
+	m.set_max_size(25);
+	ASSERT_EQ(m.size(), 20U);
+	ASSERT_NE(m.get(9), nullptr);
+	ASSERT_NE(m.get(8), nullptr);
+	ASSERT_EQ(m.get(7), nullptr);
+}
@@ -1,2 +1,157 @@
 #include <gtest/gtest.h>
 
+#include "../../src/cache/policies/fifo.h"
+#include "../../src/cache/policies/slru.h"
+#include "../../src/cache/policies/s3fifo.h"
+#include "../../src/cache/policies/wtinylfu.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+template<typename policy_t>
+struct policy_test : public ::testing::Test
+{
+	policy_t policy;
+	std::vector<int> removed;
+
+	void SetUp() override
+	{
+		policy.set_remove_callback([this](int k){ removed.push_back(k); });
+	}
+};
+
+using policies = ::testing::Types<fifo_policy<int>, slru_policy<int>, s3fifo_policy<int>, wtinylfu_policy<int>>;
+TYPED_TEST_CASE(policy_test, policies);
+
+TYPED_TEST(policy_test, free_space)
+{
+	for(int i = 0; i < 10; ++i)
+		this->policy.put(i, 10);
+
+	ASSERT_EQ(this->policy.free_space(0), 0U);
+	ASSERT_TRUE(this->removed.empty());
+
+	ASSERT_GE(this->policy.free_space(25), 25U);
+	ASSERT_EQ(this->removed.size(), 3U);
+
+	ASSERT_EQ(this->policy.free_space(1000), 70U);
+	ASSERT_EQ(this->removed.size(), 10U);
+	ASSERT_EQ(std::set<int>(this->removed.begin(), this->removed.end()).size(), 10U);
+	ASSERT_EQ(this->policy.free_space(1000), 0U);
+}
+
+TYPED_TEST(policy_test, remove)
+{
+	for(int i = 0; i < 10; ++i)
+		this->policy.put(i, 10);
+	for(int i = 0; i < 10; i += 2)
+		this->policy.remove(i);
+	this->policy.remove(2);
+	this->policy.remove(100);
+	this->policy.touch(4);
+
+	ASSERT_EQ(this->policy.free_space(1000), 50U);
+	for(auto k: this->removed)
+		ASSERT_EQ(k % 2, 1);
+}
+
+TYPED_TEST(policy_test, put_again)
+{
+	this->policy.put(1, 10);
+	this->policy.put(1, 20);
+	this->policy.put(2, 5);
+	ASSERT_EQ(this->policy.free_space(1000), 25U);
+	ASSERT_EQ(this->removed.size(), 2U);
+}
+
+/** Elements touched are kept while a scan of elements seen once goes through */
+template<typename policy_t>
+static void scan_resistance()
+{
+	policy_t policy;
+	std::set<int> held;
+	policy.set_remove_callback([&held](int k){ held.erase(k); });
+
+	const int popular = 20;
+	for(int k = 0; k < popular; ++k)
+	{
+		policy.put(k, 1);
+		held.insert(k);
+	}
+	for(int round = 0; round < 3; ++round)
+		for(int k = 0; k < popular; ++k)
+			policy.touch(k);
+
+	// a cache holding 100 elements
+	for(int k = 1000; k < 2000; ++k)
+	{
+		policy.put(k, 1);
+		held.insert(k);
+		if(held.size() > 100) policy.free_space(held.size() - 100);
+		if(k % 10 == 0)
+			for(int p = 0; p < popular; ++p)
+				if(held.count(p)) policy.touch(p);
+	}
+
+	for(int k = 0; k < popular; ++k)
+		EXPECT_TRUE(held.count(k)) << k;
+}
+
+TEST(policy_test, slru_scan_resistance)
+{
+	scan_resistance<slru_policy<int>>();
+}
+
+TEST(policy_test, s3fifo_scan_resistance)
+{
+	scan_resistance<s3fifo_policy<int>>();
+}
+
+TEST(policy_test, wtinylfu_scan_resistance)
+{
+	scan_resistance<wtinylfu_policy<int>>();
+}
+
+TEST(policy_test, s3fifo_ghost)
+{
+	s3fifo_policy<int> policy;
+	std::vector<int> removed;
+	policy.set_remove_callback([&removed](int k){ removed.push_back(k); });
+	for(int k = 0; k < 10; ++k)
+		policy.put(k, 1);
+	// 0 is evicted from the small queue; back again, it goes to the main one
+	policy.free_space(1);
+	ASSERT_EQ(removed.back(), 0);
+	policy.put(0, 1);
+	policy.free_space(9);
+	ASSERT_EQ(removed.size(), 10U);
+	ASSERT_EQ(std::count(removed.begin(), removed.end(), 0), 1);
+}
+
+TEST(policy_test, frequency_sketch)
+{
+	frequency_sketch<int> sketch{256};
+	for(int i = 0; i < 10; ++i)
+		sketch.increment(1);
+	sketch.increment(2);
+	ASSERT_GE(sketch.frequency(1), 10U);
+	ASSERT_GE(sketch.frequency(2), 1U);
+	ASSERT_LT(sketch.frequency(2), 10U);
+
+	// counters saturate, and are halved as samples grow
+	for(int i = 0; i < 100; ++i)
+		sketch.increment(1);
+	ASSERT_EQ(sketch.frequency(1), 15U);
+	for(int i = 0; i < 10 * 256; ++i)
+		sketch.increment(1000 + i);
+	ASSERT_LT(sketch.frequency(1), 15U);
+
+	// a wider sketch keeps the counts it is given
+	frequency_sketch<int> wider{1024};
+	wider.restore(1, sketch.frequency(1));
+	wider.restore(2, 100);
+	ASSERT_EQ(wider.frequency(1), sketch.frequency(1));
+	ASSERT_EQ(wider.frequency(2), 15U);
+	ASSERT_EQ(wider.frequency(3), 0U);
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include "../../src/cache/tag.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+TEST(tag_test, insert_and_remove)
+{
+	tagger<std::string, int> t;
+	t.insert("html", 3);
+	t.insert("html", 0);
+	t.insert("css", 7);
+	ASSERT_EQ(t.size("html"), 2U);
+	ASSERT_EQ(t.tags_count(), 2U);
+
+	ASSERT_EQ(t.remove(3), "html");
+	ASSERT_EQ(t.remove(3), "");
+	ASSERT_EQ(t.remove(42), "");
+	ASSERT_EQ(t.size("html"), 1U);
+
+	ASSERT_EQ(t.remove(7), "css");
+	ASSERT_EQ(t.tags_count(), 1U);
+}
+
+TEST(tag_test, retag)
+{
+	tagger<std::string, int> t;
+	t.insert("html", 1);
+	t.insert("js", 1);
+	ASSERT_EQ(t.size("html"), 0U);
+	ASSERT_EQ(t.size("js"), 1U);
+	ASSERT_EQ(t.remove(1), "js");
+}
+
+TEST(tag_test, clear)
+{
+	tagger<std::string, int> t;
+	for(int i = 0; i < 10; ++i)
+		t.insert(i % 2 ? "odd" : "even", i);
+	t.remove(4);
+
+	std::vector<int> cleared;
+	t.clear("even", [&cleared](int id) { cleared.push_back(id); });
+	std::sort(cleared.begin(), cleared.end());
+	ASSERT_EQ(cleared, (std::vector<int>{0, 2, 6, 8}));
+	ASSERT_EQ(t.size("even"), 0U);
+	ASSERT_EQ(t.size("odd"), 5U);
+
+	t.clear("missing", [](int) { FAIL(); });
+	ASSERT_EQ(t.remove(2), "");
+	ASSERT_EQ(t.remove(3), "odd");
+}
+
+TEST(tag_test, many_tags)
+{
+	tagger<std::string, int> t;
+	const int count = 10000;
+	for(int i = 0; i < count; ++i)
+		t.insert("surrogate-" + std::to_string(i % 5000), i);
+	ASSERT_EQ(t.tags_count(), 5000U);
+	ASSERT_EQ(t.size("surrogate-42"), 2U);
+
+	for(int i = 0; i < count; i += 2)
+		ASSERT_EQ(t.remove(i), "surrogate-" + std::to_string(i % 5000));
+	ASSERT_EQ(t.tags_count(), 2500U);
+	for(int i = 1; i < count; i += 2)
+		t.remove(i);
+	ASSERT_EQ(t.tags_count(), 0U);
+}
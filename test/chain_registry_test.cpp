@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "../src/protocol/chain_registry.h"
+#include "../src/protocol/handler_factory.h"
+#include "../src/configuration/configuration_wrapper.h"
+#include "../src/chain_of_responsibility/chain_of_responsibility.h"
+
+namespace
+{
+
+template<uint16_t Status>
+struct responder : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	void on_request_preamble(http::http_request&&)
+	{
+		http::http_response res;
+		res.status(Status);
+		on_header(std::move(res));
+	}
+};
+
+template<uint16_t Status>
+std::unique_ptr<node_interface> make_responder()
+{
+	return make_unique_chain<node_interface, responder<Status>>();
+}
+
+}
+
+TEST(chain_registry, select)
+{
+	server::chain_registry registry;
+	auto vod = registry.add("vod", make_responder<200>);
+	auto live = registry.add("live", make_responder<204>);
+
+	ASSERT_TRUE(registry.route("Media.cydev1.com", "", "vod"));
+	ASSERT_TRUE(registry.route("media.cydev1.com", "/live/", "live"));
+	ASSERT_FALSE(registry.route("media.cydev1.com", "/", "unknown"));
+	ASSERT_TRUE(registry.routing());
+
+	EXPECT_EQ(registry.select("media.cydev1.com", "/live/channel1"), live);
+	EXPECT_EQ(registry.select("MEDIA.cydev1.com:443", "/live/channel1"), live);
+	EXPECT_EQ(registry.select("media.cydev1.com", "/vod/movie.mp4"), vod);
+	EXPECT_EQ(registry.select("media.cydev1.com", "/live"), vod);
+	EXPECT_EQ(registry.select("www.cydev1.com", "/live/channel1"), server::chain_registry::default_chain);
+	EXPECT_EQ(registry.select("", "/"), server::chain_registry::default_chain);
+
+	ASSERT_TRUE(registry.route("media.cydev1.com", "/vod", "live"));
+	EXPECT_EQ(registry.select("media.cydev1.com", "/vod"), live);
+	EXPECT_EQ(registry.select("media.cydev1.com", "/vod/movie.mp4"), live);
+	EXPECT_EQ(registry.select("media.cydev1.com", "/vodka"), vod);
+
+	ASSERT_TRUE(registry.configure({}));
+	EXPECT_FALSE(registry.routing());
+}
+
+TEST(chain_registry, selector)
+{
+	auto& registry = server::handler_interface::chains();
+	registry.add("test_live", make_responder<204>);
+	ASSERT_TRUE(registry.configure({{"media.cydev1.com", "/live/", "test_live"}}));
+
+	uint16_t status{0};
+	node_interface* used{nullptr};
+	for(int i = 0; i < 2; ++i)
+	{
+		auto chain = server::handler_interface::acquire_chain();
+		// The selector is pooled like the chains it selects
+		if(used)
+			EXPECT_EQ(chain.get(), used);
+		used = chain.get();
+		chain->initialize_callbacks([&status](http::http_response&& res) { status = res.status_code(); },
+			[](dstring &&) {}, [](dstring &&, dstring &&) {}, []() {}, [](const errors::error_code &) {}, []() {});
+
+		http::http_request req{true};
+		req.hostname("media.cydev1.com");
+		req.path("/live/channel1");
+		chain->on_request_preamble(std::move(req));
+		EXPECT_EQ(status, 204);
+		status = 0;
+		server::handler_interface::release_chain(std::move(chain));
+	}
+
+	registry.configure({});
+}
@@ -11,6 +11,8 @@
 #include "../src/http/http_codec.h"
 #include "../src/http/http_request.h"
 #include "../src/http/http_response.h"
+#include "../src/http_parser/http_scan.h"
+#include "../src/utils/arena.h"
 
 namespace
 {
@@ -572,4 +574,203 @@ TEST( codec, too_long_uri )
 	EXPECT_TRUE(fcb_called);
 }
 
+TEST( codec, decode_splitted_header )
+{
+	const std::string r1 = "GET /static/ind";
+	const std::string r2 = "ex.html?a=b HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"User-Ag";
+	const std::string r3 = "ent: curl/7.50.1\r\n"
+		"Content-Length: 4\r\n"
+		"\r\n"
+		"bo";
+	const std::string r4 = "dy";
+
+	http::http_request r;
+	bool eom{false};
+	std::string body;
+	auto codec_scb = [&r](http::http_structured_data** data){ *data = &r; };
+	auto codec_hcb = [](){};
+	auto codec_bcb = [&body](dstring&& b){ body.append(std::string(b)); };
+	auto codec_tcb = [](dstring&&, dstring&&){ FAIL(); };
+	auto codec_ccb = [&eom](){ eom = true; };
+	auto codec_fcb = [](int, bool&){ FAIL(); };
+
+	http_codec decoder;
+	decoder.register_callback(codec_scb,codec_hcb,codec_bcb,codec_tcb,codec_ccb,codec_fcb);
+	for( auto&& chunk : { r1, r2, r3, r4 } )
+	{
+		//Parsed tokens must not refer to the caller buffer
+		std::string read{chunk};
+		decoder.decode(read.data(), read.size());
+		std::fill(read.begin(), read.end(), 'x');
+	}
+
+	ASSERT_TRUE(eom);
+	EXPECT_EQ(std::string(r.path()), "/static/index.html");
+	EXPECT_EQ(std::string(r.query()), "a=b");
+	EXPECT_EQ(std::string(r.header("host")), "localhost");
+	EXPECT_EQ(std::string(r.header("user-agent")), "curl/7.50.1");
+	EXPECT_EQ(body, "body");
+}
+
+TEST( codec, body_off_the_arena )
+{
+	const std::string preamble = "POST /upload HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"Content-Length: 100000\r\n"
+		"\r\n";
+
+	utils::arena mem;
+	utils::arena::scope use{mem};
+	http::http_request r;
+	bool eom{false};
+	size_t received{0};
+	auto codec_scb = [&r](http::http_structured_data** data){ *data = &r; };
+	auto codec_hcb = [](){};
+	auto codec_bcb = [&received](dstring&& b){ received += b.size(); };
+	auto codec_tcb = [](dstring&&, dstring&&){ FAIL(); };
+	auto codec_ccb = [&eom](){ eom = true; };
+	auto codec_fcb = [](int, bool&){ FAIL(); };
+
+	http_codec decoder;
+	decoder.register_callback(codec_scb,codec_hcb,codec_bcb,codec_tcb,codec_ccb,codec_fcb);
+	ASSERT_TRUE(decoder.decode(preamble.data(), preamble.size()));
+	EXPECT_EQ(std::string(r.header("host")), "localhost");
+	auto reserved = mem.reserved();
+
+	//A body trickling in small reads does not grow the arena of the request
+	const std::string read(100, 'x');
+	for(size_t i = 0; i < 1000; ++i)
+		ASSERT_TRUE(decoder.decode(read.data(), read.size()));
+	EXPECT_TRUE(eom);
+	EXPECT_EQ(received, 100000U);
+	EXPECT_EQ(mem.reserved(), reserved);
+}
+
+TEST( codec, scan_modes )
+{
+	// Long enough to go through the 16 and 32 bytes blocks, plus a tail
+	const std::string ua{"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/54.0.2840.71"};
+	const std::string req = "GET /path HTTP/1.1\r\n"
+		"accept-language-and-some-more-padding-here: it-IT,it;q=0.8,en-US;q=0.6\r\n"
+		"host: localhost\r\n"
+		"user-agent: " + ua + "\r\n"
+		"x.dotted.Header: val\tue\r\n"
+		"\r\n";
+
+	for( auto mode : { HTTP_SCAN_SCALAR, HTTP_SCAN_SSE42, HTTP_SCAN_AVX2 } )
+	{
+		http_scan_set_mode( mode );
+		http::http_request r;
+		bool eom{false};
+		auto codec_scb = [&r](http::http_structured_data** data){ *data = &r; };
+		auto codec_hcb = [](){};
+		auto codec_bcb = [](dstring&&){ FAIL(); };
+		auto codec_tcb = [](dstring&&, dstring&&){ FAIL(); };
+		auto codec_ccb = [&eom](){ eom = true; };
+		auto codec_fcb = [](int, bool&){ FAIL(); };
+
+		http_codec decoder;
+		decoder.register_callback(codec_scb,codec_hcb,codec_bcb,codec_tcb,codec_ccb,codec_fcb);
+		decoder.decode(req.data(), req.size());
+
+		ASSERT_TRUE(eom);
+		EXPECT_EQ(std::string(r.header("user-agent")), ua);
+		EXPECT_EQ(std::string(r.header("accept-language-and-some-more-padding-here")), "it-IT,it;q=0.8,en-US;q=0.6");
+		EXPECT_EQ(std::string(r.header("x.dotted.header")), "val\tue");
+	}
+
+	http_scan_set_mode( HTTP_SCAN_AUTO );
+}
+
+TEST( codec, invalid_header_value )
+{
+	// A control char in the middle of a long value must not be skipped
+	std::string req = "GET /path HTTP/1.1\r\n"
+		"user-agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\x01 (KHTML, like Gecko)\r\n"
+		"\r\n";
+
+	http::http_request r;
+	auto codec_scb = [&r](http::http_structured_data** data){ *data = &r; };
+	auto codec_hcb = [](){ FAIL(); };
+	auto codec_bcb = [](dstring&&){ FAIL(); };
+	auto codec_tcb = [](dstring&&, dstring&&){ FAIL(); };
+	auto codec_ccb = [](){ FAIL(); };
+
+	bool fcb_called{false};
+	auto codec_fcb = [&fcb_called](int code, bool&)
+	{
+		fcb_called = true;
+		EXPECT_EQ(code, HPE_INVALID_HEADER_TOKEN);
+	};
+
+	http_codec decoder;
+	decoder.register_callback(codec_scb,codec_hcb,codec_bcb,codec_tcb,codec_ccb,codec_fcb);
+	decoder.decode(req.data(), req.size());
+
+	EXPECT_TRUE(fcb_called);
+}
+
+TEST( codec, encode_res_bytes )
+{
+	http_response message;
+	message.protocol(proto_version::HTTP11);
+	message.status(404);
+	message.keepalive(false);
+	message.header("via", "1");
+	message.header("via", "2");
+	message.header("cookie", "a=1");
+	message.header("cookie", "b=2");
+
+	http_codec encoder;
+	auto encoded = encoder.encode_header(message);
+	EXPECT_EQ(std::string(encoded), "HTTP/1.1 404 Not Found\r\n"
+		"connection: close\r\ncontent-length: 0\r\ncookie: a=1; b=2\r\nvia: 1, 2\r\n\r\n");
+
+	// Encoded once, until something changes
+	EXPECT_EQ(message.serialize().cdata(), encoded.cdata());
+	message.keepalive(false);
+	EXPECT_EQ(message.serialize().cdata(), encoded.cdata());
+
+	message.status(404, "Nowhere");
+	EXPECT_EQ(std::string(message.serialize()), "HTTP/1.1 404 Nowhere\r\n"
+		"connection: close\r\ncontent-length: 0\r\ncookie: a=1; b=2\r\nvia: 1, 2\r\n\r\n");
+
+	message.status(204);
+	message.remove_header("cookie");
+	EXPECT_EQ(std::string(message.serialize()), "HTTP/1.1 204 No Content\r\n"
+		"connection: close\r\ncontent-length: 0\r\nvia: 1, 2\r\n\r\n");
+}
+
+TEST( codec, stop_after_message )
+{
+	http::http_request msg{false};
+	http_codec upgrading;
+	int messages{0};
+
+	auto scb = [&msg](http::http_structured_data** data){*data=&msg;};
+	auto hcb = [](){};
+	auto bcb = [](dstring&&){};
+	auto tcb = [](dstring&&, dstring&&){};
+	auto ccb = [&upgrading, &messages](){ if(++messages == 1) upgrading.stop_after_message(); };
+	auto fcb = [](int,bool&){FAIL();};
+	upgrading.register_callback(scb,hcb,bcb,tcb,ccb,fcb);
+
+	const std::string upgrade = "GET / HTTP/1.1\r\nhost: localhost\r\n"
+		"connection: Upgrade, HTTP2-Settings\r\nupgrade: h2c\r\nhttp2-settings: AAMAAABkAAQAAP__\r\n\r\n";
+	const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+	const std::string read = upgrade + preface;
+
+	ASSERT_TRUE(upgrading.decode(read.data(), read.size()));
+	EXPECT_EQ(messages, 1);
+	EXPECT_EQ(upgrading.decoded(), upgrade.size());
+
+	// Stopping is for one message only
+	const std::string next = "GET /next HTTP/1.1\r\n\r\nGET /last HTTP/1.1\r\n\r\n";
+	ASSERT_TRUE(upgrading.decode(next.data(), next.size()));
+	EXPECT_EQ(messages, 3);
+	EXPECT_EQ(upgrading.decoded(), next.size());
+}
+
 }//namespace
@@ -17,6 +17,7 @@ TEST(cor_propagation, request_propagation)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         void on_request_preamble(http::http_request&& message) {  ++count; base::on_request_preamble(std::move(message)); }
 		void on_request_body(dstring&& chunk) {  ++count; base::on_request_body(std::move(chunk)); }
@@ -25,6 +26,7 @@ TEST(cor_propagation, request_propagation)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         void on_request_preamble(http::http_request&& message) { ++count; base::on_request_preamble(std::move(message)); }
 		void on_request_body(dstring&& chunk) { ++count; base::on_request_body(std::move(chunk)); }
@@ -47,6 +49,7 @@ TEST(cor_propagation, request_propagation_and_on_body)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		n1() {}
 
@@ -59,6 +62,7 @@ TEST(cor_propagation, request_propagation_and_on_body)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
 
@@ -72,6 +76,7 @@ TEST(cor_propagation, request_propagation_and_on_body)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		n3() {}
 
@@ -98,6 +103,7 @@ TEST(cor_propagation, multiple_body_propagation)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
     };
@@ -105,6 +111,7 @@ TEST(cor_propagation, multiple_body_propagation)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
     };
@@ -112,6 +119,7 @@ TEST(cor_propagation, multiple_body_propagation)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -138,6 +146,7 @@ TEST(cor_propagation, request_propagation_on_header)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
 
@@ -150,6 +159,7 @@ TEST(cor_propagation, request_propagation_on_header)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
 
@@ -163,6 +173,7 @@ TEST(cor_propagation, request_propagation_on_header)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -188,6 +199,7 @@ TEST(cor_propagation, end_of_message)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
     };
@@ -195,6 +207,7 @@ TEST(cor_propagation, end_of_message)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
     };
@@ -202,6 +215,7 @@ TEST(cor_propagation, end_of_message)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -229,6 +243,7 @@ TEST(cor_propagation, error)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
     };
@@ -236,6 +251,7 @@ TEST(cor_propagation, error)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
     };
@@ -243,6 +259,7 @@ TEST(cor_propagation, error)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -269,6 +286,7 @@ TEST(cor_propagation, trailer_propagation)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
 
@@ -281,6 +299,7 @@ TEST(cor_propagation, trailer_propagation)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
 
@@ -294,6 +313,7 @@ TEST(cor_propagation, trailer_propagation)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		n3() {}
 
@@ -319,6 +339,7 @@ TEST(cor_propagation, middle_error)
 	struct n1 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
     };
@@ -326,6 +347,7 @@ TEST(cor_propagation, middle_error)
 	struct n2 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n2() {}
 
@@ -339,6 +361,7 @@ TEST(cor_propagation, middle_error)
 	struct n3 : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -369,6 +392,7 @@ TEST(cor_propagation, asynchronous_fw)
 	count = 0;
 	struct n1 : public node_interface {
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
 
@@ -385,6 +409,7 @@ TEST(cor_propagation, asynchronous_fw)
 
         int ciao = 0;
 		using node_interface::node_interface;
+		void reset() {}
 		void on_request_preamble(http::http_request&& message)
 		{
 			local_io_service.post([this, &message](){
@@ -398,6 +423,7 @@ TEST(cor_propagation, asynchronous_fw)
 	struct n3: public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -429,6 +455,7 @@ TEST(cor_propagation, asynchronous_bw)
 	count = 0;
 	struct n1 : public node_interface {
 		using node_interface::node_interface;
+		void reset() {}
 
         n1() {}
 
@@ -445,6 +472,7 @@ TEST(cor_propagation, asynchronous_bw)
 
         int ciao = 0;
 		using node_interface::node_interface;
+		void reset() {}
 		void on_request_preamble(http::http_request&& message)
 		{
 			local_io_service.post([this, &message]()
@@ -471,6 +499,7 @@ TEST(cor_propagation, asynchronous_bw)
 	struct n3: public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
         n3() {}
 
@@ -500,4 +529,57 @@ TEST(cor_propagation, asynchronous_bw)
 	ASSERT_TRUE(has_called_asynchronously);
 }
 
+TEST(cor_propagation, reset)
+{
+	count = 0;
+	static int resets{0};
+	resets = 0;
+
+	struct forwarding : public node_interface
+	{
+		using node_interface::node_interface;
+
+		bool seen{false};
+
+		void on_request_body(dstring&& chunk)
+		{
+			ASSERT_FALSE(seen);
+			seen = true;
+			base::on_request_body(std::move(chunk));
+		}
+
+		void reset() { seen = false; ++resets; }
+	};
+
+	struct bouncing : public node_interface
+	{
+		using node_interface::node_interface;
+
+		bool seen{false};
+
+		void on_request_body(dstring&& chunk)
+		{
+			ASSERT_FALSE(seen);
+			seen = true;
+			base::on_body(std::move(chunk));
+		}
+
+		void reset() { seen = false; ++resets; }
+	};
+
+	auto c = make_unique_chain<node_interface, forwarding, forwarding, bouncing>();
+	c->initialize_callbacks([](http::http_response &&) {}, [](dstring &&) { ++count; }, [](dstring &&, dstring &&) {},
+		[]() {}, [](const errors::error_code &) {}, []() {});
+
+	c->on_request_body({});
+	ASSERT_EQ(count, 1);
+
+	c->reset();
+	ASSERT_EQ(resets, 3);
+
+	// Same chain, same nodes in their first state: both directions are still linked
+	c->on_request_body({});
+	ASSERT_EQ(count, 2);
+}
+
 }
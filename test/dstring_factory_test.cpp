@@ -48,3 +48,16 @@ TEST(dstring_factory, create_twice)
 	EXPECT_TRUE(d1 == d2);
 	EXPECT_FALSE( d1.cdata() == d2.cdata());
 }
+
+TEST(dstring_factory, join)
+{
+	std::vector<dstring> chunks{dstring{"header:"}, dstring{}, dstring{" a value long enough not to be inlined"}};
+	auto d = dstring_factory::join(chunks);
+	EXPECT_EQ(std::string(d), "header: a value long enough not to be inlined");
+	EXPECT_EQ(d.size(), 45);
+
+	// A single chunk is shared, not copied
+	chunks.erase(chunks.begin(), chunks.begin() + 2);
+	EXPECT_EQ(dstring_factory::join(chunks).cdata(), chunks.front().cdata());
+	EXPECT_FALSE(dstring_factory::join({}));
+}
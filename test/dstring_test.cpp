@@ -113,6 +113,59 @@ TEST(dstring, substr)
 	EXPECT_EQ((std::string{d3.cdata(), d3.size()}), "Ambaraba");
 }
 
+TEST(dstring, slice)
+{
+	dstring d1;
+	{
+		dstring d{"AmbarabaCiciCocoTreCivetteSulComo"};
+		d1 = d.slice(8, 4);
+		EXPECT_EQ(d1.cdata(), d.cdata() + 8);
+		EXPECT_EQ(std::string(d1), "Cici");
+
+		auto d2 = d.slice(d.cbegin() + 12, d.cbegin() + 16);
+		EXPECT_EQ(std::string(d2), "Coco");
+		EXPECT_FALSE(d.slice(3, 0));
+	}
+
+	//The storage outlives the string that owned it
+	EXPECT_EQ(std::string(d1), "Cici");
+
+	//Appending detaches
+	auto d3 = d1;
+	d1.append("Coco");
+	EXPECT_EQ(std::string(d1), "CiciCoco");
+	EXPECT_EQ(std::string(d3), "Cici");
+
+	//Short strings are stored inline: slicing them copies
+	dstring d4{"Ambaraba"};
+	auto d5 = d4.slice(0, 4);
+	EXPECT_NE(d5.cdata(), d4.cdata());
+	EXPECT_EQ(std::string(d5), "Amba");
+}
+
+TEST(dstring, wrap)
+{
+	auto storage = std::make_shared<std::string>("AmbarabaCiciCocoTreCivetteSulComo");
+	std::weak_ptr<std::string> alive = storage;
+	dstring d1;
+	{
+		auto d = dstring::wrap(storage->data(), storage->size(), storage);
+		storage.reset();
+		EXPECT_EQ(d.cdata(), alive.lock()->data());
+		d1 = d.slice(8, 4);
+		EXPECT_EQ(std::string(d1), "Cici");
+	}
+
+	//Slices keep the owner alive
+	EXPECT_FALSE(alive.expired());
+	auto d2 = d1;
+	d2.append("Coco");
+	EXPECT_EQ(std::string(d2), "CiciCoco");
+	EXPECT_EQ(std::string(alive.lock()->substr(8, 4)), "Cici");
+	d1 = dstring{};
+	EXPECT_TRUE(alive.expired());
+}
+
 TEST(dstring, converters)
 {
 	size_t int_value;
@@ -156,23 +209,36 @@ TEST(dstring, find)
 
 TEST(dstring, append)
 {
-	dstring d1("abcd");
-	EXPECT_EQ(d1.size(), 4);
+	dstring d1("abcdefghijklmnopq");
+	EXPECT_EQ(d1.size(), 17);
 
-	d1.append("efgh",4);
-	EXPECT_EQ(d1.size(), 8);
+	d1.append("rstu",4);
+	EXPECT_EQ(d1.size(), 21);
 
 	dstring d2 = d1;
 	EXPECT_TRUE(d2 == d1);
 	EXPECT_TRUE(d2.cdata() == d1.cdata());
 
-	d1.append("ilmn",4);
-	EXPECT_EQ(d1.size(), 12);
+	d1.append("vwxy",4);
+	EXPECT_EQ(d1.size(), 25);
 	EXPECT_FALSE(d2 == d1);
 	EXPECT_FALSE(d2.cdata() == d1.cdata());
 
+	EXPECT_EQ(std::string(d2),"abcdefghijklmnopqrstu");
+	EXPECT_EQ(std::string(d1),"abcdefghijklmnopqrstuvwxy");
+}
+
+TEST(dstring, append_inline)
+{
+	dstring d1("abcd");
+	d1.append("efgh",4);
+	dstring d2 = d1;
+	EXPECT_FALSE(d2.cdata() == d1.cdata());
+
+	//Crossing the inline capacity
+	d1.append("ilmnopqrstuvz");
+	EXPECT_EQ(std::string(d1),"abcdefghilmnopqrstuvz");
 	EXPECT_EQ(std::string(d2),"abcdefgh");
-	EXPECT_EQ(std::string(d1),"abcdefghilmn");
 }
 
 TEST(dstring, append_insensitive)
@@ -11,6 +11,9 @@
 #include "../src/protocol/handler_factory.h"
 #include "../src/protocol/handler_http1.h"
 #include "../src/protocol/handler_http2.h"
+#include "../src/protocol/handler_cleartext.h"
+#include "../src/http2/session.h"
+#include "../src/utils/arena.h"
 
 #include "../src/dummy_node.h"
 
@@ -27,6 +30,9 @@ struct MockConnector : public server::connector_interface
 	MOCK_METHOD0(do_read, void());
 	boost::asio::ip::address origin() const override { return boost::asio::ip::address::from_string("127.0.0.1");}
 	bool is_ssl() const noexcept override { return true; }
+
+	server::handler_interface* current{nullptr};
+	void handler(server::handler_interface* h) override { current = h; h->connector(this); }
 };
 
 struct handler: public ::testing::Test
@@ -194,6 +200,68 @@ TEST_F(handler, http1_non_persistent)
 }
 
 
+TEST_F(handler, cleartext_http1)
+{
+	// The first byte could start the HTTP/2 preface, the second one cannot
+	std::string req =
+			"PUT / HTTP/1.1\r\n"
+			"host:localhost:1443\r\n"
+			"date: Tue, 17 May 2016 14:53:09 GMT\r\n"
+			"content-length: 0\r\n"
+			"connection: close\r\n"
+			"\r\n";
+
+	server::handler_factory factory;
+	auto sniffer = new server::handler_cleartext{factory};
+	conn.handler(sniffer);
+
+	std::string expected_response = "HTTP/1.1 200 OK\r\n"
+			"connection: close\r\n"
+			"content-length: 33\r\n"
+			"content-type: text/plain\r\n"
+			"date: Tue, 17 May 2016 14:53:09 GMT\r\n"
+			"\r\n"
+			"Ave client, dummy node says hello";
+
+	cb = [this]()
+	{
+		auto h = conn.current;
+		if(service::locator::service_pool().get_thread_io_service().stopped())
+			return;
+
+		dstring chunk;
+		while(h->on_write(chunk))
+		{
+			if(h->should_stop() || chunk.empty())
+			{
+				if(h->should_stop())
+					deadline->cancel();
+				break;
+			}
+
+			response.append(chunk);
+			chunk = {};
+		}
+
+		if(!h->should_stop())
+		{
+			service::locator::service_pool().get_thread_io_service().post(cb);
+		}
+	};
+
+	ASSERT_TRUE(sniffer->start());
+	// Bytes of the same buffer, as the connector hands them
+	ASSERT_TRUE(sniffer->on_read(req.data(), 1));
+	ASSERT_EQ(conn.current, sniffer);
+	ASSERT_TRUE(sniffer->on_read(req.data() + 1, req.size() - 1));
+	ASSERT_NE(dynamic_cast<server::handler_http1*>(conn.current), nullptr);
+
+	service::locator::service_pool().get_thread_io_service().run();
+	ASSERT_TRUE(conn.current->should_stop());
+	EXPECT_EQ(expected_response, response);
+	delete conn.current;
+}
+
 TEST_F(handler, http1_pipelining)
 {
 
@@ -258,3 +326,342 @@ TEST_F(handler, http1_pipelining)
 	ASSERT_TRUE(h1.should_stop());
 	EXPECT_EQ(expected_response, response);
 }
+
+namespace
+{
+
+/** Answers /slow after the others, with its path as body. */
+struct delayed_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	static size_t dispatched;
+	static size_t dispatched_before_slow_answer;
+
+	void on_request_preamble(http::http_request&& msg)
+	{
+		++dispatched;
+		path = msg.path();
+		auto delay = path == "/slow" ? boost::posix_time::milliseconds(50) : boost::posix_time::milliseconds(1);
+		timer.reset(new boost::asio::deadline_timer(service::locator::service_pool().get_thread_io_service()));
+		timer->expires_from_now(delay);
+		timer->async_wait([this](const boost::system::error_code& ec)
+		{
+			if(ec)
+				return;
+			if(path == "/slow")
+				dispatched_before_slow_answer = dispatched;
+
+			http::http_response preamble;
+			preamble.protocol(http::proto_version::HTTP11);
+			preamble.date(date);
+			preamble.status(200);
+			preamble.content_len(path.size());
+			on_header(std::move(preamble));
+			on_body(dstring{path.cdata(), path.size()});
+			on_end_of_message();
+		});
+	}
+
+private:
+	dstring path;
+	std::unique_ptr<boost::asio::deadline_timer> timer;
+};
+
+size_t delayed_node::dispatched;
+size_t delayed_node::dispatched_before_slow_answer;
+
+}
+
+TEST_F(handler, http1_pipelining_in_parallel)
+{
+	// Through the initializer, so that no pooled chain of the other tests is used
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, delayed_node>();
+	});
+	delayed_node::dispatched = 0;
+
+	std::string req =
+			"GET /slow HTTP/1.1\r\n"
+			"host:localhost:1443\r\n"
+			"\r\n"
+			"GET /fast HTTP/1.1\r\n"
+			"host:localhost:1443\r\n"
+			"\r\n"
+			"GET /last HTTP/1.1\r\n"
+			"host:localhost:1443\r\n"
+			"connection: close\r\n"
+			"\r\n";
+
+	server::handler_http1 h1{http::proto_version::HTTP11};
+	h1.connector(&conn);
+
+	std::string expected_response = "HTTP/1.1 200 OK\r\n"
+			"connection: keep-alive\r\n"
+			"content-length: 5\r\n"
+			"date: Tue, 17 May 2016 14:53:09 GMT\r\n"
+			"\r\n"
+			"/slow"
+			"HTTP/1.1 200 OK\r\n"
+			"connection: keep-alive\r\n"
+			"content-length: 5\r\n"
+			"date: Tue, 17 May 2016 14:53:09 GMT\r\n"
+			"\r\n"
+			"/fast"
+			"HTTP/1.1 200 OK\r\n"
+			"connection: close\r\n"
+			"content-length: 5\r\n"
+			"date: Tue, 17 May 2016 14:53:09 GMT\r\n"
+			"\r\n"
+			"/last";
+
+	cb = [this, &h1]()
+	{
+		if(service::locator::service_pool().get_thread_io_service().stopped())
+			return;
+
+		dstring chunk;
+		while(h1.on_write(chunk))
+		{
+			if(h1.should_stop() || chunk.empty())
+			{
+				if(h1.should_stop())
+					deadline->cancel();
+				break;
+			}
+
+			response.append(chunk);
+			chunk = {};
+		}
+
+		if(!h1.should_stop())
+			service::locator::service_pool().get_thread_io_service().post(cb);
+	};
+
+	ASSERT_TRUE(h1.start());
+	h1.on_read(req.data(), req.size());
+	service::locator::service_pool().get_thread_io_service().run();
+	ASSERT_TRUE(h1.should_stop());
+
+	// All of them were down the chain while the first one was still waited for
+	EXPECT_EQ(delayed_node::dispatched_before_slow_answer, 3);
+	EXPECT_EQ(expected_response, response);
+
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, dummy_node>();
+	});
+}
+
+namespace
+{
+
+/** Answers at once, while the arena of the stream is the current one: the body is allocated in it. */
+struct immediate_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	void on_request_preamble(http::http_request&&)
+	{
+		http::http_response preamble;
+		preamble.protocol(http::proto_version::HTTP11);
+		preamble.date(date);
+		preamble.status(200);
+		preamble.content_len(strlen(message));
+		on_header(std::move(preamble));
+		on_body(dstring{message});
+		on_end_of_message();
+	}
+};
+
+struct http2_client
+{
+	nghttp2_session* session{nullptr};
+	std::string body;
+	bool closed{false};
+
+	http2_client()
+	{
+		nghttp2_session_callbacks* callbacks;
+		nghttp2_session_callbacks_new(&callbacks);
+		nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks,
+			[](nghttp2_session*, uint8_t, int32_t, const uint8_t* data, size_t len, void* user_data)
+			{
+				static_cast<http2_client*>(user_data)->body.append(reinterpret_cast<const char*>(data), len);
+				return 0;
+			});
+		nghttp2_session_callbacks_set_on_stream_close_callback(callbacks,
+			[](nghttp2_session*, int32_t, uint32_t, void* user_data)
+			{
+				static_cast<http2_client*>(user_data)->closed = true;
+				return 0;
+			});
+		nghttp2_session_client_new(&session, callbacks, this);
+		nghttp2_session_callbacks_del(callbacks);
+	}
+
+	~http2_client() { nghttp2_session_del(session); }
+
+	/** Hands to the server what the client has to send. */
+	void send(server::handler_interface& server)
+	{
+		const uint8_t* data;
+		ssize_t len;
+		while((len = nghttp2_session_mem_send(session, &data)) > 0)
+			server.on_read(reinterpret_cast<const char*>(data), len);
+	}
+};
+
+}
+
+TEST_F(handler, http2_body_outliving_its_stream)
+{
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, immediate_node>();
+	});
+
+	auto& ios = service::locator::service_pool().get_thread_io_service();
+	auto session = new http2::session();
+	conn.handler(session);
+	http2_client client;
+
+	// What the session gives to write is held until the client reads it, as the connector
+	// holds it until the socket takes it: the stream and its arena are gone by then
+	std::vector<dstring> written;
+	cb = [&]()
+	{
+		std::vector<dstring> chunks;
+		{
+			// An arena current while writing is no place for what the socket takes later
+			utils::arena elsewhere;
+			utils::arena::scope use{elsewhere};
+			if(ios.stopped() || !session->on_write_chunks(chunks))
+				return;
+		}
+		std::move(chunks.begin(), chunks.end(), std::back_inserter(written));
+		ios.post([&]()
+		{
+			for(auto&& chunk : written)
+				nghttp2_session_mem_recv(client.session, reinterpret_cast<const uint8_t*>(chunk.cdata()), chunk.size());
+			written.clear();
+			if(client.closed)
+				return deadline->cancel();
+			client.send(*session);
+		});
+	};
+
+	ASSERT_TRUE(session->start());
+	nghttp2_submit_settings(client.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+	const nghttp2_nv request[] = {
+		{ (uint8_t*)":method", (uint8_t*)"GET", 7, 3, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":scheme", (uint8_t*)"https", 7, 5, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":authority", (uint8_t*)"localhost", 10, 9, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":path", (uint8_t*)"/", 5, 1, NGHTTP2_NV_FLAG_NONE } };
+	nghttp2_submit_request(client.session, nullptr, request, 4, nullptr, nullptr);
+	client.send(*session);
+	ios.run();
+
+	EXPECT_TRUE(client.closed);
+	EXPECT_EQ(client.body, message);
+	delete session;
+
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, dummy_node>();
+	});
+}
+
+namespace
+{
+
+/** Answers when told to: until then its stream stays open. */
+struct held_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	static std::vector<held_node*> held;
+
+	void on_request_preamble(http::http_request&&) { held.push_back(this); }
+
+	static void answer_all()
+	{
+		for(auto node : held)
+		{
+			http::http_response preamble;
+			preamble.protocol(http::proto_version::HTTP11);
+			preamble.date(date);
+			preamble.status(204);
+			node->on_header(std::move(preamble));
+			node->on_end_of_message();
+		}
+		held.clear();
+	}
+};
+
+std::vector<held_node*> held_node::held;
+
+}
+
+TEST_F(handler, http2_priority_frames_override_urgency)
+{
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, held_node>();
+	});
+
+	auto& ios = service::locator::service_pool().get_thread_io_service();
+	auto session = new http2::session();
+	conn.handler(session);
+	http2_client client;
+	// What the session writes is dropped: only the streams it opened are looked at
+	cb = [&]()
+	{
+		std::vector<dstring> chunks;
+		if(!ios.stopped())
+			session->on_write_chunks(chunks);
+	};
+
+	ASSERT_TRUE(session->start());
+	nghttp2_submit_settings(client.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+	const nghttp2_nv request[] = {
+		{ (uint8_t*)":method", (uint8_t*)"GET", 7, 3, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":scheme", (uint8_t*)"https", 7, 5, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":authority", (uint8_t*)"localhost", 10, 9, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)":path", (uint8_t*)"/", 5, 1, NGHTTP2_NV_FLAG_NONE },
+		{ (uint8_t*)"priority", (uint8_t*)"u=0", 8, 3, NGHTTP2_NV_FLAG_NONE } };
+	auto urgent = nghttp2_submit_request(client.session, nullptr, request, 5, nullptr, nullptr);
+	nghttp2_priority_spec spec;
+	nghttp2_priority_spec_init(&spec, 0, 100, 0);
+	auto weighted = nghttp2_submit_request(client.session, &spec, request, 5, nullptr, nullptr);
+	auto reprioritized = nghttp2_submit_request(client.session, nullptr, request, 5, nullptr, nullptr);
+	// The PRIORITY frame must follow the HEADERS: the client would send it first, while the stream is idle
+	client.send(*session);
+	nghttp2_priority_spec_init(&spec, 0, 32, 0);
+	nghttp2_submit_priority(client.session, NGHTTP2_FLAG_NONE, reprioritized, &spec);
+	client.send(*session);
+
+	auto weight = [session](std::int32_t id)
+	{
+		auto stream = nghttp2_session_find_stream(session->next_layer(), id);
+		return stream ? nghttp2_stream_get_weight(stream) : 0;
+	};
+	// The urgency of the header is the weight, unless the client sent one in the HEADERS or later
+	EXPECT_EQ(weight(urgent), 256);
+	EXPECT_EQ(weight(weighted), 100);
+	EXPECT_EQ(weight(reprioritized), 32);
+
+	held_node::answer_all();
+	deadline->cancel();
+	ios.run();
+	delete session;
+
+	server::handler_interface::chain_initializer([]()
+	{
+		return make_unique_chain<node_interface, dummy_node>();
+	});
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "../src/http/http_headers.h"
+#include "../src/http/http_commons.h"
+
+#include <string>
+#include <vector>
+
+TEST(headers, intern)
+{
+	EXPECT_EQ(http::header_key{http::hf_content_len}.id, http::header_id::content_len);
+	EXPECT_EQ(http::header_key{dstring{"host"}}.id, http::header_id::host);
+	EXPECT_EQ(http::header_key{"x-host"}.id, http::header_id::unknown);
+	EXPECT_EQ(http::header_key{"Host"}.id, http::header_id::unknown);
+	EXPECT_EQ(http::header_key{http::header_id::via}.hash, http::header_hash("via"));
+	EXPECT_EQ(std::string(http::header_name(http::header_id::transfer_encoding)), http::hf_transfer_encoding);
+}
+
+TEST(headers, sorted_as_multimap)
+{
+	http::header_list l;
+	l.insert("via", "1");
+	l.insert("accept", "2");
+	l.insert(http::header_id::via, "3");
+	l.insert("cookie", "4");
+
+	std::vector<std::string> order;
+	for(auto&& h : l)
+		order.push_back(std::string(h.first) + std::string(h.second));
+	EXPECT_EQ(order, (std::vector<std::string>{"accept2", "cookie4", "via1", "via3"}));
+
+	EXPECT_EQ(l.count("via"), 2);
+	EXPECT_EQ(std::string(l.find(http::header_id::via)->second), "1");
+	EXPECT_EQ(l.find("accept-encoding"), l.end());
+}
+
+TEST(headers, erase)
+{
+	http::header_list l;
+	l.insert("a", "1");
+	l.insert("b", "2");
+	l.insert("a", "3");
+
+	EXPECT_EQ(l.erase("a"), 2);
+	EXPECT_EQ(l.erase("a"), 0);
+	ASSERT_EQ(l.size(), 1);
+
+	l.erase_if([](const http::header_list::header_t& h){ return h.first == "b"; });
+	EXPECT_TRUE(l.empty());
+}
+
+TEST(headers, key_taken_from_an_entry)
+{
+	http::header_list l;
+	l.insert("x-a", "0");
+	http::header_key key{l.cbegin()->first};
+	// the list grows and moves its entries while the key refers to one of them
+	for(int i = 1; i < 64; ++i)
+		l.insert(key, dstring::to_string(i));
+	EXPECT_EQ(l.count(key), 64);
+	EXPECT_EQ(l.erase(key), 64);
+	EXPECT_TRUE(l.empty());
+}
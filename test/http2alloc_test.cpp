@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "../src/http2/http2alloc.h"
+
+#include <cstring>
+
+TEST(http2alloc, reuses_freed_blocks)
+{
+	http2::mem_pool pool;
+	auto a = pool.allocate(100);
+	auto reserved = pool.reserved();
+	EXPECT_GT(reserved, 0);
+	pool.deallocate(a);
+
+	// Same size class
+	EXPECT_EQ(pool.allocate(120), a);
+	EXPECT_NE(pool.allocate(100), a);
+	EXPECT_EQ(pool.reserved(), reserved);
+}
+
+TEST(http2alloc, realloc_keeps_content)
+{
+	http2::mem_pool pool;
+	auto p = static_cast<char*>(pool.reallocate(nullptr, 10));
+	std::memcpy(p, "123456789", 10);
+	EXPECT_EQ(pool.reallocate(p, 16), p);
+
+	p = static_cast<char*>(pool.reallocate(p, 2 * http2::mem_pool::max_pooled));
+	EXPECT_STREQ(p, "123456789");
+	p = static_cast<char*>(pool.reallocate(p, 4 * http2::mem_pool::max_pooled));
+	EXPECT_STREQ(p, "123456789");
+	EXPECT_EQ(pool.reallocate(p, 0), nullptr);
+}
+
+TEST(http2alloc, large_blocks)
+{
+	http2::mem_pool pool;
+	auto a = pool.allocate(http2::mem_pool::max_pooled + 1);
+	auto b = pool.allocate(http2::mem_pool::chunk_size * 2);
+	auto c = pool.allocate(http2::mem_pool::max_pooled * 3);
+	auto reserved = pool.reserved();
+	pool.deallocate(b);
+	EXPECT_LE(pool.reserved(), reserved - http2::mem_pool::chunk_size * 2);
+	pool.deallocate(a);
+	pool.deallocate(c);
+	EXPECT_EQ(pool.reserved(), 0);
+}
+
+TEST(http2alloc, nghttp2_hooks)
+{
+	http2::mem_pool pool;
+	nghttp2_mem mem = http2::create_allocator(pool);
+	auto p = static_cast<int*>(mem.calloc(16, sizeof(int), mem.mem_user_data));
+	for(int i = 0; i < 16; ++i)
+		EXPECT_EQ(p[i], 0);
+	mem.free(p, mem.mem_user_data);
+
+	// Whatever is left is released by the pool
+	mem.malloc(10000, mem.mem_user_data);
+	pool.release_on_destruction();
+	mem.free(mem.malloc(100, mem.mem_user_data), mem.mem_user_data);
+}
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include "../src/utils/http_clock.h"
+#include "../src/log/format.h"
+
+#include <chrono>
+#include <string>
+#include <boost/asio/io_service.hpp>
+
+TEST(http_clock, date)
+{
+	const auto& date = utils::http_clock::date();
+	ASSERT_EQ(date.size(), 29);
+
+	EXPECT_EQ(std::string(date).substr(25), " GMT");
+}
+
+TEST(http_clock, timer)
+{
+	boost::asio::io_service ios;
+	utils::http_clock::start(ios);
+	EXPECT_EQ(utils::http_clock::date().size(), 29);
+
+	ios.run_one();
+	EXPECT_EQ(std::string(utils::http_clock::date()),
+		logging::format::http_header_date(std::chrono::system_clock::now()));
+
+	// Once stopped, the timer is canceled and the io_service runs out of work without waiting it
+	utils::http_clock::stop();
+	auto begin = std::chrono::steady_clock::now();
+	ios.run();
+	EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds{500});
+	EXPECT_EQ(utils::http_clock::date().size(), 29);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "../../src/requests_manager/cache_manager/byte_range.h"
+
+using nodes::byte_range;
+
+TEST(byte_range, parse)
+{
+	byte_range range;
+	ASSERT_TRUE(byte_range::parse("bytes=100-199", range));
+	EXPECT_EQ(range.first, 100U);
+	EXPECT_EQ(range.last, 199U);
+	EXPECT_EQ(range.size(), 100U);
+
+	ASSERT_TRUE(byte_range::parse("bytes=100-", range));
+	EXPECT_EQ(range.first, 100U);
+	EXPECT_EQ(range.last, byte_range::unbounded);
+
+	ASSERT_TRUE(byte_range::parse("bytes=-100", range));
+	EXPECT_EQ(range.suffix, 100U);
+
+	for(auto wrong : {"", "bytes=", "bytes=-", "bytes=-0", "bytes=a-b", "bytes=5-1", "bytes=0-1,5-6", "items=0-1",
+		"bytes=99999999999999999999-"})
+		EXPECT_FALSE(byte_range::parse(wrong, range)) << wrong;
+}
+
+TEST(byte_range, resolve)
+{
+	byte_range range, resolved;
+	ASSERT_TRUE(byte_range::parse("bytes=100-", range));
+	ASSERT_TRUE(range.resolve(150, resolved));
+	EXPECT_EQ(resolved.first, 100U);
+	EXPECT_EQ(resolved.last, 149U);
+	EXPECT_EQ(resolved.content_range(150), "bytes 100-149/150");
+	EXPECT_EQ(range.last, byte_range::unbounded);
+
+	ASSERT_TRUE(byte_range::parse("bytes=-100", range));
+	ASSERT_TRUE(range.resolve(150, resolved));
+	EXPECT_EQ(resolved.first, 50U);
+	EXPECT_EQ(resolved.last, 149U);
+	EXPECT_EQ(resolved.suffix, 0U);
+	// the range asked is kept, to be resolved again against another size
+	ASSERT_TRUE(range.resolve(300, resolved));
+	EXPECT_EQ(resolved.first, 200U);
+	EXPECT_EQ(resolved.last, 299U);
+
+	ASSERT_TRUE(byte_range::parse("bytes=-200", range));
+	ASSERT_TRUE(range.resolve(150, resolved));
+	EXPECT_EQ(resolved.first, 0U);
+
+	ASSERT_TRUE(byte_range::parse("bytes=150-", range));
+	EXPECT_FALSE(range.resolve(150, resolved));
+	EXPECT_TRUE(range.resolve(151, resolved));
+	EXPECT_EQ(byte_range::unsatisfied(150), "bytes */150");
+}
+
+TEST(byte_range, slices)
+{
+	byte_range range;
+	ASSERT_TRUE(byte_range::parse("bytes=" + std::to_string(byte_range::slice_size - 1) + "-" +
+		std::to_string(2 * byte_range::slice_size), range));
+	EXPECT_EQ(range.first_slice(), 0U);
+	EXPECT_EQ(range.last_slice(), 2U);
+
+	uint64_t total = 2 * byte_range::slice_size + 10;
+	EXPECT_EQ(byte_range::slice_length(0, total), byte_range::slice_size);
+	EXPECT_EQ(byte_range::slice_length(2, total), 10U);
+	EXPECT_EQ(byte_range::slice_length(3, total), 0U);
+
+	byte_range asked;
+	asked.first = byte_range::slice_size;
+	EXPECT_EQ(asked.header(), "bytes=" + std::to_string(byte_range::slice_size) + "-");
+}
+
+TEST(byte_range, content_range)
+{
+	byte_range range;
+	uint64_t total = 0;
+	ASSERT_TRUE(byte_range::parse_content_range("bytes 0-99/1000", range, total));
+	EXPECT_EQ(range.first, 0U);
+	EXPECT_EQ(range.last, 99U);
+	EXPECT_EQ(total, 1000U);
+
+	byte_range unknown;
+	ASSERT_TRUE(byte_range::parse_content_range("bytes */500", unknown, total));
+	EXPECT_EQ(unknown.last, byte_range::unbounded);
+	EXPECT_EQ(total, 500U);
+
+	for(auto wrong : {"", "bytes 0-99/*", "bytes 0-99", "bytes 0-1000/1000", "bytes 9-1/10"})
+		EXPECT_FALSE(byte_range::parse_content_range(wrong, range, total)) << wrong;
+}
@@ -22,14 +22,14 @@ TEST_F(cache_cleaner_test, not_matching_req)
 	auto ch = make_unique_chain<node_interface, first_node, nodes::cache_cleaner, last_node>();
 	ch->on_request_preamble(std::move(req1));
 	ASSERT_TRUE(last_node::request); //it passed
-	last_node::reset();
+	last_node::clear();
 	auto ch2 = make_unique_chain<node_interface, first_node, nodes::cache_cleaner, last_node>();
 	http::http_request req2;
 	req2.method(http_method::HTTP_POST);
 	req2.path("/cache/clear");
 	ch2->on_request_preamble(std::move(req2));
 	ASSERT_TRUE(last_node::request); //it passed
-	last_node::reset();
+	last_node::clear();
 	auto ch3 = make_unique_chain<node_interface, first_node, nodes::cache_cleaner, last_node>();
 	http::http_request req3;
 	req3.method(http_method::HTTP_POST);
@@ -37,7 +37,7 @@ TEST_F(cache_cleaner_test, not_matching_req)
 	req3.hostname("ciaone.cynny.com");
 	ch3->on_request_preamble(std::move(req3));
 	ASSERT_TRUE(last_node::request); //it passed
-	last_node::reset();
+	last_node::clear();
 }
 
 TEST_F(cache_cleaner_test, clear_tag)
@@ -25,8 +25,9 @@ struct cache_manager_test : public ::preset::test
 struct last_node_normal : node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 	last_node_normal() {}
-	~last_node_normal() noexcept { reset(); }
+	~last_node_normal() noexcept { clear(); }
 	static boost::optional<http::http_request> request;
 	static uint req_body;
 	static uint req_trailer;
@@ -37,7 +38,7 @@ struct last_node_normal : node_interface
 	static int status_code;
 	static std::vector<std::pair<std::string, std::string>> headers;
 
-	static void reset()
+	static void clear()
 	{
 		request.reset();
 		req_body = 0;
@@ -127,8 +128,8 @@ TEST_F(cache_manager_test, first_goes_through_second_is_cached)
 		ASSERT_TRUE(last_node_normal::request->path() == uri);
 		ASSERT_TRUE(last_node_normal::request->hostname() == hostname);
 		ASSERT_TRUE(first_node::response->header("x-cache-status") == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await writing on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 							  {
@@ -187,8 +188,8 @@ TEST_F(cache_manager_test, not_modified_content) //todo: manage case in which, i
 					 ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 					 ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 					 ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-					 first_node::reset();
-					 last_node_normal::reset();
+					 first_node::clear();
+					 last_node_normal::clear();
 					 put_waiter.expires_from_now(boost::posix_time::seconds(2)); //await writing on disk.
 					 put_waiter.async_wait([&](const boost::system::error_code &ec)
 										   {
@@ -247,8 +248,8 @@ TEST_F(cache_manager_test, not_matching_etag) //todo: manage case in which, inst
 					 ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 					 ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 					 ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-					 first_node::reset();
-					 last_node_normal::reset();
+					 first_node::clear();
+					 last_node_normal::clear();
 					 put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await writing on disk.
 					 put_waiter.async_wait([&](const boost::system::error_code &ec)
 					 {
@@ -307,8 +308,8 @@ TEST_F(cache_manager_test, invalidate_on_modification_put_complete)
 					 ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 					 ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 					 ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-					 first_node::reset();
-					 last_node_normal::reset();
+					 first_node::clear();
+					 last_node_normal::clear();
 					 /** First the element gets saved on cache.*/
 					 put_waiter.expires_from_now(boost::posix_time::seconds(1));
 					 put_waiter.async_wait([&](const boost::system::error_code &ec)
@@ -322,8 +323,8 @@ TEST_F(cache_manager_test, invalidate_on_modification_put_complete)
 						 ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 						 ASSERT_TRUE(first_node::response);
 						 ASSERT_TRUE(first_node::response->status_code() == 200);
-						 first_node::reset();
-						 last_node_normal::reset();
+						 first_node::clear();
+						 last_node_normal::clear();
 						 /** Now send another get and see that it is a miss!*/
 						ch3->on_request_preamble(std::move(third));
 						ch3->on_request_finished(); /** This will give a miss; */
@@ -395,8 +396,8 @@ TEST_F(cache_manager_test, status_codes_allowed)
 					ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");  /** This one is always miss!*/
 					ASSERT_EQ(first_node::response->status_code(),current);
 
-					last_node_normal::reset();
-					first_node::reset();
+					last_node_normal::clear();
+					first_node::clear();
 					http::http_request req = verification_request;
 					/** Prepare and send another request... That's the only way to verify that it was in cache*/
 					current_chain = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
@@ -423,8 +424,8 @@ TEST_F(cache_manager_test, status_codes_allowed)
 								/** schedule another call*/
 								single_request_spawner.expires_from_now(boost::posix_time::milliseconds(100));
 								single_request_spawner.async_wait(spawn_request);
-								first_node::reset();
-								last_node_normal::reset();
+								first_node::clear();
+								last_node_normal::clear();
 							});
 
 				}
@@ -464,8 +465,8 @@ TEST_F(cache_manager_test, request_max_age_0)
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS"); /** Not found in cache*/
 		/** Now we send a new one*/
-		last_node_normal::reset();
-		first_node::reset();
+		last_node_normal::clear();
+		first_node::clear();
 		first_chain = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
 		http::http_request max_age_0{cached_request};
 		ASSERT_FALSE(first_node::response);
@@ -506,8 +507,8 @@ TEST_F(cache_manager_test, request_smaxage_0)
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS"); /** Not found in cache*/
 		/** Now we send a new one*/
-		last_node_normal::reset();
-		first_node::reset();
+		last_node_normal::clear();
+		first_node::clear();
 		first_chain = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
 		http::http_request max_age_0{cached_request};
 		ASSERT_FALSE(first_node::response);
@@ -549,8 +550,8 @@ TEST_F(cache_manager_test, request_no_cache)
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS"); /** Not found in cache*/
 		/** Now we send a new one*/
-		last_node_normal::reset();
-		first_node::reset();
+		last_node_normal::clear();
+		first_node::clear();
 		first_chain = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
 		http::http_request max_age_0{cached_request};
 		ASSERT_FALSE(first_node::response);
@@ -592,8 +593,8 @@ TEST_F(cache_manager_test, request_legacy_no_cache)
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS"); /** Not found in cache*/
 		/** Now we send a new one*/
-		last_node_normal::reset();
-		first_node::reset();
+		last_node_normal::clear();
+		first_node::clear();
 		first_chain = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
 		http::http_request max_age_0{cached_request};
 		ASSERT_FALSE(first_node::response);
@@ -643,8 +644,8 @@ TEST_F(cache_manager_test, response_max_age_0)
 		ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 		ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -668,8 +669,8 @@ TEST_F(cache_manager_test, response_max_age_0)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 }
 
 
@@ -707,8 +708,8 @@ TEST_F(cache_manager_test, response_no_cache)
 					 ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 					 ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 					 ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-					 first_node::reset();
-					 last_node_normal::reset();
+					 first_node::clear();
+					 last_node_normal::clear();
 					 put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 					 put_waiter.async_wait([&](const boost::system::error_code &ec)
 					 {
@@ -732,8 +733,8 @@ TEST_F(cache_manager_test, response_no_cache)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 }
 
 
@@ -771,8 +772,8 @@ TEST_F(cache_manager_test, response_max_age_verify)
 		ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 		ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(20)); //await so that it expires.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -796,8 +797,8 @@ TEST_F(cache_manager_test, response_max_age_verify)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 }
 
 TEST_F(cache_manager_test, invalid_cache_domain)
@@ -835,8 +836,8 @@ TEST_F(cache_manager_test, invalid_cache_domain)
 		ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 		ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -860,8 +861,8 @@ TEST_F(cache_manager_test, invalid_cache_domain)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 }
 
 
@@ -902,8 +903,8 @@ TEST_F(cache_manager_test, valid_cache_domain)
 		ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 		ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -928,8 +929,8 @@ TEST_F(cache_manager_test, valid_cache_domain)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 
 }
 
@@ -975,8 +976,8 @@ TEST_F(cache_manager_test, gzip_in_cache)
 		ASSERT_TRUE(std::string(last_node_normal::request->path()) == uri);
 		ASSERT_TRUE(std::string(last_node_normal::request->hostname()) == hostname);
 		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		/** Run the verifier: the stuff must be in cache*/
 		t1.expires_from_now(boost::posix_time::seconds(1));
 		t1.async_wait([&](const boost::system::error_code &ec)
@@ -991,8 +992,8 @@ TEST_F(cache_manager_test, gzip_in_cache)
 			ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
 			ASSERT_TRUE(std::string(first_node::res_body_str) != "the quick brown fox jumped over the lazy fox");
 			gzipped_data = std::string(first_node::res_body_str);
-			first_node::reset();
-			last_node_normal::reset();
+			first_node::clear();
+			last_node_normal::clear();
 			plain_req_check->on_request_preamble(std::move(plain_verifier));
 			plain_req_check->on_request_finished();
 			ASSERT_FALSE(last_node_normal::request);
@@ -1003,8 +1004,8 @@ TEST_F(cache_manager_test, gzip_in_cache)
 				ASSERT_TRUE(first_node::response);
 				ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
 				ASSERT_TRUE(std::string(first_node::res_body_str) == last_node_normal::_body);
-				first_node::reset();
-				last_node_normal::reset();
+				first_node::clear();
+				last_node_normal::clear();
 				gzip_req_check->on_request_preamble(std::move(gzip_verifier));
 				gzip_req_check->on_request_finished();
 				t4.expires_from_now(boost::posix_time::seconds(1));
@@ -1035,6 +1036,180 @@ TEST_F(cache_manager_test, gzip_in_cache)
 }
 
 
+TEST_F(cache_manager_test, range_of_cached_content)
+{
+	last_node_normal::_body = "thebody";
+	last_node_normal::headers.clear();
+	auto ch = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	auto ch2 = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	http::http_request first, second;
+	first.method(http_method::HTTP_GET);
+	std::string hostname = "www.ciaociao.org";
+	std::string uri = "/prova_range_of_cached_content.txt";
+	first.hostname(hostname.c_str());
+	first.path(uri.c_str());
+	first.protocol(http::proto_version::HTTP11);
+	second = first;
+	second.header("range", "bytes=1-3");
+	ch->on_request_preamble(std::move(first));
+	auto &io =service::locator::service_pool().get_thread_io_service();
+	boost::asio::deadline_timer t{io};
+	boost::asio::deadline_timer put_waiter{io};
+	boost::asio::deadline_timer content_waiter{io};
+
+	t.expires_from_now(boost::posix_time::milliseconds(1));
+	t.async_wait([&](const boost::system::error_code &ec)
+	{
+		ASSERT_FALSE(ec) << "an unknown error stopped the timer" << ec.message();
+		ch->on_request_finished();
+		ASSERT_TRUE(last_node_normal::request);
+		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
+		first_node::clear();
+		last_node_normal::clear();
+		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await writing on disk.
+		put_waiter.async_wait([&](const boost::system::error_code &ec)
+		{
+			ASSERT_FALSE(ec);
+			ch2->on_request_preamble(std::move(second));
+			ch2->on_request_finished();
+			ASSERT_FALSE(last_node_normal::request);
+			content_waiter.expires_from_now(boost::posix_time::seconds(1));
+			content_waiter.async_wait([&](const boost::system::error_code &ec){
+
+				ASSERT_FALSE(ec);
+				/** the range is cut from the whole content */
+				ASSERT_TRUE(first_node::response);
+				ASSERT_EQ(first_node::response->status_code(), 206);
+				ASSERT_EQ(std::string(first_node::response->header("content-range")), "bytes 1-3/7");
+				ASSERT_EQ(first_node::response->content_len(), 3U);
+				ASSERT_EQ(first_node::res_body_str, "heb");
+				ASSERT_TRUE(first_node::res_eom);
+				ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
+			});
+		});
+	});
+
+	service::locator::service_pool().get_thread_io_service().run();
+	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
+}
+
+
+TEST_F(cache_manager_test, range_from_slices)
+{
+	last_node_normal::_body = "thebody";
+	last_node_normal::headers.clear();
+	auto ch = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	auto ch2 = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	http::http_request first, second;
+	first.method(http_method::HTTP_GET);
+	std::string hostname = "www.ciaociao.org";
+	std::string uri = "/prova_range_from_slices.txt";
+	first.hostname(hostname.c_str());
+	first.path(uri.c_str());
+	first.protocol(http::proto_version::HTTP11);
+	first.header("range", "bytes=2-4");
+	second = first;
+	ch->on_request_preamble(std::move(first));
+	auto &io =service::locator::service_pool().get_thread_io_service();
+	boost::asio::deadline_timer t{io};
+	boost::asio::deadline_timer put_waiter{io};
+	boost::asio::deadline_timer content_waiter{io};
+
+	t.expires_from_now(boost::posix_time::milliseconds(1));
+	t.async_wait([&](const boost::system::error_code &ec)
+	{
+		ASSERT_FALSE(ec) << "an unknown error stopped the timer" << ec.message();
+		ch->on_request_finished();
+		/** the whole slice is asked to the board, which sends the whole content anyway */
+		ASSERT_TRUE(last_node_normal::request);
+		ASSERT_EQ(std::string(last_node_normal::request->header("range")), "bytes=0-1048575");
+		ASSERT_EQ(first_node::response->status_code(), 206);
+		ASSERT_EQ(std::string(first_node::response->header("content-range")), "bytes 2-4/7");
+		ASSERT_EQ(first_node::res_body_str, "ebo");
+		ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
+		first_node::clear();
+		last_node_normal::clear();
+		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await writing on disk.
+		put_waiter.async_wait([&](const boost::system::error_code &ec)
+		{
+			ASSERT_FALSE(ec);
+			ch2->on_request_preamble(std::move(second));
+			ch2->on_request_finished();
+			ASSERT_FALSE(last_node_normal::request);
+			content_waiter.expires_from_now(boost::posix_time::seconds(1));
+			content_waiter.async_wait([&](const boost::system::error_code &ec){
+
+				ASSERT_FALSE(ec);
+				ASSERT_TRUE(first_node::response);
+				ASSERT_EQ(first_node::response->status_code(), 206);
+				ASSERT_EQ(std::string(first_node::response->header("content-range")), "bytes 2-4/7");
+				ASSERT_EQ(first_node::res_body_str, "ebo");
+				ASSERT_TRUE(first_node::res_eom);
+				ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
+			});
+		});
+	});
+
+	service::locator::service_pool().get_thread_io_service().run();
+	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
+}
+
+
+TEST_F(cache_manager_test, range_from_another_range)
+{
+	last_node_normal::_body = "hebod";
+	last_node_normal::status_code = 206;
+	last_node_normal::headers = {{"content-range", "bytes 1-5/7"}};
+	auto ch = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	auto ch2 = make_unique_chain<node_interface, first_node, nodes::cache_manager, last_node_normal>();
+	http::http_request first, second;
+	first.method(http_method::HTTP_GET);
+	std::string hostname = "www.ciaociao.org";
+	std::string uri = "/prova_range_from_another_range.txt";
+	first.hostname(hostname.c_str());
+	first.path(uri.c_str());
+	first.protocol(http::proto_version::HTTP11);
+	first.header("range", "bytes=2-4");
+	second = first;
+	ch->on_request_preamble(std::move(first));
+	auto &io =service::locator::service_pool().get_thread_io_service();
+	boost::asio::deadline_timer t{io};
+	boost::asio::deadline_timer put_waiter{io};
+
+	t.expires_from_now(boost::posix_time::milliseconds(1));
+	t.async_wait([&](const boost::system::error_code &ec)
+	{
+		ASSERT_FALSE(ec) << "an unknown error stopped the timer" << ec.message();
+		ch->on_request_finished();
+		/** the board sends a range other than the slice asked: the client still gets its own */
+		ASSERT_TRUE(last_node_normal::request);
+		ASSERT_EQ(std::string(last_node_normal::request->header("range")), "bytes=0-1048575");
+		ASSERT_EQ(first_node::response->status_code(), 206);
+		ASSERT_EQ(std::string(first_node::response->header("content-range")), "bytes 2-4/7");
+		ASSERT_EQ(first_node::response->content_len(), 3U);
+		ASSERT_EQ(first_node::res_body_str, "ebo");
+		ASSERT_TRUE(first_node::res_eom);
+		first_node::clear();
+		last_node_normal::clear();
+		put_waiter.expires_from_now(boost::posix_time::seconds(1));
+		put_waiter.async_wait([&](const boost::system::error_code &ec)
+		{
+			ASSERT_FALSE(ec);
+			/** nothing was stored from it */
+			ch2->on_request_preamble(std::move(second));
+			ch2->on_request_finished();
+			ASSERT_TRUE(last_node_normal::request);
+			ASSERT_EQ(first_node::res_body_str, "ebo");
+			ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "MISS");
+		});
+	});
+
+	service::locator::service_pool().get_thread_io_service().run();
+	last_node_normal::_body = "thebody";
+	last_node_normal::status_code = 200;
+	last_node_normal::headers.clear();
+}
+
 #ifdef DOOORMAT_PREFETCH_ENABLED
 TEST_F(cache_manager_test, head_before_get)
 {
@@ -1077,8 +1252,8 @@ TEST_F(cache_manager_test, head_before_get)
 		ASSERT_FALSE(first_node::res_body);
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(first_node::res_eom);
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -1103,8 +1278,8 @@ TEST_F(cache_manager_test, head_before_get)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 
 }
 
@@ -1150,8 +1325,8 @@ TEST_F(cache_manager_test, get_before_head)
 		ASSERT_TRUE(first_node::res_body);
 		ASSERT_TRUE(first_node::response);
 		ASSERT_TRUE(first_node::res_eom);
-		first_node::reset();
-		last_node_normal::reset();
+		first_node::clear();
+		last_node_normal::clear();
 		put_waiter.expires_from_now(boost::posix_time::seconds(1)); //await, just in case it wants to write on disk.
 		put_waiter.async_wait([&](const boost::system::error_code &ec)
 		{
@@ -1178,8 +1353,8 @@ TEST_F(cache_manager_test, get_before_head)
 	service::locator::service_pool().get_thread_io_service().run();
 	ASSERT_TRUE(std::string(first_node::response->header("x-cache-status")) == "HIT");
 	last_node_normal::headers.clear();
-	last_node_normal::reset();
-	first_node::reset();
+	last_node_normal::clear();
+	first_node::clear();
 
 }
 #endif
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "../../src/requests_manager/cache_manager/cached_response.h"
+
+#include <cstring>
+
+namespace
+{
+
+std::string store(nodes::cached_response &encoder, const http::http_response &response,
+	const std::vector<std::string> &chunks, const nodes::cached_response::trailers_t &trailers)
+{
+	std::string stored = encoder.encode_header(response);
+	for(auto &c : chunks)
+		stored += encoder.encode_body(dstring{c.data(), c.size()});
+	for(auto &t : trailers)
+		encoder.encode_trailer(t.first, t.second);
+	stored += encoder.encode_eom();
+	return stored;
+}
+
+}
+
+TEST(cached_response, round_trip)
+{
+	http::http_response response;
+	response.protocol(http::proto_version::HTTP11);
+	response.status(200);
+	response.header("content-type", "text/plain");
+	response.header("etag", "123");
+	response.content_len(10);
+
+	nodes::cached_response encoder;
+	std::string stored = store(encoder, response, {"hello", " world"}, {});
+	dstring view{stored.data(), stored.size()};
+
+	http::http_response decoded;
+	dstring body;
+	nodes::cached_response::trailers_t trailers;
+	ASSERT_TRUE(nodes::cached_response::decode(view, decoded, body, trailers));
+	EXPECT_EQ(decoded.status_code(), 200);
+	EXPECT_EQ(decoded.protocol_version(), http::proto_version::HTTP11);
+	EXPECT_EQ(std::string(decoded.header("content-type")), "text/plain");
+	EXPECT_EQ(std::string(decoded.header("etag")), "123");
+	EXPECT_EQ(std::string(decoded.header("content-length")), "11");
+	EXPECT_EQ(std::string(body), "hello world");
+	EXPECT_TRUE(trailers.empty());
+	// the body is not copied
+	EXPECT_EQ(body.cdata(), view.cdata() + stored.find("hello world"));
+}
+
+TEST(cached_response, trailers)
+{
+	http::http_response response;
+	response.protocol(http::proto_version::HTTP11);
+	response.status(200);
+	response.chunked(true);
+
+	nodes::cached_response encoder;
+	std::string stored = store(encoder, response, {"body"}, {{"checksum", "abc"}});
+
+	http::http_response decoded;
+	dstring body;
+	nodes::cached_response::trailers_t trailers;
+	ASSERT_TRUE(nodes::cached_response::decode(dstring{stored.data(), stored.size()}, decoded, body, trailers));
+	EXPECT_TRUE(decoded.chunked());
+	EXPECT_EQ(std::string(body), "body");
+	ASSERT_EQ(trailers.size(), 1U);
+	EXPECT_EQ(std::string(trailers[0].first), "checksum");
+	EXPECT_EQ(std::string(trailers[0].second), "abc");
+}
+
+TEST(cached_response, damaged)
+{
+	http::http_response response;
+	response.protocol(http::proto_version::HTTP11);
+	response.status(200);
+
+	nodes::cached_response encoder;
+	std::string stored = store(encoder, response, {"body"}, {});
+
+	for(size_t size = 0; size < stored.size(); ++size)
+	{
+		http::http_response decoded;
+		dstring body;
+		nodes::cached_response::trailers_t trailers;
+		EXPECT_FALSE(nodes::cached_response::decode(dstring{stored.data(), size}, decoded, body, trailers));
+	}
+	stored[0] = 'X';
+	http::http_response decoded;
+	dstring body;
+	nodes::cached_response::trailers_t trailers;
+	EXPECT_FALSE(nodes::cached_response::decode(dstring{stored.data(), stored.size()}, decoded, body, trailers));
+}
+
+TEST(cached_response, sizes_overflowing)
+{
+	http::http_response response;
+	response.protocol(http::proto_version::HTTP11);
+	response.status(200);
+
+	nodes::cached_response encoder;
+	std::string stored = store(encoder, response, {"body"}, {});
+
+	// sizes adding up to the right one only by wrapping around, as if the trailers began with the count of
+	// the headers, which is 0
+	uint64_t body_size = -sizeof(uint32_t);
+	uint32_t trailers_size;
+	auto footer = stored.size() - sizeof(body_size) - sizeof(trailers_size);
+	std::memcpy(&trailers_size, &stored[footer + sizeof(body_size)], sizeof(trailers_size));
+	trailers_size += 4 + sizeof(uint32_t);
+	std::memcpy(&stored[footer], &body_size, sizeof(body_size));
+	std::memcpy(&stored[footer + sizeof(body_size)], &trailers_size, sizeof(trailers_size));
+
+	http::http_response decoded;
+	dstring body;
+	nodes::cached_response::trailers_t trailers;
+	EXPECT_FALSE(nodes::cached_response::decode(dstring{stored.data(), stored.size()}, decoded, body, trailers));
+}
@@ -23,7 +23,7 @@ errors::error_code first_node::err{};
 std::function<void(void)> first_node::res_start_fn{};
 std::function<void(void)> first_node::res_stop_fn{};
 
-void first_node::reset()
+void first_node::clear()
 {
 	request.reset();
 	response.reset();
@@ -116,7 +116,7 @@ std::list<dstring> last_node::body_parts;
 dstring last_node::trailer_key{};
 dstring last_node::trailer_value{};
 
-void last_node::reset()
+void last_node::clear()
 {
 	request.reset();
 	req_body = 0;
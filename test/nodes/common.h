@@ -135,9 +135,10 @@ protected:
 struct first_node : node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 
 	first_node() {}
-	~first_node() noexcept { reset(); }
+	~first_node() noexcept { clear(); }
 
 	static boost::optional<http::http_request> request;
 	static boost::optional<http::http_response> response;
@@ -152,7 +153,7 @@ struct first_node : node_interface
 	static errors::error_code err;
 	static std::function<void(void)> res_start_fn;
 	static std::function<void(void)> res_stop_fn;
-	static void reset();
+	static void clear();
 
 	void on_request_preamble(http::http_request&& r);
 	void on_request_body(dstring&& c);
@@ -170,16 +171,17 @@ struct first_node : node_interface
 struct last_node : node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 
 	last_node() {}
-	~last_node() noexcept { reset(); }
+	~last_node() noexcept { clear(); }
 
 	static boost::optional<http::http_request> request;
 	static uint req_body;
 	static uint req_trailer;
 	static uint req_eom;
 	static errors::error_code err;
-	static void reset();
+	static void clear();
 
 	void on_request_preamble(http::http_request&& r);
 	void on_request_body(dstring&& c);
@@ -196,6 +198,7 @@ struct last_node : node_interface
 struct blocked_node : node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 
 	blocked_node() {}
 
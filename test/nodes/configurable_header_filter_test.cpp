@@ -86,7 +86,7 @@ protected:
 	virtual void TearDown() override
 	{
 		preset::teardown(ch);
-// 		last_node::reset();
+// 		last_node::clear();
 	}
 };
 }
@@ -11,6 +11,7 @@ struct date_setter_test : public ::testing::Test
 	struct last_node : node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 		last_node() {}
 
 		void on_request_preamble(http::http_request&& r) { ++preamble_called; }
@@ -36,6 +37,7 @@ struct date_setter_test : public ::testing::Test
 	struct first_node : node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		first_node() {}
 
@@ -66,7 +66,7 @@ protected:
 	{
 		preset::setup(new gzip_mock_conf{});
 		preset::init_thread_local();
-		last_node::reset();
+		last_node::clear();
 	}
 };
 
@@ -16,6 +16,7 @@ struct id_header_adder_test : public ::testing::Test
 	struct last_node : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		last_node() {}
 
@@ -28,6 +29,7 @@ struct id_header_adder_test : public ::testing::Test
 	struct first_node : public node_interface
 	{
 		using node_interface::node_interface;
+		void reset() {}
 
 		first_node() {}
 
@@ -26,7 +26,7 @@ TEST_F(method_filter_test, all_allowed_methods)
 		EXPECT_EQ(last_node::req_body, 1);
 		EXPECT_EQ(last_node::req_trailer, 1);
 		EXPECT_EQ(last_node::req_eom, 1);
-		last_node::reset();
+		last_node::clear();
 	}
 }
 
@@ -53,7 +53,7 @@ TEST_F(method_filter_test, all_unsupported_methods)
 
 		EXPECT_TRUE( first_node::err == INTERNAL_ERROR(errors::http_error_code::method_not_allowed) ) << first_node::err.code();
 
-		first_node::reset();
+		first_node::clear();
 	}
 }
 
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "nghttp2/nghttp2.h"
+#include "../src/http2/priority.h"
+
+namespace
+{
+
+std::int32_t weight(const std::string& value)
+{
+	return http2::urgency_weight(reinterpret_cast<const std::uint8_t*>(value.data()), value.size());
+}
+
+}
+
+TEST(priority, urgency)
+{
+	EXPECT_EQ(weight("u=0"), 256);
+	EXPECT_EQ(weight("u=1"), 128);
+	EXPECT_EQ(weight("u=7"), 1);
+	// The default urgency is the default weight of RFC 7540
+	EXPECT_EQ(weight("u=3"), NGHTTP2_DEFAULT_WEIGHT);
+}
+
+TEST(priority, parameters_and_other_members)
+{
+	EXPECT_EQ(weight("u=3;i"), NGHTTP2_DEFAULT_WEIGHT);
+	EXPECT_EQ(weight("u=0;x=1"), 256);
+	EXPECT_EQ(weight("u=2, i"), 64);
+	EXPECT_EQ(weight("i, u=5"), 4);
+	EXPECT_EQ(weight("i,u=6"), 2);
+}
+
+TEST(priority, whitespace)
+{
+	EXPECT_EQ(weight(" u=1"), 128);
+	EXPECT_EQ(weight("u=1 "), 128);
+	EXPECT_EQ(weight("\tu=1\t, i"), 128);
+	EXPECT_EQ(weight("i ,  u=4 "), 8);
+}
+
+TEST(priority, no_urgency)
+{
+	EXPECT_EQ(weight(""), 0);
+	EXPECT_EQ(weight("i"), 0);
+	EXPECT_EQ(weight("u"), 0);
+	EXPECT_EQ(weight("u="), 0);
+	EXPECT_EQ(weight("u=8"), 0);
+	EXPECT_EQ(weight("u=12"), 0);
+	EXPECT_EQ(weight("u=-1"), 0);
+	EXPECT_EQ(weight("u = 1"), 0);
+	EXPECT_EQ(weight("urgency=1"), 0);
+	EXPECT_EQ(weight("x=1;u=1"), 0);
+	EXPECT_EQ(weight(",,,"), 0);
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "../src/http2/window_tuner.h"
+
+using clock_type = http2::window_tuner::clock;
+
+TEST(window_tuner, grows_when_window_is_filled)
+{
+	http2::window_tuner tuner{65535, 1 << 24};
+	auto now = clock_type::now();
+	ASSERT_TRUE(tuner.on_data(16384));
+	tuner.on_ping_sent(now);
+	EXPECT_FALSE(tuner.on_data(16384));
+	EXPECT_FALSE(tuner.on_data(16384));
+
+	EXPECT_EQ(tuner.on_ping_ack(now + std::chrono::milliseconds(40)), 131070);
+	EXPECT_EQ(tuner.window(), 131070);
+	EXPECT_EQ(tuner.rtt(), std::chrono::milliseconds(40));
+}
+
+TEST(window_tuner, stays_when_window_is_not_the_limit)
+{
+	http2::window_tuner tuner{65535, 1 << 24};
+	auto now = clock_type::now();
+	ASSERT_TRUE(tuner.on_data(1000));
+	tuner.on_ping_sent(now);
+	EXPECT_EQ(tuner.on_ping_ack(now + std::chrono::milliseconds(10)), 0);
+	EXPECT_EQ(tuner.window(), 65535);
+
+	// An unsolicited ACK is no sample
+	EXPECT_EQ(tuner.on_ping_ack(now + std::chrono::milliseconds(20)), 0);
+	EXPECT_EQ(tuner.rtt(), std::chrono::milliseconds(10));
+}
+
+TEST(window_tuner, capped_at_limit)
+{
+	http2::window_tuner tuner{65535, 100000};
+	auto now = clock_type::now();
+	ASSERT_TRUE(tuner.on_data(65535));
+	tuner.on_ping_sent(now);
+	EXPECT_EQ(tuner.on_ping_ack(now), 100000);
+
+	// Nothing left to learn
+	EXPECT_FALSE(tuner.on_data(100000));
+}
@@ -3,8 +3,14 @@
 #include "../test/testcommon.h"
 #include "../test/nodes/common.h"
 #include "../src/cache/policies/fifo.h"
+#include "../src/cache/policies/slru.h"
+#include "../src/cache/policies/s3fifo.h"
+#include "../src/cache/policies/wtinylfu.h"
 #include "../src/service_locator/service_initializer.h"
 #include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 
 std::string generate_random_string(size_t length) {
@@ -27,6 +33,19 @@ using namespace test_utils;
 
 static std::vector<std::string> requested_uris;
 
+/** The URIs of the access logs, in the order they were requested */
+static std::vector<std::string> read_access_logs()
+{
+	std::vector<std::string> uris;
+	std::ifstream infile("../resources/logs/accesslog_purified.txt");
+	std::string tmp;
+	while(std::getline(infile, tmp)) uris.push_back(tmp);
+
+	std::ifstream infile2("../resources/logs/accesscynnyspace_purified.txt");
+	while(std::getline(infile2, tmp)) uris.push_back(tmp);
+	return uris;
+}
+
 struct cache_perf_test : public preset::test {
 protected:
 	virtual void SetUp() override
@@ -35,12 +54,7 @@ protected:
 		/** Load file*/
 		if(requested_uris.empty()) {
 			std::cout << "LOADING!" << std::endl;
-			std::ifstream infile("../resources/logs/accesslog_purified.txt");
-			std::string tmp;
-			while(std::getline(infile, tmp)) requested_uris.push_back(tmp);
-
-			std::ifstream infile2("../resources/logs/accesscynnyspace_purified.txt");
-			while(std::getline(infile2, tmp)) requested_uris.push_back(tmp);
+			requested_uris = read_access_logs();
 			//int generator = 2758787;
 			std::random_shuffle(requested_uris.begin(), requested_uris.end());
 		}
@@ -380,3 +394,175 @@ TEST_F(cache_perf_test, get) {
 
 
 
+
+/** Hits per millisecond of threads reading the same keys concurrently. */
+template<typename cache_t>
+static double hits_per_ms(cache_t& current_cache, const std::vector<std::string>& keys, int threads_number)
+{
+	const int lookups = 1 << 18;
+	std::vector<std::thread> threads;
+	auto beginning = std::chrono::high_resolution_clock::now();
+	for(int t = 0; t < threads_number; ++t)
+	{
+		threads.emplace_back([&current_cache, &keys, t]()
+		{
+			for(int i = 0; i < lookups; ++i)
+				current_cache.has(keys[(i * 7 + t) % keys.size()]);
+		});
+	}
+	for(auto& t: threads)
+		t.join();
+	auto end = std::chrono::high_resolution_clock::now();
+	double time = std::chrono::duration_cast<std::chrono::microseconds>(end - beginning).count();
+	return (double)lookups * threads_number * 1000 / time;
+}
+
+template<typename cache_t>
+static void fill(cache_t& current_cache, const std::vector<std::string>& keys)
+{
+	for(auto& key: keys)
+	{
+		current_cache.begin_put(key, 564546, std::chrono::system_clock::now());
+		current_cache.put(key, "ciao");
+		current_cache.end_put(key);
+	}
+}
+
+TEST_F(cache_perf_test, has_threads)
+{
+	std::vector<std::string> keys;
+	for(int i = 0; i < 10000; ++i)
+		keys.push_back(generate_random_string(100));
+
+	cache<fifo_policy> sharded_cache;
+	cache<fifo_policy, std::string, 1024 * 1024, 1> single_cache;
+	fill(sharded_cache, keys);
+	fill(single_cache, keys);
+
+	int count = 0;
+	boost::asio::deadline_timer wait_fs(service::locator::service_pool().get_thread_io_service());
+	wait_fs.expires_from_now(boost::posix_time::milliseconds(5));
+	std::function<void(const boost::system::error_code &ec)> wait_fun;
+	wait_fun = [&](const boost::system::error_code &ec){
+		if((!sharded_cache.has(keys.back()) || !single_cache.has(keys.back())) && count++ < 1000000)
+		{
+			wait_fs.expires_from_now(boost::posix_time::milliseconds(5));
+			wait_fs.async_wait(wait_fun);
+			return;
+		}
+		service::locator::service_pool().allow_graceful_termination();
+	};
+	wait_fs.async_wait(wait_fun);
+	service::locator::service_pool().get_thread_io_service().run();
+
+	for(int threads_number = 1; threads_number <= 16; threads_number *= 2)
+	{
+		measurement sharded{"[CACHE] Hits per ms, sharded, " + std::to_string(threads_number) + " threads"};
+		measurement single{"[CACHE] Hits per ms, one shard, " + std::to_string(threads_number) + " threads"};
+		sharded.put(hits_per_ms(sharded_cache, keys, threads_number));
+		single.put(hits_per_ms(single_cache, keys, threads_number));
+		sharded.push_average();
+		single.push_average();
+	}
+}
+
+/** A request of an access log, with the size of the body of its response */
+struct traced_request
+{
+	std::string uri;
+	size_t size;
+};
+
+/** Reads the requests served with 200 from an access log written by doormat:
+ * host logname user [time] "method uri protocol" status size ...
+ * The ones whose size was not logged are skipped.
+ * */
+static std::vector<traced_request> read_access_trace(const std::string& path)
+{
+	std::vector<traced_request> trace;
+	std::ifstream infile(path);
+	std::string line;
+	while(std::getline(infile, line))
+	{
+		auto open = line.find('"');
+		auto close = open == std::string::npos ? open : line.find('"', open + 1);
+		if(close == std::string::npos) continue;
+
+		std::istringstream request{line.substr(open + 1, close - open - 1)};
+		std::istringstream response{line.substr(close + 1)};
+		std::string method, uri;
+		unsigned int status;
+		size_t size;
+		if(request >> method >> uri && response >> status >> size && status == 200 && size)
+			trace.push_back(traced_request{uri, size});
+	}
+	return trace;
+}
+
+/** Replays an access trace on a policy whose cache holds a fraction of the distinct bytes requested,
+ * and reports the hit ratios. Contents take the size of their latest response.
+ * */
+template<template<class> class policy_t>
+static void replay(const std::string& name, const std::vector<traced_request>& trace, double capacity_fraction)
+{
+	std::unordered_map<std::string, int> ids;
+	std::vector<size_t> sizes;
+	size_t distinct_bytes = 0;
+	for(auto& r: trace)
+	{
+		if(!ids.emplace(r.uri, sizes.size()).second) continue;
+		sizes.push_back(r.size);
+		distinct_bytes += r.size;
+	}
+	const size_t capacity = distinct_bytes * capacity_fraction;
+
+	policy_t<int> policy;
+	std::vector<bool> held(sizes.size(), false);
+	size_t used = 0;
+	policy.set_remove_callback([&](int id)
+	{
+		held[id] = false;
+		used -= sizes[id];
+	});
+
+	double hits = 0, bytes = 0, hit_bytes = 0;
+	for(auto& r: trace)
+	{
+		auto id = ids[r.uri];
+		bytes += r.size;
+		if(held[id])
+		{
+			++hits;
+			hit_bytes += r.size;
+			policy.touch(id);
+			continue;
+		}
+		held[id] = true;
+		sizes[id] = r.size;
+		used += r.size;
+		policy.put(id, r.size);
+		if(used > capacity) policy.free_space(used - capacity);
+	}
+
+	auto label = "[CACHE] " + name + " with " + std::to_string(int(capacity_fraction * 100)) + "% of the bytes, ";
+	measurement object_ratio{label + "object hit ratio (%)"};
+	measurement byte_ratio{label + "byte hit ratio (%)"};
+	object_ratio.put(trace.empty() ? 0 : hits * 100 / trace.size());
+	byte_ratio.put(bytes == 0 ? 0 : hit_bytes * 100 / bytes);
+	object_ratio.push_average();
+	byte_ratio.push_average();
+}
+
+TEST_F(cache_perf_test, policies_hit_ratio)
+{
+	auto trace = read_access_trace("../resources/logs/access.log");
+	if(trace.empty())
+		std::cout << "[CACHE] no access trace with sizes to replay" << std::endl;
+	for(double capacity_fraction: {0.01, 0.1})
+	{
+		replay<fifo_policy>("fifo", trace, capacity_fraction);
+		replay<slru_policy>("slru", trace, capacity_fraction);
+		replay<s3fifo_policy>("s3fifo", trace, capacity_fraction);
+		replay<wtinylfu_policy>("wtinylfu", trace, capacity_fraction);
+	}
+}
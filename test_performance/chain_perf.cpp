@@ -18,6 +18,8 @@
 #include <requests_manager/error_file_provider.h>
 #include <requests_manager/id_header_adder.h>
 #include <chain_of_responsibility/chain_of_responsibility.h>
+#include <utils/arena.h>
+#include <protocol/handler_factory.h>
 #include <requests_manager/cache_manager/cache_manager.h>
 
 
@@ -62,6 +64,7 @@ http::http_response make_res_header()
 struct analizing_node : public node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 
 	analizing_node() {}
 
@@ -130,6 +133,7 @@ std::unordered_map<std::string, std::pair<req_representation, res_representation
 struct smart_node : public node_interface
 {
 	using node_interface::node_interface;
+	void reset() {}
 
 	smart_node() {std::cout << "creating" << std::endl; }
 
@@ -395,6 +399,202 @@ TEST_F(chain_perf_basic, simplest_get)
 }
 
 
+/** What the nodes of the chain do with the headers of every request and response. */
+TEST_F(chain_perf_basic, header_operations)
+{
+	size_t test_repetitions = 100000;
+	measurement request_headers("[CHAIN] Request header operations (ns)");
+	measurement response_headers("[CHAIN] Response header operations (ns)");
+
+	for(int run = 0; run < 5; ++run)
+	{
+		size_t found{0};
+		auto begin_req = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+		{
+			http::http_request req{true};
+			req.method(http_method::HTTP_GET);
+			req.protocol(http::proto_version::HTTP11);
+			req.hostname(("cy1.cydev1.com"));
+			add_req_headers(req);
+			found += req.has(http::hf_connection);
+			found += req.has(http::hf_accept_encoding, [](const dstring& v){ return v.find(http::hv_gzip) != dstring::npos; });
+			found += req.has(http::hf_maxforward);
+			found += req.hostname().size();
+			found += req.header("user-agent").size();
+			req.remove_header(http::hf_cyn_dest);
+			req.header(http::hf_via, "doormat");
+			found += req.serialize().size();
+		}
+		auto end_req = std::chrono::high_resolution_clock::now();
+		request_headers.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_req - begin_req).count() / test_repetitions);
+
+		auto begin_res = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+		{
+			auto res = make_res_header();
+			res.content_len(13);
+			found += res.has(http::hf_content_encoding);
+			found += res.header(http::hf_content_type).size();
+			res.remove_header(http::hf_server);
+			res.header(http::hf_server, "doormat");
+			found += res.serialize().size();
+		}
+		auto end_res = std::chrono::high_resolution_clock::now();
+		response_headers.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_res - begin_res).count() / test_repetitions);
+		ASSERT_TRUE(found);
+	}
+
+	request_headers.push_average();
+	response_headers.push_average();
+}
+
+
+/** A transaction lifetime: chain and request are built, then dropped together. */
+TEST_F(chain_perf_basic, transaction_arena)
+{
+	size_t test_repetitions = 10000;
+	measurement heap("[CHAIN] Transaction setup and teardown, heap (ns)");
+	measurement arena("[CHAIN] Transaction setup and teardown, arena (ns)");
+
+	auto transaction = [this]()
+	{
+		auto chain = make_chain();
+		http::http_request req{true};
+		req.method(http_method::HTTP_GET);
+		req.protocol(http::proto_version::HTTP11);
+		req.hostname(("cy1.cydev1.com"));
+		add_req_headers(req);
+		return req.serialize().size();
+	};
+
+	for(int run = 0; run < 5; ++run)
+	{
+		size_t size{0};
+		auto begin_heap = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+			size += transaction();
+		auto end_heap = std::chrono::high_resolution_clock::now();
+		heap.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_heap - begin_heap).count() / test_repetitions);
+
+		auto begin_arena = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+		{
+			utils::arena mem;
+			utils::arena::scope use{mem};
+			size += transaction();
+		}
+		auto end_arena = std::chrono::high_resolution_clock::now();
+		arena.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_arena - begin_arena).count() / test_repetitions);
+		ASSERT_TRUE(size);
+	}
+
+	heap.push_average();
+	arena.push_average();
+}
+
+/** Chains built for every transaction or taken back from the pool of the thread. */
+TEST_F(chain_perf_basic, chain_pool)
+{
+	size_t test_repetitions = 10000;
+	measurement built("[CHAIN] Chain per transaction, built (ns)");
+	measurement pooled("[CHAIN] Chain per transaction, pooled (ns)");
+
+	auto previous = server::handler_interface::make_chain;
+	server::handler_interface::chain_initializer([this](){ return make_chain(); });
+
+	for(int run = 0; run < 5; ++run)
+	{
+		auto begin_built = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+		{
+			auto chain = server::handler_interface::make_chain();
+			ASSERT_TRUE(chain);
+		}
+		auto end_built = std::chrono::high_resolution_clock::now();
+		built.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_built - begin_built).count() / test_repetitions);
+
+		auto begin_pooled = std::chrono::high_resolution_clock::now();
+		for(size_t i = 0; i < test_repetitions; ++i)
+		{
+			auto chain = server::handler_interface::acquire_chain();
+			ASSERT_TRUE(chain);
+			server::handler_interface::release_chain(std::move(chain));
+		}
+		auto end_pooled = std::chrono::high_resolution_clock::now();
+		pooled.put(std::chrono::duration_cast<std::chrono::nanoseconds>(end_pooled - begin_pooled).count() / test_repetitions);
+	}
+
+	server::handler_interface::chain_initializer(previous);
+	built.push_average();
+	pooled.push_average();
+}
+
+namespace
+{
+
+/** Handles body events only to forward them, as nodes not interested in them did. */
+struct forwarding_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	void on_request_body(dstring&& chunk) { base::on_request_body(std::move(chunk)); }
+	void on_body(dstring&& chunk) { base::on_body(std::move(chunk)); }
+};
+
+/** Handles nothing: the chain skips it. */
+struct passthrough_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+};
+
+/** Sends every request chunk back as response body. */
+struct echo_node : public node_interface
+{
+	using node_interface::node_interface;
+	void reset() {}
+
+	void on_request_body(dstring&& chunk) { base::on_body(std::move(chunk)); }
+};
+
+template<typename N>
+double round_trip(size_t repetitions)
+{
+	size_t received{0};
+	auto chain = make_unique_chain<node_interface, N, N, N, N, N, N, N, N, N, N, N, N, N, N, echo_node>();
+	chain->initialize_callbacks([](http::http_response&&){}, [&received](dstring&&){ ++received; },
+		[](dstring&&, dstring&&){}, [](){}, [](const errors::error_code&){}, [](){});
+
+	dstring chunk{"HELLO, WORLD!"};
+	auto begin = std::chrono::high_resolution_clock::now();
+	for(size_t i = 0; i < repetitions; ++i)
+		chain->on_request_body(dstring{chunk});
+	auto end = std::chrono::high_resolution_clock::now();
+
+	EXPECT_EQ(received, repetitions);
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / repetitions;
+}
+
+}
+
+/** One request chunk down and one response chunk up a chain of 15 nodes. */
+TEST_F(chain_perf_basic, event_dispatch)
+{
+	size_t test_repetitions = 1000000;
+	measurement forwarding("[CHAIN] Body event round trip, forwarding nodes (ns)");
+	measurement passthrough("[CHAIN] Body event round trip, pass-through nodes (ns)");
+
+	for(int run = 0; run < 5; ++run)
+	{
+		forwarding.put(round_trip<forwarding_node>(test_repetitions));
+		passthrough.put(round_trip<passthrough_node>(test_repetitions));
+	}
+
+	forwarding.push_average();
+	passthrough.push_average();
+}
 
 TEST_F(chain_perf_basic, morphcast_1)
 {
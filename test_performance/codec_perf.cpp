@@ -0,0 +1,169 @@
+#include "utils/measurements.h"
+#include "../src/http/http_codec.h"
+#include "../src/http/http_request.h"
+#include "../src/http/http_response.h"
+#include "../src/http_parser/http_scan.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** Request headers as captured in front of our boards. */
+const std::vector<std::string> captured_requests
+{
+	"GET /static/js/app.min.js?v=1478012345 HTTP/1.1\r\n"
+	"Host: cy1.cydev1.com\r\n"
+	"Connection: keep-alive\r\n"
+	"Accept: */*\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/54.0.2840.71 Safari/537.36\r\n"
+	"Referer: https://cy1.cydev1.com/\r\n"
+	"Accept-Encoding: gzip, deflate, sdch, br\r\n"
+	"Accept-Language: it-IT,it;q=0.8,en-US;q=0.6,en;q=0.4\r\n"
+	"Cookie: _ga=GA1.2.1234567890.1478012345; _gid=GA1.2.987654321.1478012345; session=e251616b542b3b81838d49136dc47d89b758948f\r\n"
+	"\r\n",
+
+	"GET /api/v1/timeline?from=0&count=50 HTTP/1.1\r\n"
+	"Host: api.cydev1.com\r\n"
+	"User-Agent: Mozilla/5.0 (Windows NT 10.0; WOW64; rv:49.0) Gecko/20100101 Firefox/49.0\r\n"
+	"Accept: application/json, text/javascript, */*; q=0.01\r\n"
+	"Accept-Language: en-US,en;q=0.5\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"X-Requested-With: XMLHttpRequest\r\n"
+	"If-None-Match: W/\"2b-y1De87r7kN7VRjYOfNc+SQ\"\r\n"
+	"Connection: keep-alive\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"\r\n",
+
+	"GET /media/video/3f2a/seg-00042.ts HTTP/1.1\r\n"
+	"Host: media.cydev1.com\r\n"
+	"User-Agent: stagefright/1.2 (Linux;Android 6.0.1)\r\n"
+	"Accept: */*\r\n"
+	"Range: bytes=1048576-2097151\r\n"
+	"Connection: keep-alive\r\n"
+	"\r\n",
+
+	"POST /upload HTTP/1.1\r\n"
+	"Host: cy1.cydev1.com\r\n"
+	"User-Agent: curl/7.50.1\r\n"
+	"Accept: */*\r\n"
+	"Content-Type: application/x-www-form-urlencoded\r\n"
+	"Content-Length: 11\r\n"
+	"\r\n"
+	"hello=world"
+};
+
+double decode_throughput(http_scan_mode mode, size_t repetitions)
+{
+	http_scan_set_mode(mode);
+
+	http::http_request req;
+	size_t completed{0};
+	http::http_codec decoder;
+	decoder.register_callback(
+		[&req](http::http_structured_data** data){ req = http::http_request{}; *data = &req; },
+		[](){},
+		[](dstring&&){},
+		[](dstring&&, dstring&&){},
+		[&completed](){ ++completed; },
+		[](int, bool&){ FAIL(); });
+
+	size_t bytes{0};
+	auto begin = std::chrono::high_resolution_clock::now();
+	for(size_t i = 0; i < repetitions; ++i)
+	{
+		for(const auto& r : captured_requests)
+		{
+			decoder.decode(r.data(), r.size());
+			bytes += r.size();
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	EXPECT_EQ(completed, repetitions * captured_requests.size());
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+	return us ? static_cast<double>(bytes) / us : 0; // bytes/us == MB/s
+}
+
+http::http_response captured_response()
+{
+	http::http_response r;
+	r.protocol(http::proto_version::HTTP11);
+	r.status(200);
+	r.keepalive(true);
+	r.header("content-type", "application/json; charset=utf-8");
+	r.date("Fri, 28 Oct 2016 15:15:37 GMT");
+	r.header("etag", "W/\"2b-y1De87r7kN7VRjYOfNc+SQ\"");
+	r.header("cache-control", "public, max-age=3600");
+	r.header("x-debug-cyn-hash", "e251616b542b3b81838d49136dc47d89b758948f");
+	r.header("x-powered-by", "Express");
+	r.header("vary", "Accept-Encoding");
+	r.header("via", "HTTP/1.1 cy1.cydev1.com");
+	r.header("server", "doormat");
+	r.content_len(12345);
+	return r;
+}
+
+/**
+ * @param reuse when false every message is changed before being encoded,
+ * so that nothing encoded before can be used.
+ */
+double encode_throughput(bool reuse, size_t repetitions)
+{
+	auto response = captured_response();
+	size_t bytes{0};
+	auto begin = std::chrono::high_resolution_clock::now();
+	for(size_t i = 0; i < repetitions; ++i)
+	{
+		if(!reuse)
+			response.status(200);
+		http::http_codec encoder;
+		bytes += encoder.encode_header(response).size();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+	return us ? static_cast<double>(bytes) / us : 0; // bytes/us == MB/s
+}
+
+}
+
+TEST(codec_perf, encode_response_headers)
+{
+	const size_t test_repetitions = 200000;
+	measurement fresh("[CODEC] Response header encoding (MB/s)");
+	measurement reused("[CODEC] Response header encoding, unchanged message (MB/s)");
+
+	for(int i = 0; i < 5; ++i)
+	{
+		fresh.put(encode_throughput(false, test_repetitions));
+		reused.put(encode_throughput(true, test_repetitions));
+	}
+
+	fresh.push_average();
+	reused.push_average();
+}
+
+TEST(codec_perf, decode_captured_headers)
+{
+	const size_t test_repetitions = 50000;
+	measurement scalar("[CODEC] Request decoding, scalar scan (MB/s)");
+	measurement sse42("[CODEC] Request decoding, SSE4.2 scan (MB/s)");
+	measurement avx2("[CODEC] Request decoding, AVX2 scan (MB/s)");
+
+	for(int i = 0; i < 5; ++i)
+	{
+		scalar.put(decode_throughput(HTTP_SCAN_SCALAR, test_repetitions));
+		sse42.put(decode_throughput(HTTP_SCAN_SSE42, test_repetitions));
+		avx2.put(decode_throughput(HTTP_SCAN_AVX2, test_repetitions));
+	}
+	http_scan_set_mode(HTTP_SCAN_AUTO);
+
+	scalar.push_average();
+	sse42.push_average();
+	avx2.push_average();
+}
@@ -0,0 +1,79 @@
+#include "utils/measurements.h"
+#include "../src/utils/dstring.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+/** Allocations are counted only on the thread measuring, and only while a counter exists */
+thread_local size_t* counted{nullptr};
+
+/** Counts the heap allocations made by this thread in its scope */
+class allocation_counter
+{
+	size_t allocations{0};
+	size_t* previous;
+public:
+	allocation_counter() noexcept : previous{counted} { counted = &allocations; }
+	allocation_counter(const allocation_counter&) = delete;
+	allocation_counter& operator=(const allocation_counter&) = delete;
+	~allocation_counter() { counted = previous; }
+
+	size_t get() const noexcept { return allocations; }
+};
+
+/** Average number of heap allocations of op, run n times. */
+template<typename Op>
+double allocations_per_operation(const std::string& name, Op op, size_t n = 1000)
+{
+	measurement m{"dstring " + name + " (allocations)"};
+	for(size_t i = 0; i < n; ++i)
+	{
+		size_t allocations;
+		{
+			allocation_counter counter;
+			op();
+			allocations = counter.get();
+		}
+		m.put(allocations);
+	}
+	m.push_average();
+	return m.get_average();
+}
+
+}
+
+void* operator new(std::size_t n)
+{
+	if(counted)
+		++*counted;
+	if(void* p = std::malloc(n ? n : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+TEST(dstring_performance, allocations)
+{
+	const dstring short_value{"keep-alive"};
+	const dstring long_value{"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"};
+	const dstring immutable_value = dstring::make_immutable("application/x-www-form-urlencoded");
+
+	EXPECT_EQ(allocations_per_operation("default construction", [](){ dstring d; }), 0);
+	EXPECT_EQ(allocations_per_operation("short construction", [](){ dstring d{"gzip"}; }), 0);
+	EXPECT_EQ(allocations_per_operation("long construction", [&long_value](){ dstring d{long_value.cdata(), long_value.size()}; }), 1);
+	EXPECT_EQ(allocations_per_operation("short copy", [&short_value](){ dstring d{short_value}; }), 0);
+	EXPECT_EQ(allocations_per_operation("long copy", [&long_value](){ dstring d{long_value}; }), 0);
+	EXPECT_EQ(allocations_per_operation("slice", [&long_value](){ auto d = long_value.slice(13, 5); }), 0);
+	EXPECT_EQ(allocations_per_operation("short append", [](){ dstring d{"max-age"}; d.append("=0"); }), 0);
+	EXPECT_EQ(allocations_per_operation("to_string", [](){ auto d = dstring::to_string(1478012345); }), 0);
+	EXPECT_EQ(allocations_per_operation("immutable copy", [&immutable_value](){ dstring d{immutable_value}; }), 0);
+}
@@ -0,0 +1,432 @@
+#include "utils/measurements.h"
+#include "../src/http2/http2alloc.h"
+
+#include <nghttp2/nghttp2.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+#define NV(NAME, VALUE) \
+{ \
+	(uint8_t *)NAME, (uint8_t *)VALUE, sizeof(NAME) - 1, sizeof(VALUE) - 1, NGHTTP2_NV_FLAG_NONE \
+}
+
+nghttp2_nv request_headers[] =
+{
+	NV(":method", "GET"),
+	NV(":scheme", "https"),
+	NV(":authority", "cy1.cydev1.com"),
+	NV(":path", "/static/js/app.min.js?v=1478012345"),
+	NV("accept", "*/*"),
+	NV("accept-encoding", "gzip, deflate, br"),
+	NV("user-agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/54.0.2840.71"),
+	NV("cookie", "_ga=GA1.2.1234567890.1478012345; session=e251616b542b3b81838d49136dc47d89b758948f")
+};
+
+nghttp2_nv response_headers[] =
+{
+	NV(":status", "200"),
+	NV("content-type", "application/javascript"),
+	NV("cache-control", "max-age=3600"),
+	NV("server", "doormat")
+};
+
+struct endpoint
+{
+	nghttp2_session* session{nullptr};
+	size_t completed{0};
+	// Server side: the body and how much of it every stream of a burst has sent
+	std::string body;
+	std::vector<size_t> sent;
+	nghttp2_session* peer{nullptr};
+	size_t received{0};
+	// Bytes a write of the server takes at most
+	size_t budget{std::numeric_limits<size_t>::max()};
+	size_t gathered{0};
+	// Client side: what came before the response of a given stream was over
+	int32_t awaited{-1};
+	size_t received_before{0};
+	// Server side: requests the chain has still to answer
+	std::vector<int32_t> requested;
+};
+
+size_t& sent_by(endpoint& server, int32_t stream_id)
+{
+	return server.sent[(stream_id / 2) % server.sent.size()];
+}
+
+ssize_t read_body(nghttp2_session*, int32_t stream_id, uint8_t* buf, size_t length, uint32_t* data_flags,
+	nghttp2_data_source* source, void* user_data)
+{
+	auto& server = *static_cast<endpoint*>(user_data);
+	auto& sent = sent_by(server, stream_id);
+	size_t len = std::min(length, server.body.size() - sent);
+	if(source->ptr)
+		*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+	else
+	{
+		std::memcpy(buf, server.body.data() + sent, len);
+		sent += len;
+	}
+	if(sent + (source->ptr ? len : 0) == server.body.size())
+		*data_flags |= NGHTTP2_DATA_FLAG_EOF;
+	return len;
+}
+
+// Stands for a gathering write: the header and the body go to the peer as they are
+int send_data(nghttp2_session*, nghttp2_frame* frame, const uint8_t* framehd, size_t length,
+	nghttp2_data_source*, void* user_data)
+{
+	auto& server = *static_cast<endpoint*>(user_data);
+	auto& sent = sent_by(server, frame->hd.stream_id);
+	nghttp2_session_mem_recv(server.peer, framehd, 9);
+	nghttp2_session_mem_recv(server.peer, reinterpret_cast<const uint8_t*>(server.body.data()) + sent, length);
+	sent += length;
+	server.gathered += 9 + length;
+	return server.gathered < server.budget ? 0 : NGHTTP2_ERR_PAUSE;
+}
+
+int on_request(nghttp2_session* session, const nghttp2_frame* frame, void* user_data)
+{
+	if(frame->hd.type != NGHTTP2_HEADERS || !(frame->hd.flags & NGHTTP2_FLAG_END_STREAM))
+		return 0;
+
+	auto& server = *static_cast<endpoint*>(user_data);
+	sent_by(server, frame->hd.stream_id) = 0;
+	nghttp2_data_provider prd;
+	prd.source.ptr = server.peer;
+	prd.read_callback = read_body;
+	nghttp2_submit_response(session, frame->hd.stream_id, response_headers,
+		sizeof(response_headers) / sizeof(nghttp2_nv), &prd);
+	++server.completed;
+	return 0;
+}
+
+int on_request_queued(nghttp2_session*, const nghttp2_frame* frame, void* user_data)
+{
+	if(frame->hd.type == NGHTTP2_HEADERS && (frame->hd.flags & NGHTTP2_FLAG_END_STREAM))
+		static_cast<endpoint*>(user_data)->requested.push_back(frame->hd.stream_id);
+	return 0;
+}
+
+int on_response(nghttp2_session*, const nghttp2_frame* frame, void* user_data)
+{
+	// On stream 0 the same flag is a SETTINGS ack
+	if(frame->hd.stream_id && (frame->hd.flags & NGHTTP2_FLAG_END_STREAM))
+	{
+		auto& client = *static_cast<endpoint*>(user_data);
+		++client.completed;
+		if(frame->hd.stream_id == client.awaited)
+			client.received_before = client.received;
+	}
+	return 0;
+}
+
+int on_response_data(nghttp2_session*, uint8_t, int32_t, const uint8_t*, size_t len, void* user_data)
+{
+	static_cast<endpoint*>(user_data)->received += len;
+	return 0;
+}
+
+void pump(nghttp2_session* from, nghttp2_session* to)
+{
+	const uint8_t* data;
+	ssize_t len;
+	while((len = nghttp2_session_mem_send(from, &data)) > 0)
+		nghttp2_session_mem_recv(to, data, len);
+}
+
+// A write of the server as the session does it: no more than its budget
+void write(endpoint& server, nghttp2_session* to)
+{
+	const uint8_t* data;
+	ssize_t len;
+	server.gathered = 0;
+	while(server.gathered < server.budget && (len = nghttp2_session_mem_send(server.session, &data)) > 0)
+	{
+		nghttp2_session_mem_recv(to, data, len);
+		server.gathered += len;
+	}
+}
+
+struct scenario
+{
+	bool pooled;
+	bool no_copy;
+	size_t body_size;
+	size_t connections;
+	size_t requests;
+	size_t concurrency;
+};
+
+/**
+ * Connections, each carrying a burst of concurrent requests at a time,
+ * go through a client and a server session in memory.
+ * @return the elapsed seconds.
+ */
+double serve(const scenario& sc)
+{
+	nghttp2_session_callbacks* server_callbacks;
+	nghttp2_session_callbacks_new(&server_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(server_callbacks, on_request);
+	nghttp2_session_callbacks_set_send_data_callback(server_callbacks, send_data);
+	nghttp2_session_callbacks* client_callbacks;
+	nghttp2_session_callbacks_new(&client_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(client_callbacks, on_response);
+	nghttp2_session_callbacks_set_on_data_chunk_recv_callback(client_callbacks, on_response_data);
+
+	// No waiting for window updates
+	const int32_t window = 1 << 30;
+	nghttp2_settings_entry client_settings[] = {{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, window}};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for(size_t c = 0; c < sc.connections; ++c)
+	{
+		std::unique_ptr<http2::mem_pool> pool;
+		nghttp2_mem mem;
+		if(sc.pooled)
+		{
+			pool.reset(new http2::mem_pool{});
+			mem = http2::create_allocator(*pool);
+		}
+
+		endpoint server, client;
+		server.body.assign(sc.body_size, 'x');
+		server.sent.resize(sc.concurrency);
+		nghttp2_session_server_new3(&server.session, server_callbacks, &server, nullptr, sc.pooled ? &mem : nullptr);
+		nghttp2_session_client_new(&client.session, client_callbacks, &client);
+		if(sc.no_copy)
+			server.peer = client.session;
+		nghttp2_submit_settings(server.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+		nghttp2_submit_settings(client.session, NGHTTP2_FLAG_NONE, client_settings, 1);
+		nghttp2_submit_window_update(client.session, NGHTTP2_FLAG_NONE, 0, window - 65535);
+
+		while(client.completed < sc.requests)
+		{
+			for(size_t i = 0; i < sc.concurrency; ++i)
+				nghttp2_submit_request(client.session, nullptr, request_headers,
+					sizeof(request_headers) / sizeof(nghttp2_nv), nullptr, nullptr);
+			while(nghttp2_session_want_write(client.session) || nghttp2_session_want_write(server.session))
+			{
+				pump(client.session, server.session);
+				pump(server.session, client.session);
+			}
+		}
+		EXPECT_EQ(client.completed, server.completed);
+		EXPECT_EQ(client.received, client.completed * sc.body_size);
+
+		nghttp2_session_del(client.session);
+		if(pool)
+			pool->release_on_destruction();
+		nghttp2_session_del(server.session);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	nghttp2_session_callbacks_del(server_callbacks);
+	nghttp2_session_callbacks_del(client_callbacks);
+
+	std::chrono::duration<double> elapsed = end - start;
+	return elapsed.count();
+}
+
+/**
+ * Eight images are being sent when a stylesheet of the highest weight is asked for.
+ * @return the image bytes received before the stylesheet was complete, in KiB.
+ */
+double bytes_before_stylesheet(size_t budget)
+{
+	nghttp2_session_callbacks* server_callbacks;
+	nghttp2_session_callbacks_new(&server_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(server_callbacks, on_request);
+	nghttp2_session_callbacks_set_send_data_callback(server_callbacks, send_data);
+	nghttp2_session_callbacks* client_callbacks;
+	nghttp2_session_callbacks_new(&client_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(client_callbacks, on_response);
+	nghttp2_session_callbacks_set_on_data_chunk_recv_callback(client_callbacks, on_response_data);
+
+	const int32_t window = 1 << 30;
+	nghttp2_settings_entry client_settings[] = {{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, window}};
+
+	endpoint server, client;
+	server.body.assign(1024 * 1024, 'x');
+	server.sent.resize(16);
+	server.budget = budget;
+	nghttp2_session_server_new(&server.session, server_callbacks, &server);
+	nghttp2_session_client_new(&client.session, client_callbacks, &client);
+	server.peer = client.session;
+	nghttp2_submit_settings(server.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+	nghttp2_submit_settings(client.session, NGHTTP2_FLAG_NONE, client_settings, 1);
+	nghttp2_submit_window_update(client.session, NGHTTP2_FLAG_NONE, 0, window - 65535);
+
+	for(size_t i = 0; i < 8; ++i)
+		nghttp2_submit_request(client.session, nullptr, request_headers,
+			sizeof(request_headers) / sizeof(nghttp2_nv), nullptr, nullptr);
+	pump(client.session, server.session);
+	write(server, client.session);
+
+	nghttp2_priority_spec urgent;
+	nghttp2_priority_spec_init(&urgent, 0, 256, 0);
+	client.awaited = nghttp2_submit_request(client.session, &urgent, request_headers,
+		sizeof(request_headers) / sizeof(nghttp2_nv), nullptr, nullptr);
+	while(client.completed < 9)
+	{
+		pump(client.session, server.session);
+		write(server, client.session);
+	}
+
+	nghttp2_session_del(client.session);
+	nghttp2_session_del(server.session);
+	nghttp2_session_callbacks_del(server_callbacks);
+	nghttp2_session_callbacks_del(client_callbacks);
+	return (client.received_before - server.body.size()) / 1024.;
+}
+
+/**
+ * A burst of small responses is answered by the chain in one turn of the io_service;
+ * every answer asks the session to write.
+ * @return the socket writes for every hundred responses.
+ */
+double writes_per_hundred_responses(bool deferred)
+{
+	nghttp2_session_callbacks* server_callbacks;
+	nghttp2_session_callbacks_new(&server_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(server_callbacks, on_request_queued);
+	nghttp2_session_callbacks* client_callbacks;
+	nghttp2_session_callbacks_new(&client_callbacks);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(client_callbacks, on_response);
+	nghttp2_session_callbacks_set_on_data_chunk_recv_callback(client_callbacks, on_response_data);
+
+	const size_t bursts = 100, burst = 32;
+	endpoint server, client;
+	server.body.assign(512, 'x');
+	server.sent.resize(burst);
+	nghttp2_session_server_new(&server.session, server_callbacks, &server);
+	nghttp2_session_client_new(&client.session, client_callbacks, &client);
+	nghttp2_submit_settings(server.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+	nghttp2_submit_settings(client.session, NGHTTP2_FLAG_NONE, nullptr, 0);
+
+	size_t writes = 0;
+	auto flush = [&]()
+	{
+		const uint8_t* data;
+		ssize_t len;
+		bool wrote = false;
+		while((len = nghttp2_session_mem_send(server.session, &data)) > 0)
+		{
+			nghttp2_session_mem_recv(client.session, data, len);
+			wrote = true;
+		}
+		writes += wrote;
+	};
+
+	for(size_t b = 0; b < bursts; ++b)
+	{
+		for(size_t i = 0; i < burst; ++i)
+			nghttp2_submit_request(client.session, nullptr, request_headers,
+				sizeof(request_headers) / sizeof(nghttp2_nv), nullptr, nullptr);
+		pump(client.session, server.session);
+
+		for(auto id : server.requested)
+		{
+			sent_by(server, id) = 0;
+			nghttp2_data_provider prd;
+			prd.source.ptr = nullptr;
+			prd.read_callback = read_body;
+			nghttp2_submit_response(server.session, id, response_headers,
+				sizeof(response_headers) / sizeof(nghttp2_nv), &prd);
+			if(!deferred)
+				flush();
+		}
+		server.requested.clear();
+		if(deferred)
+			flush();
+		// Window updates
+		pump(client.session, server.session);
+	}
+	EXPECT_EQ(client.completed, bursts * burst);
+
+	nghttp2_session_del(client.session);
+	nghttp2_session_del(server.session);
+	nghttp2_session_callbacks_del(server_callbacks);
+	nghttp2_session_callbacks_del(client_callbacks);
+	return writes * 100. / client.completed;
+}
+
+double requests_per_second(const scenario& sc)
+{
+	return sc.connections * sc.requests / serve(sc);
+}
+
+double megabytes_per_second(const scenario& sc)
+{
+	return sc.connections * sc.requests * sc.body_size / serve(sc) / (1024 * 1024);
+}
+
+}
+
+TEST(http2_perf, requests_per_second)
+{
+	scenario heap_sc{false, false, 1024, 200, 256, 16};
+	scenario pooled_sc{true, false, 1024, 200, 256, 16};
+	measurement heap("[HTTP2] Requests per second, heap allocator");
+	measurement pooled("[HTTP2] Requests per second, session pool");
+
+	for(int i = 0; i < 5; ++i)
+	{
+		heap.put(requests_per_second(heap_sc));
+		pooled.put(requests_per_second(pooled_sc));
+	}
+
+	heap.push_average();
+	pooled.push_average();
+}
+
+TEST(http2_perf, data_frames)
+{
+	scenario copied_sc{true, false, 256 * 1024, 100, 64, 8};
+	scenario no_copy_sc{true, true, 256 * 1024, 100, 64, 8};
+	measurement copied("[HTTP2] Response bodies, copied to the library (MB/s)");
+	measurement no_copy("[HTTP2] Response bodies, DATA frames without copy (MB/s)");
+
+	for(int i = 0; i < 5; ++i)
+	{
+		copied.put(megabytes_per_second(copied_sc));
+		no_copy.put(megabytes_per_second(no_copy_sc));
+	}
+
+	copied.push_average();
+	no_copy.push_average();
+}
+
+TEST(http2_perf, priority_under_contention)
+{
+	measurement whole("[HTTP2] Image data before the stylesheet, unbounded writes (KiB)");
+	measurement budgeted("[HTTP2] Image data before the stylesheet, 64 KiB writes (KiB)");
+
+	whole.put(bytes_before_stylesheet(std::numeric_limits<size_t>::max()));
+	budgeted.put(bytes_before_stylesheet(64 * 1024));
+
+	whole.push_average();
+	budgeted.push_average();
+}
+
+TEST(http2_perf, batched_writes)
+{
+	measurement eager("[HTTP2] Socket writes per 100 small responses, written as they come");
+	measurement batched("[HTTP2] Socket writes per 100 small responses, flushed once per turn");
+
+	eager.put(writes_per_hundred_responses(false));
+	batched.put(writes_per_hundred_responses(true));
+
+	eager.push_average();
+	batched.push_average();
+}